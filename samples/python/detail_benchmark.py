@@ -0,0 +1,72 @@
+'''
+Created on Oct 19, 2026
+
+@author: consultit
+'''
+
+import panda3d.core
+from p3recastnavigation import RNNavMeshManager, RNNavMesh
+from panda3d.core import load_prc_file_data
+from direct.showbase.ShowBase import ShowBase
+import multiprocessing
+import time
+
+dataDir = "../data"
+
+# Compares the serial and the parallel (parallel_detail) builds of the detail
+# meshes: a SOLO nav mesh, with a small detail_sample_dist so that the detail
+# meshes dominate the setup time, on 1, 2, ... up to all the hardware threads.
+detailSampleDist = "1.0"
+numRounds = 5
+
+def benchmark(parallelDetail, buildThreads):
+    """return the best setup time of a SOLO nav mesh"""
+
+    navMesMgr = RNNavMeshManager.get_global_ptr()
+    navMesMgr.set_parameter_value(RNNavMeshManager.NAVMESH, "navmesh_type",
+            "solo")
+    navMesMgr.set_parameter_value(RNNavMeshManager.NAVMESH,
+            "detail_sample_dist", detailSampleDist)
+    navMesMgr.set_parameter_value(RNNavMeshManager.NAVMESH, "parallel_detail",
+            "true" if parallelDetail else "false")
+    navMesMgr.set_parameter_value(RNNavMeshManager.NAVMESH, "build_threads",
+            str(buildThreads))
+
+    sceneNP = app.loader.load_model("dungeon.egg")
+    best = None
+    for r in range(numRounds):
+        navMeshNP = navMesMgr.create_nav_mesh()
+        navMesh = navMeshNP.node()
+        navMesh.set_owner_node_path(sceneNP)
+        startTime = time.time()
+        navMesh.setup()
+        setupTime = time.time() - startTime
+        best = setupTime if best is None else min(best, setupTime)
+        navMesh.cleanup()
+        navMesMgr.destroy_nav_mesh(navMeshNP)
+    return best
+
+if __name__ == '__main__':
+    # Load your application's configuration
+    load_prc_file_data("", "model-path " + dataDir)
+    load_prc_file_data("", "window-type none")
+
+    # Setup your application
+    app = ShowBase()
+
+    # # here is room for your own code
+    print("create a nav mesh manager")
+    navMesMgr = RNNavMeshManager()
+
+    serialTime = benchmark(False, 1)
+    print("\nserial setup (s): " + str(serialTime))
+    threads = 2
+    numCores = multiprocessing.cpu_count()
+    while True:
+        parallelTime = benchmark(True, threads)
+        print("parallel_detail x " + str(threads) + " setup (s): " +
+                str(parallelTime) + " (speedup " +
+                str(serialTime / parallelTime) + ")")
+        if threads >= numCores:
+            break
+        threads = min(threads * 2, numCores)
@@ -0,0 +1,110 @@
+'''
+Created on Oct 19, 2026
+
+@author: consultit
+'''
+
+import panda3d.core
+from p3recastnavigation import RNNavMeshManager, RNNavMesh, ValueList_LPoint3f
+from panda3d.core import load_prc_file_data, LPoint3f
+from direct.showbase.ShowBase import ShowBase
+import random
+import time
+
+dataDir = "../data"
+
+# Compares the specialized filters of path_find_filtered() with the stock one
+# (AREA_COST_FILTER, i.e. dtQueryFilter): the same random queries are timed
+# with each filter, and the number of paths equal to the stock ones counted.
+numQueries = 400
+numDangerAreas = 4
+numRounds = 5
+seed = 1
+
+def timeQueries(query, pairs):
+    """return the best time per query (us) and the paths of the last round"""
+
+    best = None
+    for r in range(numRounds):
+        paths = []
+        startTime = time.time()
+        for startPos, endPos in pairs:
+            paths.append(query(startPos, endPos))
+        queryTime = (time.time() - startTime) / len(pairs) * 1e6
+        best = queryTime if best is None else min(best, queryTime)
+    return best, paths
+
+def samePath(path1, path2):
+    if path1.size() != path2.size():
+        return False
+    for i in range(path1.size()):
+        if not path1[i].almost_equal(path2[i]):
+            return False
+    return True
+
+def filterQuery(navMesh, pathFilter):
+    return lambda startPos, endPos: navMesh.path_find_filtered(startPos,
+            endPos, pathFilter)
+
+def benchmark(navMeshType):
+    """print the query times of the filters on a nav mesh type"""
+
+    navMesMgr.set_parameter_value(RNNavMeshManager.NAVMESH, "navmesh_type",
+            navMeshType)
+    navMesMgr.set_parameter_value(RNNavMeshManager.NAVMESH, "build_all_tiles",
+            "true")
+
+    sceneNP = app.loader.load_model("dungeon.egg")
+    navMeshNP = navMesMgr.create_nav_mesh()
+    navMesh = navMeshNP.node()
+    navMesh.set_owner_node_path(sceneNP)
+    navMesh.setup()
+
+    # random query extremes over the scene, snapped to the nav mesh
+    random.seed(seed)
+    minP, maxP = sceneNP.get_tight_bounds()
+    def randomPoint():
+        return LPoint3f(random.uniform(minP.get_x(), maxP.get_x()),
+                random.uniform(minP.get_y(), maxP.get_y()),
+                (minP.get_z() + maxP.get_z()) * 0.5)
+    points = ValueList_LPoint3f()
+    for i in range(numQueries * 2):
+        points.add_value(randomPoint())
+    nearestPoints = navMesh.find_nearest_points(points)
+    pairs = [(nearestPoints[2 * i], nearestPoints[2 * i + 1])
+            for i in range(numQueries)]
+    for i in range(numDangerAreas):
+        navMesh.add_danger_area(nearestPoints[i], 3.0, 10.0)
+
+    print("\n" + navMeshType + ": " + str(numQueries) + " queries, " +
+            str(navMesh.get_num_danger_areas()) + " danger areas")
+    stockTime, stockPaths = timeQueries(
+            filterQuery(navMesh, RNNavMesh.AREA_COST_FILTER), pairs)
+    print("AREA_COST_FILTER (stock, us/query): " + str(stockTime))
+    for name, pathFilter in [("SHORTEST_FILTER", RNNavMesh.SHORTEST_FILTER),
+            ("DANGER_FILTER", RNNavMesh.DANGER_FILTER)]:
+        filterTime, filterPaths = timeQueries(filterQuery(navMesh, pathFilter),
+                pairs)
+        same = sum(1 for p1, p2 in zip(stockPaths, filterPaths)
+                if samePath(p1, p2))
+        print(name + " (us/query): " + str(filterTime) + " (speedup " +
+                str(stockTime / filterTime) + ", " + str(same) + "/" +
+                str(numQueries) + " paths as stock)")
+
+    navMesh.cleanup()
+    navMesMgr.destroy_nav_mesh(navMeshNP)
+
+if __name__ == '__main__':
+    # Load your application's configuration
+    load_prc_file_data("", "model-path " + dataDir)
+    load_prc_file_data("", "window-type none")
+
+    # Setup your application
+    app = ShowBase()
+
+    # # here is room for your own code
+    print("create a nav mesh manager")
+    navMesMgr = RNNavMeshManager()
+
+    for navMeshType in ["solo", "tile"]:
+        benchmark(navMeshType)
@@ -0,0 +1,82 @@
+'''
+Created on Mar 24, 2016
+
+@author: consultit
+'''
+
+import panda3d.core
+from p3recastnavigation import RNNavMeshManager, RNNavMesh, ValueList_LPoint3f
+from panda3d.core import load_prc_file_data, LPoint3f, Notify
+from direct.showbase.ShowBase import ShowBase
+import time
+
+dataDir = "../data"
+
+# Compares 32 and 64 bit polygon references: run this sample with the module
+# built with polyref64=0 and then with polyref64=1 (see config.ini).
+gridSize = 24
+numRounds = 10
+
+def benchmark(navMeshType):
+    """print memory usage and path finding times of a nav mesh type"""
+
+    navMesMgr = RNNavMeshManager.get_global_ptr()
+    navMesMgr.set_parameter_value(RNNavMeshManager.NAVMESH, "navmesh_type",
+            navMeshType)
+    navMesMgr.set_parameter_value(RNNavMeshManager.NAVMESH, "build_all_tiles",
+            "true")
+
+    sceneNP = app.loader.load_model("dungeon.egg")
+    navMeshNP = navMesMgr.create_nav_mesh()
+    navMesh = navMeshNP.node()
+    navMesh.set_owner_node_path(sceneNP)
+
+    startTime = time.time()
+    navMesh.setup()
+    setupTime = time.time() - startTime
+
+    print("\n" + navMeshType + ":")
+    print("setup (s): " + str(setupTime))
+    navMesh.output_memory_usage(Notify.out())
+
+    # sample points on a grid over the scene, snapped to the nav mesh
+    minP, maxP = sceneNP.get_tight_bounds()
+    points = ValueList_LPoint3f()
+    for i in range(gridSize):
+        for j in range(gridSize):
+            x = minP.get_x() + (maxP.get_x() - minP.get_x()) * i / (gridSize - 1)
+            y = minP.get_y() + (maxP.get_y() - minP.get_y()) * j / (gridSize - 1)
+            points.add_value(LPoint3f(x, y, (minP.get_z() + maxP.get_z()) * 0.5))
+    startTime = time.time()
+    for r in range(numRounds):
+        nearestPoints = navMesh.find_nearest_points(points)
+    nearestTime = (time.time() - startTime) / numRounds
+    print("find_nearest_points (s): " + str(nearestTime))
+
+    # path find between the opposite points of the grid
+    numPoints = nearestPoints.size()
+    startTime = time.time()
+    for r in range(numRounds):
+        for i in range(numPoints):
+            navMesh.path_find_follow(nearestPoints[i],
+                    nearestPoints[numPoints - 1 - i])
+    pathTime = (time.time() - startTime) / numRounds
+    print("path_find_follow x " + str(numPoints) + " (s): " + str(pathTime))
+
+    navMesh.cleanup()
+    navMesMgr.destroy_nav_mesh(navMeshNP)
+
+if __name__ == '__main__':
+    # Load your application's configuration
+    load_prc_file_data("", "model-path " + dataDir)
+    load_prc_file_data("", "window-type none")
+
+    # Setup your application
+    app = ShowBase()
+
+    # # here is room for your own code
+    print("create a nav mesh manager")
+    navMesMgr = RNNavMeshManager()
+
+    for navMeshType in ["solo", "tile", "obstacle"]:
+        benchmark(navMeshType)
@@ -0,0 +1,101 @@
+'''
+Created on Oct 19, 2026
+
+@author: consultit
+'''
+
+import panda3d.core
+from p3recastnavigation import RNNavMeshManager, RNNavMesh
+from panda3d.core import load_prc_file_data, LPoint3f, LVector3f, NodePath
+from direct.showbase.ShowBase import ShowBase
+
+dataDir = "../data"
+
+# Checks that refresh_geometry() rebuilds only the tiles touched by a moved
+# object: those overlapping its bounds, before and after the move, grown by
+# the tile border (agent radius plus a few cells).
+cellSize = 0.3
+agentRadius = 0.6
+borderCells = 4
+moves = [(2.0, 0.0), (0.0, -3.0), (6.0, 6.0)]
+
+def touchedTiles(navMesh, objectNP, margin):
+    """return the set of tiles overlapping the grown bounds of objectNP"""
+
+    minP, maxP = objectNP.get_tight_bounds(navMesMgr.get_reference_node_path())
+    minT = navMesh.get_tile_indexes(LPoint3f(minP.get_x() - margin,
+            minP.get_y() - margin, minP.get_z()))
+    maxT = navMesh.get_tile_indexes(LPoint3f(maxP.get_x() + margin,
+            maxP.get_y() + margin, minP.get_z()))
+    # the y axis is flipped in recast coordinates
+    tiles = set()
+    for tx in range(min(minT[0], maxT[0]), max(minT[0], maxT[0]) + 1):
+        for ty in range(min(minT[1], maxT[1]), max(minT[1], maxT[1]) + 1):
+            tiles.add((tx, ty))
+    return tiles
+
+def check(navMeshType):
+    """move an object over the scene and check the tiles refreshed"""
+
+    navMesMgr.set_parameter_value(RNNavMeshManager.NAVMESH, "navmesh_type",
+            navMeshType)
+    navMesMgr.set_parameter_value(RNNavMeshManager.NAVMESH, "build_all_tiles",
+            "true")
+    navMesMgr.set_parameter_value(RNNavMeshManager.NAVMESH, "cell_size",
+            str(cellSize))
+    navMesMgr.set_parameter_value(RNNavMeshManager.NAVMESH, "agent_radius",
+            str(agentRadius))
+
+    # the owner object: the scene with a plant placed in its middle
+    ownerNP = NodePath("owner")
+    ownerNP.reparent_to(navMesMgr.get_reference_node_path())
+    sceneNP = app.loader.load_model("dungeon.egg")
+    sceneNP.reparent_to(ownerNP)
+    plantNP = app.loader.load_model("plants2.egg")
+    plantNP.reparent_to(ownerNP)
+    minP, maxP = sceneNP.get_tight_bounds(ownerNP)
+    plantNP.set_pos((minP + maxP) * 0.5)
+
+    navMeshNP = navMesMgr.create_nav_mesh()
+    navMesh = navMeshNP.node()
+    navMesh.set_owner_node_path(ownerNP)
+    navMesh.setup()
+
+    margin = agentRadius + borderCells * cellSize
+    print("\n" + navMeshType + ":")
+    ok = True
+    # refreshing the unchanged geometry rebuilds nothing
+    count = navMesh.refresh_geometry()
+    print("no move: " + str(count) + " tiles")
+    ok = ok and (count == 0)
+    for dx, dy in moves:
+        tiles = touchedTiles(navMesh, plantNP, margin)
+        plantNP.set_pos(plantNP.get_pos() + LVector3f(dx, dy, 0.0))
+        tiles |= touchedTiles(navMesh, plantNP, margin)
+        count = navMesh.refresh_geometry()
+        print("move (" + str(dx) + ", " + str(dy) + "): " + str(count) +
+                " tiles, " + str(len(tiles)) + " touched")
+        ok = ok and (0 < count <= len(tiles))
+    print("OK" if ok else "FAILED")
+
+    navMesh.cleanup()
+    navMesMgr.destroy_nav_mesh(navMeshNP)
+    ownerNP.remove_node()
+    return ok
+
+if __name__ == '__main__':
+    # Load your application's configuration
+    load_prc_file_data("", "model-path " + dataDir)
+    load_prc_file_data("", "window-type none")
+
+    # Setup your application
+    app = ShowBase()
+
+    # # here is room for your own code
+    print("create a nav mesh manager")
+    navMesMgr = RNNavMeshManager()
+    navMesMgr.get_reference_node_path().reparent_to(app.render)
+
+    results = [check(navMeshType) for navMeshType in ["tile", "obstacle"]]
+    if not all(results):
+        raise SystemExit(1)
@@ -116,6 +116,10 @@ def run_cmake(config, args):
              fatal_error("Your Panda3D build was not compiled with freetype support, but it is required!")
         cmake_args += ["-DHAVE_LIB_FREETYPE=TRUE"]
 
+    # 64 bit polygon references
+    if "polyref64" in config and config["polyref64"] in ["1", "yes", "y"]:
+        cmake_args += ["-DPOLYREF64=TRUE"]
+
     # Optimization level
     optimize = 3
 
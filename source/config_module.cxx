@@ -4,6 +4,7 @@
 #include "rnCrowdAgent.h"
 #include "rnNavMesh.h"
 #include "rnNavMeshManager.h"
+#include "support/NavMeshAlloc.h"
 
 
 Configure( config_recastnavigation );
@@ -23,6 +24,10 @@ init_librecastnavigation() {
 
   // Init your dynamic types here, e.g.:
   // MyDynamicClass::init_type();
+  // Recast/Detour allocation functions must be installed before any
+  // rcAlloc/dtAlloc call.
+  rnsup::installNavMeshAllocator();
+
   RNNavMesh::init_type();
   RNCrowdAgent::init_type();
   RNNavMeshManager::init_type();
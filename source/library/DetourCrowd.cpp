@@ -29,6 +29,7 @@
 #include "DetourMath.h"
 #include "DetourAssert.h"
 #include "DetourAlloc.h"
+#include "DetourFlowField.h"
 
 
 dtCrowd* dtAllocCrowd()
@@ -48,8 +49,11 @@ void dtFreeCrowd(dtCrowd* ptr)
 
 static const int MAX_ITERS_PER_UPDATE = 100;
 
-static const int MAX_PATHQUEUE_NODES = 4096;
+// Node pools start small and grow up to the caps on the longer searches.
+static const int MAX_PATHQUEUE_NODES = 1024;
+static const int MAX_PATHQUEUE_NODES_CAP = 16384;
 static const int MAX_COMMON_NODES = 512;
+static const int MAX_COMMON_NODES_CAP = 4096;
 
 inline float tween(const float t, const float t0, const float t1)
 {
@@ -254,42 +258,6 @@ static int addToOptQueue(dtCrowdAgent* newag, dtCrowdAgent** agents, const int n
 	return dtMin(nagents+1, maxAgents);
 }
 
-static int addToPathQueue(dtCrowdAgent* newag, dtCrowdAgent** agents, const int nagents, const int maxAgents)
-{
-	// Insert neighbour based on greatest time.
-	int slot = 0;
-	if (!nagents)
-	{
-		slot = nagents;
-	}
-	else if (newag->targetReplanTime <= agents[nagents-1]->targetReplanTime)
-	{
-		if (nagents >= maxAgents)
-			return nagents;
-		slot = nagents;
-	}
-	else
-	{
-		int i;
-		for (i = 0; i < nagents; ++i)
-			if (newag->targetReplanTime >= agents[i]->targetReplanTime)
-				break;
-		
-		const int tgt = i+1;
-		const int n = dtMin(nagents-i, maxAgents-tgt);
-		
-		dtAssert(tgt+n <= maxAgents);
-		
-		if (n > 0)
-			memmove(&agents[tgt], &agents[i], sizeof(dtCrowdAgent*)*n);
-		slot = i;
-	}
-	
-	agents[slot] = newag;
-	
-	return dtMin(nagents+1, maxAgents);
-}
-
 
 /**
 @class dtCrowd
@@ -334,6 +302,8 @@ dtCrowd::dtCrowd() :
 	m_agents(0),
 	m_activeAgents(0),
 	m_agentAnims(0),
+	m_pathqMaxIters(0),
+	m_pathqMaxTimeUsec(0),
 	m_obstacleQuery(0),
 	m_grid(0),
 	m_pathResult(0),
@@ -423,8 +393,10 @@ bool dtCrowd::init(const int maxAgents, const float maxAgentRadius, dtNavMesh* n
 	if (!m_pathResult)
 		return false;
 	
-	if (!m_pathq.init(m_maxPathResult, MAX_PATHQUEUE_NODES, nav))
+	if (!m_pathq.init(m_maxPathResult, MAX_PATHQUEUE_NODES, nav, 0, MAX_PATHQUEUE_NODES_CAP))
 		return false;
+	m_pathqMaxIters = MAX_ITERS_PER_UPDATE;
+	m_pathqMaxTimeUsec = 0;
 	
 	m_agents = (dtCrowdAgent*)dtAlloc(sizeof(dtCrowdAgent)*m_maxAgents, DT_ALLOC_PERM);
 	if (!m_agents)
@@ -455,7 +427,7 @@ bool dtCrowd::init(const int maxAgents, const float maxAgentRadius, dtNavMesh* n
 	m_navquery = dtAllocNavMeshQuery();
 	if (!m_navquery)
 		return false;
-	if (dtStatusFailed(m_navquery->init(nav, MAX_COMMON_NODES)))
+	if (dtStatusFailed(m_navquery->init(nav, MAX_COMMON_NODES, MAX_COMMON_NODES_CAP)))
 		return false;
 	
 	return true;
@@ -467,6 +439,28 @@ void dtCrowd::setObstacleAvoidanceParams(const int idx, const dtObstacleAvoidanc
 		memcpy(&m_obstacleQueryParams[idx], params, sizeof(dtObstacleAvoidanceParams));
 }
 
+/// @par
+///
+/// Path requests in progress are restarted if the number of workers changes.
+bool dtCrowd::setPathQueueParams(const int maxIters, const int maxTimeUsec, const int numWorkers)
+{
+	m_pathqMaxIters = maxIters;
+	m_pathqMaxTimeUsec = maxTimeUsec;
+	if (numWorkers == m_pathq.getWorkerCount())
+		return true;
+	return m_pathq.setWorkerCount(numWorkers);
+}
+
+void dtCrowd::getPathQueueParams(int* maxIters, int* maxTimeUsec, int* numWorkers) const
+{
+	if (maxIters)
+		*maxIters = m_pathqMaxIters;
+	if (maxTimeUsec)
+		*maxTimeUsec = m_pathqMaxTimeUsec;
+	if (numWorkers)
+		*numWorkers = m_pathq.getWorkerCount();
+}
+
 const dtObstacleAvoidanceParams* dtCrowd::getObstacleAvoidanceParams(const int idx) const
 {
 	if (idx >= 0 && idx < DT_CROWD_MAX_OBSTAVOIDANCE_PARAMS)
@@ -559,6 +553,12 @@ int dtCrowd::addAgent(const float* pos, const dtCrowdAgentParams* params)
 		ag->state = DT_CROWDAGENT_STATE_INVALID;
 	
 	ag->targetState = DT_CROWDAGENT_TARGET_NONE;
+	ag->flowField = 0;
+	ag->flowFieldVersion = 0;
+	ag->pathPriority = 0.0f;
+	ag->leaderIdx = -1;
+	dtVset(ag->formationOffset, 0,0,0);
+	dtVset(ag->followDir, 0,0,0);
 	
 	ag->active = true;
 
@@ -569,14 +569,187 @@ int dtCrowd::addAgent(const float* pos, const dtCrowdAgentParams* params)
 ///
 /// The agent is deactivated and will no longer be processed.  Its #dtCrowdAgent object
 /// is not removed from the pool.  It is marked as inactive so that it is available for reuse.
+/// The agents following it stop.
 void dtCrowd::removeAgent(const int idx)
 {
 	if (idx >= 0 && idx < m_maxAgents)
 	{
 		m_agents[idx].active = false;
+		for (int i = 0; i < m_maxAgents; ++i)
+		{
+			if (m_agents[i].active && m_agents[i].targetState == DT_CROWDAGENT_TARGET_FOLLOW &&
+				m_agents[i].leaderIdx == idx)
+				resetMoveTarget(i);
+		}
 	}
 }
 
+struct dtCrowdAgentState
+{
+	int magic;								// Magic number, used to identify the data.
+	int version;							// Data version number.
+	bool active;
+	unsigned char state;
+	bool partial;
+	unsigned char targetState;
+	bool targetReplan;
+	float topologyOptTime;
+	float desiredSpeed;
+	float npos[3], dvel[3], nvel[3], vel[3];
+	dtCrowdAgentParams params;
+	float cornerVerts[DT_CROWDAGENT_MAX_CORNERS*3];
+	unsigned char cornerFlags[DT_CROWDAGENT_MAX_CORNERS];
+	dtPolyRef cornerPolys[DT_CROWDAGENT_MAX_CORNERS];
+	int ncorners;
+	dtPolyRef targetRef;
+	float targetPos[3];
+	float targetReplanTime;
+	const dtFlowField* flowField;
+	unsigned int flowFieldVersion;
+	float pathPriority;
+	int leaderIdx;
+	float formationOffset[3], followDir[3];
+	dtCrowdAgentAnimation anim;
+	float corridorPos[3], corridorTarget[3];
+	int npath;								// Path polygons follow the state.
+};
+
+///  @see #storeAgentState
+int dtCrowd::getAgentStateSize() const
+{
+	const int headerSize = dtAlign4(sizeof(dtCrowdAgentState));
+	const int pathSize = dtAlign4(sizeof(dtPolyRef) * m_maxPathResult);
+	return headerSize + pathSize;
+}
+
+/// @par
+///
+/// The state refers to the polygons of the navigation mesh, so it can be
+/// restored as long as the polygon references are valid.
+/// @see #getAgentStateSize, #restoreAgentState
+dtStatus dtCrowd::storeAgentState(const int idx, unsigned char* data, const int maxDataSize) const
+{
+	if (idx < 0 || idx >= m_maxAgents)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	// Make sure there is enough space to store the state.
+	if (maxDataSize < getAgentStateSize())
+		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+
+	const dtCrowdAgent* ag = &m_agents[idx];
+	dtCrowdAgentState* agentState = dtGetThenAdvanceBufferPointer<dtCrowdAgentState>(data, dtAlign4(sizeof(dtCrowdAgentState)));
+	dtPolyRef* path = dtGetThenAdvanceBufferPointer<dtPolyRef>(data, dtAlign4(sizeof(dtPolyRef) * m_maxPathResult));
+
+	memset(agentState, 0, sizeof(dtCrowdAgentState));
+	agentState->magic = DT_CROWD_AGENT_STATE_MAGIC;
+	agentState->version = DT_CROWD_AGENT_STATE_VERSION;
+	agentState->active = ag->active;
+	agentState->state = ag->state;
+	agentState->partial = ag->partial;
+	agentState->targetState = ag->targetState;
+	agentState->targetReplan = ag->targetReplan;
+	agentState->topologyOptTime = ag->topologyOptTime;
+	agentState->desiredSpeed = ag->desiredSpeed;
+	dtVcopy(agentState->npos, ag->npos);
+	dtVcopy(agentState->dvel, ag->dvel);
+	dtVcopy(agentState->nvel, ag->nvel);
+	dtVcopy(agentState->vel, ag->vel);
+	agentState->params = ag->params;
+	memcpy(agentState->cornerVerts, ag->cornerVerts, sizeof(ag->cornerVerts));
+	memcpy(agentState->cornerFlags, ag->cornerFlags, sizeof(ag->cornerFlags));
+	memcpy(agentState->cornerPolys, ag->cornerPolys, sizeof(ag->cornerPolys));
+	agentState->ncorners = ag->ncorners;
+	agentState->targetRef = ag->targetRef;
+	dtVcopy(agentState->targetPos, ag->targetPos);
+	agentState->targetReplanTime = ag->targetReplanTime;
+	agentState->flowField = ag->flowField;
+	agentState->flowFieldVersion = ag->flowFieldVersion;
+	agentState->pathPriority = ag->pathPriority;
+	agentState->leaderIdx = ag->leaderIdx;
+	dtVcopy(agentState->formationOffset, ag->formationOffset);
+	dtVcopy(agentState->followDir, ag->followDir);
+	agentState->anim = m_agentAnims[idx];
+	dtVcopy(agentState->corridorPos, ag->corridor.getPos());
+	dtVcopy(agentState->corridorTarget, ag->corridor.getTarget());
+	agentState->npath = ag->corridor.getPathCount();
+	memcpy(path, ag->corridor.getPath(), sizeof(dtPolyRef) * agentState->npath);
+
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// The local boundary and the neighbours are updated on the next #update().
+/// A path request which was in progress is submitted again.
+/// @see #storeAgentState
+dtStatus dtCrowd::restoreAgentState(const int idx, const unsigned char* data, const int maxDataSize)
+{
+	if (idx < 0 || idx >= m_maxAgents)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	// Make sure there is enough space to restore the state.
+	if (maxDataSize < getAgentStateSize())
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const dtCrowdAgentState* agentState = dtGetThenAdvanceBufferPointer<const dtCrowdAgentState>(data, dtAlign4(sizeof(dtCrowdAgentState)));
+	const dtPolyRef* path = dtGetThenAdvanceBufferPointer<const dtPolyRef>(data, dtAlign4(sizeof(dtPolyRef) * m_maxPathResult));
+
+	// Check that the restore is possible.
+	if (agentState->magic != DT_CROWD_AGENT_STATE_MAGIC)
+		return DT_FAILURE | DT_WRONG_MAGIC;
+	if (agentState->version != DT_CROWD_AGENT_STATE_VERSION)
+		return DT_FAILURE | DT_WRONG_VERSION;
+	if (agentState->npath < 0 || agentState->npath > m_maxPathResult)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	dtCrowdAgent* ag = &m_agents[idx];
+	ag->active = agentState->active;
+	ag->state = agentState->state;
+	ag->partial = agentState->partial;
+	ag->targetState = agentState->targetState;
+	ag->targetReplan = agentState->targetReplan;
+	ag->topologyOptTime = agentState->topologyOptTime;
+	ag->desiredSpeed = agentState->desiredSpeed;
+	dtVcopy(ag->npos, agentState->npos);
+	dtVset(ag->disp, 0,0,0);
+	dtVcopy(ag->dvel, agentState->dvel);
+	dtVcopy(ag->nvel, agentState->nvel);
+	dtVcopy(ag->vel, agentState->vel);
+	ag->params = agentState->params;
+	memcpy(ag->cornerVerts, agentState->cornerVerts, sizeof(ag->cornerVerts));
+	memcpy(ag->cornerFlags, agentState->cornerFlags, sizeof(ag->cornerFlags));
+	memcpy(ag->cornerPolys, agentState->cornerPolys, sizeof(ag->cornerPolys));
+	ag->ncorners = agentState->ncorners;
+	ag->nneis = 0;
+	ag->targetRef = agentState->targetRef;
+	dtVcopy(ag->targetPos, agentState->targetPos);
+	ag->targetReplanTime = agentState->targetReplanTime;
+	ag->flowField = agentState->flowField;
+	ag->flowFieldVersion = agentState->flowFieldVersion;
+	ag->pathPriority = agentState->pathPriority;
+	ag->leaderIdx = agentState->leaderIdx;
+	dtVcopy(ag->formationOffset, agentState->formationOffset);
+	dtVcopy(ag->followDir, agentState->followDir);
+	m_agentAnims[idx] = agentState->anim;
+
+	// Restore the corridor.
+	if (agentState->npath > 0)
+	{
+		ag->corridor.reset(path[0], agentState->corridorPos);
+		ag->corridor.setCorridor(agentState->corridorTarget, path, agentState->npath);
+	}
+	else
+	{
+		ag->corridor.reset(0, agentState->corridorPos);
+	}
+	ag->boundary.reset();
+
+	// The path queue is not part of the state: request the path again.
+	ag->targetPathqRef = DT_PATHQ_INVALID;
+	if (ag->targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_PATH)
+		ag->targetState = DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE;
+
+	return DT_SUCCESS;
+}
+
 bool dtCrowd::requestMoveTargetReplan(const int idx, dtPolyRef ref, const float* pos)
 {
 	if (idx < 0 || idx >= m_maxAgents)
@@ -618,6 +791,8 @@ bool dtCrowd::requestMoveTarget(const int idx, dtPolyRef ref, const float* pos)
 	dtVcopy(ag->targetPos, pos);
 	ag->targetPathqRef = DT_PATHQ_INVALID;
 	ag->targetReplan = false;
+	ag->flowField = 0;
+	ag->leaderIdx = -1;
 	if (ag->targetRef)
 		ag->targetState = DT_CROWDAGENT_TARGET_REQUESTING;
 	else
@@ -639,10 +814,82 @@ bool dtCrowd::requestMoveVelocity(const int idx, const float* vel)
 	ag->targetPathqRef = DT_PATHQ_INVALID;
 	ag->targetReplan = false;
 	ag->targetState = DT_CROWDAGENT_TARGET_VELOCITY;
+	ag->flowField = 0;
+	ag->leaderIdx = -1;
 	
 	return true;
 }
 
+/// @par
+///
+/// The agent corridor is taken from the flow field during #update(), and it is
+/// taken again when the flow field changes or when its end is near.
+bool dtCrowd::requestMoveFlowField(const int idx, const dtFlowField* field)
+{
+	if (idx < 0 || idx >= m_maxAgents)
+		return false;
+	if (!field)
+		return false;
+
+	dtCrowdAgent* ag = &m_agents[idx];
+
+	// Initialize request.
+	ag->targetRef = 0;
+	dtVcopy(ag->targetPos, ag->npos);
+	ag->targetPathqRef = DT_PATHQ_INVALID;
+	ag->targetReplan = false;
+	ag->targetState = DT_CROWDAGENT_TARGET_FLOW_FIELD;
+	ag->flowField = field;
+	// Force a new corridor.
+	ag->flowFieldVersion = field->getVersion() - 1;
+	ag->leaderIdx = -1;
+
+	return true;
+}
+
+/// @par
+///
+/// The slot is moved along the navigation mesh surface from the leader, so
+/// it is never behind a wall as seen from the leader. The agent corridor end is
+/// moved to the slot during #update(), and a local path to the slot is searched
+/// only when that fails.
+bool dtCrowd::requestMoveFollow(const int idx, const int leaderIdx, const float* offset)
+{
+	if (idx < 0 || idx >= m_maxAgents)
+		return false;
+	if (leaderIdx < 0 || leaderIdx >= m_maxAgents || leaderIdx == idx)
+		return false;
+	if (!m_agents[leaderIdx].active || m_agents[leaderIdx].targetState == DT_CROWDAGENT_TARGET_FOLLOW)
+		return false;
+
+	dtCrowdAgent* ag = &m_agents[idx];
+
+	// Initialize request.
+	ag->targetRef = 0;
+	dtVcopy(ag->targetPos, ag->npos);
+	ag->targetPathqRef = DT_PATHQ_INVALID;
+	// Force a path to the slot.
+	ag->targetReplan = true;
+	ag->targetReplanTime = 0;
+	ag->targetState = DT_CROWDAGENT_TARGET_FOLLOW;
+	ag->flowField = 0;
+	ag->leaderIdx = leaderIdx;
+	dtVcopy(ag->formationOffset, offset);
+	dtVset(ag->followDir, 0,0,0);
+
+	return true;
+}
+
+/// @par
+///
+/// The priority applies from the next path request of the agent.
+void dtCrowd::setAgentPathPriority(const int idx, const float priority)
+{
+	if (idx < 0 || idx >= m_maxAgents)
+		return;
+	m_agents[idx].pathPriority = priority;
+}
+
 bool dtCrowd::resetMoveTarget(const int idx)
 {
 	if (idx < 0 || idx >= m_maxAgents)
@@ -657,6 +904,8 @@ bool dtCrowd::resetMoveTarget(const int idx)
 	ag->targetPathqRef = DT_PATHQ_INVALID;
 	ag->targetReplan = false;
 	ag->targetState = DT_CROWDAGENT_TARGET_NONE;
+	ag->flowField = 0;
+	ag->leaderIdx = -1;
 	
 	return true;
 }
@@ -676,10 +925,6 @@ int dtCrowd::getActiveAgents(dtCrowdAgent** agents, const int maxAgents)
 
 void dtCrowd::updateMoveRequest(const float /*dt*/)
 {
-	const int PATH_MAX_AGENTS = 8;
-	dtCrowdAgent* queue[PATH_MAX_AGENTS];
-	int nqueue = 0;
-	
 	// Fire off new requests.
 	for (int i = 0; i < m_maxAgents; ++i)
 	{
@@ -762,24 +1007,20 @@ void dtCrowd::updateMoveRequest(const float /*dt*/)
 			}
 		}
 		
+		// The path queue grows as needed and serves the requests by
+		// priority, so all the waiting agents can be queued.
 		if (ag->targetState == DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE)
 		{
-			nqueue = addToPathQueue(ag, queue, nqueue, PATH_MAX_AGENTS);
+			ag->targetPathqRef = m_pathq.request(ag->corridor.getLastPoly(), ag->targetRef,
+												 ag->corridor.getTarget(), ag->targetPos,
+												 &m_filters[ag->params.queryFilterType], ag->pathPriority);
+			if (ag->targetPathqRef != DT_PATHQ_INVALID)
+				ag->targetState = DT_CROWDAGENT_TARGET_WAITING_FOR_PATH;
 		}
 	}
 
-	for (int i = 0; i < nqueue; ++i)
-	{
-		dtCrowdAgent* ag = queue[i];
-		ag->targetPathqRef = m_pathq.request(ag->corridor.getLastPoly(), ag->targetRef,
-											 ag->corridor.getTarget(), ag->targetPos, &m_filters[ag->params.queryFilterType]);
-		if (ag->targetPathqRef != DT_PATHQ_INVALID)
-			ag->targetState = DT_CROWDAGENT_TARGET_WAITING_FOR_PATH;
-	}
-
-	
 	// Update requests.
-	m_pathq.update(MAX_ITERS_PER_UPDATE);
+	m_pathq.update(m_pathqMaxIters, m_pathqMaxTimeUsec);
 
 	dtStatus status;
 
@@ -919,7 +1160,8 @@ void dtCrowd::updateTopologyOptimization(dtCrowdAgent** agents, const int nagent
 		dtCrowdAgent* ag = agents[i];
 		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
 			continue;
-		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
+		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY ||
+			ag->targetState == DT_CROWDAGENT_TARGET_FLOW_FIELD || ag->targetState == DT_CROWDAGENT_TARGET_FOLLOW)
 			continue;
 		if ((ag->params.updateFlags & DT_CROWD_OPTIMIZE_TOPO) == 0)
 			continue;
@@ -992,6 +1234,28 @@ void dtCrowd::checkPathValidity(dtCrowdAgent** agents, const int nagents, const
 		if (ag->targetState == DT_CROWDAGENT_TARGET_NONE || ag->targetState == DT_CROWDAGENT_TARGET_VELOCITY)
 			continue;
 
+		// Flow field agents take their corridor from the flow field, which is repaired by its owner.
+		if (ag->targetState == DT_CROWDAGENT_TARGET_FLOW_FIELD)
+		{
+			if (replan || !ag->corridor.isValid(CHECK_LOOKAHEAD, m_navquery, &m_filters[ag->params.queryFilterType]))
+				ag->flowFieldVersion = ag->flowField->getVersion() - 1;
+			continue;
+		}
+
+		// Followers move their corridor to their slot: search a new one if not
+		// valid, from where the agent is, dropping any pending search.
+		if (ag->targetState == DT_CROWDAGENT_TARGET_FOLLOW)
+		{
+			if (replan || !ag->corridor.isValid(CHECK_LOOKAHEAD, m_navquery, &m_filters[ag->params.queryFilterType]))
+			{
+				ag->corridor.reset(ag->corridor.getFirstPoly(), ag->npos);
+				ag->targetPathqRef = DT_PATHQ_INVALID;
+				ag->targetReplan = true;
+				ag->targetReplanTime = TARGET_REPLAN_DELAY;
+			}
+			continue;
+		}
+
 		// Try to recover move request position.
 		if (ag->targetState != DT_CROWDAGENT_TARGET_NONE && ag->targetState != DT_CROWDAGENT_TARGET_FAILED)
 		{
@@ -1043,6 +1307,187 @@ void dtCrowd::checkPathValidity(dtCrowdAgent** agents, const int nagents, const
 	}
 }
 	
+void dtCrowd::updateFlowFields(dtCrowdAgent** agents, const int nagents)
+{
+	static const int FLOW_FIELD_MIN_PATH = 10;
+
+	for (int i = 0; i < nagents; ++i)
+	{
+		dtCrowdAgent* ag = agents[i];
+		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+			continue;
+		if (ag->targetState != DT_CROWDAGENT_TARGET_FLOW_FIELD)
+			continue;
+
+		// Take a new corridor if the flow field changed, or if the end of the
+		// current one is near and it is not a goal.
+		const dtFlowField* field = ag->flowField;
+		if (ag->flowFieldVersion == field->getVersion() &&
+			(ag->corridor.getPathCount() >= FLOW_FIELD_MIN_PATH || field->isGoal(ag->corridor.getLastPoly())))
+			continue;
+		ag->flowFieldVersion = field->getVersion();
+
+		const int npath = field->getPath(ag->corridor.getFirstPoly(), m_pathResult, m_maxPathResult);
+		if (!npath)
+		{
+			// Goals can't be reached from here: stay.
+			ag->corridor.reset(ag->corridor.getFirstPoly(), ag->npos);
+			ag->targetRef = 0;
+			dtVcopy(ag->targetPos, ag->npos);
+			ag->partial = true;
+			continue;
+		}
+		ag->targetRef = m_pathResult[npath-1];
+		field->getTargetPos(ag->targetRef, ag->targetPos);
+		ag->corridor.setCorridor(ag->targetPos, m_pathResult, npath);
+		ag->partial = !field->isGoal(ag->targetRef);
+	}
+}
+
+bool dtCrowd::appendFollowerPath(dtCrowdAgent* ag, int nres, const float* slotPos)
+{
+	// The result in m_pathResult starts where the corridor ended when the
+	// request was issued: the corridor end is not moved meanwhile.
+	const dtPolyRef* path = ag->corridor.getPath();
+	const int npath = ag->corridor.getPathCount();
+	dtPolyRef* res = m_pathResult;
+	if (!npath || path[npath-1] != res[0])
+		return false;
+	
+	// Put the old path in front of the result, without trackbacks.
+	if (npath > 1)
+	{
+		if ((npath-1)+nres > m_maxPathResult)
+			nres = m_maxPathResult - (npath-1);
+		memmove(res+npath-1, res, sizeof(dtPolyRef)*nres);
+		memcpy(res, path, sizeof(dtPolyRef)*(npath-1));
+		nres += npath-1;
+		for (int j = 0; j < nres; ++j)
+		{
+			if (j-1 >= 0 && j+1 < nres && res[j-1] == res[j+1])
+			{
+				memmove(res+(j-1), res+(j+1), sizeof(dtPolyRef)*(nres-(j+1)));
+				nres -= 2;
+				j -= 2;
+			}
+		}
+	}
+	
+	// The slot may have moved off the last polygon in the meantime.
+	float target[3];
+	dtVcopy(target, slotPos);
+	if (dtStatusFailed(m_navquery->closestPointOnPoly(res[nres-1], slotPos, target, 0)))
+		return false;
+	ag->corridor.setCorridor(target, res, nres);
+	return true;
+}
+
+void dtCrowd::updateFollowers(dtCrowdAgent** agents, const int nagents)
+{
+	static const float FOLLOW_REPLAN_DELAY = 0.5f; // seconds
+	static const int MAX_VISITED = 16;
+
+	for (int i = 0; i < nagents; ++i)
+	{
+		dtCrowdAgent* ag = agents[i];
+		if (ag->state != DT_CROWDAGENT_STATE_WALKING)
+			continue;
+		if (ag->targetState != DT_CROWDAGENT_TARGET_FOLLOW)
+			continue;
+
+		const dtCrowdAgent* leader = &m_agents[ag->leaderIdx];
+		const dtQueryFilter* filter = &m_filters[ag->params.queryFilterType];
+
+		// Leader heading: toward the next corner of its corridor, else along its velocity.
+		float dir[3];
+		if (leader->ncorners > 0)
+			dtVsub(dir, &leader->cornerVerts[0], leader->npos);
+		else
+			dtVcopy(dir, leader->vel);
+		dir[1] = 0;
+		if (dtVlenSqr(dir) > dtSqr(0.01f))
+		{
+			dtVnormalize(dir);
+			dtVcopy(ag->followDir, dir);
+		}
+		const float* fwd = ag->followDir;
+
+		// Formation slot, moved along the surface from the leader.
+		float slot[3];
+		dtVcopy(slot, leader->npos);
+		slot[0] += -fwd[2]*ag->formationOffset[0] + fwd[0]*ag->formationOffset[2];
+		slot[2] += fwd[0]*ag->formationOffset[0] + fwd[2]*ag->formationOffset[2];
+		float slotPos[3];
+		dtPolyRef visited[MAX_VISITED];
+		int nvisited = 0;
+		m_navquery->moveAlongSurface(leader->corridor.getFirstPoly(), leader->npos, slot, filter,
+									 slotPos, visited, &nvisited, MAX_VISITED);
+		if (!nvisited)
+			continue;
+		const dtPolyRef slotRef = visited[nvisited-1];
+		float h = slotPos[1];
+		m_navquery->getPolyHeight(slotRef, slotPos, &h);
+		slotPos[1] = h;
+
+		// Collect the path to the slot requested to the path queue, if any,
+		// appending it to the corridor as for the other agents.
+		if (ag->targetPathqRef != DT_PATHQ_INVALID)
+		{
+			const dtStatus status = m_pathq.getRequestStatus(ag->targetPathqRef);
+			if (dtStatusFailed(status))
+			{
+				// Retry later.
+				ag->targetPathqRef = DT_PATHQ_INVALID;
+			}
+			else if (dtStatusSucceed(status))
+			{
+				int nres = 0;
+				const dtStatus resStatus = m_pathq.getPathResult(ag->targetPathqRef, m_pathResult, &nres, m_maxPathResult);
+				ag->targetPathqRef = DT_PATHQ_INVALID;
+				if (dtStatusSucceed(resStatus) && nres > 0 && appendFollowerPath(ag, nres, slotPos))
+					ag->targetReplan = false;
+			}
+		}
+		
+		// Move the corridor end to the slot, unless a path to it is pending.
+		if (!ag->targetReplan && ag->targetPathqRef == DT_PATHQ_INVALID)
+		{
+			ag->corridor.moveTargetPosition(slotPos, m_navquery, filter);
+			if (ag->corridor.getLastPoly() != slotRef)
+				ag->targetReplan = true;
+		}
+		
+		// Else, when the agent is on the leader's path to the slot, it just
+		// takes the rest of it.
+		if (ag->targetReplan && ag->targetPathqRef == DT_PATHQ_INVALID)
+		{
+			for (int j = 0; j < nvisited; ++j)
+			{
+				if (visited[j] != ag->corridor.getFirstPoly())
+					continue;
+				ag->corridor.setCorridor(slotPos, &visited[j], nvisited-j);
+				ag->targetReplan = false;
+				ag->targetReplanTime = 0;
+				break;
+			}
+		}
+		
+		// Else request a path from the corridor end to the slot, not too
+		// often: it is searched within the path queue budget.
+		if (ag->targetReplan && ag->targetPathqRef == DT_PATHQ_INVALID &&
+			(!ag->targetRef || ag->targetReplanTime >= FOLLOW_REPLAN_DELAY))
+		{
+			ag->targetPathqRef = m_pathq.request(ag->corridor.getLastPoly(), slotRef,
+												 ag->corridor.getTarget(), slotPos, filter, ag->pathPriority);
+			ag->targetReplanTime = 0;
+		}
+
+		ag->targetRef = slotRef;
+		dtVcopy(ag->targetPos, slotPos);
+		ag->partial = ag->corridor.getLastPoly() != slotRef;
+	}
+}
+
 void dtCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug)
 {
 	m_velocitySampleCount = 0;
@@ -1058,6 +1503,12 @@ void dtCrowd::update(const float dt, dtCrowdAgentDebugInfo* debug)
 	// Update async move request and path finder.
 	updateMoveRequest(dt);
 
+	// Update the corridors of the agents following flow fields.
+	updateFlowFields(agents, nagents);
+
+	// Update the corridors of the agents following leaders.
+	updateFollowers(agents, nagents);
+
 	// Optimize path topology.
 	updateTopologyOptimization(agents, nagents, dt);
 	
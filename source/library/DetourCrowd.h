@@ -26,6 +26,8 @@
 #include "DetourProximityGrid.h"
 #include "DetourPathQueue.h"
 
+class dtFlowField;
+
 /// The maximum number of neighbors that a crowd agent can take into account
 /// for steering decisions.
 /// @ingroup crowd
@@ -51,6 +53,15 @@ static const int DT_CROWD_MAX_OBSTAVOIDANCE_PARAMS = 8;
 ///		dtCrowdAgentParams::queryFilterType
 static const int DT_CROWD_MAX_QUERY_FILTER_TYPE = 16;
 
+/// A magic number used to detect the compatibility of crowd agent state data.
+/// @ingroup crowd
+/// @see dtCrowd::storeAgentState()
+static const int DT_CROWD_AGENT_STATE_MAGIC = 'D'<<24 | 'C'<<16 | 'A'<<8 | 'S';
+
+/// A version number used to detect the compatibility of crowd agent state data.
+/// @ingroup crowd
+static const int DT_CROWD_AGENT_STATE_VERSION = 2;
+
 /// Provides neighbor data for agents managed by the crowd.
 /// @ingroup crowd
 /// @see dtCrowdAgent::neis, dtCrowd
@@ -109,6 +120,8 @@ enum MoveRequestState
 	DT_CROWDAGENT_TARGET_WAITING_FOR_QUEUE,
 	DT_CROWDAGENT_TARGET_WAITING_FOR_PATH,
 	DT_CROWDAGENT_TARGET_VELOCITY,
+	DT_CROWDAGENT_TARGET_FLOW_FIELD,
+	DT_CROWDAGENT_TARGET_FOLLOW,
 };
 
 /// Represents an agent managed by a #dtCrowd object.
@@ -169,6 +182,12 @@ struct dtCrowdAgent
 	dtPathQueueRef targetPathqRef;		///< Path finder ref.
 	bool targetReplan;					///< Flag indicating that the current path is being replanned.
 	float targetReplanTime;				/// <Time since the agent's target was replanned.
+	const dtFlowField* flowField;		///< Flow field followed in case of DT_CROWDAGENT_TARGET_FLOW_FIELD.
+	unsigned int flowFieldVersion;		///< Version of the flow field the corridor was taken from.
+	float pathPriority;					///< Priority of the path requests, in path queue update ticks. (See: #dtPathQueue::request)
+	int leaderIdx;						///< Index of the agent followed in case of DT_CROWDAGENT_TARGET_FOLLOW, else -1.
+	float formationOffset[3];			///< Formation slot relative to the leader. (See: #dtCrowd::requestMoveFollow) [(x, y, z)]
+	float followDir[3];					///< Last known heading of the leader. [(x, y, z)]
 };
 
 struct dtCrowdAgentAnimation
@@ -208,6 +227,8 @@ class dtCrowd
 	dtCrowdAgentAnimation* m_agentAnims;
 	
 	dtPathQueue m_pathq;
+	int m_pathqMaxIters;
+	int m_pathqMaxTimeUsec;
 
 	dtObstacleAvoidanceParams m_obstacleQueryParams[DT_CROWD_MAX_OBSTAVOIDANCE_PARAMS];
 	dtObstacleAvoidanceQuery* m_obstacleQuery;
@@ -230,6 +251,9 @@ class dtCrowd
 	void updateTopologyOptimization(dtCrowdAgent** agents, const int nagents, const float dt);
 	void updateMoveRequest(const float dt);
 	void checkPathValidity(dtCrowdAgent** agents, const int nagents, const float dt);
+	void updateFlowFields(dtCrowdAgent** agents, const int nagents);
+	bool appendFollowerPath(dtCrowdAgent* ag, int nres, const float* slotPos);
+	void updateFollowers(dtCrowdAgent** agents, const int nagents);
 
 	inline int getAgentIndex(const dtCrowdAgent* agent) const  { return (int)(agent - m_agents); }
 
@@ -287,6 +311,25 @@ public:
 	/// Removes the agent from the crowd.
 	///  @param[in]		idx		The agent index. [Limits: 0 <= value < #getAgentCount()]
 	void removeAgent(const int idx);
+
+	/// Gets the size of the buffer required by #storeAgentState to store an agent's state.
+	/// @return The size of the agent's state.
+	int getAgentStateSize() const;
+
+	/// Stores the runtime state of the specified agent: position, velocities,
+	/// move request and path corridor.
+	///  @param[in]		idx				The agent index. [Limits: 0 <= value < #getAgentCount()]
+	///  @param[out]	data			The buffer to store the agent's state in.
+	///  @param[in]		maxDataSize		The size of the data buffer. [Limit: >= #getAgentStateSize]
+	/// @return The status flags for the operation.
+	dtStatus storeAgentState(const int idx, unsigned char* data, const int maxDataSize) const;
+
+	/// Restores the runtime state of the specified agent.
+	///  @param[in]		idx				The agent index. [Limits: 0 <= value < #getAgentCount()]
+	///  @param[in]		data			The agent's state. (Obtained from #storeAgentState.)
+	///  @param[in]		maxDataSize		The size of the state within the data buffer.
+	/// @return The status flags for the operation.
+	dtStatus restoreAgentState(const int idx, const unsigned char* data, const int maxDataSize);
 	
 	/// Submits a new move request for the specified agent.
 	///  @param[in]		idx		The agent index. [Limits: 0 <= value < #getAgentCount()]
@@ -301,6 +344,30 @@ public:
 	/// @return True if the request was successfully submitted.
 	bool requestMoveVelocity(const int idx, const float* vel);
 
+	/// Submits a new move request for the specified agent, toward the goals of a flow field.
+	/// The agent corridor is taken from the flow field, so no path is ever requested.
+	///  @param[in]		idx		The agent index. [Limits: 0 <= value < #getAgentCount()]
+	///  @param[in]		field	The flow field, which must outlive the request.
+	/// @return True if the request was successfully submitted.
+	bool requestMoveFlowField(const int idx, const dtFlowField* field);
+
+	/// Submits a new move request for the specified agent, following a leader agent
+	/// at a formation slot: the agent steers along a short corridor to the slot,
+	/// which is moved with the leader. When the slot leaves the corridor the agent
+	/// takes the leader's path to the slot, if on it, else requests a path to the
+	/// path queue, within its budget.
+	///  @param[in]		idx			The agent index. [Limits: 0 <= value < #getAgentCount()]
+	///  @param[in]		leaderIdx	The leader agent index, which must not follow another agent.
+	///  @param[in]		offset		The slot relative to the leader, along the right of its heading
+	///  							and along its heading. [(right, unused, forward)]
+	/// @return True if the request was successfully submitted.
+	bool requestMoveFollow(const int idx, const int leaderIdx, const float* offset);
+
+	/// Sets the priority of the path requests of the specified agent.
+	///  @param[in]		idx			The agent index. [Limits: 0 <= value < #getAgentCount()]
+	///  @param[in]		priority	The priority, in path queue update ticks. (See: #dtPathQueue::request)
+	void setAgentPathPriority(const int idx, const float priority);
+
 	/// Resets any request for the specified agent.
 	///  @param[in]		idx		The agent index. [Limits: 0 <= value < #getAgentCount()]
 	/// @return True if the request was successfully reseted.
@@ -341,6 +408,16 @@ public:
 	/// @return The crowd's path request queue.
 	const dtPathQueue* getPathQueue() const { return &m_pathq; }
 
+	/// Sets the budget of the path request queue on each crowd update.
+	///  @param[in]		maxIters		The maximum number of pathfinder iterations. [Limit: <= 0 for no limit]
+	///  @param[in]		maxTimeUsec		The maximum time, in microseconds. [Limit: <= 0 for no limit]
+	///  @param[in]		numWorkers		The number of worker threads serving the requests.
+	/// @return True if the workers could be started.
+	bool setPathQueueParams(const int maxIters, const int maxTimeUsec, const int numWorkers);
+
+	/// Gets the budget of the path request queue on each crowd update.
+	void getPathQueueParams(int* maxIters, int* maxTimeUsec, int* numWorkers) const;
+
 	/// Gets the query object used by the crowd.
 	const dtNavMeshQuery* getNavMeshQuery() const { return m_navquery; }
 
@@ -0,0 +1,541 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include <float.h>
+#include <new>
+#include "DetourFlowField.h"
+#include "DetourCommon.h"
+#include "DetourAssert.h"
+#include "DetourAlloc.h"
+
+
+dtFlowField* dtAllocFlowField()
+{
+	void* mem = dtAlloc(sizeof(dtFlowField), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtFlowField;
+}
+
+void dtFreeFlowField(dtFlowField* field)
+{
+	if (!field) return;
+	field->~dtFlowField();
+	dtFree(field);
+}
+
+// Midpoint of the portal of the link, on the edge of the polygon owning it.
+static void getLinkPortalMid(const dtMeshTile* tile, const dtPoly* poly, const dtLink& link, float* mid)
+{
+	const float* va = &tile->verts[poly->verts[link.edge]*3];
+	const float* vb = &tile->verts[poly->verts[(link.edge+1) % poly->vertCount]*3];
+	if (link.side != 0xff && (link.bmin != 0 || link.bmax != 255))
+	{
+		// Tile boundary links can span only part of the edge.
+		const float s = 1.0f/255.0f;
+		float left[3], right[3];
+		dtVlerp(left, va, vb, link.bmin*s);
+		dtVlerp(right, va, vb, link.bmax*s);
+		dtVlerp(mid, left, right, 0.5f);
+	}
+	else
+	{
+		dtVlerp(mid, va, vb, 0.5f);
+	}
+}
+
+dtFlowField::dtFlowField() :
+	m_nav(0),
+	m_tiles(0),
+	m_maxTiles(0),
+	m_goalRefs(0),
+	m_goalPos(0),
+	m_ngoals(0),
+	m_heap(0),
+	m_heapSize(0),
+	m_heapCapacity(0),
+	m_version(0)
+{
+}
+
+dtFlowField::~dtFlowField()
+{
+	purge();
+}
+
+void dtFlowField::purge()
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+		dtFree(m_tiles[i].next);
+	dtFree(m_tiles);
+	m_tiles = 0;
+	m_maxTiles = 0;
+	dtFree(m_goalRefs);
+	m_goalRefs = 0;
+	dtFree(m_goalPos);
+	m_goalPos = 0;
+	m_ngoals = 0;
+	dtFree(m_heap);
+	m_heap = 0;
+	m_heapSize = 0;
+	m_heapCapacity = 0;
+}
+
+dtStatus dtFlowField::init(const dtNavMesh* nav)
+{
+	purge();
+	if (!nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	m_nav = nav;
+
+	m_maxTiles = nav->getMaxTiles();
+	m_tiles = (TileField*)dtAlloc(sizeof(TileField)*m_maxTiles, DT_ALLOC_PERM);
+	if (!m_tiles)
+	{
+		m_maxTiles = 0;
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memset(m_tiles, 0, sizeof(TileField)*m_maxTiles);
+	m_version++;
+
+	return DT_SUCCESS;
+}
+
+bool dtFlowField::resetTile(const int i)
+{
+	const dtMeshTile* tile = m_nav->getTile(i);
+	TileField* field = &m_tiles[i];
+	const int polyCount = tile->header ? tile->header->polyCount : 0;
+	if (polyCount != field->polyCount)
+	{
+		dtFree(field->next);
+		memset(field, 0, sizeof(TileField));
+		if (polyCount)
+		{
+			// One block: refs first, they could be wider than floats.
+			const int size = polyCount*((int)sizeof(dtPolyRef) + (int)sizeof(float)*4);
+			unsigned char* mem = (unsigned char*)dtAlloc(size, DT_ALLOC_PERM);
+			if (!mem)
+				return false;
+			field->next = (dtPolyRef*)mem;
+			field->costs = (float*)(mem + sizeof(dtPolyRef)*polyCount);
+			field->pos = field->costs + polyCount;
+		}
+		field->polyCount = polyCount;
+	}
+	field->salt = tile->header ? tile->salt : 0;
+	for (int j = 0; j < polyCount; ++j)
+	{
+		field->next[j] = 0;
+		field->costs[j] = FLT_MAX;
+		dtVset(&field->pos[j*3], 0,0,0);
+	}
+	return true;
+}
+
+bool dtFlowField::getData(dtPolyRef ref, const TileField** field, int* ip) const
+{
+	if (!m_nav || !ref)
+		return false;
+	unsigned int salt, it, ipoly;
+	m_nav->decodePolyId(ref, salt, it, ipoly);
+	if ((int)it >= m_maxTiles)
+		return false;
+	const TileField* f = &m_tiles[it];
+	if (!f->salt || f->salt != salt || (int)ipoly >= f->polyCount)
+		return false;
+	*field = f;
+	*ip = (int)ipoly;
+	return true;
+}
+
+bool dtFlowField::push(const float cost, dtPolyRef ref)
+{
+	if (m_heapSize == m_heapCapacity)
+	{
+		const int capacity = m_heapCapacity ? m_heapCapacity*2 : 256;
+		HeapItem* heap = (HeapItem*)dtAlloc(sizeof(HeapItem)*capacity, DT_ALLOC_PERM);
+		if (!heap)
+			return false;
+		if (m_heapSize)
+			memcpy(heap, m_heap, sizeof(HeapItem)*m_heapSize);
+		dtFree(m_heap);
+		m_heap = heap;
+		m_heapCapacity = capacity;
+	}
+	// Bubble up.
+	int i = m_heapSize++;
+	while (i > 0)
+	{
+		const int parent = (i-1)/2;
+		if (m_heap[parent].cost <= cost)
+			break;
+		m_heap[i] = m_heap[parent];
+		i = parent;
+	}
+	m_heap[i].cost = cost;
+	m_heap[i].ref = ref;
+	return true;
+}
+
+dtFlowField::HeapItem dtFlowField::pop()
+{
+	dtAssert(m_heapSize > 0);
+	const HeapItem result = m_heap[0];
+	const HeapItem last = m_heap[--m_heapSize];
+	// Trickle down.
+	int i = 0;
+	for (;;)
+	{
+		int child = i*2+1;
+		if (child >= m_heapSize)
+			break;
+		if (child+1 < m_heapSize && m_heap[child+1].cost < m_heap[child].cost)
+			child++;
+		if (last.cost <= m_heap[child].cost)
+			break;
+		m_heap[i] = m_heap[child];
+		i = child;
+	}
+	if (m_heapSize)
+		m_heap[i] = last;
+	return result;
+}
+
+/// @par
+///
+/// Dijkstra search from the items in the heap. Polygons are entered through the
+/// midpoint of the portal toward the next polygon, so the cost of a polygon is
+/// the cost of its next polygon plus the cost of walking from that portal to the
+/// point the next polygon is left through. Items are never decreased inside the
+/// heap: outdated ones are skipped when popped.
+void dtFlowField::expand()
+{
+	while (m_heapSize)
+	{
+		const HeapItem item = pop();
+		const TileField* field;
+		int ip;
+		if (!getData(item.ref, &field, &ip))
+			continue;
+		if (item.cost > field->costs[ip])
+			continue;
+
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(item.ref, &tile, &poly);
+		if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+			continue;
+		const float* pos = &field->pos[ip*3];
+
+		for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+		{
+			const dtLink& link = tile->links[i];
+			const dtPolyRef neighbourRef = link.ref;
+			const TileField* neighbourField;
+			int nip;
+			if (!getData(neighbourRef, &neighbourField, &nip))
+				continue;
+
+			const dtMeshTile* neighbourTile = 0;
+			const dtPoly* neighbourPoly = 0;
+			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
+			// Off-mesh connections are traversed only by explicit paths.
+			if (neighbourPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+				continue;
+			// The filter is stored by value, so it behaves as the default
+			// dtQueryFilter::passFilter() and dtQueryFilter::getCost().
+			if ((neighbourPoly->flags & m_filter.getIncludeFlags()) == 0 ||
+				(neighbourPoly->flags & m_filter.getExcludeFlags()) != 0)
+				continue;
+
+			float mid[3];
+			getLinkPortalMid(tile, poly, link, mid);
+			const float cost = item.cost + dtVdist(mid, pos)*m_filter.getAreaCost(poly->getArea());
+			if (cost >= neighbourField->costs[nip])
+				continue;
+
+			// Data of valid tiles is owned by the flow field.
+			TileField* nf = &m_tiles[neighbourField - m_tiles];
+			nf->costs[nip] = cost;
+			nf->next[nip] = item.ref;
+			dtVcopy(&nf->pos[nip*3], mid);
+			if (!push(cost, neighbourRef))
+			{
+				m_heapSize = 0;
+				return;
+			}
+		}
+	}
+}
+
+dtStatus dtFlowField::rebuild()
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (!resetTile(i))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	m_heapSize = 0;
+	int nvalid = 0;
+	for (int i = 0; i < m_ngoals; ++i)
+	{
+		const TileField* field;
+		int ip;
+		if (!getData(m_goalRefs[i], &field, &ip))
+			continue;
+		TileField* f = &m_tiles[field - m_tiles];
+		f->costs[ip] = 0.0f;
+		f->next[ip] = 0;
+		dtVcopy(&f->pos[ip*3], &m_goalPos[i*3]);
+		if (!push(0.0f, m_goalRefs[i]))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		nvalid++;
+	}
+	expand();
+	m_version++;
+
+	return nvalid ? DT_SUCCESS : DT_FAILURE | DT_INVALID_PARAM;
+}
+
+dtStatus dtFlowField::build(const dtPolyRef* goalRefs, const float* goalPos, const int ngoals,
+							const dtQueryFilter* filter)
+{
+	if (!m_nav)
+		return DT_FAILURE;
+	if (!goalRefs || !goalPos || ngoals <= 0 || !filter)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	m_filter = *filter;
+
+	if (ngoals != m_ngoals)
+	{
+		dtFree(m_goalRefs);
+		dtFree(m_goalPos);
+		m_ngoals = 0;
+		m_goalRefs = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*ngoals, DT_ALLOC_PERM);
+		m_goalPos = (float*)dtAlloc(sizeof(float)*3*ngoals, DT_ALLOC_PERM);
+		if (!m_goalRefs || !m_goalPos)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memcpy(m_goalRefs, goalRefs, sizeof(dtPolyRef)*ngoals);
+	memcpy(m_goalPos, goalPos, sizeof(float)*3*ngoals);
+	m_ngoals = ngoals;
+
+	return rebuild();
+}
+
+/// @par
+///
+/// Let be C the minimum between the old costs of the polygons of the changed
+/// tiles, and the costs of the unchanged polygons bordering the new ones: the
+/// polygons whose cost is lower than C don't depend on the changed tiles, so
+/// they are kept, while the others are searched again, starting from the kept
+/// polygons bordering them.
+/// If a goal polygon is in a changed tile the flow field is rebuilt, but if
+/// it's no longer valid the flow field is left as is: its changed tiles are
+/// unreached until build() is called again.
+dtStatus dtFlowField::update(bool* repaired)
+{
+	if (repaired)
+		*repaired = false;
+	if (!m_nav || !m_tiles)
+		return DT_FAILURE;
+
+	unsigned char* changed = (unsigned char*)dtAlloc(m_maxTiles, DT_ALLOC_TEMP);
+	if (!changed)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	// Find the changed tiles and their old minimum cost.
+	float threshold = FLT_MAX;
+	int nchanged = 0;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		const unsigned int salt = tile->header ? tile->salt : 0;
+		const TileField* field = &m_tiles[i];
+		changed[i] = salt != field->salt ? 1 : 0;
+		if (!changed[i])
+			continue;
+		nchanged++;
+		for (int j = 0; j < field->polyCount; ++j)
+			threshold = dtMin(threshold, field->costs[j]);
+	}
+	if (!nchanged)
+	{
+		dtFree(changed);
+		return DT_SUCCESS;
+	}
+	// Goals inside changed tiles: rebuild, unless a goal is no longer valid,
+	// then the goals must be found again by the caller.
+	bool goalChanged = false;
+	for (int i = 0; i < m_ngoals; ++i)
+	{
+		if (!changed[m_nav->decodePolyIdTile(m_goalRefs[i])])
+			continue;
+		if (!m_nav->isValidPolyRef(m_goalRefs[i]))
+		{
+			dtFree(changed);
+			return DT_SUCCESS | DT_PARTIAL_RESULT;
+		}
+		goalChanged = true;
+	}
+	if (repaired)
+		*repaired = true;
+	if (goalChanged)
+	{
+		dtFree(changed);
+		return rebuild();
+	}
+
+	// Reset the changed tiles, and get the costs of the polygons bordering them.
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (!changed[i])
+			continue;
+		if (!resetTile(i))
+		{
+			dtFree(changed);
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+		const dtMeshTile* tile = m_nav->getTile(i);
+		if (!tile->header)
+			continue;
+		for (int j = 0; j < tile->header->polyCount; ++j)
+		{
+			const dtPoly* poly = &tile->polys[j];
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+			{
+				const dtPolyRef neighbourRef = tile->links[k].ref;
+				if (!neighbourRef || changed[m_nav->decodePolyIdTile(neighbourRef)])
+					continue;
+				const TileField* field;
+				int ip;
+				if (getData(neighbourRef, &field, &ip))
+					threshold = dtMin(threshold, field->costs[ip]);
+			}
+		}
+	}
+	dtFree(changed);
+
+	// Invalidate the polygons that could depend on the changed tiles.
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		TileField* field = &m_tiles[i];
+		for (int j = 0; j < field->polyCount; ++j)
+		{
+			if (field->costs[j] >= threshold)
+			{
+				field->costs[j] = FLT_MAX;
+				field->next[j] = 0;
+			}
+		}
+	}
+
+	// Search again from the kept polygons bordering unreached ones.
+	m_heapSize = 0;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const TileField* field = &m_tiles[i];
+		if (!field->polyCount)
+			continue;
+		const dtMeshTile* tile = m_nav->getTile(i);
+		const dtPolyRef base = m_nav->getPolyRefBase(tile);
+		for (int j = 0; j < field->polyCount; ++j)
+		{
+			if (field->costs[j] == FLT_MAX)
+				continue;
+			const dtPoly* poly = &tile->polys[j];
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+			{
+				const TileField* neighbourField;
+				int nip;
+				if (getData(tile->links[k].ref, &neighbourField, &nip) &&
+					neighbourField->costs[nip] == FLT_MAX)
+				{
+					if (!push(field->costs[j], base | (dtPolyRef)j))
+						return DT_FAILURE | DT_OUT_OF_MEMORY;
+					break;
+				}
+			}
+		}
+	}
+	expand();
+	m_version++;
+
+	return DT_SUCCESS;
+}
+
+bool dtFlowField::getCost(dtPolyRef ref, float* cost) const
+{
+	const TileField* field;
+	int ip;
+	if (!getData(ref, &field, &ip) || field->costs[ip] == FLT_MAX)
+		return false;
+	if (cost)
+		*cost = field->costs[ip];
+	return true;
+}
+
+dtPolyRef dtFlowField::getNext(dtPolyRef ref) const
+{
+	const TileField* field;
+	int ip;
+	if (!getData(ref, &field, &ip))
+		return 0;
+	return field->next[ip];
+}
+
+bool dtFlowField::getTargetPos(dtPolyRef ref, float* pos) const
+{
+	const TileField* field;
+	int ip;
+	if (!getData(ref, &field, &ip) || field->costs[ip] == FLT_MAX)
+		return false;
+	dtVcopy(pos, &field->pos[ip*3]);
+	return true;
+}
+
+bool dtFlowField::isGoal(dtPolyRef ref) const
+{
+	const TileField* field;
+	int ip;
+	if (!getData(ref, &field, &ip))
+		return false;
+	return field->costs[ip] != FLT_MAX && !field->next[ip];
+}
+
+/// @par
+///
+/// Next polygons are changed only on strict cost improvements, so the path has no loops.
+int dtFlowField::getPath(dtPolyRef startRef, dtPolyRef* path, const int maxPath) const
+{
+	int n = 0;
+	dtPolyRef ref = startRef;
+	while (ref && n < maxPath)
+	{
+		const TileField* field;
+		int ip;
+		if (!getData(ref, &field, &ip) || field->costs[ip] == FLT_MAX)
+			break;
+		path[n++] = ref;
+		ref = field->next[ip];
+	}
+	return n;
+}
@@ -0,0 +1,156 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURFLOWFIELD_H
+#define DETOURFLOWFIELD_H
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+/// A distance map over the polygons of a navigation mesh, toward a set of
+/// goals: every reachable polygon stores its cost to the nearest goal and the
+/// next polygon to walk through, so any number of agents can head to the goals
+/// without path queries.
+/// @ingroup crowd
+class dtFlowField
+{
+	/// Per tile data, indexed by the polygon index inside the tile.
+	struct TileField
+	{
+		unsigned int salt;	///< Salt of the tile when the data was built, 0 if no data.
+		int polyCount;
+		dtPolyRef* next;	///< Next polygon toward the goals, 0 for goals and unreached polygons.
+		float* costs;		///< Cost to the goals, FLT_MAX for unreached polygons.
+		float* pos;			///< Portal midpoint toward the next polygon, or goal position. [(x, y, z) * polyCount]
+	};
+
+	struct HeapItem
+	{
+		float cost;
+		dtPolyRef ref;
+	};
+
+	const dtNavMesh* m_nav;
+	dtQueryFilter m_filter;
+
+	TileField* m_tiles;
+	int m_maxTiles;
+
+	dtPolyRef* m_goalRefs;
+	float* m_goalPos;
+	int m_ngoals;
+
+	HeapItem* m_heap;
+	int m_heapSize;
+	int m_heapCapacity;
+
+	unsigned int m_version;
+
+	void purge();
+	bool resetTile(const int i);
+	bool getData(dtPolyRef ref, const TileField** field, int* ip) const;
+	bool push(const float cost, dtPolyRef ref);
+	HeapItem pop();
+	void expand();
+	dtStatus rebuild();
+
+public:
+	dtFlowField();
+	~dtFlowField();
+
+	/// Initializes the flow field.
+	///  @param[in]		nav		The navigation mesh the flow field refers to.
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav);
+
+	/// Builds the flow field with a multi-source Dijkstra search from the goals.
+	///  @param[in]		goalRefs	The references of the goal polygons. [(polyRef) * @p ngoals]
+	///  @param[in]		goalPos		The goal positions. [(x, y, z) * @p ngoals]
+	///  @param[in]		ngoals		The number of goals.
+	///  @param[in]		filter		The polygon filter to apply. (Copied: derived filters behave as the base one.)
+	/// @returns The status flags for the operation.
+	dtStatus build(const dtPolyRef* goalRefs, const float* goalPos, const int ngoals,
+				   const dtQueryFilter* filter);
+
+	/// Repairs the flow field after tiles of the navigation mesh changed.
+	/// Only the polygons whose cost could have changed are searched again.
+	/// If a goal polygon is no longer valid, nothing is searched and
+	/// #DT_PARTIAL_RESULT is returned: the caller should find the goal
+	/// polygons again and call build().
+	///  @param[out]	repaired	True if the flow field changed. [opt]
+	/// @returns The status flags for the operation.
+	dtStatus update(bool* repaired = 0);
+
+	/// Gets the cost to reach the goals from the specified polygon.
+	///  @param[in]		ref		The polygon reference.
+	///  @param[out]	cost	The cost. [opt]
+	/// @returns True if the polygon can reach the goals.
+	bool getCost(dtPolyRef ref, float* cost) const;
+
+	/// Gets the next polygon toward the goals, or 0 for goal or unreached polygons.
+	dtPolyRef getNext(dtPolyRef ref) const;
+
+	/// Gets the point to steer to from the specified polygon: the midpoint of
+	/// the portal toward the next polygon, or the goal position.
+	/// @returns True if the polygon can reach the goals.
+	bool getTargetPos(dtPolyRef ref, float* pos) const;
+
+	/// Returns true if the specified polygon is a goal polygon.
+	bool isGoal(dtPolyRef ref) const;
+
+	/// Gets the polygons from the specified polygon toward the goals, by
+	/// following the next polygons.
+	///  @param[in]		startRef	The start polygon reference.
+	///  @param[out]	path		The polygons. [(polyRef) * @p maxPath]
+	///  @param[in]		maxPath		The maximum number of polygons.
+	/// @returns The number of polygons, 0 if the start polygon can't reach the goals.
+	int getPath(dtPolyRef startRef, dtPolyRef* path, const int maxPath) const;
+
+	/// Gets the version of the flow field: it changes on each build and repair.
+	inline unsigned int getVersion() const { return m_version; }
+
+	/// @name Goals
+	///@{
+	inline int getGoalCount() const { return m_ngoals; }
+	inline const dtPolyRef* getGoalRefs() const { return m_goalRefs; }
+	inline const float* getGoalPos() const { return m_goalPos; }
+	///@}
+
+	/// Gets the filter used by the flow field.
+	inline const dtQueryFilter* getFilter() const { return &m_filter; }
+
+	/// Gets the navigation mesh the flow field refers to.
+	inline const dtNavMesh* getNavMesh() const { return m_nav; }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtFlowField(const dtFlowField&);
+	dtFlowField& operator=(const dtFlowField&);
+};
+
+/// Allocates a flow field object using the Detour allocator.
+/// @return A flow field object that is ready for initialization, or null on failure.
+///  @ingroup crowd
+dtFlowField* dtAllocFlowField();
+
+/// Frees the specified flow field object using the Detour allocator.
+///  @param[in]		field		A flow field object allocated using #dtAllocFlowField
+///  @ingroup crowd
+void dtFreeFlowField(dtFlowField* field);
+
+#endif // DETOURFLOWFIELD_H
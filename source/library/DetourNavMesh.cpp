@@ -119,6 +119,29 @@ inline int computeTileHash(int x, int y, const int mask)
 	return (int)(n & mask);
 }
 
+// Gets the height of a detail triangle of a polygon at a location.
+inline bool getDetailTriHeight(const dtMeshTile* tile, const dtPoly* poly, const dtPolyDetail* pd,
+							   const int tri, const float* pos, float* height)
+{
+	const unsigned char* t = &tile->detailTris[(pd->triBase+tri)*4];
+	const float* v[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		if (t[k] < poly->vertCount)
+			v[k] = &tile->verts[poly->verts[t[k]]*3];
+		else
+			v[k] = &tile->detailVerts[(pd->vertBase+(t[k]-poly->vertCount))*3];
+	}
+	float h;
+	if (dtClosestHeightPointTriangle(pos, v[0], v[1], v[2], h))
+	{
+		if (height)
+			*height = h;
+		return true;
+	}
+	return false;
+}
+
 inline unsigned int allocLink(dtMeshTile* tile)
 {
 	if (tile->linksFreeList == DT_NULL_LINK)
@@ -270,7 +293,7 @@ dtStatus dtNavMesh::init(unsigned char* data, const int dataSize, const int flag
 	dtMeshHeader* header = (dtMeshHeader*)data;
 	if (header->magic != DT_NAVMESH_MAGIC)
 		return DT_FAILURE | DT_WRONG_MAGIC;
-	if (header->version != DT_NAVMESH_VERSION)
+	if (!dtNavMeshVersionSupported(header->version))
 		return DT_FAILURE | DT_WRONG_VERSION;
 
 	dtNavMeshParams params;
@@ -636,9 +659,6 @@ void dtNavMesh::closestPointOnPoly(dtPolyRef ref, const float* pos, float* close
 		return;
 	}
 	
-	const unsigned int ip = (unsigned int)(poly - tile->polys);
-	const dtPolyDetail* pd = &tile->detailMeshes[ip];
-	
 	// Clamp point to be inside the polygon.
 	float verts[DT_VERTS_PER_POLYGON*3];	
 	float edged[DT_VERTS_PER_POLYGON];
@@ -675,24 +695,43 @@ void dtNavMesh::closestPointOnPoly(dtPolyRef ref, const float* pos, float* close
 	}
 	
 	// Find height at the location.
-	for (int j = 0; j < pd->triCount; ++j)
+	float h;
+	if (getPolyHeight(tile, poly, closest, &h))
+		closest[1] = h;
+}
+
+/// @par
+///
+/// Only the detail triangles in the detail grid cell of the location are
+/// tested, if the tile has detail grids. The first triangle containing the
+/// location gives the height, as with a linear search over the triangles.
+bool dtNavMesh::getPolyHeight(const dtMeshTile* tile, const dtPoly* poly, const float* pos, float* height) const
+{
+	const unsigned int ip = (unsigned int)(poly - tile->polys);
+	const dtPolyDetail* pd = &tile->detailMeshes[ip];
+
+	const dtPolyDetailGrid* grid = tile->detailGrids ? &tile->detailGrids[ip] : 0;
+	if (grid && grid->width)
 	{
-		const unsigned char* t = &tile->detailTris[(pd->triBase+j)*4];
-		const float* v[3];
-		for (int k = 0; k < 3; ++k)
-		{
-			if (t[k] < poly->vertCount)
-				v[k] = &tile->verts[poly->verts[t[k]]*3];
-			else
-				v[k] = &tile->detailVerts[(pd->vertBase+(t[k]-poly->vertCount))*3];
-		}
-		float h;
-		if (dtClosestHeightPointTriangle(closest, v[0], v[1], v[2], h))
+		const int x = dtClamp((int)((pos[0] - grid->bmin[0]) * grid->invCellSize[0]), 0, (int)grid->width-1);
+		const int z = dtClamp((int)((pos[2] - grid->bmin[1]) * grid->invCellSize[1]), 0, (int)grid->height-1);
+		const unsigned short* cells = &tile->detailGridCells[grid->cellBase];
+		const int cell = x + z*grid->width;
+		for (int i = cells[cell]; i < cells[cell+1]; ++i)
 		{
-			closest[1] = h;
-			break;
+			if (getDetailTriHeight(tile, poly, pd, cells[i], pos, height))
+				return true;
 		}
+		// Not over the cell's triangles: the location is outside the polygon,
+		// or on a triangle edge within the epsilon of the height test.
+	}
+
+	for (int j = 0; j < pd->triCount; ++j)
+	{
+		if (getDetailTriHeight(tile, poly, pd, j, pos, height))
+			return true;
 	}
+	return false;
 }
 
 dtPolyRef dtNavMesh::findNearestPolyInTile(const dtMeshTile* tile,
@@ -850,7 +889,7 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	dtMeshHeader* header = (dtMeshHeader*)data;
 	if (header->magic != DT_NAVMESH_MAGIC)
 		return DT_FAILURE | DT_WRONG_MAGIC;
-	if (header->version != DT_NAVMESH_VERSION)
+	if (!dtNavMeshVersionSupported(header->version))
 		return DT_FAILURE | DT_WRONG_VERSION;
 		
 	// Make sure the location is free.
@@ -915,6 +954,8 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
 	const int bvtreeSize = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
 	const int offMeshLinksSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
+	const bool hasDetailGrids = (header->version & DT_NAVMESH_VERSION_DETAIL_GRID) != 0;
+	const int detailGridsSize = hasDetailGrids ? dtAlign4(sizeof(dtPolyDetailGrid)*header->detailMeshCount) : 0;
 	
 	unsigned char* d = data + headerSize;
 	tile->verts = dtGetThenAdvanceBufferPointer<float>(d, vertsSize);
@@ -925,6 +966,14 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	tile->detailTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailTrisSize);
 	tile->bvTree = dtGetThenAdvanceBufferPointer<dtBVNode>(d, bvtreeSize);
 	tile->offMeshCons = dtGetThenAdvanceBufferPointer<dtOffMeshConnection>(d, offMeshLinksSize);
+	tile->detailGrids = 0;
+	tile->detailGridCells = 0;
+	if (hasDetailGrids)
+	{
+		// The cells take the rest of the data.
+		tile->detailGrids = dtGetThenAdvanceBufferPointer<dtPolyDetailGrid>(d, detailGridsSize);
+		tile->detailGridCells = (unsigned short*)d;
+	}
 
 	// If there are no items in the bvtree, reset the tree pointer.
 	if (!bvtreeSize)
@@ -1246,6 +1295,8 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	tile->detailTris = 0;
 	tile->bvTree = 0;
 	tile->offMeshCons = 0;
+	tile->detailGrids = 0;
+	tile->detailGridCells = 0;
 
 	// Update salt, salt should never be zero.
 #ifdef DT_POLYREF64
@@ -25,6 +25,7 @@
 // Undefine (or define in a build cofnig) the following line to use 64bit polyref.
 // Generally not needed, useful for very large worlds.
 // Note: tiles build using 32bit refs are not compatible with 64bit refs!
+// Note: the build defines it when configured with POLYREF64 (see CMakeLists.txt).
 //#define DT_POLYREF64 1
 
 #ifdef DT_POLYREF64
@@ -72,12 +73,26 @@ static const int DT_NAVMESH_MAGIC = 'D'<<24 | 'N'<<16 | 'A'<<8 | 'V';
 /// A version number used to detect compatibility of navigation tile data.
 static const int DT_NAVMESH_VERSION = 7;
 
+/// A flag of the tile data version number: the data holds detail grids. (See dtPolyDetailGrid)
+/// Tiles without it are still supported, and search all the detail triangles of a polygon.
+static const int DT_NAVMESH_VERSION_DETAIL_GRID = 1<<16;
+
+/// The flags of the tile data version number, for optional sections of the tile data.
+static const int DT_NAVMESH_VERSION_FLAGS = 0x7fff<<16;
+
 /// A magic number used to detect the compatibility of navigation tile states.
 static const int DT_NAVMESH_STATE_MAGIC = 'D'<<24 | 'N'<<16 | 'M'<<8 | 'S';
 
 /// A version number used to detect compatibility of navigation tile states.
 static const int DT_NAVMESH_STATE_VERSION = 1;
 
+/// Checks that a tile data version number, with its flags, is supported.
+inline bool dtNavMeshVersionSupported(const int version)
+{
+	return (version & ~DT_NAVMESH_VERSION_FLAGS) == DT_NAVMESH_VERSION &&
+		(version & DT_NAVMESH_VERSION_FLAGS & ~DT_NAVMESH_VERSION_DETAIL_GRID) == 0;
+}
+
 /// @}
 
 /// A flag that indicates that an entity links to an external entity.
@@ -191,6 +206,20 @@ struct dtPolyDetail
 	unsigned char triCount;			///< The number of triangles in the sub-mesh.
 };
 
+/// Defines a grid over the detail sub-mesh of a polygon on the xz-plane, to find
+/// the detail triangles under a location without testing all of them.
+/// @note This structure is rarely if ever used by the end user.
+/// @see dtMeshTile
+struct dtPolyDetailGrid
+{
+	float bmin[2];					///< The minimum bounds of the grid. [(x, z)]
+	float invCellSize[2];			///< The inverse of the size of the cells. [(x, z)]
+	unsigned int cellBase;			///< The offset of the grid in the dtMeshTile::detailGridCells array.
+	unsigned char width;			///< The number of cells along the x-axis. (Zero if the polygon has no grid.)
+	unsigned char height;			///< The number of cells along the z-axis.
+	unsigned short size;			///< The number of items of the grid in the dtMeshTile::detailGridCells array.
+};
+
 /// Defines a link between polygons.
 /// @note This structure is rarely if ever used by the end user.
 /// @see dtMeshTile
@@ -295,6 +324,15 @@ struct dtMeshTile
 	dtBVNode* bvTree;
 
 	dtOffMeshConnection* offMeshCons;		///< The tile off-mesh connections. [Size: dtMeshHeader::offMeshConCount]
+
+	/// The detail grids of the polygons. [Size: dtMeshHeader::detailMeshCount]
+	/// (Will be null if the tile data has no #DT_NAVMESH_VERSION_DETAIL_GRID flag.)
+	dtPolyDetailGrid* detailGrids;
+
+	/// The detail grid cells: for each grid, the offsets of the cells' triangle lists
+	/// from dtPolyDetailGrid::cellBase [Size: width*height + 1], followed by the lists
+	/// of the detail triangles, relative to dtPolyDetail::triBase, overlapping each cell.
+	unsigned short* detailGridCells;
 		
 	unsigned char* data;					///< The tile data. (Not directly accessed under normal situations.)
 	int dataSize;							///< Size of the tile data.
@@ -428,6 +466,14 @@ public:
 	///  @param[out]	poly	The polygon.
 	void getTileAndPolyByRefUnsafe(const dtPolyRef ref, const dtMeshTile** tile, const dtPoly** poly) const;
 
+	/// Gets the height of the detail mesh of a ground polygon at a location.
+	///  @param[in]		tile	The tile containing the polygon.
+	///  @param[in]		poly	The polygon. [Type: #DT_POLYTYPE_GROUND]
+	///  @param[in]		pos		The location. [(x, y, z)]
+	///  @param[out]	height	The height of the detail mesh at the location.
+	/// @return True if the location is over the detail mesh of the polygon.
+	bool getPolyHeight(const dtMeshTile* tile, const dtPoly* poly, const float* pos, float* height) const;
+
 	/// Checks the validity of a polygon reference.
 	///  @param[in]	ref		The polygon reference to check.
 	/// @return True if polygon reference is valid for the navigation mesh.
@@ -29,6 +29,11 @@
 
 static unsigned short MESH_NULL_IDX = 0xffff;
 
+/// Polygons with fewer detail triangles have no detail grid.
+static const int DETAIL_GRID_MIN_TRIS = 8;
+/// Maximum number of detail grid cells along an axis.
+static const int DETAIL_GRID_MAX_SIZE = 16;
+
 
 struct BVItem
 {
@@ -37,37 +42,39 @@ struct BVItem
 	int i;
 };
 
-static int compareItemX(const void* va, const void* vb)
-{
-	const BVItem* a = (const BVItem*)va;
-	const BVItem* b = (const BVItem*)vb;
-	if (a->bmin[0] < b->bmin[0])
-		return -1;
-	if (a->bmin[0] > b->bmin[0])
-		return 1;
-	return 0;
-}
-
-static int compareItemY(const void* va, const void* vb)
-{
-	const BVItem* a = (const BVItem*)va;
-	const BVItem* b = (const BVItem*)vb;
-	if (a->bmin[1] < b->bmin[1])
-		return -1;
-	if (a->bmin[1] > b->bmin[1])
-		return 1;
-	return 0;
-}
-
-static int compareItemZ(const void* va, const void* vb)
+// Partially orders items[imin..imax) along the axis, so that the item at
+// isplit is in its sorted position, items before it are not greater and
+// items after it are not less (quickselect). This is all the median split
+// needs, and it's cheaper than a full sort at every level of the tree.
+static void partitionItems(BVItem* items, int imin, int imax, const int isplit, const int axis)
 {
-	const BVItem* a = (const BVItem*)va;
-	const BVItem* b = (const BVItem*)vb;
-	if (a->bmin[2] < b->bmin[2])
-		return -1;
-	if (a->bmin[2] > b->bmin[2])
-		return 1;
-	return 0;
+	int lo = imin;
+	int hi = imax-1;
+	while (lo < hi)
+	{
+		const unsigned short pivot = items[(lo+hi)/2].bmin[axis];
+		int i = lo;
+		int j = hi;
+		while (i <= j)
+		{
+			while (items[i].bmin[axis] < pivot) i++;
+			while (items[j].bmin[axis] > pivot) j--;
+			if (i <= j)
+			{
+				BVItem tmp = items[i];
+				items[i] = items[j];
+				items[j] = tmp;
+				i++;
+				j--;
+			}
+		}
+		if (isplit <= j)
+			hi = j;
+		else if (isplit >= i)
+			lo = i;
+		else
+			break;
+	}
 }
 
 static void calcExtends(BVItem* items, const int /*nitems*/, const int imin, const int imax,
@@ -139,24 +146,11 @@ static void subdivide(BVItem* items, int nitems, int imin, int imax, int& curNod
 							   node.bmax[1] - node.bmin[1],
 							   node.bmax[2] - node.bmin[2]);
 		
-		if (axis == 0)
-		{
-			// Sort along x-axis
-			qsort(items+imin, inum, sizeof(BVItem), compareItemX);
-		}
-		else if (axis == 1)
-		{
-			// Sort along y-axis
-			qsort(items+imin, inum, sizeof(BVItem), compareItemY);
-		}
-		else
-		{
-			// Sort along z-axis
-			qsort(items+imin, inum, sizeof(BVItem), compareItemZ);
-		}
-		
 		int isplit = imin+inum/2;
 		
+		// Split at the median along the longest axis.
+		partitionItems(items, imin, imax, isplit, axis);
+		
 		// Left
 		subdivide(items, nitems, imin, isplit, curNode, nodes);
 		// Right
@@ -268,6 +262,113 @@ static unsigned char classifyOffMeshPoint(const float* pt, const float* bmin, co
 	return 0xff;	
 }
 
+// Sets up the detail grid of a polygon, and fills its cells if they are
+// given. Cells hold about one triangle each, and list the triangles whose
+// bounds, slightly enlarged for the epsilon of the height test, overlap them.
+// Returns the number of items of the grid.
+static int buildPolyDetailGrid(const dtNavMeshCreateParams* params, const int ip,
+							   dtPolyDetailGrid* grid, unsigned short* cells)
+{
+	const unsigned int vb = params->detailMeshes[ip*4+0];
+	const unsigned int tb = params->detailMeshes[ip*4+2];
+	const int ntris = (int)params->detailMeshes[ip*4+3];
+	if (grid)
+		memset(grid, 0, sizeof(dtPolyDetailGrid));
+	if (ntris < DETAIL_GRID_MIN_TRIS)
+		return 0;
+
+	// Triangle bounds.
+	float tbounds[255*4];
+	float bmin[2] = { FLT_MAX, FLT_MAX }, bmax[2] = { -FLT_MAX, -FLT_MAX };
+	for (int i = 0; i < ntris; ++i)
+	{
+		const unsigned char* t = &params->detailTris[(tb+i)*4];
+		float* b = &tbounds[i*4];
+		b[0] = b[1] = FLT_MAX;
+		b[2] = b[3] = -FLT_MAX;
+		for (int k = 0; k < 3; ++k)
+		{
+			const float* v = &params->detailVerts[(vb+t[k])*3];
+			b[0] = dtMin(b[0], v[0]);
+			b[1] = dtMin(b[1], v[2]);
+			b[2] = dtMax(b[2], v[0]);
+			b[3] = dtMax(b[3], v[2]);
+		}
+		const float pad = 0.001f*dtMax(b[2]-b[0], b[3]-b[1]);
+		b[0] -= pad;
+		b[1] -= pad;
+		b[2] += pad;
+		b[3] += pad;
+		bmin[0] = dtMin(bmin[0], b[0]);
+		bmin[1] = dtMin(bmin[1], b[1]);
+		bmax[0] = dtMax(bmax[0], b[2]);
+		bmax[1] = dtMax(bmax[1], b[3]);
+	}
+
+	// About a triangle per cell, with square-ish cells.
+	const float w = dtMax(bmax[0]-bmin[0], 1e-4f);
+	const float h = dtMax(bmax[1]-bmin[1], 1e-4f);
+	const int width = dtClamp((int)(dtMathSqrtf(ntris*w/h) + 0.5f), 1, DETAIL_GRID_MAX_SIZE);
+	const int height = dtClamp((int)(dtMathSqrtf(ntris*h/w) + 0.5f), 1, DETAIL_GRID_MAX_SIZE);
+	const float inv[2] = { width/w, height/h };
+	const int ncells = width*height;
+
+	// Count the triangles per cell.
+	int offsets[DETAIL_GRID_MAX_SIZE*DETAIL_GRID_MAX_SIZE+1];
+	memset(offsets, 0, sizeof(offsets));
+	for (int i = 0; i < ntris; ++i)
+	{
+		const float* b = &tbounds[i*4];
+		const int x0 = dtClamp((int)((b[0]-bmin[0])*inv[0]), 0, width-1);
+		const int z0 = dtClamp((int)((b[1]-bmin[1])*inv[1]), 0, height-1);
+		const int x1 = dtClamp((int)((b[2]-bmin[0])*inv[0]), 0, width-1);
+		const int z1 = dtClamp((int)((b[3]-bmin[1])*inv[1]), 0, height-1);
+		for (int z = z0; z <= z1; ++z)
+			for (int x = x0; x <= x1; ++x)
+				offsets[x+z*width]++;
+	}
+	int size = ncells+1;
+	for (int i = 0; i <= ncells; ++i)
+	{
+		const int n = offsets[i];
+		offsets[i] = size;
+		size += n;
+	}
+	size = offsets[ncells];
+	if (size > 0xffff)
+		return 0;
+
+	if (grid)
+	{
+		grid->bmin[0] = bmin[0];
+		grid->bmin[1] = bmin[1];
+		grid->invCellSize[0] = inv[0];
+		grid->invCellSize[1] = inv[1];
+		grid->width = (unsigned char)width;
+		grid->height = (unsigned char)height;
+		grid->size = (unsigned short)size;
+	}
+	if (cells)
+	{
+		for (int i = 0; i <= ncells; ++i)
+			cells[i] = (unsigned short)offsets[i];
+		// Triangles in increasing order in each cell, so that the first one
+		// found is the same as with a linear search.
+		for (int i = 0; i < ntris; ++i)
+		{
+			const float* b = &tbounds[i*4];
+			const int x0 = dtClamp((int)((b[0]-bmin[0])*inv[0]), 0, width-1);
+			const int z0 = dtClamp((int)((b[1]-bmin[1])*inv[1]), 0, height-1);
+			const int x1 = dtClamp((int)((b[2]-bmin[0])*inv[0]), 0, width-1);
+			const int z1 = dtClamp((int)((b[3]-bmin[1])*inv[1]), 0, height-1);
+			for (int z = z0; z <= z1; ++z)
+				for (int x = x0; x <= x1; ++x)
+					cells[offsets[x+z*width]++] = (unsigned short)i;
+		}
+	}
+	return size;
+}
+
 // TODO: Better error handling.
 
 /// @par
@@ -431,12 +532,25 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*params->polyCount);
 	const int detailVertsSize = dtAlign4(sizeof(float)*3*uniqueDetailVertCount);
 	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*detailTriCount);
-	const int bvTreeSize = params->buildBvTree ? dtAlign4(sizeof(dtBVNode)*params->polyCount*2) : 0;
+	// The BV tree is always built: a binary tree with a leaf per polygon
+	// has exactly 2*polyCount-1 nodes.
+	const int bvNodeCount = params->polyCount > 0 ? params->polyCount*2-1 : 0;
+	const int bvTreeSize = dtAlign4(sizeof(dtBVNode)*bvNodeCount);
 	const int offMeshConsSize = dtAlign4(sizeof(dtOffMeshConnection)*storedOffMeshConCount);
+	// Detail grids, if some polygons have many detail triangles.
+	int detailGridItemCount = 0;
+	if (params->buildDetailGrid && params->detailMeshes)
+	{
+		for (int i = 0; i < params->polyCount; ++i)
+			detailGridItemCount += buildPolyDetailGrid(params, i, 0, 0);
+	}
+	const int detailGridsSize = detailGridItemCount ? dtAlign4(sizeof(dtPolyDetailGrid)*params->polyCount) : 0;
+	const int detailGridCellsSize = dtAlign4(sizeof(unsigned short)*detailGridItemCount);
 	
 	const int dataSize = headerSize + vertsSize + polysSize + linksSize +
 						 detailMeshesSize + detailVertsSize + detailTrisSize +
-						 bvTreeSize + offMeshConsSize;
+						 bvTreeSize + offMeshConsSize +
+						 detailGridsSize + detailGridCellsSize;
 						 
 	unsigned char* data = (unsigned char*)dtAlloc(sizeof(unsigned char)*dataSize, DT_ALLOC_PERM);
 	if (!data)
@@ -457,11 +571,13 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	unsigned char* navDTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailTrisSize);
 	dtBVNode* navBvtree = dtGetThenAdvanceBufferPointer<dtBVNode>(d, bvTreeSize);
 	dtOffMeshConnection* offMeshCons = dtGetThenAdvanceBufferPointer<dtOffMeshConnection>(d, offMeshConsSize);
+	dtPolyDetailGrid* navDGrids = dtGetThenAdvanceBufferPointer<dtPolyDetailGrid>(d, detailGridsSize);
+	unsigned short* navDGridCells = dtGetThenAdvanceBufferPointer<unsigned short>(d, detailGridCellsSize);
 	
 	
 	// Store header
 	header->magic = DT_NAVMESH_MAGIC;
-	header->version = DT_NAVMESH_VERSION;
+	header->version = DT_NAVMESH_VERSION | (detailGridItemCount ? DT_NAVMESH_VERSION_DETAIL_GRID : 0);
 	header->x = params->tileX;
 	header->y = params->tileY;
 	header->layer = params->tileLayer;
@@ -480,7 +596,7 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	header->walkableRadius = params->walkableRadius;
 	header->walkableClimb = params->walkableClimb;
 	header->offMeshConCount = storedOffMeshConCount;
-	header->bvNodeCount = params->buildBvTree ? params->polyCount*2 : 0;
+	header->bvNodeCount = bvNodeCount;
 	
 	const int offMeshVertsBase = params->vertCount;
 	const int offMeshPolyBase = params->polyCount;
@@ -621,10 +737,22 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 		}
 	}
 
+	// Store detail grids.
+	if (detailGridItemCount)
+	{
+		unsigned int cellBase = 0;
+		for (int i = 0; i < params->polyCount; ++i)
+		{
+			const int size = buildPolyDetailGrid(params, i, &navDGrids[i], &navDGridCells[cellBase]);
+			navDGrids[i].cellBase = cellBase;
+			cellBase += (unsigned int)size;
+		}
+	}
+
 	// Store and create BVtree.
-	if (params->buildBvTree)
+	if (bvNodeCount > 0)
 	{
-		createBVTree(params, navBvtree, 2*params->polyCount);
+		createBVTree(params, navBvtree, bvNodeCount);
 	}
 	
 	// Store Off-Mesh connections.
@@ -662,12 +790,12 @@ bool dtNavMeshHeaderSwapEndian(unsigned char* data, const int /*dataSize*/)
 	dtMeshHeader* header = (dtMeshHeader*)data;
 	
 	int swappedMagic = DT_NAVMESH_MAGIC;
-	int swappedVersion = DT_NAVMESH_VERSION;
+	int swappedVersion = header->version;
 	dtSwapEndian(&swappedMagic);
 	dtSwapEndian(&swappedVersion);
 	
-	if ((header->magic != DT_NAVMESH_MAGIC || header->version != DT_NAVMESH_VERSION) &&
-		(header->magic != swappedMagic || header->version != swappedVersion))
+	if ((header->magic != DT_NAVMESH_MAGIC || !dtNavMeshVersionSupported(header->version)) &&
+		(header->magic != swappedMagic || !dtNavMeshVersionSupported(swappedVersion)))
 	{
 		return false;
 	}
@@ -709,13 +837,13 @@ bool dtNavMeshHeaderSwapEndian(unsigned char* data, const int /*dataSize*/)
 /// Call #dtNavMeshHeaderSwapEndian() first on the data if the data is expected to be in wrong endianess 
 /// to start with. Call #dtNavMeshHeaderSwapEndian() after the data has been swapped if converting from 
 /// native to foreign endianess.
-bool dtNavMeshDataSwapEndian(unsigned char* data, const int /*dataSize*/)
+bool dtNavMeshDataSwapEndian(unsigned char* data, const int dataSize)
 {
 	// Make sure the data is in right format.
 	dtMeshHeader* header = (dtMeshHeader*)data;
 	if (header->magic != DT_NAVMESH_MAGIC)
 		return false;
-	if (header->version != DT_NAVMESH_VERSION)
+	if (!dtNavMeshVersionSupported(header->version))
 		return false;
 	
 	// Patch header pointers.
@@ -740,6 +868,12 @@ bool dtNavMeshDataSwapEndian(unsigned char* data, const int /*dataSize*/)
 	//unsigned char* detailTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailTrisSize);
 	dtBVNode* bvTree = dtGetThenAdvanceBufferPointer<dtBVNode>(d, bvtreeSize);
 	dtOffMeshConnection* offMeshCons = dtGetThenAdvanceBufferPointer<dtOffMeshConnection>(d, offMeshLinksSize);
+	const bool hasDetailGrids = (header->version & DT_NAVMESH_VERSION_DETAIL_GRID) != 0;
+	const int detailGridsSize = hasDetailGrids ? dtAlign4(sizeof(dtPolyDetailGrid)*header->detailMeshCount) : 0;
+	dtPolyDetailGrid* detailGrids = dtGetThenAdvanceBufferPointer<dtPolyDetailGrid>(d, detailGridsSize);
+	// The grid cells take the rest of the data: their count is not known before swapping.
+	unsigned short* detailGridCells = (unsigned short*)d;
+	const int detailGridCellCount = hasDetailGrids ? (int)(data + dataSize - d) / (int)sizeof(unsigned short) : 0;
 	
 	// Vertices
 	for (int i = 0; i < header->vertCount*3; ++i)
@@ -797,6 +931,22 @@ bool dtNavMeshDataSwapEndian(unsigned char* data, const int /*dataSize*/)
 		dtSwapEndian(&con->rad);
 		dtSwapEndian(&con->poly);
 	}
+
+	// Detail grids.
+	for (int i = 0; hasDetailGrids && i < header->detailMeshCount; ++i)
+	{
+		dtPolyDetailGrid* grid = &detailGrids[i];
+		dtSwapEndian(&grid->bmin[0]);
+		dtSwapEndian(&grid->bmin[1]);
+		dtSwapEndian(&grid->invCellSize[0]);
+		dtSwapEndian(&grid->invCellSize[1]);
+		dtSwapEndian(&grid->cellBase);
+		dtSwapEndian(&grid->size);
+	}
+	for (int i = 0; i < detailGridCellCount; ++i)
+	{
+		dtSwapEndian(&detailGridCells[i]);
+	}
 	
 	return true;
 }
@@ -97,10 +97,15 @@ struct dtNavMeshCreateParams
 	float cs;				///< The xz-plane cell size of the polygon mesh. [Limit: > 0] [Unit: wu]
 	float ch;				///< The y-axis cell height of the polygon mesh. [Limit: > 0] [Unit: wu]
 
-	/// True if a bounding volume tree should be built for the tile.
-	/// @note The BVTree is not normally needed for layered navigation meshes.
+	/// Ignored: a bounding volume tree is always built for the tile, so that
+	/// polygon queries never fall back to a linear scan.
 	bool buildBvTree;
 
+	/// True if detail grids should be built for the polygons with many detail
+	/// triangles, so that height queries test only the triangles of a grid cell.
+	/// Needs the detail mesh. (See dtPolyDetailGrid)
+	bool buildDetailGrid;
+
 	/// @}
 };
 
@@ -83,24 +83,9 @@ float dtQueryFilter::getCost(const float* pa, const float* pb,
 {
 	return dtVdist(pa, pb) * m_areaCost[curPoly->getArea()];
 }
-#else
-inline bool dtQueryFilter::passFilter(const dtPolyRef /*ref*/,
-									  const dtMeshTile* /*tile*/,
-									  const dtPoly* poly) const
-{
-	return (poly->flags & m_includeFlags) != 0 && (poly->flags & m_excludeFlags) == 0;
-}
-
-inline float dtQueryFilter::getCost(const float* pa, const float* pb,
-									const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
-									const dtPolyRef /*curRef*/, const dtMeshTile* /*curTile*/, const dtPoly* curPoly,
-									const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/) const
-{
-	return dtVdist(pa, pb) * m_areaCost[curPoly->getArea()];
-}
 #endif	
 	
-static const float H_SCALE = 0.999f; // Search heuristic scale.
+static const float H_SCALE = DT_QUERY_HEURISTIC_SCALE; // Search heuristic scale.
 
 
 dtNavMeshQuery* dtAllocNavMeshQuery()
@@ -163,10 +148,12 @@ dtNavMeshQuery::~dtNavMeshQuery()
 /// functions are used.
 ///
 /// This function can be used multiple times.
-dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
+dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes, const int maxNodesCap)
 {
 	if (maxNodes > DT_NULL_IDX || maxNodes > (1 << DT_NODE_PARENT_BITS) - 1)
 		return DT_FAILURE | DT_INVALID_PARAM;
+	if (maxNodesCap > DT_NULL_IDX || maxNodesCap > (1 << DT_NODE_PARENT_BITS) - 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
 
 	m_nav = nav;
 	
@@ -178,12 +165,13 @@ dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
 			dtFree(m_nodePool);
 			m_nodePool = 0;
 		}
-		m_nodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(maxNodes, dtNextPow2(maxNodes/4));
+		m_nodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(maxNodes, dtNextPow2(maxNodes/4), maxNodesCap);
 		if (!m_nodePool)
 			return DT_FAILURE | DT_OUT_OF_MEMORY;
 	}
 	else
 	{
+		m_nodePool->setMaxNodesCap(maxNodesCap);
 		m_nodePool->clear();
 	}
 	
@@ -455,7 +443,8 @@ dtStatus dtNavMeshQuery::findRandomPointAroundCircle(dtPolyRef startRef, const f
 			else
 			{
 				neighbourNode->flags = DT_NODE_OPEN;
-				m_openList->push(neighbourNode);
+				if (!m_openList->push(neighbourNode))
+					status |= DT_OUT_OF_NODES;
 			}
 		}
 	}
@@ -527,9 +516,6 @@ dtStatus dtNavMeshQuery::closestPointOnPoly(dtPolyRef ref, const float* pos, flo
 		return DT_SUCCESS;
 	}
 
-	const unsigned int ip = (unsigned int)(poly - tile->polys);
-	const dtPolyDetail* pd = &tile->detailMeshes[ip];
-
 	// Clamp point to be inside the polygon.
 	float verts[DT_VERTS_PER_POLYGON*3];	
 	float edged[DT_VERTS_PER_POLYGON];
@@ -566,24 +552,9 @@ dtStatus dtNavMeshQuery::closestPointOnPoly(dtPolyRef ref, const float* pos, flo
 	}
 
 	// Find height at the location.
-	for (int j = 0; j < pd->triCount; ++j)
-	{
-		const unsigned char* t = &tile->detailTris[(pd->triBase+j)*4];
-		const float* v[3];
-		for (int k = 0; k < 3; ++k)
-		{
-			if (t[k] < poly->vertCount)
-				v[k] = &tile->verts[poly->verts[t[k]]*3];
-			else
-				v[k] = &tile->detailVerts[(pd->vertBase+(t[k]-poly->vertCount))*3];
-		}
-		float h;
-		if (dtClosestHeightPointTriangle(closest, v[0], v[1], v[2], h))
-		{
-			closest[1] = h;
-			break;
-		}
-	}
+	float h;
+	if (m_nav->getPolyHeight(tile, poly, closest, &h))
+		closest[1] = h;
 	
 	return DT_SUCCESS;
 }
@@ -673,27 +644,8 @@ dtStatus dtNavMeshQuery::getPolyHeight(dtPolyRef ref, const float* pos, float* h
 	}
 	else
 	{
-		const unsigned int ip = (unsigned int)(poly - tile->polys);
-		const dtPolyDetail* pd = &tile->detailMeshes[ip];
-		for (int j = 0; j < pd->triCount; ++j)
-		{
-			const unsigned char* t = &tile->detailTris[(pd->triBase+j)*4];
-			const float* v[3];
-			for (int k = 0; k < 3; ++k)
-			{
-				if (t[k] < poly->vertCount)
-					v[k] = &tile->verts[poly->verts[t[k]]*3];
-				else
-					v[k] = &tile->detailVerts[(pd->vertBase+(t[k]-poly->vertCount))*3];
-			}
-			float h;
-			if (dtClosestHeightPointTriangle(pos, v[0], v[1], v[2], h))
-			{
-				if (height)
-					*height = h;
-				return DT_SUCCESS;
-			}
-		}
+		if (m_nav->getPolyHeight(tile, poly, pos, height))
+			return DT_SUCCESS;
 	}
 	
 	return DT_FAILURE | DT_INVALID_PARAM;
@@ -783,6 +735,73 @@ dtStatus dtNavMeshQuery::findNearestPoly(const float* center, const float* exten
 	return DT_SUCCESS;
 }
 
+/// @par
+///
+/// Results are returned in the same order as @p centers. Queries whose
+/// search box does not intersect any polygons get a zero reference, and
+/// their nearest point is left untouched.
+///
+dtStatus dtNavMeshQuery::findNearestPolys(const float* centers, const int count, const float* extents,
+										  const dtQueryFilter* filter,
+										  dtPolyRef* nearestRefs, float* nearestPts) const
+{
+	dtAssert(m_nav);
+
+	if (!centers || !extents || !filter || !nearestRefs || count < 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (count == 0)
+		return DT_SUCCESS;
+
+	// Sort the queries by tile location (key in the high bits, query
+	// index in the low ones) with a radix sort on the packed keys.
+	unsigned long long* keys = (unsigned long long*)dtAlloc(sizeof(unsigned long long)*count*2, DT_ALLOC_TEMP);
+	if (!keys)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	unsigned long long* tmp = keys + count;
+	for (int i = 0; i < count; ++i)
+	{
+		int tx, ty;
+		m_nav->calcTileLoc(&centers[i*3], &tx, &ty);
+		const unsigned int tileKey = ((unsigned int)(ty & 0xffff) << 16) | (unsigned int)(tx & 0xffff);
+		keys[i] = ((unsigned long long)tileKey << 32) | (unsigned int)i;
+	}
+	for (int shift = 32; shift < 64; shift += 8)
+	{
+		int offsets[256];
+		memset(offsets, 0, sizeof(offsets));
+		for (int i = 0; i < count; ++i)
+			offsets[(keys[i] >> shift) & 0xff]++;
+		int sum = 0;
+		for (int b = 0; b < 256; ++b)
+		{
+			const int c = offsets[b];
+			offsets[b] = sum;
+			sum += c;
+		}
+		for (int i = 0; i < count; ++i)
+			tmp[offsets[(keys[i] >> shift) & 0xff]++] = keys[i];
+		dtSwap(keys, tmp);
+	}
+
+	dtStatus status = DT_SUCCESS;
+	for (int k = 0; k < count; ++k)
+	{
+		const int i = (int)(keys[k] & 0xffffffff);
+		dtStatus s = findNearestPoly(&centers[i*3], extents, filter, &nearestRefs[i],
+									 nearestPts ? &nearestPts[i*3] : 0);
+		if (dtStatusFailed(s))
+		{
+			nearestRefs[i] = 0;
+			status = s;
+		}
+	}
+
+	// Four passes: keys ends up in the original buffer.
+	dtFree(keys);
+	
+	return status;
+}
+
 void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, const float* qmax,
 										 const dtQueryFilter* filter, dtPolyQuery* query) const
 {
@@ -1018,187 +1037,7 @@ dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 								  const dtQueryFilter* filter,
 								  dtPolyRef* path, int* pathCount, const int maxPath) const
 {
-	dtAssert(m_nav);
-	dtAssert(m_nodePool);
-	dtAssert(m_openList);
-	
-	if (pathCount)
-		*pathCount = 0;
-	
-	// Validate input
-	if (!m_nav->isValidPolyRef(startRef) || !m_nav->isValidPolyRef(endRef) ||
-		!startPos || !endPos || !filter || maxPath <= 0 || !path || !pathCount)
-		return DT_FAILURE | DT_INVALID_PARAM;
-
-	if (startRef == endRef)
-	{
-		path[0] = startRef;
-		*pathCount = 1;
-		return DT_SUCCESS;
-	}
-	
-	m_nodePool->clear();
-	m_openList->clear();
-	
-	dtNode* startNode = m_nodePool->getNode(startRef);
-	dtVcopy(startNode->pos, startPos);
-	startNode->pidx = 0;
-	startNode->cost = 0;
-	startNode->total = dtVdist(startPos, endPos) * H_SCALE;
-	startNode->id = startRef;
-	startNode->flags = DT_NODE_OPEN;
-	m_openList->push(startNode);
-	
-	dtNode* lastBestNode = startNode;
-	float lastBestNodeCost = startNode->total;
-	
-	bool outOfNodes = false;
-	
-	while (!m_openList->empty())
-	{
-		// Remove node from open list and put it in closed list.
-		dtNode* bestNode = m_openList->pop();
-		bestNode->flags &= ~DT_NODE_OPEN;
-		bestNode->flags |= DT_NODE_CLOSED;
-		
-		// Reached the goal, stop searching.
-		if (bestNode->id == endRef)
-		{
-			lastBestNode = bestNode;
-			break;
-		}
-		
-		// Get current poly and tile.
-		// The API input has been cheked already, skip checking internal data.
-		const dtPolyRef bestRef = bestNode->id;
-		const dtMeshTile* bestTile = 0;
-		const dtPoly* bestPoly = 0;
-		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
-		
-		// Get parent poly and tile.
-		dtPolyRef parentRef = 0;
-		const dtMeshTile* parentTile = 0;
-		const dtPoly* parentPoly = 0;
-		if (bestNode->pidx)
-			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
-		if (parentRef)
-			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
-		
-		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
-		{
-			dtPolyRef neighbourRef = bestTile->links[i].ref;
-			
-			// Skip invalid ids and do not expand back to where we came from.
-			if (!neighbourRef || neighbourRef == parentRef)
-				continue;
-			
-			// Get neighbour poly and tile.
-			// The API input has been cheked already, skip checking internal data.
-			const dtMeshTile* neighbourTile = 0;
-			const dtPoly* neighbourPoly = 0;
-			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);			
-			
-			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
-				continue;
-
-			// deal explicitly with crossing tile boundaries
-			unsigned char crossSide = 0;
-			if (bestTile->links[i].side != 0xff)
-				crossSide = bestTile->links[i].side >> 1;
-
-			// get the node
-			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef, crossSide);
-			if (!neighbourNode)
-			{
-				outOfNodes = true;
-				continue;
-			}
-			
-			// If the node is visited the first time, calculate node position.
-			if (neighbourNode->flags == 0)
-			{
-				getEdgeMidPoint(bestRef, bestPoly, bestTile,
-								neighbourRef, neighbourPoly, neighbourTile,
-								neighbourNode->pos);
-			}
-
-			// Calculate cost and heuristic.
-			float cost = 0;
-			float heuristic = 0;
-			
-			// Special case for last node.
-			if (neighbourRef == endRef)
-			{
-				// Cost
-				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
-													  parentRef, parentTile, parentPoly,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly);
-				const float endCost = filter->getCost(neighbourNode->pos, endPos,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly,
-													  0, 0, 0);
-				
-				cost = bestNode->cost + curCost + endCost;
-				heuristic = 0;
-			}
-			else
-			{
-				// Cost
-				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
-													  parentRef, parentTile, parentPoly,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly);
-				cost = bestNode->cost + curCost;
-				heuristic = dtVdist(neighbourNode->pos, endPos)*H_SCALE;
-			}
-
-			const float total = cost + heuristic;
-			
-			// The node is already in open list and the new result is worse, skip.
-			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
-				continue;
-			// The node is already visited and process, and the new result is worse, skip.
-			if ((neighbourNode->flags & DT_NODE_CLOSED) && total >= neighbourNode->total)
-				continue;
-			
-			// Add or update the node.
-			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
-			neighbourNode->id = neighbourRef;
-			neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
-			neighbourNode->cost = cost;
-			neighbourNode->total = total;
-			
-			if (neighbourNode->flags & DT_NODE_OPEN)
-			{
-				// Already in open, update node location.
-				m_openList->modify(neighbourNode);
-			}
-			else
-			{
-				// Put the node in open list.
-				neighbourNode->flags |= DT_NODE_OPEN;
-				m_openList->push(neighbourNode);
-			}
-			
-			// Update nearest node to target so far.
-			if (heuristic < lastBestNodeCost)
-			{
-				lastBestNodeCost = heuristic;
-				lastBestNode = neighbourNode;
-			}
-		}
-	}
-
-	dtStatus status = getPathToNode(lastBestNode, path, pathCount, maxPath);
-
-	if (lastBestNode->id != endRef)
-		status |= DT_PARTIAL_RESULT;
-
-	if (outOfNodes)
-		status |= DT_OUT_OF_NODES;
-	
-	return status;
+	return findPath<dtQueryFilter>(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath);
 }
 
 dtStatus dtNavMeshQuery::getPathToNode(dtNode* endNode, dtPolyRef* path, int* pathCount, int maxPath) const
@@ -1503,7 +1342,8 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			{
 				// Put the node in open list.
 				neighbourNode->flags |= DT_NODE_OPEN;
-				m_openList->push(neighbourNode);
+				if (!m_openList->push(neighbourNode))
+					m_query.status |= DT_OUT_OF_NODES;
 			}
 			
 			// Update nearest node to target so far.
@@ -2861,7 +2701,8 @@ dtStatus dtNavMeshQuery::findPolysAroundCircle(dtPolyRef startRef, const float*
 			else
 			{
 				neighbourNode->flags = DT_NODE_OPEN;
-				m_openList->push(neighbourNode);
+				if (!m_openList->push(neighbourNode))
+					status |= DT_OUT_OF_NODES;
 			}
 		}
 	}
@@ -3034,7 +2875,8 @@ dtStatus dtNavMeshQuery::findPolysAroundShape(dtPolyRef startRef, const float* v
 			else
 			{
 				neighbourNode->flags = DT_NODE_OPEN;
-				m_openList->push(neighbourNode);
+				if (!m_openList->push(neighbourNode))
+					status |= DT_OUT_OF_NODES;
 			}
 		}
 	}
@@ -3614,7 +3456,8 @@ dtStatus dtNavMeshQuery::findDistanceToWall(dtPolyRef startRef, const float* cen
 			else
 			{
 				neighbourNode->flags |= DT_NODE_OPEN;
-				m_openList->push(neighbourNode);
+				if (!m_openList->push(neighbourNode))
+					status |= DT_OUT_OF_NODES;
 			}
 		}
 	}
@@ -0,0 +1,480 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include <new>
+#include "DetourNavMeshSampler.h"
+#include "DetourCommon.h"
+#include "DetourAssert.h"
+#include "DetourAlloc.h"
+
+
+dtNavMeshSampler* dtAllocNavMeshSampler()
+{
+	void* mem = dtAlloc(sizeof(dtNavMeshSampler), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtNavMeshSampler;
+}
+
+void dtFreeNavMeshSampler(dtNavMeshSampler* sampler)
+{
+	if (!sampler) return;
+	sampler->~dtNavMeshSampler();
+	dtFree(sampler);
+}
+
+// Builds an alias table with Vose's method: entry i is chosen with
+// probability prob[i], otherwise alias[i] is.
+static void buildSamplerAliasTable(const float* weights, const int n, const float sum,
+								   float* prob, int* alias, int* work)
+{
+	int* small = work;
+	int* large = work + n;
+	int nsmall = 0, nlarge = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		prob[i] = weights[i] * n / sum;
+		alias[i] = i;
+		if (prob[i] < 1.0f)
+			small[nsmall++] = i;
+		else
+			large[nlarge++] = i;
+	}
+	while (nsmall && nlarge)
+	{
+		const int s = small[--nsmall];
+		const int l = large[--nlarge];
+		alias[s] = l;
+		prob[l] = (prob[l] + prob[s]) - 1.0f;
+		if (prob[l] < 1.0f)
+			small[nsmall++] = l;
+		else
+			large[nlarge++] = l;
+	}
+	// Leftovers are due to rounding errors.
+	while (nlarge)
+		prob[large[--nlarge]] = 1.0f;
+	while (nsmall)
+	{
+		const int s = small[--nsmall];
+		prob[s] = weights[s] > 0.0f ? 1.0f : 0.0f;
+	}
+}
+
+static inline int pickSamplerAlias(const float* prob, const int* alias, const int n, float (*frand)())
+{
+	const int i = dtClamp((int)(frand() * n), 0, n-1);
+	return frand() < prob[i] ? i : alias[i];
+}
+
+// Clips a polygon in the xz-plane against: sign*(v[axis] - value) <= 0.
+static int clipSamplerPoly(const float* in, const int n, float* out, const int axis,
+						   const float value, const float sign)
+{
+	int m = 0;
+	for (int i = 0, j = n-1; i < n; j = i++)
+	{
+		const float* a = &in[j*3];
+		const float* b = &in[i*3];
+		const float da = sign * (a[axis] - value);
+		const float db = sign * (b[axis] - value);
+		if ((da <= 0.0f) != (db <= 0.0f))
+			dtVlerp(&out[m++*3], a, b, da / (da - db));
+		if (db <= 0.0f)
+			dtVcopy(&out[m++*3], b);
+	}
+	return m;
+}
+
+// Clips a polygon to the square [center - radius, center + radius] in the xz-plane.
+static int clipSamplerPolyToSquare(const float* verts, const int nverts, const float* center,
+								   const float radius, float* out, float* tmp)
+{
+	int n = clipSamplerPoly(verts, nverts, tmp, 0, center[0] + radius, 1.0f);
+	n = clipSamplerPoly(tmp, n, out, 0, center[0] - radius, -1.0f);
+	n = clipSamplerPoly(out, n, tmp, 2, center[2] + radius, 1.0f);
+	n = clipSamplerPoly(tmp, n, out, 2, center[2] - radius, -1.0f);
+	return n;
+}
+
+static float getSamplerPolyArea(const float* verts, const int nverts)
+{
+	float area = 0.0f;
+	for (int i = 2; i < nverts; ++i)
+		area += dtTriArea2D(&verts[0], &verts[(i-1)*3], &verts[i*3]);
+	return dtMathFabsf(area) * 0.5f;
+}
+
+static const int SAMPLER_MAX_CLIPPED_VERTS = DT_VERTS_PER_POLYGON + 4;
+
+dtNavMeshSampler::dtNavMeshSampler() :
+	m_navquery(0),
+	m_nav(0),
+	m_areaMask(0),
+	m_tiles(0),
+	m_maxTiles(0),
+	m_tileProb(0),
+	m_tileAlias(0),
+	m_area(0),
+	m_weights(0),
+	m_work(0),
+	m_polys(0),
+	m_prob(0),
+	m_alias(0),
+	m_scratchCapacity(0)
+{
+}
+
+dtNavMeshSampler::~dtNavMeshSampler()
+{
+	purge();
+}
+
+void dtNavMeshSampler::purge()
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		dtFree(m_tiles[i].polys);
+		dtFree(m_tiles[i].prob);
+		dtFree(m_tiles[i].alias);
+	}
+	dtFree(m_tiles);
+	m_tiles = 0;
+	m_maxTiles = 0;
+	dtFree(m_tileProb);
+	m_tileProb = 0;
+	dtFree(m_tileAlias);
+	m_tileAlias = 0;
+	m_area = 0;
+	dtFree(m_weights);
+	m_weights = 0;
+	dtFree(m_work);
+	m_work = 0;
+	dtFree(m_polys);
+	m_polys = 0;
+	dtFree(m_prob);
+	m_prob = 0;
+	dtFree(m_alias);
+	m_alias = 0;
+	m_scratchCapacity = 0;
+}
+
+bool dtNavMeshSampler::reserve(const int n)
+{
+	if (n <= m_scratchCapacity)
+		return true;
+	int capacity = dtMax(m_scratchCapacity * 2, 64);
+	while (capacity < n)
+		capacity *= 2;
+	dtFree(m_weights);
+	dtFree(m_work);
+	dtFree(m_polys);
+	dtFree(m_prob);
+	dtFree(m_alias);
+	m_weights = (float*)dtAlloc(sizeof(float)*capacity, DT_ALLOC_PERM);
+	m_work = (int*)dtAlloc(sizeof(int)*capacity*2, DT_ALLOC_PERM);
+	m_polys = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*capacity, DT_ALLOC_PERM);
+	m_prob = (float*)dtAlloc(sizeof(float)*capacity, DT_ALLOC_PERM);
+	m_alias = (int*)dtAlloc(sizeof(int)*capacity, DT_ALLOC_PERM);
+	if (!m_weights || !m_work || !m_polys || !m_prob || !m_alias)
+	{
+		m_scratchCapacity = 0;
+		return false;
+	}
+	m_scratchCapacity = capacity;
+	return true;
+}
+
+dtStatus dtNavMeshSampler::init(const dtNavMeshQuery* navquery, const dtQueryFilter* filter,
+								const unsigned long long areaMask)
+{
+	purge();
+
+	if (!navquery || !navquery->getAttachedNavMesh() || !filter)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	m_navquery = navquery;
+	m_nav = navquery->getAttachedNavMesh();
+	m_filter = *filter;
+	m_areaMask = areaMask;
+
+	const int maxTiles = m_nav->getMaxTiles();
+	m_tiles = (TileTable*)dtAlloc(sizeof(TileTable)*maxTiles, DT_ALLOC_PERM);
+	m_tileProb = (float*)dtAlloc(sizeof(float)*maxTiles, DT_ALLOC_PERM);
+	m_tileAlias = (int*)dtAlloc(sizeof(int)*maxTiles, DT_ALLOC_PERM);
+	if (!m_tiles || !m_tileProb || !m_tileAlias)
+	{
+		purge();
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memset(m_tiles, 0, sizeof(TileTable)*maxTiles);
+	m_maxTiles = maxTiles;
+
+	return update();
+}
+
+bool dtNavMeshSampler::passFilter(const dtPoly* poly) const
+{
+	if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+		return false;
+	if (!(poly->flags & m_filter.getIncludeFlags()) || (poly->flags & m_filter.getExcludeFlags()))
+		return false;
+	return ((m_areaMask >> poly->getArea()) & 1ULL) != 0;
+}
+
+bool dtNavMeshSampler::buildTile(const int i)
+{
+	TileTable& t = m_tiles[i];
+	dtFree(t.polys);
+	dtFree(t.prob);
+	dtFree(t.alias);
+	memset(&t, 0, sizeof(TileTable));
+
+	const dtMeshTile* tile = m_nav->getTile(i);
+	t.header = tile->header;
+	if (!tile->header)
+		return true;
+	t.salt = tile->salt;
+
+	if (!reserve(tile->header->polyCount))
+		return false;
+
+	// Weight the polygons by area.
+	int n = 0;
+	float sum = 0.0f;
+	for (int j = 0; j < tile->header->polyCount; ++j)
+	{
+		const dtPoly* poly = &tile->polys[j];
+		if (!passFilter(poly))
+			continue;
+		float verts[DT_VERTS_PER_POLYGON*3];
+		for (int k = 0; k < poly->vertCount; ++k)
+			dtVcopy(&verts[k*3], &tile->verts[poly->verts[k]*3]);
+		const float area = getSamplerPolyArea(verts, poly->vertCount);
+		if (area <= 0.0f)
+			continue;
+		m_work[n] = j;
+		m_weights[n] = area;
+		sum += area;
+		n++;
+	}
+	if (!n)
+		return true;
+
+	t.polys = (int*)dtAlloc(sizeof(int)*n, DT_ALLOC_PERM);
+	t.prob = (float*)dtAlloc(sizeof(float)*n, DT_ALLOC_PERM);
+	t.alias = (int*)dtAlloc(sizeof(int)*n, DT_ALLOC_PERM);
+	if (!t.polys || !t.prob || !t.alias)
+	{
+		dtFree(t.polys);
+		dtFree(t.prob);
+		dtFree(t.alias);
+		t.polys = 0;
+		t.prob = 0;
+		t.alias = 0;
+		return false;
+	}
+	memcpy(t.polys, m_work, sizeof(int)*n);
+	buildSamplerAliasTable(m_weights, n, sum, t.prob, t.alias, m_work);
+	t.npolys = n;
+	t.area = sum;
+	return true;
+}
+
+/// @par
+///
+/// Only the tiles whose salt changed are rebuilt, while the alias table over
+/// the tiles is rebuilt whenever a tile changed.
+dtStatus dtNavMeshSampler::update(bool* changed)
+{
+	if (changed)
+		*changed = false;
+	if (!m_nav)
+		return DT_FAILURE;
+
+	bool dirty = false;
+	dtStatus status = DT_SUCCESS;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->getTile(i);
+		const TileTable& t = m_tiles[i];
+		if (tile->header == t.header && (!tile->header || tile->salt == t.salt))
+			continue;
+		if (!buildTile(i))
+			status = DT_FAILURE | DT_OUT_OF_MEMORY;
+		dirty = true;
+	}
+	if (!dirty)
+		return status;
+
+	if (changed)
+		*changed = true;
+	if (!reserve(m_maxTiles))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_area = 0.0f;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		m_weights[i] = m_tiles[i].area;
+		m_area += m_tiles[i].area;
+	}
+	if (m_area > 0.0f)
+		buildSamplerAliasTable(m_weights, m_maxTiles, m_area, m_tileProb, m_tileAlias, m_work);
+
+	return status;
+}
+
+void dtNavMeshSampler::samplePoly(const dtMeshTile* tile, const dtPoly* poly, float (*frand)(), float* pt) const
+{
+	float verts[DT_VERTS_PER_POLYGON*3];
+	float areas[DT_VERTS_PER_POLYGON];
+	for (int k = 0; k < poly->vertCount; ++k)
+		dtVcopy(&verts[k*3], &tile->verts[poly->verts[k]*3]);
+	const float s = frand();
+	const float t = frand();
+	dtRandomPointInConvexPoly(verts, poly->vertCount, areas, s, t, pt);
+}
+
+/// @par
+///
+/// The points are uniformly distributed over the area of the polygons
+/// passing the filter. Tiles changed since the last #update() are skipped.
+dtStatus dtNavMeshSampler::samplePoints(const int count, float (*frand)(),
+										dtPolyRef* refs, float* points, int* npoints) const
+{
+	if (!frand || !points || !npoints || count < 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	*npoints = 0;
+	if (m_area <= 0.0f)
+		return DT_FAILURE;
+
+	int n = 0;
+	const int maxAttempts = count * 2 + 16;
+	for (int attempt = 0; n < count && attempt < maxAttempts; ++attempt)
+	{
+		const int it = pickSamplerAlias(m_tileProb, m_tileAlias, m_maxTiles, frand);
+		const TileTable& t = m_tiles[it];
+		const dtMeshTile* tile = m_nav->getTile(it);
+		if (!t.npolys || tile->header != t.header || tile->salt != t.salt)
+			continue;
+		const int ip = t.polys[pickSamplerAlias(t.prob, t.alias, t.npolys, frand)];
+		const dtPolyRef ref = m_nav->getPolyRefBase(tile) | (dtPolyRef)ip;
+
+		float* pt = &points[n*3];
+		samplePoly(tile, &tile->polys[ip], frand, pt);
+		float h = 0.0f;
+		if (dtStatusSucceed(m_navquery->getPolyHeight(ref, pt, &h)))
+			pt[1] = h;
+		if (refs)
+			refs[n] = ref;
+		n++;
+	}
+	*npoints = n;
+
+	return n < count ? DT_SUCCESS | DT_PARTIAL_RESULT : DT_SUCCESS;
+}
+
+/// @par
+///
+/// The polygons overlapping the circle are clipped to its bounding square and
+/// weighted by the clipped area, then points outside the circle are rejected,
+/// so at least pi/4 of the sampled points are accepted.
+dtStatus dtNavMeshSampler::samplePointsAroundCircle(const float* center, const float radius,
+													const int count, float (*frand)(),
+													dtPolyRef* refs, float* points, int* npoints)
+{
+	if (!center || !frand || !points || !npoints || count < 0 || radius <= 0.0f)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	*npoints = 0;
+	if (!m_nav)
+		return DT_FAILURE;
+
+	// Collect the polygons overlapping the circle.
+	const float ext[3] = { radius, radius, radius };
+	int npolys = 0;
+	for (;;)
+	{
+		if (!reserve(m_scratchCapacity + 1))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		dtStatus status = m_navquery->queryPolygons(center, ext, &m_filter, m_polys, &npolys, m_scratchCapacity);
+		if (dtStatusFailed(status))
+			return status;
+		if (!dtStatusDetail(status, DT_BUFFER_TOO_SMALL))
+			break;
+	}
+
+	// Weight them by the area inside the square.
+	float clipped[SAMPLER_MAX_CLIPPED_VERTS*3];
+	float tmp[SAMPLER_MAX_CLIPPED_VERTS*3];
+	int n = 0;
+	float sum = 0.0f;
+	for (int i = 0; i < npolys; ++i)
+	{
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(m_polys[i], &tile, &poly);
+		if (!passFilter(poly))
+			continue;
+		float verts[DT_VERTS_PER_POLYGON*3];
+		for (int k = 0; k < poly->vertCount; ++k)
+			dtVcopy(&verts[k*3], &tile->verts[poly->verts[k]*3]);
+		const int nclipped = clipSamplerPolyToSquare(verts, poly->vertCount, center, radius, clipped, tmp);
+		const float area = nclipped >= 3 ? getSamplerPolyArea(clipped, nclipped) : 0.0f;
+		if (area <= 0.0f)
+			continue;
+		m_polys[n] = m_polys[i];
+		m_weights[n] = area;
+		sum += area;
+		n++;
+	}
+	if (!n)
+		return DT_FAILURE;
+	buildSamplerAliasTable(m_weights, n, sum, m_prob, m_alias, m_work);
+
+	// Sample the clipped polygons and reject the points outside the circle.
+	const float radiusSqr = dtSqr(radius);
+	int m = 0;
+	const int maxAttempts = count * 8 + 16;
+	for (int attempt = 0; m < count && attempt < maxAttempts; ++attempt)
+	{
+		const dtPolyRef ref = m_polys[pickSamplerAlias(m_prob, m_alias, n, frand)];
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		m_nav->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+		float verts[DT_VERTS_PER_POLYGON*3];
+		for (int k = 0; k < poly->vertCount; ++k)
+			dtVcopy(&verts[k*3], &tile->verts[poly->verts[k]*3]);
+		const int nclipped = clipSamplerPolyToSquare(verts, poly->vertCount, center, radius, clipped, tmp);
+
+		float areas[SAMPLER_MAX_CLIPPED_VERTS];
+		float* pt = &points[m*3];
+		const float s = frand();
+		const float t = frand();
+		dtRandomPointInConvexPoly(clipped, nclipped, areas, s, t, pt);
+		if (dtVdist2DSqr(pt, center) > radiusSqr)
+			continue;
+		float h = 0.0f;
+		if (dtStatusSucceed(m_navquery->getPolyHeight(ref, pt, &h)))
+			pt[1] = h;
+		if (refs)
+			refs[m] = ref;
+		m++;
+	}
+	*npoints = m;
+
+	return m < count ? DT_SUCCESS | DT_PARTIAL_RESULT : DT_SUCCESS;
+}
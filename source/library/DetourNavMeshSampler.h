@@ -0,0 +1,136 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURNAVMESHSAMPLER_H
+#define DETOURNAVMESHSAMPLER_H
+
+#include "DetourNavMesh.h"
+#include "DetourNavMeshQuery.h"
+
+/// Samples random points over the polygons of a navigation mesh, uniformly
+/// by surface area, in constant time per point: polygons are chosen with
+/// alias tables over the tiles and over the polygons of each tile.
+/// The tables of a tile are rebuilt only when the tile changes.
+/// @ingroup detour
+class dtNavMeshSampler
+{
+	/// Per tile alias table, over the polygons passing the filter.
+	struct TileTable
+	{
+		unsigned int salt;				///< Salt of the tile when the table was built, 0 if no table.
+		const dtMeshHeader* header;		///< Header of the tile when the table was built.
+		int npolys;
+		int* polys;						///< Polygon indices inside the tile.
+		float* prob;
+		int* alias;
+		float area;						///< Total area of the polygons.
+	};
+
+	const dtNavMeshQuery* m_navquery;
+	const dtNavMesh* m_nav;
+	dtQueryFilter m_filter;
+	unsigned long long m_areaMask;
+
+	TileTable* m_tiles;
+	int m_maxTiles;
+
+	/// Alias table over the tiles.
+	float* m_tileProb;
+	int* m_tileAlias;
+	float m_area;
+
+	/// Scratch buffers, for building tables and sampling around a point.
+	float* m_weights;
+	int* m_work;
+	dtPolyRef* m_polys;
+	float* m_prob;
+	int* m_alias;
+	int m_scratchCapacity;
+
+	void purge();
+	bool reserve(const int n);
+	bool passFilter(const dtPoly* poly) const;
+	bool buildTile(const int i);
+	void samplePoly(const dtMeshTile* tile, const dtPoly* poly, float (*frand)(), float* pt) const;
+
+public:
+	dtNavMeshSampler();
+	~dtNavMeshSampler();
+
+	/// Initializes the sampler.
+	///  @param[in]		navquery	The query object used for the polygon heights, attached to the navigation mesh to sample.
+	///  @param[in]		filter		The polygon filter to apply. (Copied: only the include and exclude flags are used.)
+	///  @param[in]		areaMask	The areas to sample, a bit per area id.
+	/// @returns The status flags for the operation.
+	dtStatus init(const dtNavMeshQuery* navquery, const dtQueryFilter* filter,
+				  const unsigned long long areaMask = ~0ULL);
+
+	/// Rebuilds the tables of the tiles changed since the last update.
+	///  @param[out]	changed		True if some tile changed. [opt]
+	/// @returns The status flags for the operation.
+	dtStatus update(bool* changed = 0);
+
+	/// Samples random points over the whole navigation mesh.
+	///  @param[in]		count		The number of points to sample.
+	///  @param[in]		frand		Function returning a random number [0..1).
+	///  @param[out]	refs		The polygons the points lie on. [opt] [(polyRef) * @p count]
+	///  @param[out]	points		The points. [(x, y, z) * @p count]
+	///  @param[out]	npoints		The number of points sampled.
+	/// @returns The status flags for the operation.
+	dtStatus samplePoints(const int count, float (*frand)(),
+						  dtPolyRef* refs, float* points, int* npoints) const;
+
+	/// Samples random points within a circle: over the polygons overlapping
+	/// the circle, and within @p radius vertically of its center.
+	/// Points may lie on polygons not connected to the center.
+	///  @param[in]		center		The center of the circle. [(x, y, z)]
+	///  @param[in]		radius		The radius of the circle.
+	///  @param[in]		count		The number of points to sample.
+	///  @param[in]		frand		Function returning a random number [0..1).
+	///  @param[out]	refs		The polygons the points lie on. [opt] [(polyRef) * @p count]
+	///  @param[out]	points		The points. [(x, y, z) * @p count]
+	///  @param[out]	npoints		The number of points sampled: less than @p count
+	///								if the circle is barely covered.
+	/// @returns The status flags for the operation.
+	dtStatus samplePointsAroundCircle(const float* center, const float radius,
+									  const int count, float (*frand)(),
+									  dtPolyRef* refs, float* points, int* npoints);
+
+	/// Gets the total area of the sampled polygons.
+	inline float getArea() const { return m_area; }
+
+	/// Gets the navigation mesh the sampler refers to.
+	inline const dtNavMesh* getNavMesh() const { return m_nav; }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtNavMeshSampler(const dtNavMeshSampler&);
+	dtNavMeshSampler& operator=(const dtNavMeshSampler&);
+};
+
+/// Allocates a sampler object using the Detour allocator.
+/// @return A sampler object that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtNavMeshSampler* dtAllocNavMeshSampler();
+
+/// Frees the specified sampler object using the Detour allocator.
+///  @param[in]		sampler		A sampler object allocated using #dtAllocNavMeshSampler
+///  @ingroup detour
+void dtFreeNavMeshSampler(dtNavMeshSampler* sampler);
+
+#endif // DETOURNAVMESHSAMPLER_H
@@ -48,56 +48,175 @@ inline unsigned int dtHashRef(dtPolyRef a)
 #endif
 
 //////////////////////////////////////////////////////////////////////////////////////////
-dtNodePool::dtNodePool(int maxNodes, int hashSize) :
-	m_nodes(0),
-	m_first(0),
+dtNodePool::dtNodePool(int maxNodes, int hashSize, int maxNodesCap) :
+	m_chunkCount(0),
+	m_chunkSize(maxNodes),
+	m_buckets(0),
 	m_next(0),
 	m_maxNodes(maxNodes),
+	m_maxNodesCap(maxNodes),
 	m_hashSize(hashSize),
-	m_nodeCount(0)
+	m_baseHashSize(hashSize),
+	m_generation(1),
+	m_nodeCount(0),
+	m_outOfNodes(false)
 {
 	dtAssert(dtNextPow2(m_hashSize) == (unsigned int)m_hashSize);
 	// pidx is special as 0 means "none" and 1 is the first node. For that reason
 	// we have 1 fewer nodes available than the number of values it can contain.
 	dtAssert(m_maxNodes > 0 && m_maxNodes <= DT_NULL_IDX && m_maxNodes <= (1 << DT_NODE_PARENT_BITS) - 1);
 
-	m_nodes = (dtNode*)dtAlloc(sizeof(dtNode)*m_maxNodes, DT_ALLOC_PERM);
+	memset(m_chunks, 0, sizeof(m_chunks));
+	m_chunks[0] = (dtNode*)dtAlloc(sizeof(dtNode)*m_maxNodes, DT_ALLOC_PERM);
 	m_next = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*m_maxNodes, DT_ALLOC_PERM);
-	m_first = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*hashSize, DT_ALLOC_PERM);
+	m_buckets = (Bucket*)dtAlloc(sizeof(Bucket)*m_hashSize, DT_ALLOC_PERM);
 
-	dtAssert(m_nodes);
+	dtAssert(m_chunks[0]);
 	dtAssert(m_next);
-	dtAssert(m_first);
+	dtAssert(m_buckets);
+	m_chunkCount = 1;
+	m_chunkBase[0] = 0;
+	m_chunkBase[1] = m_maxNodes;
 
-	memset(m_first, 0xff, sizeof(dtNodeIndex)*m_hashSize);
+	memset(m_buckets, 0, sizeof(Bucket)*m_hashSize);
 	memset(m_next, 0xff, sizeof(dtNodeIndex)*m_maxNodes);
+
+	setMaxNodesCap(maxNodesCap);
+	resetStats();
 }
 
 dtNodePool::~dtNodePool()
 {
-	dtFree(m_nodes);
+	for (int i = 0; i < m_chunkCount; ++i)
+		dtFree(m_chunks[i]);
 	dtFree(m_next);
-	dtFree(m_first);
+	dtFree(m_buckets);
+}
+
+void dtNodePool::setMaxNodesCap(int maxNodesCap)
+{
+	m_maxNodesCap = dtMax(m_maxNodes, dtMin(maxNodesCap, dtMin((int)DT_NULL_IDX, (1 << DT_NODE_PARENT_BITS) - 1)));
+}
+
+void dtNodePool::resetStats()
+{
+	m_searchCount = 0;
+	m_nodesTouched = 0;
+	m_peakNodes = 0;
+	m_outOfNodesCount = 0;
 }
 
 void dtNodePool::clear()
 {
-	memset(m_first, 0xff, sizeof(dtNodeIndex)*m_hashSize);
+	if (m_nodeCount > 0)
+	{
+		m_searchCount++;
+		m_nodesTouched += m_nodeCount;
+		m_peakNodes = dtMax(m_peakNodes, m_nodeCount);
+	}
+	if (m_outOfNodes)
+		m_outOfNodesCount++;
 	m_nodeCount = 0;
+	m_outOfNodes = false;
+
+	// Invalidate all the buckets at once. Once every 2^16 clears the tags
+	// wrap around, and are reset for real.
+	m_generation++;
+	if (m_generation == 0)
+	{
+		memset(m_buckets, 0, sizeof(Bucket)*m_hashSize);
+		m_generation = 1;
+	}
+}
+
+dtNode* dtNodePool::chunkNodeAt(int i) const
+{
+	// The chunks double in size, unless the cap clamped one of them and was
+	// raised later: then the next chunks start earlier than that.
+	int k = dtMin((int)dtIlog2((unsigned int)(i / m_chunkSize)) + 1, m_chunkCount-1);
+	while (k+1 < m_chunkCount && m_chunkBase[k+1] <= i)
+		k++;
+	return &m_chunks[k][i - m_chunkBase[k]];
+}
+
+unsigned int dtNodePool::getChunkNodeIdx(const dtNode* node) const
+{
+	for (int k = 1; k < m_chunkCount; ++k)
+	{
+		const int size = m_chunkBase[k+1] - m_chunkBase[k];
+		if (node >= m_chunks[k] && node < m_chunks[k] + size)
+			return (unsigned int)(m_chunkBase[k] + (node - m_chunks[k])) + 1;
+	}
+	dtAssert(false);
+	return 0;
+}
+
+// Adds a chunk doubling the capacity, or up to the cap.
+// The nodes already allocated do not move.
+bool dtNodePool::grow()
+{
+	if (m_maxNodes >= m_maxNodesCap || m_chunkCount >= DT_NODE_MAX_CHUNKS)
+		return false;
+	const int n = dtMin(m_maxNodes, m_maxNodesCap - m_maxNodes);
+
+	dtNode* chunk = (dtNode*)dtAlloc(sizeof(dtNode)*n, DT_ALLOC_PERM);
+	dtNodeIndex* next = (dtNodeIndex*)dtAlloc(sizeof(dtNodeIndex)*(m_maxNodes+n), DT_ALLOC_PERM);
+	if (!chunk || !next)
+	{
+		dtFree(chunk);
+		dtFree(next);
+		return false;
+	}
+	memcpy(next, m_next, sizeof(dtNodeIndex)*m_maxNodes);
+	memset(&next[m_maxNodes], 0xff, sizeof(dtNodeIndex)*n);
+	dtFree(m_next);
+	m_next = next;
+	m_chunks[m_chunkCount++] = chunk;
+	m_maxNodes += n;
+	m_chunkBase[m_chunkCount] = m_maxNodes;
+
+	// Keep the chains as short as with the initial size.
+	const int hashSize = (int)dtNextPow2((unsigned int)(((long long)m_baseHashSize*m_maxNodes) / m_chunkSize));
+	if (hashSize > m_hashSize)
+		rehash(hashSize);
+	return true;
+}
+
+// Rebuilds the hash of the current nodes with more buckets. If the buckets
+// cannot be allocated the old ones are kept.
+void dtNodePool::rehash(int hashSize)
+{
+	Bucket* buckets = (Bucket*)dtAlloc(sizeof(Bucket)*hashSize, DT_ALLOC_PERM);
+	if (!buckets)
+		return;
+	memset(buckets, 0, sizeof(Bucket)*hashSize);
+	dtFree(m_buckets);
+	m_buckets = buckets;
+	m_hashSize = hashSize;
+
+	// Reinsert in allocation order, to keep the newest nodes first.
+	for (int i = 0; i < m_nodeCount; ++i)
+	{
+		Bucket& b = m_buckets[dtHashRef(nodeAt(i)->id) & (m_hashSize-1)];
+		m_next[i] = b.gen == m_generation ? b.first : DT_NULL_IDX;
+		b.first = (dtNodeIndex)i;
+		b.gen = m_generation;
+	}
 }
 
 unsigned int dtNodePool::findNodes(dtPolyRef id, dtNode** nodes, const int maxNodes)
 {
 	int n = 0;
 	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
+	dtNodeIndex i = getFirst(bucket);
 	while (i != DT_NULL_IDX)
 	{
-		if (m_nodes[i].id == id)
+		dtNode* node = nodeAt(i);
+		if (node->id == id)
 		{
 			if (n >= maxNodes)
 				return n;
-			nodes[n++] = &m_nodes[i];
+			nodes[n++] = node;
 		}
 		i = m_next[i];
 	}
@@ -108,11 +227,12 @@ unsigned int dtNodePool::findNodes(dtPolyRef id, dtNode** nodes, const int maxNo
 dtNode* dtNodePool::findNode(dtPolyRef id, unsigned char state)
 {
 	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
+	dtNodeIndex i = getFirst(bucket);
 	while (i != DT_NULL_IDX)
 	{
-		if (m_nodes[i].id == id && m_nodes[i].state == state)
-			return &m_nodes[i];
+		dtNode* node = nodeAt(i);
+		if (node->id == id && node->state == state)
+			return node;
 		i = m_next[i];
 	}
 	return 0;
@@ -121,23 +241,32 @@ dtNode* dtNodePool::findNode(dtPolyRef id, unsigned char state)
 dtNode* dtNodePool::getNode(dtPolyRef id, unsigned char state)
 {
 	unsigned int bucket = dtHashRef(id) & (m_hashSize-1);
-	dtNodeIndex i = m_first[bucket];
+	dtNodeIndex i = getFirst(bucket);
 	dtNode* node = 0;
 	while (i != DT_NULL_IDX)
 	{
-		if (m_nodes[i].id == id && m_nodes[i].state == state)
-			return &m_nodes[i];
+		node = nodeAt(i);
+		if (node->id == id && node->state == state)
+			return node;
 		i = m_next[i];
 	}
 	
 	if (m_nodeCount >= m_maxNodes)
-		return 0;
+	{
+		if (!grow())
+		{
+			m_outOfNodes = true;
+			return 0;
+		}
+		// The hash may have grown.
+		bucket = dtHashRef(id) & (m_hashSize-1);
+	}
 	
 	i = (dtNodeIndex)m_nodeCount;
 	m_nodeCount++;
 	
 	// Init node
-	node = &m_nodes[i];
+	node = nodeAt(i);
 	node->pidx = 0;
 	node->cost = 0;
 	node->total = 0;
@@ -145,8 +274,10 @@ dtNode* dtNodePool::getNode(dtPolyRef id, unsigned char state)
 	node->state = state;
 	node->flags = 0;
 	
-	m_next[i] = m_first[bucket];
-	m_first[bucket] = i;
+	Bucket& b = m_buckets[bucket];
+	m_next[i] = b.gen == m_generation ? b.first : DT_NULL_IDX;
+	b.first = i;
+	b.gen = m_generation;
 	
 	return node;
 }
@@ -169,6 +300,19 @@ dtNodeQueue::~dtNodeQueue()
 	dtFree(m_heap);
 }
 
+bool dtNodeQueue::grow()
+{
+	const int capacity = m_capacity*2;
+	dtNode** heap = (dtNode**)dtAlloc(sizeof(dtNode*)*(capacity+1), DT_ALLOC_PERM);
+	if (!heap)
+		return false;
+	memcpy(heap, m_heap, sizeof(dtNode*)*m_size);
+	dtFree(m_heap);
+	m_heap = heap;
+	m_capacity = capacity;
+	return true;
+}
+
 void dtNodeQueue::bubbleUp(int i, dtNode* node)
 {
 	int parent = (i-1)/2;
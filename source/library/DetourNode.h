@@ -46,10 +46,20 @@ struct dtNode
 
 static const int DT_MAX_STATES_PER_NODE = 1 << DT_NODE_STATE_BITS;	// number of extra states per node. See dtNode::state
 
+static const int DT_NODE_MAX_CHUNKS = 17;	// enough chunks to double from 1 node up to DT_NULL_IDX nodes.
+
+/// A pool of search nodes, hashed by polygon ref.
+/// Clearing is O(1): the hash buckets are tagged with a generation, which
+/// clear() increments. Nodes are allocated in chunks, each one doubling the
+/// capacity, so the pool can grow during a search up to a cap without
+/// moving the nodes already handed out.
 class dtNodePool
 {
 public:
-	dtNodePool(int maxNodes, int hashSize);
+	/// @param[in]		maxNodes		The initial number of nodes.
+	/// @param[in]		hashSize		The initial number of hash buckets. [Limit: power of 2]
+	/// @param[in]		maxNodesCap		The number of nodes the pool can grow to, or 0 for a fixed size pool.
+	dtNodePool(int maxNodes, int hashSize, int maxNodesCap = 0);
 	~dtNodePool();
 	void clear();
 
@@ -62,19 +72,21 @@ public:
 	inline unsigned int getNodeIdx(const dtNode* node) const
 	{
 		if (!node) return 0;
-		return (unsigned int)(node - m_nodes) + 1;
+		if (node >= m_chunks[0] && node < m_chunks[0] + m_chunkSize)
+			return (unsigned int)(node - m_chunks[0]) + 1;
+		return getChunkNodeIdx(node);
 	}
 
 	inline dtNode* getNodeAtIdx(unsigned int idx)
 	{
 		if (!idx) return 0;
-		return &m_nodes[idx - 1];
+		return nodeAt((int)idx - 1);
 	}
 
 	inline const dtNode* getNodeAtIdx(unsigned int idx) const
 	{
 		if (!idx) return 0;
-		return &m_nodes[idx - 1];
+		return nodeAt((int)idx - 1);
 	}
 	
 	inline int getMemUsed() const
@@ -82,27 +94,82 @@ public:
 		return sizeof(*this) +
 			sizeof(dtNode)*m_maxNodes +
 			sizeof(dtNodeIndex)*m_maxNodes +
-			sizeof(dtNodeIndex)*m_hashSize;
+			sizeof(Bucket)*m_hashSize;
 	}
 	
+	/// The current capacity of the pool.
 	inline int getMaxNodes() const { return m_maxNodes; }
+	/// The capacity the pool can grow to.
+	inline int getMaxNodesCap() const { return m_maxNodesCap; }
+	/// Sets the capacity the pool can grow to. (Never below the current capacity.)
+	void setMaxNodesCap(int maxNodesCap);
 	
 	inline int getHashSize() const { return m_hashSize; }
-	inline dtNodeIndex getFirst(int bucket) const { return m_first[bucket]; }
+	inline dtNodeIndex getFirst(int bucket) const
+	{
+		return m_buckets[bucket].gen == m_generation ? m_buckets[bucket].first : DT_NULL_IDX;
+	}
 	inline dtNodeIndex getNext(int i) const { return m_next[i]; }
 	inline int getNodeCount() const { return m_nodeCount; }
+
+	/// The number of searches run since the last resetStats(): the clears
+	/// of a pool holding nodes, plus the search in progress.
+	inline unsigned int getSearchCount() const { return m_searchCount + (m_nodeCount > 0 ? 1 : 0); }
+	/// The total number of nodes touched by the searches.
+	inline unsigned long long getNodesTouched() const { return m_nodesTouched + m_nodeCount; }
+	/// The average number of nodes touched per search.
+	inline float getAverageNodesTouched() const
+	{
+		const unsigned int n = getSearchCount();
+		return n ? (float)((double)getNodesTouched() / n) : 0.0f;
+	}
+	/// The highest number of nodes touched by a search.
+	inline int getPeakNodes() const { return m_nodeCount > m_peakNodes ? m_nodeCount : m_peakNodes; }
+	/// The number of searches which needed more nodes than the cap.
+	inline unsigned int getOutOfNodesCount() const { return m_outOfNodesCount; }
+	void resetStats();
 	
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
 	dtNodePool(const dtNodePool&);
 	dtNodePool& operator=(const dtNodePool&);
+
+	/// Hash bucket: the head of its chain is valid only if tagged with the current generation.
+	struct Bucket
+	{
+		unsigned short gen;
+		dtNodeIndex first;
+	};
+
+	inline dtNode* nodeAt(int i) const
+	{
+		if (i < m_chunkSize)
+			return &m_chunks[0][i];
+		return chunkNodeAt(i);
+	}
+	dtNode* chunkNodeAt(int i) const;
+	unsigned int getChunkNodeIdx(const dtNode* node) const;
+	bool grow();
+	void rehash(int hashSize);
 	
-	dtNode* m_nodes;
-	dtNodeIndex* m_first;
+	dtNode* m_chunks[DT_NODE_MAX_CHUNKS];	///< Chunk k > 0 holds up to m_chunkSize << (k-1) nodes.
+	int m_chunkBase[DT_NODE_MAX_CHUNKS+1];	///< Index of the first node of each chunk, m_chunkBase[m_chunkCount] == m_maxNodes.
+	int m_chunkCount;
+	int m_chunkSize;
+	Bucket* m_buckets;
 	dtNodeIndex* m_next;
-	const int m_maxNodes;
-	const int m_hashSize;
+	int m_maxNodes;
+	int m_maxNodesCap;
+	int m_hashSize;
+	int m_baseHashSize;						///< Hash size for the first chunk alone, scaled up as the pool grows.
+	unsigned short m_generation;
 	int m_nodeCount;
+	bool m_outOfNodes;
+
+	unsigned int m_searchCount;
+	unsigned long long m_nodesTouched;
+	int m_peakNodes;
+	unsigned int m_outOfNodesCount;
 };
 
 class dtNodeQueue
@@ -123,10 +190,15 @@ public:
 		return result;
 	}
 	
-	inline void push(dtNode* node)
+	// The heap grows as needed: it never holds more nodes than their pool.
+	// Returns false if it can't grow: the node is not queued then.
+	inline bool push(dtNode* node)
 	{
+		if (m_size >= m_capacity && !grow())
+			return false;
 		m_size++;
 		bubbleUp(m_size-1, node);
+		return true;
 	}
 	
 	inline void modify(dtNode* node)
@@ -158,9 +230,10 @@ private:
 
 	void bubbleUp(int i, dtNode* node);
 	void trickleDown(int i, dtNode* node);
+	bool grow();
 	
 	dtNode** m_heap;
-	const int m_capacity;
+	int m_capacity;
 	int m_size;
 };		
 
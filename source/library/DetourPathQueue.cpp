@@ -17,21 +17,99 @@
 //
 
 #include <string.h>
+#include <limits.h>
+#include <new>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "DetourPathQueue.h"
 #include "DetourNavMesh.h"
 #include "DetourNavMeshQuery.h"
 #include "DetourAlloc.h"
 #include "DetourCommon.h"
+#include "DetourNode.h"
 
 
+// Requests are referenced by generation (high 16 bits) and slot (low 16 bits).
+static const int PATHQ_SLOT_BITS = 16;
+static const int PATHQ_MAX_QUEUE = 1 << PATHQ_SLOT_BITS;
+static const int PATHQ_INITIAL_QUEUE = 8;
+// Pathfinder iterations run between budget checks.
+static const int PATHQ_SLICE_ITERS = 32;
+
+static long long getTimeUsec()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct dtPathQueue::Worker
+{
+	dtNavMeshQuery* navquery;
+	std::thread thread;
+	/// Query in progress on this worker's query object.
+	int current;
+	dtPathQueueRef currentRef;
+	/// Last update served.
+	unsigned int frame;
+};
+
+struct dtPathQueue::Scheduler
+{
+	std::mutex lock;
+	std::condition_variable start;
+	std::condition_variable done;
+	unsigned int frame;
+	int running;
+	bool quit;
+	/// Budget of the current update.
+	std::atomic<int> itersLeft;
+	long long deadline;
+
+	Scheduler() : frame(0), running(0), quit(false), itersLeft(0), deadline(0) {}
+};
+
+struct dtPathQueue::PendingQuery
+{
+	/// Aged priority less the update tick: the order doesn't change with time.
+	double key;
+	unsigned int sequence;
+	dtPathQueueRef ref;
+
+	/// Served after other.
+	inline bool operator<(const PendingQuery& other) const
+	{
+		return key < other.key || (key == other.key && (int)(sequence - other.sequence) > 0);
+	}
+};
+
 dtPathQueue::dtPathQueue() :
-	m_nextHandle(1),
+	m_queue(0),
+	m_queueCapacity(0),
+	m_requestCount(0),
+	m_freeSlots(0),
+	m_nfreeSlots(0),
+	m_pending(0),
+	m_npending(0),
+	m_nextGeneration(1),
+	m_nextSequence(0),
 	m_maxPathSize(0),
-	m_queueHead(0),
-	m_navquery(0)
+	m_maxSearchNodeCount(0),
+	m_maxSearchNodeCap(0),
+	m_nav(0),
+	m_navquery(0),
+	m_workers(0),
+	m_nworkers(0),
+	m_scheduler(0),
+	m_tick(0),
+	m_latencyCount(0),
+	m_latencyHead(0),
+	m_completedCount(0),
+	m_maxRequestCount(0)
 {
-	for (int i = 0; i < MAX_QUEUE; ++i)
-		m_queue[i].path = 0;
 }
 
 dtPathQueue::~dtPathQueue()
@@ -39,162 +117,520 @@ dtPathQueue::~dtPathQueue()
 	purge();
 }
 
+void dtPathQueue::stopWorkers()
+{
+	if (!m_workers)
+		return;
+	if (m_nworkers)
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_scheduler->lock);
+			m_scheduler->quit = true;
+		}
+		m_scheduler->start.notify_all();
+	}
+	for (int i = 0; i <= m_nworkers; ++i)
+	{
+		Worker& w = m_workers[i];
+		if (w.thread.joinable())
+			w.thread.join();
+		if (i > 0)
+			dtFreeNavMeshQuery(w.navquery);
+		w.~Worker();
+	}
+	dtFree(m_workers);
+	m_workers = 0;
+	m_nworkers = 0;
+	m_scheduler->quit = false;
+}
+
 void dtPathQueue::purge()
 {
+	if (m_scheduler)
+	{
+		stopWorkers();
+		m_scheduler->~Scheduler();
+		dtFree(m_scheduler);
+		m_scheduler = 0;
+	}
 	dtFreeNavMeshQuery(m_navquery);
 	m_navquery = 0;
-	for (int i = 0; i < MAX_QUEUE; ++i)
-	{
+	for (int i = 0; i < m_queueCapacity; ++i)
 		dtFree(m_queue[i].path);
-		m_queue[i].path = 0;
-	}
+	dtFree(m_queue);
+	m_queue = 0;
+	m_queueCapacity = 0;
+	m_requestCount = 0;
+	dtFree(m_freeSlots);
+	m_freeSlots = 0;
+	m_nfreeSlots = 0;
+	dtFree(m_pending);
+	m_pending = 0;
+	m_npending = 0;
 }
 
-bool dtPathQueue::init(const int maxPathSize, const int maxSearchNodeCount, dtNavMesh* nav)
+bool dtPathQueue::init(const int maxPathSize, const int maxSearchNodeCount, dtNavMesh* nav, const int numWorkers,
+					   const int maxSearchNodeCap)
 {
 	purge();
 
 	m_navquery = dtAllocNavMeshQuery();
 	if (!m_navquery)
 		return false;
-	if (dtStatusFailed(m_navquery->init(nav, maxSearchNodeCount)))
+	if (dtStatusFailed(m_navquery->init(nav, maxSearchNodeCount, maxSearchNodeCap)))
 		return false;
-	
+
+	void* mem = dtAlloc(sizeof(Scheduler), DT_ALLOC_PERM);
+	if (!mem)
+		return false;
+	m_scheduler = new(mem) Scheduler;
+
+	m_nav = nav;
+	m_maxSearchNodeCount = maxSearchNodeCount;
+	m_maxSearchNodeCap = maxSearchNodeCap;
 	m_maxPathSize = maxPathSize;
-	for (int i = 0; i < MAX_QUEUE; ++i)
+	if (!grow())
+		return false;
+
+	m_tick = 0;
+	resetStats();
+
+	return setWorkerCount(numWorkers);
+}
+
+bool dtPathQueue::setWorkerCount(const int numWorkers)
+{
+	if (!m_scheduler)
+		return false;
+	stopWorkers();
+
+	// Restart the requests in progress.
+	for (int i = 0; i < m_queueCapacity; ++i)
 	{
-		m_queue[i].ref = DT_PATHQ_INVALID;
-		m_queue[i].path = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*m_maxPathSize, DT_ALLOC_PERM);
-		if (!m_queue[i].path)
+		PathQuery& q = m_queue[i];
+		if (q.ref != DT_PATHQ_INVALID && dtStatusInProgress(q.status))
+		{
+			q.status = 0;
+			q.worker = -1;
+			pushPending(q);
+		}
+	}
+
+	const int n = dtMax(numWorkers, 0);
+	m_workers = (Worker*)dtAlloc(sizeof(Worker)*(n+1), DT_ALLOC_PERM);
+	if (!m_workers)
+		return false;
+	for (int i = 0; i <= n; ++i)
+	{
+		Worker* w = new(&m_workers[i]) Worker;
+		w->navquery = 0;
+		w->current = -1;
+		w->currentRef = DT_PATHQ_INVALID;
+		w->frame = m_scheduler->frame;
+	}
+	m_workers[0].navquery = m_navquery;
+
+	for (int i = 1; i <= n; ++i)
+	{
+		Worker& w = m_workers[i];
+		w.navquery = dtAllocNavMeshQuery();
+		if (!w.navquery || dtStatusFailed(w.navquery->init(m_nav, m_maxSearchNodeCount, m_maxSearchNodeCap)))
+		{
+			// Run with the workers started so far.
+			dtFreeNavMeshQuery(w.navquery);
+			w.navquery = 0;
 			return false;
+		}
+		w.thread = std::thread(&dtPathQueue::workerLoop, this, i);
+		m_nworkers = i;
 	}
-	
-	m_queueHead = 0;
-	
+
 	return true;
 }
 
-void dtPathQueue::update(const int maxIters)
+bool dtPathQueue::grow()
 {
-	static const int MAX_KEEP_ALIVE = 2; // in update ticks.
+	if (m_queueCapacity >= PATHQ_MAX_QUEUE)
+		return false;
+	const int capacity = m_queueCapacity ? dtMin(m_queueCapacity*2, PATHQ_MAX_QUEUE) : PATHQ_INITIAL_QUEUE;
+	PathQuery* queue = (PathQuery*)dtAlloc(sizeof(PathQuery)*capacity, DT_ALLOC_PERM);
+	int* freeSlots = (int*)dtAlloc(sizeof(int)*capacity, DT_ALLOC_PERM);
+	PendingQuery* pending = (PendingQuery*)dtAlloc(sizeof(PendingQuery)*capacity*2, DT_ALLOC_PERM);
+	if (!queue || !freeSlots || !pending)
+	{
+		dtFree(queue);
+		dtFree(freeSlots);
+		dtFree(pending);
+		return false;
+	}
+	if (m_queueCapacity)
+		memcpy(queue, m_queue, sizeof(PathQuery)*m_queueCapacity);
+	memset(&queue[m_queueCapacity], 0, sizeof(PathQuery)*(capacity-m_queueCapacity));
+	for (int i = m_queueCapacity; i < capacity; ++i)
+	{
+		PathQuery& q = queue[i];
+		q.ref = DT_PATHQ_INVALID;
+		q.worker = -1;
+		q.path = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*m_maxPathSize, DT_ALLOC_PERM);
+		if (!q.path)
+		{
+			for (int j = m_queueCapacity; j < i; ++j)
+				dtFree(queue[j].path);
+			dtFree(queue);
+			dtFree(freeSlots);
+			dtFree(pending);
+			return false;
+		}
+	}
+	// The new slots are free, lowest first.
+	if (m_nfreeSlots)
+		memcpy(freeSlots, m_freeSlots, sizeof(int)*m_nfreeSlots);
+	for (int i = capacity-1; i >= m_queueCapacity; --i)
+		freeSlots[m_nfreeSlots++] = i;
+	if (m_npending)
+		memcpy(pending, m_pending, sizeof(PendingQuery)*m_npending);
+	dtFree(m_queue);
+	dtFree(m_freeSlots);
+	dtFree(m_pending);
+	m_queue = queue;
+	m_freeSlots = freeSlots;
+	m_pending = pending;
+	m_queueCapacity = capacity;
+	return true;
+}
+
+dtPathQueue::PathQuery* dtPathQueue::getQuery(dtPathQueueRef ref) const
+{
+	if (ref == DT_PATHQ_INVALID)
+		return 0;
+	const int slot = (int)(ref & (PATHQ_MAX_QUEUE-1));
+	if (slot >= m_queueCapacity || m_queue[slot].ref != ref)
+		return 0;
+	return &m_queue[slot];
+}
+
+void dtPathQueue::freeQuery(PathQuery& q)
+{
+	q.ref = DT_PATHQ_INVALID;
+	q.status = 0;
+	m_requestCount--;
+	m_freeSlots[m_nfreeSlots++] = (int)(&q - m_queue);
+}
 
-	// Update path request until there is nothing to update
-	// or upto maxIters pathfinder iterations has been consumed.
-	int iterCount = maxIters;
-	
-	for (int i = 0; i < MAX_QUEUE; ++i)
+void dtPathQueue::pushPending(const PathQuery& q)
+{
+	// When full, drop the entries of the requests no longer waiting: at most
+	// m_queueCapacity are.
+	if (m_npending == m_queueCapacity*2)
 	{
-		PathQuery& q = m_queue[m_queueHead % MAX_QUEUE];
-		
-		// Skip inactive requests.
-		if (q.ref == DT_PATHQ_INVALID)
+		int n = 0;
+		for (int i = 0; i < m_npending; ++i)
 		{
-			m_queueHead++;
-			continue;
+			const PathQuery* w = getQuery(m_pending[i].ref);
+			if (w && w->worker == -1 && w->status == 0)
+				m_pending[n++] = m_pending[i];
 		}
-		
-		// Handle completed request.
-		if (dtStatusSucceed(q.status) || dtStatusFailed(q.status))
+		m_npending = n;
+		std::make_heap(m_pending, m_pending+m_npending);
+	}
+	PendingQuery& p = m_pending[m_npending++];
+	p.key = (double)q.priority - (double)q.requestTick;
+	p.sequence = q.sequence;
+	p.ref = q.ref;
+	std::push_heap(m_pending, m_pending+m_npending);
+}
+
+/// @par
+///
+/// A worker first resumes the query in progress on its own query object, then
+/// starts the waiting one with the highest priority, aged by the waited
+/// update ticks. The heap entries of the requests already served or read are
+/// skipped.
+dtPathQueue::PathQuery* dtPathQueue::pickQuery(const int worker)
+{
+	Worker& w = m_workers[worker];
+	if (w.current != -1)
+	{
+		PathQuery* q = getQuery(w.currentRef);
+		w.current = -1;
+		w.currentRef = DT_PATHQ_INVALID;
+		if (q && q->worker == worker && dtStatusInProgress(q->status))
+			return q;
+	}
+
+	std::lock_guard<std::mutex> guard(m_scheduler->lock);
+	while (m_npending > 0)
+	{
+		std::pop_heap(m_pending, m_pending+m_npending);
+		m_npending--;
+		PathQuery* q = getQuery(m_pending[m_npending].ref);
+		if (q && q->worker == -1 && q->status == 0)
 		{
-			// If the path result has not been read in few frames, free the slot.
-			q.keepAlive++;
-			if (q.keepAlive > MAX_KEEP_ALIVE)
-			{
-				q.ref = DT_PATHQ_INVALID;
-				q.status = 0;
-			}
-			
-			m_queueHead++;
-			continue;
+			q->worker = worker;
+			return q;
+		}
+	}
+	return 0;
+}
+
+void dtPathQueue::runQueries(const int worker)
+{
+	Scheduler& s = *m_scheduler;
+	Worker& w = m_workers[worker];
+	dtNavMeshQuery* navquery = w.navquery;
+
+	PathQuery* q = 0;
+	for (;;)
+	{
+		if (s.deadline && getTimeUsec() >= s.deadline)
+			break;
+		if (s.itersLeft.load(std::memory_order_relaxed) <= 0)
+			break;
+		if (!q)
+		{
+			q = pickQuery(worker);
+			if (!q)
+				break;
 		}
-		
+
 		// Handle query start.
-		if (q.status == 0)
+		if (q->status == 0)
 		{
-			q.status = m_navquery->initSlicedFindPath(q.startRef, q.endRef, q.startPos, q.endPos, q.filter);
-		}		
+			q->status = navquery->initSlicedFindPath(q->startRef, q->endRef, q->startPos, q->endPos, q->filter);
+		}
 		// Handle query in progress.
-		if (dtStatusInProgress(q.status))
+		if (dtStatusInProgress(q->status))
 		{
+			const int left = s.itersLeft.fetch_sub(PATHQ_SLICE_ITERS, std::memory_order_relaxed);
+			const int maxIters = dtMin(PATHQ_SLICE_ITERS, left);
 			int iters = 0;
-			q.status = m_navquery->updateSlicedFindPath(iterCount, &iters);
-			iterCount -= iters;
+			if (maxIters > 0)
+				q->status = navquery->updateSlicedFindPath(maxIters, &iters);
+			// Give back the unused iterations.
+			if (iters < PATHQ_SLICE_ITERS)
+				s.itersLeft.fetch_add(PATHQ_SLICE_ITERS - iters, std::memory_order_relaxed);
 		}
-		if (dtStatusSucceed(q.status))
+		if (dtStatusSucceed(q->status))
 		{
-			q.status = m_navquery->finalizeSlicedFindPath(q.path, &q.npath, m_maxPathSize);
+			q->status = navquery->finalizeSlicedFindPath(q->path, &q->npath, m_maxPathSize);
 		}
 
-		if (iterCount <= 0)
-			break;
+		if (!dtStatusInProgress(q->status))
+		{
+			recordLatency(*q);
+			q = 0;
+		}
+	}
 
-		m_queueHead++;
+	// Resume the query in progress on the next update.
+	if (q)
+	{
+		w.current = (int)(q - m_queue);
+		w.currentRef = q->ref;
 	}
 }
 
-dtPathQueueRef dtPathQueue::request(dtPolyRef startRef, dtPolyRef endRef,
-									const float* startPos, const float* endPos,
-									const dtQueryFilter* filter)
+void dtPathQueue::workerLoop(const int worker)
 {
-	// Find empty slot
-	int slot = -1;
-	for (int i = 0; i < MAX_QUEUE; ++i)
+	Scheduler& s = *m_scheduler;
+	Worker& w = m_workers[worker];
+	for (;;)
 	{
-		if (m_queue[i].ref == DT_PATHQ_INVALID)
 		{
-			slot = i;
-			break;
+			std::unique_lock<std::mutex> lock(s.lock);
+			while (!s.quit && s.frame == w.frame)
+				s.start.wait(lock);
+			if (s.quit)
+				return;
+			w.frame = s.frame;
+		}
+		runQueries(worker);
+		{
+			std::lock_guard<std::mutex> guard(s.lock);
+			if (--s.running == 0)
+				s.done.notify_one();
 		}
 	}
-	// Could not find slot.
-	if (slot == -1)
+}
+
+void dtPathQueue::recordLatency(const PathQuery& q)
+{
+	const long long now = getTimeUsec();
+	std::lock_guard<std::mutex> guard(m_scheduler->lock);
+	m_latencyUsec[m_latencyHead] = (float)(now - q.requestTime);
+	m_latencyUpdates[m_latencyHead] = m_tick - q.requestTick;
+	m_latencyHead = (m_latencyHead+1) % DT_PATHQ_LATENCY_SAMPLES;
+	if (m_latencyCount < DT_PATHQ_LATENCY_SAMPLES)
+		m_latencyCount++;
+	m_completedCount++;
+}
+
+void dtPathQueue::update(const int maxIters, const int maxTimeUsec)
+{
+	static const int MAX_KEEP_ALIVE = 2; // in update ticks.
+
+	if (!m_scheduler)
+		return;
+	m_tick++;
+
+	for (int i = 0; i < m_queueCapacity; ++i)
+	{
+		PathQuery& q = m_queue[i];
+		if (q.ref == DT_PATHQ_INVALID)
+			continue;
+		// Handle completed request.
+		if (dtStatusSucceed(q.status) || dtStatusFailed(q.status))
+		{
+			// If the path result has not been read in few frames, free the slot.
+			q.keepAlive++;
+			if (q.keepAlive > MAX_KEEP_ALIVE)
+				freeQuery(q);
+		}
+	}
+
+	// Set the budget and serve the requests on all the workers.
+	Scheduler& s = *m_scheduler;
+	s.itersLeft.store(maxIters > 0 ? maxIters : INT_MAX/2);
+	s.deadline = maxTimeUsec > 0 ? getTimeUsec() + maxTimeUsec : 0;
+	if (m_nworkers)
+	{
+		{
+			std::lock_guard<std::mutex> guard(s.lock);
+			s.running = m_nworkers;
+			s.frame++;
+		}
+		s.start.notify_all();
+	}
+	runQueries(0);
+	if (m_nworkers)
+	{
+		std::unique_lock<std::mutex> lock(s.lock);
+		while (s.running > 0)
+			s.done.wait(lock);
+	}
+}
+
+dtPathQueueRef dtPathQueue::request(dtPolyRef startRef, dtPolyRef endRef,
+									const float* startPos, const float* endPos,
+									const dtQueryFilter* filter, const float priority)
+{
+	if (!m_scheduler)
 		return DT_PATHQ_INVALID;
-	
-	dtPathQueueRef ref = m_nextHandle++;
-	if (m_nextHandle == DT_PATHQ_INVALID) m_nextHandle++;
-	
+
+	// Take a free slot, growing the queue if there is none.
+	if (!m_nfreeSlots && !grow())
+		return DT_PATHQ_INVALID;
+	const int slot = m_freeSlots[--m_nfreeSlots];
+
+	dtPathQueueRef ref = ((dtPathQueueRef)m_nextGeneration << PATHQ_SLOT_BITS) | (dtPathQueueRef)slot;
+	m_nextGeneration++;
+	if (m_nextGeneration == 0) m_nextGeneration++;
+
 	PathQuery& q = m_queue[slot];
 	q.ref = ref;
 	dtVcopy(q.startPos, startPos);
 	q.startRef = startRef;
 	dtVcopy(q.endPos, endPos);
 	q.endRef = endRef;
-	
+
 	q.status = 0;
 	q.npath = 0;
 	q.filter = filter;
 	q.keepAlive = 0;
-	
+
+	q.priority = priority;
+	q.sequence = m_nextSequence++;
+	q.requestTick = m_tick;
+	q.requestTime = getTimeUsec();
+	q.worker = -1;
+
+	pushPending(q);
+
+	m_requestCount++;
+	if (m_requestCount > m_maxRequestCount)
+		m_maxRequestCount = m_requestCount;
+
 	return ref;
 }
 
 dtStatus dtPathQueue::getRequestStatus(dtPathQueueRef ref) const
 {
-	for (int i = 0; i < MAX_QUEUE; ++i)
+	const PathQuery* q = getQuery(ref);
+	if (!q)
+		return DT_FAILURE;
+	return q->status;
+}
+
+dtStatus dtPathQueue::getPathResult(dtPathQueueRef ref, dtPolyRef* path, int* pathSize, const int maxPath)
+{
+	PathQuery* q = getQuery(ref);
+	if (!q)
+		return DT_FAILURE;
+
+	dtStatus details = q->status & DT_STATUS_DETAIL_MASK;
+	// Free request for reuse.
+	freeQuery(*q);
+	// Copy path
+	int n = dtMin(q->npath, maxPath);
+	memcpy(path, q->path, sizeof(dtPolyRef)*n);
+	*pathSize = n;
+	return details | DT_SUCCESS;
+}
+
+template<typename T>
+static void getPercentiles(const T* samples, const int count, float* percentiles)
+{
+	T sorted[DT_PATHQ_LATENCY_SAMPLES];
+	memcpy(sorted, samples, sizeof(T)*count);
+	std::sort(sorted, sorted+count);
+	// Nearest rank.
+	const float ranks[3] = { 0.5f, 0.9f, 0.99f };
+	for (int i = 0; i < 3; ++i)
 	{
-		if (m_queue[i].ref == ref)
-			return m_queue[i].status;
+		const int idx = dtClamp((int)(ranks[i]*count + 0.999f) - 1, 0, count-1);
+		percentiles[i] = (float)sorted[idx];
 	}
-	return DT_FAILURE;
+	percentiles[3] = (float)sorted[count-1];
 }
 
-dtStatus dtPathQueue::getPathResult(dtPathQueueRef ref, dtPolyRef* path, int* pathSize, const int maxPath)
+void dtPathQueue::getStats(dtPathQueueStats* stats) const
 {
-	for (int i = 0; i < MAX_QUEUE; ++i)
+	memset(stats, 0, sizeof(dtPathQueueStats));
+	stats->requestCount = m_requestCount;
+	stats->capacity = m_queueCapacity;
+	stats->maxRequestCount = m_maxRequestCount;
+	stats->completedCount = m_completedCount;
+	stats->latencySamples = m_latencyCount;
+	if (m_latencyCount)
 	{
-		if (m_queue[i].ref == ref)
-		{
-			PathQuery& q = m_queue[i];
-			dtStatus details = q.status & DT_STATUS_DETAIL_MASK;
-			// Free request for reuse.
-			q.ref = DT_PATHQ_INVALID;
-			q.status = 0;
-			// Copy path
-			int n = dtMin(q.npath, maxPath);
-			memcpy(path, q.path, sizeof(dtPolyRef)*n);
-			*pathSize = n;
-			return details | DT_SUCCESS;
-		}
+		getPercentiles(m_latencyUsec, m_latencyCount, stats->latencyUsec);
+		getPercentiles(m_latencyUpdates, m_latencyCount, stats->latencyUpdates);
+	}
+	unsigned long long nodes = 0;
+	for (int i = 0; i <= m_nworkers; ++i)
+	{
+		if (!m_workers || !m_workers[i].navquery)
+			continue;
+		const dtNodePool* pool = m_workers[i].navquery->getNodePool();
+		stats->searchCount += pool->getSearchCount();
+		nodes += pool->getNodesTouched();
+		stats->peakSearchNodes = dtMax(stats->peakSearchNodes, pool->getPeakNodes());
+		stats->maxSearchNodes = dtMax(stats->maxSearchNodes, pool->getMaxNodes());
+		stats->outOfNodesCount += pool->getOutOfNodesCount();
+	}
+	if (stats->searchCount)
+		stats->avgSearchNodes = (float)((double)nodes / stats->searchCount);
+}
+
+void dtPathQueue::resetStats()
+{
+	m_latencyCount = 0;
+	m_latencyHead = 0;
+	m_completedCount = 0;
+	m_maxRequestCount = m_requestCount;
+	for (int i = 0; i <= m_nworkers; ++i)
+	{
+		if (m_workers && m_workers[i].navquery)
+			m_workers[i].navquery->getNodePool()->resetStats();
 	}
-	return DT_FAILURE;
 }
@@ -26,6 +26,27 @@ static const unsigned int DT_PATHQ_INVALID = 0;
 
 typedef unsigned int dtPathQueueRef;
 
+/// Path queue statistics.
+/// Latencies go from the request to the path completion, over the last
+/// #DT_PATHQ_LATENCY_SAMPLES completed requests.
+struct dtPathQueueStats
+{
+	int requestCount;				///< Requests in the queue (waiting, in progress or completed but not read).
+	int capacity;					///< Current capacity of the queue.
+	int maxRequestCount;			///< Maximum number of requests in the queue since the last reset.
+	unsigned int completedCount;	///< Completed requests since the last reset.
+	int latencySamples;				///< Samples the latencies are computed on.
+	float latencyUsec[4];			///< 50th, 90th, 99th percentiles and maximum latency, in microseconds.
+	float latencyUpdates[4];		///< 50th, 90th, 99th percentiles and maximum latency, in update ticks.
+	unsigned int searchCount;		///< Searches run by the query objects since the last reset.
+	float avgSearchNodes;			///< Average number of nodes touched per search.
+	int peakSearchNodes;			///< Maximum number of nodes touched by a search.
+	int maxSearchNodes;				///< Current capacity of the largest node pool.
+	unsigned int outOfNodesCount;	///< Searches which needed more nodes than the node pool cap.
+};
+
+static const int DT_PATHQ_LATENCY_SAMPLES = 1024;
+
 class dtPathQueue
 {
 	struct PathQuery
@@ -41,35 +62,115 @@ class dtPathQueue
 		dtStatus status;
 		int keepAlive;
 		const dtQueryFilter* filter; ///< TODO: This is potentially dangerous!
+		/// Scheduling.
+		float priority;
+		unsigned int sequence;		///< Request order, to serve equal priorities first come first served.
+		unsigned int requestTick;	///< Update tick of the request.
+		long long requestTime;		///< Time of the request, in microseconds.
+		int worker;					///< Worker running the query, -1 if not started.
 	};
-	
-	static const int MAX_QUEUE = 8;
-	PathQuery m_queue[MAX_QUEUE];
-	dtPathQueueRef m_nextHandle;
+
+	struct Worker;
+	struct Scheduler;
+	struct PendingQuery;
+
+	PathQuery* m_queue;
+	int m_queueCapacity;
+	int m_requestCount;
+	/// Free slots (stack) and waiting requests (heap by aged priority, with
+	/// room for 2 * m_queueCapacity entries, some no longer waiting).
+	int* m_freeSlots;
+	int m_nfreeSlots;
+	PendingQuery* m_pending;
+	int m_npending;
+	unsigned short m_nextGeneration;
+	unsigned int m_nextSequence;
 	int m_maxPathSize;
-	int m_queueHead;
+	int m_maxSearchNodeCount;
+	int m_maxSearchNodeCap;
+	dtNavMesh* m_nav;
 	dtNavMeshQuery* m_navquery;
-	
+
+	/// Workers: the first one is the calling thread, using m_navquery, the
+	/// others are threads with their own query objects.
+	Worker* m_workers;
+	int m_nworkers;
+	Scheduler* m_scheduler;
+
+	unsigned int m_tick;
+
+	/// Latency samples (ring buffer).
+	float m_latencyUsec[DT_PATHQ_LATENCY_SAMPLES];
+	unsigned int m_latencyUpdates[DT_PATHQ_LATENCY_SAMPLES];
+	int m_latencyCount;
+	int m_latencyHead;
+	unsigned int m_completedCount;
+	int m_maxRequestCount;
+
 	void purge();
-	
+	void stopWorkers();
+	bool grow();
+	PathQuery* getQuery(dtPathQueueRef ref) const;
+	void freeQuery(PathQuery& q);
+	void pushPending(const PathQuery& q);
+	PathQuery* pickQuery(const int worker);
+	void runQueries(const int worker);
+	void workerLoop(const int worker);
+	void recordLatency(const PathQuery& q);
+
 public:
 	dtPathQueue();
 	~dtPathQueue();
-	
-	bool init(const int maxPathSize, const int maxSearchNodeCount, dtNavMesh* nav);
-	
-	void update(const int maxIters);
-	
+
+	/// Initializes the path queue.
+	///  @param[in]		maxPathSize			The maximum number of polygons of the paths.
+	///  @param[in]		maxSearchNodeCount	The initial number of search nodes of each query object.
+	///  @param[in]		nav					The navigation mesh.
+	///  @param[in]		numWorkers			The number of worker threads (see #setWorkerCount).
+	///  @param[in]		maxSearchNodeCap	The number of search nodes each query object can grow to,
+	///										or 0 for fixed size node pools. (See dtNavMeshQuery::init)
+	/// @return True if the initialization succeeded.
+	bool init(const int maxPathSize, const int maxSearchNodeCount, dtNavMesh* nav, const int numWorkers = 0,
+			  const int maxSearchNodeCap = 0);
+
+	/// Sets the number of worker threads: each one has its own query object, so
+	/// more requests are served concurrently during #update. With no workers
+	/// requests are served on the calling thread only.
+	/// Requests in progress are restarted.
+	/// @return True if the workers could be started.
+	bool setWorkerCount(const int numWorkers);
+	inline int getWorkerCount() const { return m_nworkers; }
+
+	/// Serves the requests, by decreasing priority, until there is nothing
+	/// left to serve or the budget is consumed.
+	/// The navigation mesh must not change during the update.
+	///  @param[in]		maxIters		The maximum number of pathfinder iterations, summed over
+	///									all threads. [Limit: <= 0 for no limit]
+	///  @param[in]		maxTimeUsec		The maximum duration of the update, in microseconds.
+	///									[Limit: <= 0 for no limit]
+	void update(const int maxIters, const int maxTimeUsec = 0);
+
+	/// Requests a path.
+	/// The priority is in update ticks: a request with priority p is served as
+	/// if it had been waiting p update ticks more, so no request starves.
+	/// @return The request reference, or #DT_PATHQ_INVALID on error.
 	dtPathQueueRef request(dtPolyRef startRef, dtPolyRef endRef,
-						   const float* startPos, const float* endPos, 
-						   const dtQueryFilter* filter);
-	
+						   const float* startPos, const float* endPos,
+						   const dtQueryFilter* filter, const float priority = 0.0f);
+
 	dtStatus getRequestStatus(dtPathQueueRef ref) const;
-	
+
 	dtStatus getPathResult(dtPathQueueRef ref, dtPolyRef* path, int* pathSize, const int maxPath);
-	
+
 	inline const dtNavMeshQuery* getNavQuery() const { return m_navquery; }
 
+	/// Gets the queue statistics. The node statistics are summed over the
+	/// query objects of all workers: call it between updates.
+	void getStats(dtPathQueueStats* stats) const;
+
+	/// Resets the queue statistics.
+	void resetStats();
+
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
 	dtPathQueue(const dtPathQueue&);
@@ -0,0 +1,106 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURQUERYFILTERS_H
+#define DETOURQUERYFILTERS_H
+
+#include "DetourNavMeshQuery.h"
+
+// Specialized query filters, meant for the template dtNavMeshQuery::findPath:
+// their functions hide the ones of dtQueryFilter, and are inlined into the
+// search. They can be passed as dtQueryFilter to the other queries, which
+// then use the flags and area costs only.
+
+/// Query filter ignoring the area costs: paths are the shortest ones
+/// through the polygons passing the include and exclude flags.
+/// @ingroup detour
+class dtShortestQueryFilter : public dtQueryFilter
+{
+public:
+	dtShortestQueryFilter() {}
+	explicit dtShortestQueryFilter(const dtQueryFilter& filter) : dtQueryFilter(filter) {}
+
+	inline float getCost(const float* pa, const float* pb,
+						 const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
+						 const dtPolyRef /*curRef*/, const dtMeshTile* /*curTile*/, const dtPoly* /*curPoly*/,
+						 const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/) const
+	{
+		return dtVdist(pa, pb);
+	}
+};
+
+static const int DT_MAX_DANGER_AREAS = 16;
+
+/// Query filter applying the area costs, and multiplying the cost of
+/// the segments crossing danger areas: circles on the xz-plane.
+/// @ingroup detour
+class dtDangerQueryFilter : public dtQueryFilter
+{
+	float m_dangerAreas[DT_MAX_DANGER_AREAS*4];	///< Danger areas. [(x, z, radius squared, cost) * #m_dangerAreaCount]
+	int m_dangerAreaCount;
+
+public:
+	dtDangerQueryFilter() : m_dangerAreaCount(0) {}
+	explicit dtDangerQueryFilter(const dtQueryFilter& filter) : dtQueryFilter(filter), m_dangerAreaCount(0) {}
+
+	/// Adds a danger area.
+	///  @param[in]		center		The center of the area. [(x, y, z)]
+	///  @param[in]		radius		The radius of the area.
+	///  @param[in]		cost		The cost multiplier of the segments crossing the area. [Limit: >= 1]
+	/// @return The index of the area, or -1 if there are already #DT_MAX_DANGER_AREAS areas.
+	inline int addDangerArea(const float* center, const float radius, const float cost)
+	{
+		if (m_dangerAreaCount >= DT_MAX_DANGER_AREAS)
+			return -1;
+		float* area = &m_dangerAreas[m_dangerAreaCount*4];
+		area[0] = center[0];
+		area[1] = center[2];
+		area[2] = dtSqr(radius);
+		area[3] = dtMax(cost, 1.0f);
+		return m_dangerAreaCount++;
+	}
+
+	/// Removes all the danger areas.
+	inline void clearDangerAreas() { m_dangerAreaCount = 0; }
+
+	inline int getDangerAreaCount() const { return m_dangerAreaCount; }
+
+	inline float getCost(const float* pa, const float* pb,
+						 const dtPolyRef prevRef, const dtMeshTile* prevTile, const dtPoly* prevPoly,
+						 const dtPolyRef curRef, const dtMeshTile* curTile, const dtPoly* curPoly,
+						 const dtPolyRef nextRef, const dtMeshTile* nextTile, const dtPoly* nextPoly) const
+	{
+		float cost = dtQueryFilter::getCost(pa, pb,
+											prevRef, prevTile, prevPoly,
+											curRef, curTile, curPoly,
+											nextRef, nextTile, nextPoly);
+		// The most dangerous area crossed counts.
+		float scale = 1.0f;
+		for (int i = 0; i < m_dangerAreaCount; ++i)
+		{
+			const float* area = &m_dangerAreas[i*4];
+			const float pt[3] = { area[0], 0.0f, area[1] };
+			float t;
+			if (area[3] > scale && dtDistancePtSegSqr2D(pt, pa, pb, t) < area[2])
+				scale = area[3];
+		}
+		return cost * scale;
+	}
+};
+
+#endif // DETOURQUERYFILTERS_H
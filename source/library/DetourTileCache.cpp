@@ -73,11 +73,18 @@ dtTileCache::dtTileCache() :
 	m_tmproc(0),
 	m_obstacles(0),
 	m_nextFreeObstacle(0),
+	m_maxObstacles(0),
+	m_maxObstaclesCap(0),
+	m_nfreeObstacles(0),
+	m_reqs(0),
 	m_nreqs(0),
-	m_nupdate(0)
+	m_maxReqs(0),
+	m_update(0),
+	m_nupdate(0),
+	m_maxUpdate(0),
+	m_updateLookup(0)
 {
 	memset(&m_params, 0, sizeof(m_params));
-	memset(m_reqs, 0, sizeof(ObstacleRequest) * MAX_REQUESTS);
 }
 	
 dtTileCache::~dtTileCache()
@@ -92,6 +99,12 @@ dtTileCache::~dtTileCache()
 	}
 	dtFree(m_obstacles);
 	m_obstacles = 0;
+	dtFree(m_reqs);
+	m_reqs = 0;
+	dtFree(m_update);
+	m_update = 0;
+	dtFree(m_updateLookup);
+	m_updateLookup = 0;
 	dtFree(m_posLookup);
 	m_posLookup = 0;
 	dtFree(m_tiles);
@@ -126,18 +139,14 @@ dtStatus dtTileCache::init(const dtTileCacheParams* params,
 	m_nreqs = 0;
 	memcpy(&m_params, params, sizeof(m_params));
 	
-	// Alloc space for obstacles.
-	m_obstacles = (dtTileCacheObstacle*)dtAlloc(sizeof(dtTileCacheObstacle)*m_params.maxObstacles, DT_ALLOC_PERM);
-	if (!m_obstacles)
+	// Alloc space for obstacles: the capacity grows on demand up to the cap.
+	if (m_params.maxObstacles < 0 || m_params.maxObstacles > DT_TILECACHE_MAX_OBSTACLES)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	m_maxObstaclesCap = dtClamp(m_params.maxObstaclesCap, m_params.maxObstacles, DT_TILECACHE_MAX_OBSTACLES);
+	if (m_params.maxObstacles > 0 && !growObstacles(m_params.maxObstacles))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	if (!reserveRequests(64) || !reserveUpdates(64))
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
-	memset(m_obstacles, 0, sizeof(dtTileCacheObstacle)*m_params.maxObstacles);
-	m_nextFreeObstacle = 0;
-	for (int i = m_params.maxObstacles-1; i >= 0; --i)
-	{
-		m_obstacles[i].salt = 1;
-		m_obstacles[i].next = m_nextFreeObstacle;
-		m_nextFreeObstacle = &m_obstacles[i];
-	}
 	
 	// Init tiles
 	m_tileLutSize = dtNextPow2(m_params.maxTiles/4);
@@ -150,8 +159,12 @@ dtStatus dtTileCache::init(const dtTileCacheParams* params,
 	m_posLookup = (dtCompressedTile**)dtAlloc(sizeof(dtCompressedTile*)*m_tileLutSize, DT_ALLOC_PERM);
 	if (!m_posLookup)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_updateLookup = (dtCompressedTileRef*)dtAlloc(sizeof(dtCompressedTileRef)*m_params.maxTiles, DT_ALLOC_PERM);
+	if (!m_updateLookup)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	memset(m_tiles, 0, sizeof(dtCompressedTile)*m_params.maxTiles);
 	memset(m_posLookup, 0, sizeof(dtCompressedTile*)*m_tileLutSize);
+	memset(m_updateLookup, 0, sizeof(dtCompressedTileRef)*m_params.maxTiles);
 	m_nextFreeTile = 0;
 	for (int i = m_params.maxTiles-1; i >= 0; --i)
 	{
@@ -163,7 +176,7 @@ dtStatus dtTileCache::init(const dtTileCacheParams* params,
 	// Init ID generator values.
 	m_tileBits = dtIlog2(dtNextPow2((unsigned int)m_params.maxTiles));
 	// Only allow 31 salt bits, since the salt mask is calculated using 32bit uint and it will overflow.
-	m_saltBits = dtMin((unsigned int)31, 32 - m_tileBits);
+	m_saltBits = dtMin((unsigned int)31, (unsigned int)(sizeof(dtCompressedTileRef)*8) - m_tileBits);
 	if (m_saltBits < 10)
 		return DT_FAILURE | DT_INVALID_PARAM;
 	
@@ -230,7 +243,7 @@ const dtTileCacheObstacle* dtTileCache::getObstacleByRef(dtObstacleRef ref)
 	if (!ref)
 		return 0;
 	unsigned int idx = decodeObstacleIdObstacle(ref);
-	if ((int)idx >= m_params.maxObstacles)
+	if ((int)idx >= m_maxObstacles)
 		return 0;
 	const dtTileCacheObstacle* ob = &m_obstacles[idx];
 	unsigned int salt = decodeObstacleIdSalt(ref);
@@ -239,6 +252,133 @@ const dtTileCacheObstacle* dtTileCache::getObstacleByRef(dtObstacleRef ref)
 	return ob;
 }
 
+bool dtTileCache::growObstacles(const int maxObstacles)
+{
+	if (maxObstacles <= m_maxObstacles)
+		return true;
+	if (maxObstacles > DT_TILECACHE_MAX_OBSTACLES)
+		return false;
+	
+	dtTileCacheObstacle* obstacles = (dtTileCacheObstacle*)dtAlloc(sizeof(dtTileCacheObstacle)*maxObstacles, DT_ALLOC_PERM);
+	if (!obstacles)
+		return false;
+	
+	// Move the obstacles, rebasing the free list pointers.
+	if (m_maxObstacles)
+		memcpy(obstacles, m_obstacles, sizeof(dtTileCacheObstacle)*m_maxObstacles);
+	for (int i = 0; i < m_maxObstacles; ++i)
+	{
+		if (m_obstacles[i].next)
+			obstacles[i].next = obstacles + (m_obstacles[i].next - m_obstacles);
+	}
+	dtTileCacheObstacle* tail = 0;
+	if (m_nextFreeObstacle)
+	{
+		tail = obstacles + (m_nextFreeObstacle - m_obstacles);
+		m_nextFreeObstacle = tail;
+		while (tail->next)
+			tail = tail->next;
+	}
+	
+	// Append the new obstacles to the free list, in index order.
+	memset(obstacles + m_maxObstacles, 0, sizeof(dtTileCacheObstacle)*(maxObstacles - m_maxObstacles));
+	for (int i = m_maxObstacles; i < maxObstacles; ++i)
+	{
+		obstacles[i].salt = 1;
+		if (tail)
+			tail->next = &obstacles[i];
+		else
+			m_nextFreeObstacle = &obstacles[i];
+		tail = &obstacles[i];
+	}
+	m_nfreeObstacles += maxObstacles - m_maxObstacles;
+	
+	dtFree(m_obstacles);
+	m_obstacles = obstacles;
+	m_maxObstacles = maxObstacles;
+	
+	return true;
+}
+
+bool dtTileCache::reserveObstacles(const int count)
+{
+	if (count <= m_nfreeObstacles)
+		return true;
+	const int needed = m_maxObstacles + count - m_nfreeObstacles;
+	if (needed > m_maxObstaclesCap)
+		return false;
+	return growObstacles(dtMin(dtMax(m_maxObstacles*2, needed), m_maxObstaclesCap));
+}
+
+bool dtTileCache::reserveRequests(const int count)
+{
+	if (m_nreqs + count <= m_maxReqs)
+		return true;
+	const int maxReqs = dtMax(m_maxReqs*2, m_nreqs + count);
+	ObstacleRequest* reqs = (ObstacleRequest*)dtAlloc(sizeof(ObstacleRequest)*maxReqs, DT_ALLOC_PERM);
+	if (!reqs)
+		return false;
+	if (m_nreqs)
+		memcpy(reqs, m_reqs, sizeof(ObstacleRequest)*m_nreqs);
+	dtFree(m_reqs);
+	m_reqs = reqs;
+	m_maxReqs = maxReqs;
+	return true;
+}
+
+bool dtTileCache::reserveUpdates(const int count)
+{
+	if (m_nupdate + count <= m_maxUpdate)
+		return true;
+	const int maxUpdate = dtMax(m_maxUpdate*2, m_nupdate + count);
+	dtCompressedTileRef* update = (dtCompressedTileRef*)dtAlloc(sizeof(dtCompressedTileRef)*maxUpdate, DT_ALLOC_PERM);
+	if (!update)
+		return false;
+	if (m_nupdate)
+		memcpy(update, m_update, sizeof(dtCompressedTileRef)*m_nupdate);
+	dtFree(m_update);
+	m_update = update;
+	m_maxUpdate = maxUpdate;
+	return true;
+}
+
+dtTileCacheObstacle* dtTileCache::allocObstacle()
+{
+	if (!m_nextFreeObstacle)
+		return 0;
+	dtTileCacheObstacle* ob = m_nextFreeObstacle;
+	m_nextFreeObstacle = ob->next;
+	m_nfreeObstacles--;
+	
+	unsigned short salt = ob->salt;
+	memset(ob, 0, sizeof(dtTileCacheObstacle));
+	ob->salt = salt;
+	ob->state = DT_OBSTACLE_PROCESSING;
+	return ob;
+}
+
+void dtTileCache::pushRequest(const int action, const dtObstacleRef ref)
+{
+	ObstacleRequest* req = &m_reqs[m_nreqs++];
+	memset(req, 0, sizeof(ObstacleRequest));
+	req->action = action;
+	req->ref = ref;
+}
+
+dtStatus dtTileCache::pushUpdate(const dtCompressedTileRef ref)
+{
+	// The lookup keeps the update list free of duplicates in O(1).
+	const unsigned int it = decodeTileIdTile(ref);
+	if ((int)it < m_params.maxTiles && m_updateLookup[it] == ref)
+		return DT_SUCCESS;
+	if (!reserveUpdates(1))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_update[m_nupdate++] = ref;
+	if ((int)it < m_params.maxTiles)
+		m_updateLookup[it] = ref;
+	return DT_SUCCESS;
+}
+
 dtStatus dtTileCache::addTile(unsigned char* data, const int dataSize, unsigned char flags, dtCompressedTileRef* result)
 {
 	// Make sure the data is in right format.
@@ -339,7 +479,7 @@ dtStatus dtTileCache::removeTile(dtCompressedTileRef ref, unsigned char** data,
 	tile->flags = 0;
 	
 	// Update salt, salt should never be zero.
-	tile->salt = (tile->salt+1) & ((1<<m_saltBits)-1);
+	tile->salt = (tile->salt+1) & ((1U<<m_saltBits)-1);
 	if (tile->salt == 0)
 		tile->salt++;
 	
@@ -350,87 +490,268 @@ dtStatus dtTileCache::removeTile(dtCompressedTileRef ref, unsigned char** data,
 	return DT_SUCCESS;
 }
 
-
-dtStatus dtTileCache::addObstacle(const float* pos, const float radius, const float height, dtObstacleRef* result)
+dtStatus dtTileCache::replaceTilesAt(const int tx, const int ty, unsigned char** data, const int* dataSize,
+									 const int count, unsigned char flags, dtCompressedTileRef* results)
 {
-	if (m_nreqs >= MAX_REQUESTS)
-		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+	const int MAX_TILES = 32;
+	dtCompressedTileRef oldTiles[MAX_TILES];
+	const int noldTiles = getTilesAt(tx,ty,oldTiles,MAX_TILES);
+	for (int i = 0; i < noldTiles; ++i)
+		removeTile(oldTiles[i], 0, 0);
 	
-	dtTileCacheObstacle* ob = 0;
-	if (m_nextFreeObstacle)
+	dtStatus status = DT_SUCCESS;
+	dtCompressedTileRef newTiles[MAX_TILES];
+	int nnewTiles = 0;
+	for (int i = 0; i < count; ++i)
 	{
-		ob = m_nextFreeObstacle;
-		m_nextFreeObstacle = ob->next;
-		ob->next = 0;
+		dtCompressedTileRef ref = 0;
+		dtStatus addStatus = addTile(data[i], dataSize[i], flags, &ref);
+		if (dtStatusFailed(addStatus))
+			status = addStatus;
+		else if (nnewTiles < MAX_TILES)
+			newTiles[nnewTiles++] = ref;
+		if (results)
+			results[i] = ref;
 	}
-	if (!ob)
-		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	
-	unsigned short salt = ob->salt;
-	memset(ob, 0, sizeof(dtTileCacheObstacle));
-	ob->salt = salt;
-	ob->state = DT_OBSTACLE_PROCESSING;
-	ob->type = DT_OBSTACLE_CYLINDER;
-	dtVcopy(ob->cylinder.pos, pos);
-	ob->cylinder.radius = radius;
-	ob->cylinder.height = height;
+	// Find again the tiles touched by the obstacles over the location.
+	for (int i = 0; i < m_maxObstacles; ++i)
+	{
+		dtTileCacheObstacle* ob = &m_obstacles[i];
+		if (ob->state == DT_OBSTACLE_EMPTY)
+			continue;
+		float bmin[3], bmax[3];
+		getObstacleBounds(ob, bmin, bmax);
+		bool affected = false;
+		for (int j = 0; j < noldTiles && !affected; ++j)
+			affected = contains(ob->touched, ob->ntouched, oldTiles[j]);
+		for (int j = 0; j < nnewTiles && !affected; ++j)
+		{
+			float tbmin[3], tbmax[3];
+			calcTightTileBounds(getTileByRef(newTiles[j])->header, tbmin, tbmax);
+			affected = dtOverlapBounds(bmin, bmax, tbmin, tbmax);
+		}
+		if (!affected)
+			continue;
+		int ntouched = 0;
+		queryTiles(bmin, bmax, ob->touched, &ntouched, DT_MAX_TOUCHED_TILES);
+		ob->ntouched = (unsigned char)ntouched;
+	}
 	
-	ObstacleRequest* req = &m_reqs[m_nreqs++];
-	memset(req, 0, sizeof(ObstacleRequest));
-	req->action = REQUEST_ADD;
-	req->ref = getObstacleRef(ob);
+	return status;
+}
+
+
+dtStatus dtTileCache::addObstacle(const float* pos, const float radius, const float height, dtObstacleRef* result)
+{
+	return addObstacles(pos, &radius, &height, 1, result);
+}
+
+dtStatus dtTileCache::addBoxObstacle(const float* bmin, const float* bmax, dtObstacleRef* result)
+{
+	return addBoxObstacles(bmin, bmax, 1, result);
+}
+
+dtStatus dtTileCache::removeObstacle(const dtObstacleRef ref)
+{
+	return removeObstacles(&ref, 1);
+}
+
+dtStatus dtTileCache::addObstacles(const float* pos, const float* radius, const float* height, const int count,
+								   dtObstacleRef* results)
+{
+	if (count <= 0)
+		return DT_SUCCESS;
+	if (!reserveRequests(count) || !reserveObstacles(count))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	
-	if (result)
-		*result = req->ref;
+	for (int i = 0; i < count; ++i)
+	{
+		dtTileCacheObstacle* ob = allocObstacle();
+		ob->type = DT_OBSTACLE_CYLINDER;
+		dtVcopy(ob->cylinder.pos, &pos[i*3]);
+		ob->cylinder.radius = radius[i];
+		ob->cylinder.height = height[i];
+		
+		const dtObstacleRef ref = getObstacleRef(ob);
+		pushRequest(REQUEST_ADD, ref);
+		if (results)
+			results[i] = ref;
+	}
 	
 	return DT_SUCCESS;
 }
 
-dtStatus dtTileCache::addBoxObstacle(const float* bmin, const float* bmax, dtObstacleRef* result)
+dtStatus dtTileCache::addBoxObstacles(const float* bmin, const float* bmax, const int count, dtObstacleRef* results)
 {
-	if (m_nreqs >= MAX_REQUESTS)
-		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+	if (count <= 0)
+		return DT_SUCCESS;
+	if (!reserveRequests(count) || !reserveObstacles(count))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	
-	dtTileCacheObstacle* ob = 0;
-	if (m_nextFreeObstacle)
+	for (int i = 0; i < count; ++i)
 	{
-		ob = m_nextFreeObstacle;
-		m_nextFreeObstacle = ob->next;
-		ob->next = 0;
+		dtTileCacheObstacle* ob = allocObstacle();
+		ob->type = DT_OBSTACLE_BOX;
+		dtVcopy(ob->box.bmin, &bmin[i*3]);
+		dtVcopy(ob->box.bmax, &bmax[i*3]);
+		
+		const dtObstacleRef ref = getObstacleRef(ob);
+		pushRequest(REQUEST_ADD, ref);
+		if (results)
+			results[i] = ref;
 	}
-	if (!ob)
+	
+	return DT_SUCCESS;
+}
+
+dtStatus dtTileCache::removeObstacles(const dtObstacleRef* refs, const int count)
+{
+	if (count <= 0)
+		return DT_SUCCESS;
+	if (!reserveRequests(count))
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	
-	unsigned short salt = ob->salt;
-	memset(ob, 0, sizeof(dtTileCacheObstacle));
-	ob->salt = salt;
-	ob->state = DT_OBSTACLE_PROCESSING;
-	ob->type = DT_OBSTACLE_BOX;
-	dtVcopy(ob->box.bmin, bmin);
-	dtVcopy(ob->box.bmax, bmax);
+	for (int i = 0; i < count; ++i)
+	{
+		if (refs[i])
+			pushRequest(REQUEST_REMOVE, refs[i]);
+	}
 	
-	ObstacleRequest* req = &m_reqs[m_nreqs++];
-	memset(req, 0, sizeof(ObstacleRequest));
-	req->action = REQUEST_ADD;
-	req->ref = getObstacleRef(ob);
+	return DT_SUCCESS;
+}
+
+struct dtObstacleState
+{
+	int magic;
+	int version;
+	int maxObstacles;
+	int nextFreeObstacle;
+	int nreqs;
+	int nupdate;
+};
+
+static int getObstacleStateDataSize(const int maxObstacles, const int nreqs, const int nupdate, const int reqSize)
+{
+	const int headerSize = dtAlign4(sizeof(dtObstacleState));
+	const int obstaclesSize = dtAlign4(sizeof(dtTileCacheObstacle) * maxObstacles);
+	const int nextSize = dtAlign4(sizeof(int) * maxObstacles);
+	const int reqsSize = dtAlign4(reqSize * nreqs);
+	const int updateSize = dtAlign4(sizeof(dtCompressedTileRef) * nupdate);
+	return headerSize + obstaclesSize + nextSize + reqsSize + updateSize;
+}
+
+int dtTileCache::getObstacleStateSize() const
+{
+	return getObstacleStateDataSize(m_maxObstacles, m_nreqs, m_nupdate, sizeof(ObstacleRequest));
+}
+
+dtStatus dtTileCache::storeObstacleState(unsigned char* data, const int maxDataSize) const
+{
+	if (maxDataSize < getObstacleStateSize())
+		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
 	
-	if (result)
-		*result = req->ref;
+	dtObstacleState* state = dtGetThenAdvanceBufferPointer<dtObstacleState>(data, dtAlign4(sizeof(dtObstacleState)));
+	dtTileCacheObstacle* obstacles = dtGetThenAdvanceBufferPointer<dtTileCacheObstacle>(data, dtAlign4(sizeof(dtTileCacheObstacle) * m_maxObstacles));
+	int* next = dtGetThenAdvanceBufferPointer<int>(data, dtAlign4(sizeof(int) * m_maxObstacles));
+	ObstacleRequest* reqs = dtGetThenAdvanceBufferPointer<ObstacleRequest>(data, dtAlign4(sizeof(ObstacleRequest) * m_nreqs));
+	dtCompressedTileRef* update = dtGetThenAdvanceBufferPointer<dtCompressedTileRef>(data, dtAlign4(sizeof(dtCompressedTileRef) * m_nupdate));
+	
+	state->magic = DT_TILECACHE_STATE_MAGIC;
+	state->version = DT_TILECACHE_STATE_VERSION;
+	state->maxObstacles = m_maxObstacles;
+	state->nextFreeObstacle = m_nextFreeObstacle ? (int)(m_nextFreeObstacle - m_obstacles) : -1;
+	state->nreqs = m_nreqs;
+	state->nupdate = m_nupdate;
+	
+	// Free list pointers are stored as indices.
+	if (m_maxObstacles)
+		memcpy(obstacles, m_obstacles, sizeof(dtTileCacheObstacle) * m_maxObstacles);
+	for (int i = 0; i < m_maxObstacles; ++i)
+	{
+		obstacles[i].next = 0;
+		next[i] = m_obstacles[i].next ? (int)(m_obstacles[i].next - m_obstacles) : -1;
+	}
+	if (m_nreqs)
+		memcpy(reqs, m_reqs, sizeof(ObstacleRequest) * m_nreqs);
+	if (m_nupdate)
+		memcpy(update, m_update, sizeof(dtCompressedTileRef) * m_nupdate);
 	
 	return DT_SUCCESS;
 }
 
-dtStatus dtTileCache::removeObstacle(const dtObstacleRef ref)
+dtStatus dtTileCache::restoreObstacleState(const unsigned char* data, const int maxDataSize)
 {
-	if (!ref)
-		return DT_SUCCESS;
-	if (m_nreqs >= MAX_REQUESTS)
-		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+	if (maxDataSize < dtAlign4(sizeof(dtObstacleState)))
+		return DT_FAILURE | DT_INVALID_PARAM;
 	
-	ObstacleRequest* req = &m_reqs[m_nreqs++];
-	memset(req, 0, sizeof(ObstacleRequest));
-	req->action = REQUEST_REMOVE;
-	req->ref = ref;
+	const dtObstacleState* state = dtGetThenAdvanceBufferPointer<const dtObstacleState>(data, dtAlign4(sizeof(dtObstacleState)));
+	if (state->magic != DT_TILECACHE_STATE_MAGIC)
+		return DT_FAILURE | DT_WRONG_MAGIC;
+	if (state->version != DT_TILECACHE_STATE_VERSION)
+		return DT_FAILURE | DT_WRONG_VERSION;
+	if (state->maxObstacles < 0 || state->maxObstacles > DT_TILECACHE_MAX_OBSTACLES ||
+		state->nreqs < 0 || state->nupdate < 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (maxDataSize < getObstacleStateDataSize(state->maxObstacles, state->nreqs, state->nupdate, sizeof(ObstacleRequest)))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	const dtTileCacheObstacle* obstacles = dtGetThenAdvanceBufferPointer<const dtTileCacheObstacle>(data, dtAlign4(sizeof(dtTileCacheObstacle) * state->maxObstacles));
+	const int* next = dtGetThenAdvanceBufferPointer<const int>(data, dtAlign4(sizeof(int) * state->maxObstacles));
+	const ObstacleRequest* reqs = dtGetThenAdvanceBufferPointer<const ObstacleRequest>(data, dtAlign4(sizeof(ObstacleRequest) * state->nreqs));
+	const dtCompressedTileRef* update = dtGetThenAdvanceBufferPointer<const dtCompressedTileRef>(data, dtAlign4(sizeof(dtCompressedTileRef) * state->nupdate));
+	
+	// The capacity never shrinks: grow it to the stored one if needed.
+	if (!growObstacles(state->maxObstacles))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_nreqs = 0;
+	m_nupdate = 0;
+	if (!reserveRequests(state->nreqs) || !reserveUpdates(state->nupdate))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	
+	if (state->maxObstacles)
+		memcpy(m_obstacles, obstacles, sizeof(dtTileCacheObstacle) * state->maxObstacles);
+	for (int i = 0; i < state->maxObstacles; ++i)
+		m_obstacles[i].next = next[i] >= 0 ? &m_obstacles[next[i]] : 0;
+	m_nextFreeObstacle = state->nextFreeObstacle >= 0 ? &m_obstacles[state->nextFreeObstacle] : 0;
+	
+	// The obstacles past the stored capacity are freed, after the stored free list.
+	m_nfreeObstacles = 0;
+	dtTileCacheObstacle* tail = 0;
+	for (dtTileCacheObstacle* ob = m_nextFreeObstacle; ob; ob = ob->next)
+	{
+		tail = ob;
+		m_nfreeObstacles++;
+	}
+	for (int i = state->maxObstacles; i < m_maxObstacles; ++i)
+	{
+		dtTileCacheObstacle* ob = &m_obstacles[i];
+		unsigned short salt = (unsigned short)(ob->salt+1);
+		if (salt == 0)
+			salt++;
+		memset(ob, 0, sizeof(dtTileCacheObstacle));
+		ob->salt = salt;
+		if (tail)
+			tail->next = ob;
+		else
+			m_nextFreeObstacle = ob;
+		tail = ob;
+		m_nfreeObstacles++;
+	}
+	
+	m_nreqs = state->nreqs;
+	if (m_nreqs)
+		memcpy(m_reqs, reqs, sizeof(ObstacleRequest) * m_nreqs);
+	m_nupdate = state->nupdate;
+	if (m_nupdate)
+		memcpy(m_update, update, sizeof(dtCompressedTileRef) * m_nupdate);
+	memset(m_updateLookup, 0, sizeof(dtCompressedTileRef) * m_params.maxTiles);
+	for (int i = 0; i < m_nupdate; ++i)
+	{
+		const unsigned int it = decodeTileIdTile(m_update[i]);
+		if ((int)it < m_params.maxTiles)
+			m_updateLookup[it] = m_update[i];
+	}
 	
 	return DT_SUCCESS;
 }
@@ -479,15 +800,22 @@ dtStatus dtTileCache::queryTiles(const float* bmin, const float* bmax,
 dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh,
 							 bool* upToDate)
 {
+	dtStatus reqStatus = DT_SUCCESS;
 	if (m_nupdate == 0)
 	{
-		// Process requests.
+		// Reserve the updates of all the requests first: on failure they stay
+		// queued, and are processed by a later update.
+		if (m_nreqs > 0 && !reserveUpdates(m_nreqs*DT_MAX_TOUCHED_TILES))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		
+		// Process requests. All the pending requests are processed at once,
+		// so a tile touched by several of them is queued once.
 		for (int i = 0; i < m_nreqs; ++i)
 		{
 			ObstacleRequest* req = &m_reqs[i];
 			
 			unsigned int idx = decodeObstacleIdObstacle(req->ref);
-			if ((int)idx >= m_params.maxObstacles)
+			if ((int)idx >= m_maxObstacles)
 				continue;
 			dtTileCacheObstacle* ob = &m_obstacles[idx];
 			unsigned int salt = decodeObstacleIdSalt(req->ref);
@@ -507,12 +835,15 @@ dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh,
 				ob->npending = 0;
 				for (int j = 0; j < ob->ntouched; ++j)
 				{
-					if (m_nupdate < MAX_UPDATE)
+					// A tile which couldn't be queued isn't pending, so the
+					// obstacle can't stay pending forever.
+					const dtStatus pushStatus = pushUpdate(ob->touched[j]);
+					if (dtStatusFailed(pushStatus))
 					{
-						if (!contains(m_update, m_nupdate, ob->touched[j]))
-							m_update[m_nupdate++] = ob->touched[j];
-						ob->pending[ob->npending++] = ob->touched[j];
+						reqStatus = pushStatus;
+						continue;
 					}
+					ob->pending[ob->npending++] = ob->touched[j];
 				}
 			}
 			else if (req->action == REQUEST_REMOVE)
@@ -523,12 +854,15 @@ dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh,
 				ob->npending = 0;
 				for (int j = 0; j < ob->ntouched; ++j)
 				{
-					if (m_nupdate < MAX_UPDATE)
+					// A tile which couldn't be queued isn't pending, so the
+					// obstacle can't stay pending forever.
+					const dtStatus pushStatus = pushUpdate(ob->touched[j]);
+					if (dtStatusFailed(pushStatus))
 					{
-						if (!contains(m_update, m_nupdate, ob->touched[j]))
-							m_update[m_nupdate++] = ob->touched[j];
-						ob->pending[ob->npending++] = ob->touched[j];
+						reqStatus = pushStatus;
+						continue;
 					}
+					ob->pending[ob->npending++] = ob->touched[j];
 				}
 			}
 		}
@@ -546,9 +880,12 @@ dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh,
 		m_nupdate--;
 		if (m_nupdate > 0)
 			memmove(m_update, m_update+1, m_nupdate*sizeof(dtCompressedTileRef));
+		const unsigned int it = decodeTileIdTile(ref);
+		if ((int)it < m_params.maxTiles && m_updateLookup[it] == ref)
+			m_updateLookup[it] = 0;
 
 		// Update obstacle states.
-		for (int i = 0; i < m_params.maxObstacles; ++i)
+		for (int i = 0; i < m_maxObstacles; ++i)
 		{
 			dtTileCacheObstacle* ob = &m_obstacles[i];
 			if (ob->state == DT_OBSTACLE_PROCESSING || ob->state == DT_OBSTACLE_REMOVING)
@@ -581,6 +918,7 @@ dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh,
 						// Return obstacle to free list.
 						ob->next = m_nextFreeObstacle;
 						m_nextFreeObstacle = ob;
+						m_nfreeObstacles++;
 					}
 				}
 			}
@@ -590,6 +928,8 @@ dtStatus dtTileCache::update(const float /*dt*/, dtNavMesh* navmesh,
 	if (upToDate)
 		*upToDate = m_nupdate == 0 && m_nreqs == 0;
 
+	if (dtStatusFailed(reqStatus))
+		return reqStatus;
 	return status;
 }
 
@@ -611,10 +951,24 @@ dtStatus dtTileCache::buildNavMeshTilesAt(const int tx, const int ty, dtNavMesh*
 }
 
 dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh* navmesh)
+{
+	unsigned char* navData = 0;
+	int navDataSize = 0;
+	dtStatus status = buildNavMeshTileData(ref, &navData, &navDataSize);
+	if (dtStatusFailed(status))
+		return status;
+	return replaceNavMeshTile(ref, navData, navDataSize, navmesh);
+}
+
+dtStatus dtTileCache::buildNavMeshTileData(const dtCompressedTileRef ref,
+										   unsigned char** outNavData, int* outNavDataSize)
 {	
 	dtAssert(m_talloc);
 	dtAssert(m_tcomp);
 	
+	*outNavData = 0;
+	*outNavDataSize = 0;
+	
 	unsigned int idx = decodeTileIdTile(ref);
 	if (idx > (unsigned int)m_params.maxTiles)
 		return DT_FAILURE | DT_INVALID_PARAM;
@@ -635,7 +989,7 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 		return status;
 	
 	// Rasterize obstacles.
-	for (int i = 0; i < m_params.maxObstacles; ++i)
+	for (int i = 0; i < m_maxObstacles; ++i)
 	{
 		const dtTileCacheObstacle* ob = &m_obstacles[i];
 		if (ob->state == DT_OBSTACLE_EMPTY || ob->state == DT_OBSTACLE_REMOVING)
@@ -677,11 +1031,7 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 	
 	// Early out if the mesh tile is empty.
 	if (!bc.lmesh->npolys)
-	{
-		// Remove existing tile.
-		navmesh->removeTile(navmesh->getTileRefAt(tile->header->tx,tile->header->ty,tile->header->tlayer),0,0);
 		return DT_SUCCESS;
-	}
 	
 	dtNavMeshCreateParams params;
 	memset(&params, 0, sizeof(params));
@@ -700,7 +1050,7 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 	params.tileLayer = tile->header->tlayer;
 	params.cs = m_params.cs;
 	params.ch = m_params.ch;
-	params.buildBvTree = false;
+	params.buildBvTree = true;
 	dtVcopy(params.bmin, tile->header->bmin);
 	dtVcopy(params.bmax, tile->header->bmax);
 	
@@ -709,11 +1059,23 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 		m_tmproc->process(&params, bc.lmesh->areas, bc.lmesh->flags);
 	}
 	
-	unsigned char* navData = 0;
-	int navDataSize = 0;
-	if (!dtCreateNavMeshData(&params, &navData, &navDataSize))
+	if (!dtCreateNavMeshData(&params, outNavData, outNavDataSize))
 		return DT_FAILURE;
+	
+	return DT_SUCCESS;
+}
 
+dtStatus dtTileCache::replaceNavMeshTile(const dtCompressedTileRef ref,
+										 unsigned char* navData, const int navDataSize, dtNavMesh* navmesh)
+{
+	unsigned int idx = decodeTileIdTile(ref);
+	if (idx > (unsigned int)m_params.maxTiles)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	const dtCompressedTile* tile = &m_tiles[idx];
+	unsigned int salt = decodeTileIdSalt(ref);
+	if (tile->salt != salt)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
 	// Remove existing tile.
 	navmesh->removeTile(navmesh->getTileRefAt(tile->header->tx,tile->header->ty,tile->header->tlayer),0,0);
 
@@ -721,7 +1083,7 @@ dtStatus dtTileCache::buildNavMeshTile(const dtCompressedTileRef ref, dtNavMesh*
 	if (navData)
 	{
 		// Let the navmesh own the data.
-		status = navmesh->addTile(navData,navDataSize,DT_TILE_FREE_DATA,0,0);
+		dtStatus status = navmesh->addTile(navData,navDataSize,DT_TILE_FREE_DATA,0,0);
 		if (dtStatusFailed(status))
 		{
 			dtFree(navData);
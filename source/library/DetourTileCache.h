@@ -7,7 +7,14 @@
 
 typedef unsigned int dtObstacleRef;
 
+#ifdef DT_POLYREF64
+// With 64bit polyrefs, compressed tile refs are 64bit too: the tile cache has
+// several layers per navmesh tile.
+#include <stdint.h>
+typedef uint64_t dtCompressedTileRef;
+#else
 typedef unsigned int dtCompressedTileRef;
+#endif
 
 /// Flags for addTile
 enum dtCompressedTileFlags
@@ -55,6 +62,10 @@ struct dtObstacleBox
 };
 
 static const int DT_MAX_TOUCHED_TILES = 8;
+
+/// The maximum number of obstacles: obstacle refs have 16 index bits.
+static const int DT_TILECACHE_MAX_OBSTACLES = 1 << 16;
+
 struct dtTileCacheObstacle
 {
 	union
@@ -83,7 +94,8 @@ struct dtTileCacheParams
 	float walkableClimb;
 	float maxSimplificationError;
 	int maxTiles;
-	int maxObstacles;
+	int maxObstacles;			///< The initial number of obstacles. [Limit: <= #DT_TILECACHE_MAX_OBSTACLES]
+	int maxObstaclesCap;		///< The number of obstacles the cache can grow to, or 0 for a fixed capacity. [Limit: <= #DT_TILECACHE_MAX_OBSTACLES]
 };
 
 struct dtTileCacheMeshProcess
@@ -108,9 +120,16 @@ public:
 	inline int getTileCount() const { return m_params.maxTiles; }
 	inline const dtCompressedTile* getTile(const int i) const { return &m_tiles[i]; }
 	
-	inline int getObstacleCount() const { return m_params.maxObstacles; }
+	/// The current obstacle capacity. (Obstacles are returned empty past the used ones.)
+	inline int getObstacleCount() const { return m_maxObstacles; }
+	/// The obstacle at an index. The pointer is invalidated when the capacity grows.
 	inline const dtTileCacheObstacle* getObstacle(const int i) const { return &m_obstacles[i]; }
+	/// The number of obstacles in use.
+	inline int getUsedObstacleCount() const { return m_maxObstacles - m_nfreeObstacles; }
+	/// The capacity the obstacles can grow to.
+	inline int getMaxObstaclesCap() const { return m_maxObstaclesCap; }
 	
+	/// The obstacle of a reference. The pointer is invalidated when the capacity grows.
 	const dtTileCacheObstacle* getObstacleByRef(dtObstacleRef ref);
 	
 	dtObstacleRef getObstacleRef(const dtTileCacheObstacle* obmin) const;
@@ -130,11 +149,70 @@ public:
 	
 	dtStatus removeTile(dtCompressedTileRef ref, unsigned char** data, int* dataSize);
 	
+	/// Replaces the tiles (layers) at a location, and finds again the tiles
+	/// touched by the obstacles over it. The navigation mesh tiles are not
+	/// rebuilt. Expects no pending obstacle request or tile rebuild (see #isUpToDate).
+	///  @param[in]		tx, ty			The location.
+	///  @param[in]		data			The data of the new tiles. [Size: @p count]
+	///  @param[in]		dataSize		The sizes of the new tiles. [Size: @p count]
+	///  @param[in]		count			The number of new tiles.
+	///  @param[in]		flags			The tile flags. (See: #dtCompressedTileFlags)
+	///  @param[out]	results			The new tile references, 0 for the tiles which could
+	///									not be added, whose data is left to the caller. [Size: @p count] (Optional)
+	/// @return The status flags for the operation.
+	dtStatus replaceTilesAt(const int tx, const int ty, unsigned char** data, const int* dataSize,
+							const int count, unsigned char flags, dtCompressedTileRef* results);
+	
 	dtStatus addObstacle(const float* pos, const float radius, const float height, dtObstacleRef* result);
 	dtStatus addBoxObstacle(const float* bmin, const float* bmax, dtObstacleRef* result);
 	
 	dtStatus removeObstacle(const dtObstacleRef ref);
 	
+	/// Adds a batch of cylinder obstacles. Either all of them or none are added.
+	/// The requests of a batch are processed by the same #update, so the tiles
+	/// touched by several obstacles are rebuilt only once.
+	///  @param[in]		pos			The positions of the obstacles. [(x, y, z) * @p count]
+	///  @param[in]		radius		The radii of the obstacles. [Size: @p count]
+	///  @param[in]		height		The heights of the obstacles. [Size: @p count]
+	///  @param[in]		count		The number of obstacles.
+	///  @param[out]	results		The obstacle references. [Size: @p count] (Optional)
+	/// @return The status flags for the operation.
+	dtStatus addObstacles(const float* pos, const float* radius, const float* height, const int count,
+						  dtObstacleRef* results);
+	
+	/// Adds a batch of box obstacles. Either all of them or none are added.
+	///  @param[in]		bmin		The minimum bounds of the boxes. [(x, y, z) * @p count]
+	///  @param[in]		bmax		The maximum bounds of the boxes. [(x, y, z) * @p count]
+	///  @param[in]		count		The number of obstacles.
+	///  @param[out]	results		The obstacle references. [Size: @p count] (Optional)
+	/// @return The status flags for the operation.
+	dtStatus addBoxObstacles(const float* bmin, const float* bmax, const int count, dtObstacleRef* results);
+	
+	/// Removes a batch of obstacles. Null references are skipped.
+	///  @param[in]		refs		The obstacle references. [Size: @p count]
+	///  @param[in]		count		The number of obstacles.
+	/// @return The status flags for the operation.
+	dtStatus removeObstacles(const dtObstacleRef* refs, const int count);
+	
+	/// Whether there are obstacle requests or tile rebuilds left to #update.
+	inline bool isUpToDate() const { return m_nupdate == 0 && m_nreqs == 0; }
+	
+	/// Gets the size of the buffer required by #storeObstacleState to store the obstacles' state.
+	int getObstacleStateSize() const;
+	
+	/// Stores the obstacles, including the pending obstacle requests and tile rebuilds.
+	///  @param[out]	data			The buffer to store the obstacles' state in.
+	///  @param[in]		maxDataSize		The size of the data buffer. [Limit: >= #getObstacleStateSize]
+	/// @return The status flags for the operation.
+	dtStatus storeObstacleState(unsigned char* data, const int maxDataSize) const;
+	
+	/// Restores the obstacles. The navigation mesh tiles are not rebuilt: they
+	/// are expected to be restored to the same point in time.
+	///  @param[in]		data			The obstacles' state. (Obtained from #storeObstacleState.)
+	///  @param[in]		maxDataSize		The size of the state within the data buffer.
+	/// @return The status flags for the operation.
+	dtStatus restoreObstacleState(const unsigned char* data, const int maxDataSize);
+	
 	dtStatus queryTiles(const float* bmin, const float* bmax,
 						dtCompressedTileRef* results, int* resultCount, const int maxResults) const;
 	
@@ -150,6 +228,26 @@ public:
 	
 	dtStatus buildNavMeshTile(const dtCompressedTileRef ref, class dtNavMesh* navmesh);
 	
+	/// Builds the navigation mesh data of a compressed tile, without touching
+	/// the navigation mesh. Can be called concurrently for different tiles,
+	/// as long as the allocator gives each thread its own memory, and the
+	/// tile cache is not modified meanwhile.
+	///  @param[in]		ref				The reference of the compressed tile.
+	///  @param[out]	navData			The tile data, to be freed with dtFree, or null if the tile is empty.
+	///  @param[out]	navDataSize		The size of the tile data.
+	/// @return The status flags for the operation.
+	dtStatus buildNavMeshTileData(const dtCompressedTileRef ref, unsigned char** navData, int* navDataSize);
+	
+	/// Replaces the navigation mesh tile at the location of a compressed tile.
+	///  @param[in]		ref				The reference of the compressed tile.
+	///  @param[in]		navData			The data built by #buildNavMeshTileData, owned by the navigation mesh
+	///									on success, freed on failure. If null, the location is left empty.
+	///  @param[in]		navDataSize		The size of the tile data.
+	///  @param[in]		navmesh			The mesh to affect.
+	/// @return The status flags for the operation.
+	dtStatus replaceNavMeshTile(const dtCompressedTileRef ref, unsigned char* navData, const int navDataSize,
+								class dtNavMesh* navmesh);
+	
 	void calcTightTileBounds(const struct dtTileCacheLayerHeader* header, float* bmin, float* bmax) const;
 	
 	void getObstacleBounds(const struct dtTileCacheObstacle* ob, float* bmin, float* bmax) const;
@@ -213,6 +311,14 @@ private:
 		dtObstacleRef ref;
 	};
 	
+	bool growObstacles(const int maxObstacles);
+	bool reserveObstacles(const int count);
+	bool reserveRequests(const int count);
+	bool reserveUpdates(const int count);
+	dtTileCacheObstacle* allocObstacle();
+	void pushRequest(const int action, const dtObstacleRef ref);
+	dtStatus pushUpdate(const dtCompressedTileRef ref);
+	
 	int m_tileLutSize;						///< Tile hash lookup size (must be pot).
 	int m_tileLutMask;						///< Tile hash lookup mask.
 	
@@ -231,14 +337,18 @@ private:
 	
 	dtTileCacheObstacle* m_obstacles;
 	dtTileCacheObstacle* m_nextFreeObstacle;
+	int m_maxObstacles;						///< Current obstacle capacity.
+	int m_maxObstaclesCap;					///< Obstacle capacity limit.
+	int m_nfreeObstacles;					///< Number of obstacles in the free list.
 	
-	static const int MAX_REQUESTS = 64;
-	ObstacleRequest m_reqs[MAX_REQUESTS];
+	ObstacleRequest* m_reqs;				///< Pending obstacle requests.
 	int m_nreqs;
+	int m_maxReqs;
 	
-	static const int MAX_UPDATE = 64;
-	dtCompressedTileRef m_update[MAX_UPDATE];
+	dtCompressedTileRef* m_update;			///< Tiles to rebuild, in request order.
 	int m_nupdate;
+	int m_maxUpdate;
+	dtCompressedTileRef* m_updateLookup;	///< Per tile index: the ref queued in m_update, or 0.
 };
 
 dtTileCache* dtAllocTileCache();
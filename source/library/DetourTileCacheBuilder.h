@@ -24,6 +24,8 @@
 
 static const int DT_TILECACHE_MAGIC = 'D'<<24 | 'T'<<16 | 'L'<<8 | 'R'; ///< 'DTLR';
 static const int DT_TILECACHE_VERSION = 1;
+static const int DT_TILECACHE_STATE_MAGIC = 'D'<<24 | 'T'<<16 | 'C'<<8 | 'S'; ///< 'DTCS';
+static const int DT_TILECACHE_STATE_VERSION = 2;
 
 static const unsigned char DT_TILECACHE_NULL_AREA = 0;
 static const unsigned char DT_TILECACHE_WALKABLE_AREA = 63;
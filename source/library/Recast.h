@@ -921,6 +921,29 @@ void rcFilterLedgeSpans(rcContext* ctx, const int walkableHeight,
 ///  @param[in,out]	solid			A fully built heightfield.  (All spans have been added.)
 void rcFilterWalkableLowHeightSpans(rcContext* ctx, int walkableHeight, rcHeightfield& solid);
 
+/// Filters applied by #rcFilterWalkableSpans.
+/// @see rcFilterWalkableSpans
+enum rcFilterSpanFlags
+{
+	RC_FILTER_LOW_HANGING_OBSTACLES = 0x01,		///< As #rcFilterLowHangingWalkableObstacles.
+	RC_FILTER_LEDGE_SPANS = 0x02,				///< As #rcFilterLedgeSpans.
+	RC_FILTER_WALKABLE_LOW_HEIGHT_SPANS = 0x04,	///< As #rcFilterWalkableLowHeightSpans.
+};
+
+/// Applies the selected span filters, with the same result as calling them one by one,
+/// on a column-compacted copy of the spans built once.
+///  @ingroup recast
+///  @param[in,out]	ctx				The build context to use during the operation.
+///  @param[in]		filters			The filters to apply. [Flags: #rcFilterSpanFlags]
+///  @param[in]		walkableHeight	Minimum floor to 'ceiling' height that will still allow the floor area to
+///  								be considered walkable. [Limit: >= 3] [Units: vx]
+///  @param[in]		walkableClimb	Maximum ledge height that is considered to still be traversable.
+///  								[Limit: >=0] [Units: vx]
+///  @param[in,out]	solid			A fully built heightfield.  (All spans have been added.)
+///  @returns True if the operation completed successfully.
+bool rcFilterWalkableSpans(rcContext* ctx, const int filters, const int walkableHeight,
+						   const int walkableClimb, rcHeightfield& solid);
+
 /// Returns the number of spans contained in the specified heightfield.
 ///  @ingroup recast
 ///  @param[in,out]	ctx		The build context to use during the operation.
@@ -1134,10 +1157,13 @@ bool rcBuildHeightfieldLayers(rcContext* ctx, rcCompactHeightfield& chf,
 ///  							[Limit: >=0] [Units: vx]
 ///  @param[out]	cset		The resulting contour set. (Must be pre-allocated.)
 ///  @param[in]		buildFlags	The build flags. (See: #rcBuildContoursFlags)
+///  @param[in]		nthreads	The maximum number of threads building the contours, the calling
+///  							one included. [Limit: >= 1]
 ///  @returns True if the operation completed successfully.
 bool rcBuildContours(rcContext* ctx, rcCompactHeightfield& chf,
 					 const float maxError, const int maxEdgeLen,
-					 rcContourSet& cset, const int buildFlags = RC_CONTOUR_TESS_WALL_EDGES);
+					 rcContourSet& cset, const int buildFlags = RC_CONTOUR_TESS_WALL_EDGES,
+					 const int nthreads = 1);
 
 /// Builds a polygon mesh from the provided contours.
 ///  @ingroup recast
@@ -1167,10 +1193,12 @@ bool rcMergePolyMeshes(rcContext* ctx, rcPolyMesh** meshes, const int nmeshes, r
 ///  @param[in]		sampleMaxError	The maximum distance the detail mesh surface should deviate from 
 ///  								heightfield data. [Limit: >=0] [Units: wu]
 ///  @param[out]	dmesh			The resulting detail mesh.  (Must be pre-allocated.)
+///  @param[in]		nthreads		The maximum number of threads building the polygon details,
+///  								the calling one included. [Limit: >= 1]
 ///  @returns True if the operation completed successfully.
 bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompactHeightfield& chf,
 						   const float sampleDist, const float sampleMaxError,
-						   rcPolyMeshDetail& dmesh);
+						   rcPolyMeshDetail& dmesh, const int nthreads = 1);
 
 /// Copies the poly mesh data from src to dst.
 ///  @ingroup recast
@@ -21,9 +21,12 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <new>
+#include <atomic>
 #include "Recast.h"
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
+#include "RecastThreads.h"
 
 
 static int getCornerHeight(int x, int y, int i, int dir,
@@ -808,6 +811,437 @@ static void mergeRegionHoles(rcContext* ctx, rcContourRegion& region)
 }
 
 
+/// Minimum number of regions per thread of the parallel contour build.
+static const int RC_CONTOUR_REGIONS_PER_THREAD = 16;
+
+/// Marks the non connected edges of the spans of rows [y0, y1).
+static void markContourBoundaries(const rcCompactHeightfield& chf, unsigned char* flags,
+								  const int y0, const int y1)
+{
+	const int w = chf.width;
+	for (int y = y0; y < y1; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			const rcCompactCell& c = chf.cells[x+y*w];
+			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+			{
+				unsigned char res = 0;
+				const rcCompactSpan& s = chf.spans[i];
+				if (!chf.spans[i].reg || (chf.spans[i].reg & RC_BORDER_REG))
+				{
+					flags[i] = 0;
+					continue;
+				}
+				for (int dir = 0; dir < 4; ++dir)
+				{
+					unsigned short r = 0;
+					if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
+					{
+						const int ax = x + rcGetDirOffsetX(dir);
+						const int ay = y + rcGetDirOffsetY(dir);
+						const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
+						r = chf.spans[ai].reg;
+					}
+					if (r == chf.spans[i].reg)
+						res |= (1 << dir);
+				}
+				flags[i] = res ^ 0xf; // Inverse, mark non connected edges.
+			}
+		}
+	}
+}
+
+/// Stores the raw and the simplified contour of a region into @p cont.
+static bool storeContour(rcContext* ctx, const rcIntArray& verts, const rcIntArray& simplified,
+						 const int borderSize, const unsigned short reg, const unsigned char area,
+						 rcContour* cont)
+{
+	cont->rverts = 0;
+	cont->nverts = simplified.size()/4;
+	cont->verts = (int*)rcAlloc(sizeof(int)*cont->nverts*4, RC_ALLOC_PERM);
+	if (!cont->verts)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'verts' (%d).", cont->nverts);
+		return false;
+	}
+	memcpy(cont->verts, &simplified[0], sizeof(int)*cont->nverts*4);
+	if (borderSize > 0)
+	{
+		// If the heightfield was build with bordersize, remove the offset.
+		for (int j = 0; j < cont->nverts; ++j)
+		{
+			int* v = &cont->verts[j*4];
+			v[0] -= borderSize;
+			v[2] -= borderSize;
+		}
+	}
+	
+	cont->nrverts = verts.size()/4;
+	cont->rverts = (int*)rcAlloc(sizeof(int)*cont->nrverts*4, RC_ALLOC_PERM);
+	if (!cont->rverts)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'rverts' (%d).", cont->nrverts);
+		return false;
+	}
+	memcpy(cont->rverts, &verts[0], sizeof(int)*cont->nrverts*4);
+	if (borderSize > 0)
+	{
+		// If the heightfield was build with bordersize, remove the offset.
+		for (int j = 0; j < cont->nrverts; ++j)
+		{
+			int* v = &cont->rverts[j*4];
+			v[0] -= borderSize;
+			v[2] -= borderSize;
+		}
+	}
+	
+	cont->reg = reg;
+	cont->area = area;
+	return true;
+}
+
+/// Grows the contours of the set to hold at least @p n of them.
+static bool growContours(rcContext* ctx, rcContourSet& cset, int& maxContours, const int n)
+{
+	if (n <= maxContours)
+		return true;
+	// This happens when a region has holes.
+	const int oldMax = maxContours;
+	while (maxContours < n)
+		maxContours *= 2;
+	rcContour* newConts = (rcContour*)rcAlloc(sizeof(rcContour)*maxContours, RC_ALLOC_PERM);
+	if (!newConts)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'conts' (%d).", maxContours);
+		return false;
+	}
+	for (int j = 0; j < cset.nconts; ++j)
+	{
+		newConts[j] = cset.conts[j];
+		// Reset source pointers to prevent data deletion.
+		cset.conts[j].verts = 0;
+		cset.conts[j].rverts = 0;
+	}
+	rcFree(cset.conts);
+	cset.conts = newConts;
+	
+	for (int m = oldMax; m < maxContours; m *= 2)
+		ctx->log(RC_LOG_WARNING, "rcBuildContours: Expanding max contours from %d to %d.", m, m*2);
+	return true;
+}
+
+/// Contours built by a thread, with the span each one starts from.
+struct rcContourWorker
+{
+	inline rcContourWorker() : conts(0), starts(0), nconts(0), cap(0) {}
+	inline ~rcContourWorker()
+	{
+		for (int i = 0; i < nconts; ++i)
+		{
+			rcFree(conts[i].verts);
+			rcFree(conts[i].rverts);
+		}
+		rcFree(conts);
+		rcFree(starts);
+	}
+	rcWorkerContext ctx;
+	rcContour* conts;
+	int* starts;
+	int nconts, cap;
+};
+
+/// Contour build shared by the threads: regions are handed out in increasing order.
+struct rcContourJob
+{
+	rcCompactHeightfield* chf;
+	unsigned char* flags;
+	float maxError;
+	int maxEdgeLen;
+	int buildFlags;
+	int nthreads;
+	/// Per region: the first of its boundary spans. [Size: nregions+1]
+	const int* regionFirst;
+	/// The boundary spans of the regions, in scan order. [(cell, span) * #regionFirst[nregions]]
+	const int* regionSpans;
+	int nregions;
+	rcContourWorker* workers;
+	std::atomic<int> next;
+	std::atomic<bool> failed;
+};
+
+static void runContourMarkWorker(void* arg, const int w)
+{
+	rcContourJob* job = (rcContourJob*)arg;
+	const int h = job->chf->height;
+	markContourBoundaries(*job->chf, job->flags, w*h/job->nthreads, (w+1)*h/job->nthreads);
+}
+
+static void runContourWorker(void* arg, const int w)
+{
+	rcContourJob* job = (rcContourJob*)arg;
+	rcContourWorker& worker = job->workers[w];
+	rcWorkerContext* ctx = &worker.ctx;
+	rcCompactHeightfield& chf = *job->chf;
+	unsigned char* flags = job->flags;
+	const int width = chf.width;
+	
+	// The point buffers are reused by all the contours of this thread.
+	rcIntArray verts(256);
+	rcIntArray simplified(64);
+	
+	for (int r = job->next++; r < job->nregions && !job->failed; r = job->next++)
+	{
+		ctx->setItem(r);
+		for (int k = job->regionFirst[r]; k < job->regionFirst[r+1]; ++k)
+		{
+			const int c = job->regionSpans[k*2+0];
+			const int i = job->regionSpans[k*2+1];
+			// Already walked by a contour of this region.
+			if (flags[i] == 0)
+				continue;
+			const unsigned short reg = chf.spans[i].reg;
+			const unsigned char area = chf.areas[i];
+			
+			verts.resize(0);
+			simplified.resize(0);
+			
+			ctx->startTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
+			walkContour(c % width, c / width, i, chf, flags, verts);
+			ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
+			
+			ctx->startTimer(RC_TIMER_BUILD_CONTOURS_SIMPLIFY);
+			simplifyContour(verts, simplified, job->maxError, job->maxEdgeLen, job->buildFlags);
+			removeDegenerateSegments(simplified);
+			ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_SIMPLIFY);
+			
+			if (simplified.size()/4 < 3)
+				continue;
+			
+			if (worker.nconts >= worker.cap)
+			{
+				const int cap = rcMax(worker.cap*2, 16);
+				rcContour* conts = (rcContour*)rcAlloc(sizeof(rcContour)*cap, RC_ALLOC_PERM);
+				int* starts = (int*)rcAlloc(sizeof(int)*cap, RC_ALLOC_PERM);
+				if (!conts || !starts)
+				{
+					ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'conts' (%d).", cap);
+					rcFree(conts);
+					rcFree(starts);
+					job->failed = true;
+					return;
+				}
+				if (worker.nconts)
+				{
+					memcpy(conts, worker.conts, sizeof(rcContour)*worker.nconts);
+					memcpy(starts, worker.starts, sizeof(int)*worker.nconts);
+				}
+				rcFree(worker.conts);
+				rcFree(worker.starts);
+				worker.conts = conts;
+				worker.starts = starts;
+				worker.cap = cap;
+			}
+			
+			rcContour* cont = &worker.conts[worker.nconts];
+			worker.starts[worker.nconts] = i;
+			worker.nconts++;
+			if (!storeContour(ctx, verts, simplified, chf.borderSize, reg, area, cont))
+			{
+				job->failed = true;
+				return;
+			}
+		}
+	}
+}
+
+struct rcContourOrder
+{
+	int start;
+	int worker;
+	int index;
+};
+
+static int compareContourOrder(const void* va, const void* vb)
+{
+	const rcContourOrder* a = (const rcContourOrder*)va;
+	const rcContourOrder* b = (const rcContourOrder*)vb;
+	if (a->start < b->start)
+		return -1;
+	if (a->start > b->start)
+		return 1;
+	return 0;
+}
+
+/// Builds the contours on nthreads threads: the boundaries are marked by
+/// bands of rows, then the contours are traced and simplified by region,
+/// since the walk of a contour only updates the flags of its own region.
+/// The contours are stored in the order of the spans they start from, which
+/// is the order of the serial build.
+static bool buildContoursParallel(rcContext* ctx, rcCompactHeightfield& chf, unsigned char* flags,
+								  const float maxError, const int maxEdgeLen, const int buildFlags,
+								  const int nthreads, rcContourSet& cset, int& maxContours)
+{
+	const int w = chf.width;
+	const int h = chf.height;
+	const int nregions = chf.maxRegions+1;
+	
+	rcContourJob job;
+	job.chf = &chf;
+	job.flags = flags;
+	job.maxError = maxError;
+	job.maxEdgeLen = maxEdgeLen;
+	job.buildFlags = buildFlags;
+	job.nthreads = nthreads;
+	job.regionFirst = 0;
+	job.regionSpans = 0;
+	job.nregions = nregions;
+	job.workers = 0;
+	job.next = 1;
+	job.failed = false;
+	
+	ctx->startTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
+	
+	// Mark boundaries.
+	rcRunWorkers(runContourMarkWorker, &job, nthreads);
+	
+	// Bucket the boundary spans by region, in scan order.
+	rcScopedDelete<int> regionFirst((int*)rcAlloc(sizeof(int)*(nregions+1), RC_ALLOC_TEMP));
+	if (!regionFirst)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'regionFirst' (%d).", nregions+1);
+		return false;
+	}
+	memset(regionFirst, 0, sizeof(int)*(nregions+1));
+	for (int i = 0; i < chf.spanCount; ++i)
+	{
+		if (flags[i] == 0 || flags[i] == 0xf)
+		{
+			flags[i] = 0;
+			continue;
+		}
+		regionFirst[chf.spans[i].reg+1]++;
+	}
+	for (int r = 0; r < nregions; ++r)
+		regionFirst[r+1] += regionFirst[r];
+	rcScopedDelete<int> regionSpans((int*)rcAlloc(sizeof(int)*rcMax(regionFirst[nregions], 1)*2, RC_ALLOC_TEMP));
+	if (!regionSpans)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'regionSpans' (%d).", regionFirst[nregions]*2);
+		return false;
+	}
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			const rcCompactCell& c = chf.cells[x+y*w];
+			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+			{
+				if (flags[i] == 0)
+					continue;
+				const int k = regionFirst[chf.spans[i].reg]++;
+				regionSpans[k*2+0] = x+y*w;
+				regionSpans[k*2+1] = i;
+			}
+		}
+	}
+	// Shift the bucket starts back.
+	for (int r = nregions; r > 0; --r)
+		regionFirst[r] = regionFirst[r-1];
+	regionFirst[0] = 0;
+	
+	ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
+	
+	job.regionFirst = regionFirst;
+	job.regionSpans = regionSpans;
+	
+	rcContourWorker* workers = (rcContourWorker*)rcAlloc(sizeof(rcContourWorker)*nthreads, RC_ALLOC_TEMP);
+	if (!workers)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'workers' (%d).", nthreads);
+		return false;
+	}
+	for (int i = 0; i < nthreads; ++i)
+		new(&workers[i]) rcContourWorker;
+	// The calling thread keeps the timers of its share in ctx too.
+	workers[0].ctx.setTimerTarget(ctx);
+	job.workers = workers;
+	
+	// Trace and simplify the contours.
+	rcRunWorkers(runContourWorker, &job, nthreads);
+	
+	// Pass on the messages in region order, then the time spent by each thread.
+	int* logPos = (int*)rcAlloc(sizeof(int)*nthreads, RC_ALLOC_TEMP);
+	if (logPos)
+	{
+		memset(logPos, 0, sizeof(int)*nthreads);
+		for (int r = 1; r < nregions; ++r)
+			for (int i = 0; i < nthreads; ++i)
+				workers[i].ctx.replayLog(ctx, r, logPos[i]);
+		rcFree(logPos);
+	}
+	for (int i = 0; i < nthreads; ++i)
+	{
+		const rcWorkerContext& wctx = workers[i].ctx;
+		ctx->log(RC_LOG_PROGRESS, "rcBuildContours: Thread %d: %d contours, trace %.2f ms, simplify %.2f ms.", i,
+				 workers[i].nconts,
+				 rcMax(wctx.getAccumulatedTime(RC_TIMER_BUILD_CONTOURS_TRACE), 0)/1000.0f,
+				 rcMax(wctx.getAccumulatedTime(RC_TIMER_BUILD_CONTOURS_SIMPLIFY), 0)/1000.0f);
+	}
+	
+	bool ok = !job.failed;
+	
+	// Store the contours in the order of their starting spans.
+	int nconts = 0;
+	for (int i = 0; i < nthreads; ++i)
+		nconts += workers[i].nconts;
+	rcContourOrder* order = 0;
+	if (ok && nconts > 0)
+	{
+		order = (rcContourOrder*)rcAlloc(sizeof(rcContourOrder)*nconts, RC_ALLOC_TEMP);
+		if (!order)
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'order' (%d).", nconts);
+			ok = false;
+		}
+	}
+	if (ok && nconts > 0)
+	{
+		int n = 0;
+		for (int i = 0; i < nthreads; ++i)
+		{
+			for (int j = 0; j < workers[i].nconts; ++j)
+			{
+				order[n].start = workers[i].starts[j];
+				order[n].worker = i;
+				order[n].index = j;
+				n++;
+			}
+		}
+		qsort(order, nconts, sizeof(rcContourOrder), compareContourOrder);
+		
+		ok = growContours(ctx, cset, maxContours, nconts);
+		if (ok)
+		{
+			for (int i = 0; i < nconts; ++i)
+			{
+				rcContour& cont = workers[order[i].worker].conts[order[i].index];
+				cset.conts[cset.nconts++] = cont;
+				// The set owns the data now.
+				cont.verts = 0;
+				cont.rverts = 0;
+			}
+		}
+	}
+	rcFree(order);
+	
+	for (int i = 0; i < nthreads; ++i)
+		workers[i].~rcContourWorker();
+	rcFree(workers);
+	
+	return ok;
+}
+
 /// @par
 ///
 /// The raw contours will match the region outlines exactly. The @p maxError and @p maxEdgeLen
@@ -818,12 +1252,16 @@ static void mergeRegionHoles(rcContext* ctx, rcContourRegion& region)
 ///
 /// Setting @p maxEdgeLength to zero will disabled the edge length feature.
 ///
+/// With more than one thread, the contours of different regions are traced and simplified
+/// in parallel, then stored in the same order as with one thread: the contour set is the
+/// same. The time spent by each thread is logged.
+///
 /// See the #rcConfig documentation for more information on the configuration parameters.
 ///
 /// @see rcAllocContourSet, rcCompactHeightfield, rcContourSet, rcConfig
 bool rcBuildContours(rcContext* ctx, rcCompactHeightfield& chf,
 					 const float maxError, const int maxEdgeLen,
-					 rcContourSet& cset, const int buildFlags)
+					 rcContourSet& cset, const int buildFlags, const int nthreads)
 {
 	rcAssert(ctx);
 	
@@ -864,142 +1302,68 @@ bool rcBuildContours(rcContext* ctx, rcCompactHeightfield& chf,
 		return false;
 	}
 	
-	ctx->startTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
-	
-	// Mark boundaries.
-	for (int y = 0; y < h; ++y)
+	// Threads are worth it for many regions only.
+	const int nworkers = rcMin(nthreads, (int)chf.maxRegions / RC_CONTOUR_REGIONS_PER_THREAD);
+	if (nworkers > 1)
 	{
-		for (int x = 0; x < w; ++x)
-		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
-			{
-				unsigned char res = 0;
-				const rcCompactSpan& s = chf.spans[i];
-				if (!chf.spans[i].reg || (chf.spans[i].reg & RC_BORDER_REG))
-				{
-					flags[i] = 0;
-					continue;
-				}
-				for (int dir = 0; dir < 4; ++dir)
-				{
-					unsigned short r = 0;
-					if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
-					{
-						const int ax = x + rcGetDirOffsetX(dir);
-						const int ay = y + rcGetDirOffsetY(dir);
-						const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
-						r = chf.spans[ai].reg;
-					}
-					if (r == chf.spans[i].reg)
-						res |= (1 << dir);
-				}
-				flags[i] = res ^ 0xf; // Inverse, mark non connected edges.
-			}
-		}
+		if (!buildContoursParallel(ctx, chf, flags, maxError, maxEdgeLen, buildFlags,
+								   nworkers, cset, maxContours))
+			return false;
 	}
-	
-	ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
-	
-	rcIntArray verts(256);
-	rcIntArray simplified(64);
-	
-	for (int y = 0; y < h; ++y)
+	else
 	{
-		for (int x = 0; x < w; ++x)
+		ctx->startTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
+		
+		// Mark boundaries.
+		markContourBoundaries(chf, flags, 0, h);
+		
+		ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
+		
+		rcIntArray verts(256);
+		rcIntArray simplified(64);
+		
+		for (int y = 0; y < h; ++y)
 		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+			for (int x = 0; x < w; ++x)
 			{
-				if (flags[i] == 0 || flags[i] == 0xf)
+				const rcCompactCell& c = chf.cells[x+y*w];
+				for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
 				{
-					flags[i] = 0;
-					continue;
-				}
-				const unsigned short reg = chf.spans[i].reg;
-				if (!reg || (reg & RC_BORDER_REG))
-					continue;
-				const unsigned char area = chf.areas[i];
-				
-				verts.resize(0);
-				simplified.resize(0);
-				
-				ctx->startTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
-				walkContour(x, y, i, chf, flags, verts);
-				ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
-				
-				ctx->startTimer(RC_TIMER_BUILD_CONTOURS_SIMPLIFY);
-				simplifyContour(verts, simplified, maxError, maxEdgeLen, buildFlags);
-				removeDegenerateSegments(simplified);
-				ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_SIMPLIFY);
-				
-				
-				// Store region->contour remap info.
-				// Create contour.
-				if (simplified.size()/4 >= 3)
-				{
-					if (cset.nconts >= maxContours)
+					if (flags[i] == 0 || flags[i] == 0xf)
 					{
-						// Allocate more contours.
-						// This happens when a region has holes.
-						const int oldMax = maxContours;
-						maxContours *= 2;
-						rcContour* newConts = (rcContour*)rcAlloc(sizeof(rcContour)*maxContours, RC_ALLOC_PERM);
-						for (int j = 0; j < cset.nconts; ++j)
-						{
-							newConts[j] = cset.conts[j];
-							// Reset source pointers to prevent data deletion.
-							cset.conts[j].verts = 0;
-							cset.conts[j].rverts = 0;
-						}
-						rcFree(cset.conts);
-						cset.conts = newConts;
-						
-						ctx->log(RC_LOG_WARNING, "rcBuildContours: Expanding max contours from %d to %d.", oldMax, maxContours);
+						flags[i] = 0;
+						continue;
 					}
+					const unsigned short reg = chf.spans[i].reg;
+					if (!reg || (reg & RC_BORDER_REG))
+						continue;
+					const unsigned char area = chf.areas[i];
 					
-					rcContour* cont = &cset.conts[cset.nconts++];
+					verts.resize(0);
+					simplified.resize(0);
 					
-					cont->nverts = simplified.size()/4;
-					cont->verts = (int*)rcAlloc(sizeof(int)*cont->nverts*4, RC_ALLOC_PERM);
-					if (!cont->verts)
-					{
-						ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'verts' (%d).", cont->nverts);
-						return false;
-					}
-					memcpy(cont->verts, &simplified[0], sizeof(int)*cont->nverts*4);
-					if (borderSize > 0)
-					{
-						// If the heightfield was build with bordersize, remove the offset.
-						for (int j = 0; j < cont->nverts; ++j)
-						{
-							int* v = &cont->verts[j*4];
-							v[0] -= borderSize;
-							v[2] -= borderSize;
-						}
-					}
+					ctx->startTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
+					walkContour(x, y, i, chf, flags, verts);
+					ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
 					
-					cont->nrverts = verts.size()/4;
-					cont->rverts = (int*)rcAlloc(sizeof(int)*cont->nrverts*4, RC_ALLOC_PERM);
-					if (!cont->rverts)
-					{
-						ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'rverts' (%d).", cont->nrverts);
-						return false;
-					}
-					memcpy(cont->rverts, &verts[0], sizeof(int)*cont->nrverts*4);
-					if (borderSize > 0)
+					ctx->startTimer(RC_TIMER_BUILD_CONTOURS_SIMPLIFY);
+					simplifyContour(verts, simplified, maxError, maxEdgeLen, buildFlags);
+					removeDegenerateSegments(simplified);
+					ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_SIMPLIFY);
+					
+					
+					// Store region->contour remap info.
+					// Create contour.
+					if (simplified.size()/4 >= 3)
 					{
-						// If the heightfield was build with bordersize, remove the offset.
-						for (int j = 0; j < cont->nrverts; ++j)
-						{
-							int* v = &cont->rverts[j*4];
-							v[0] -= borderSize;
-							v[2] -= borderSize;
-						}
+						// Allocate more contours if necessary.
+						if (!growContours(ctx, cset, maxContours, cset.nconts+1))
+							return false;
+						
+						rcContour* cont = &cset.conts[cset.nconts++];
+						if (!storeContour(ctx, verts, simplified, borderSize, reg, area, cont))
+							return false;
 					}
-					
-					cont->reg = reg;
-					cont->area = area;
 				}
 			}
 		}
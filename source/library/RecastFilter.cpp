@@ -20,6 +20,7 @@
 #include <math.h>
 #include <stdio.h>
 #include "Recast.h"
+#include "RecastAlloc.h"
 #include "RecastAssert.h"
 
 /// @par
@@ -200,3 +201,240 @@ void rcFilterWalkableLowHeightSpans(rcContext* ctx, int walkableHeight, rcHeight
 		}
 	}
 }
+
+/// The column-compacted spans and the neighbour heights used by the ledge filter of
+/// #rcFilterWalkableSpans.
+struct rcLedgeSpans
+{
+	const int* first;
+	const unsigned short* bots;
+	const unsigned short* tops;
+	int* minh;
+	int* asmin;
+	int* asmax;
+	int walkableHeight;
+	int walkableClimb;
+};
+
+/// Updates the neighbour heights of the spans of the neighbour columns c and nc with
+/// each other.
+static inline void updateLedgeNeighbours(const rcLedgeSpans& ls, const int c, const int nc)
+{
+	const int send = ls.first[c+1];
+	const int nbeg = ls.first[nc];
+	const int nend = ls.first[nc+1];
+	for (int i = ls.first[c]; i < send; ++i)
+	{
+		const int bot = ls.bots[i];
+		const int top = ls.tops[i];
+		int minh = ls.minh[i];
+		int asmin = ls.asmin[i];
+		int asmax = ls.asmax[i];
+		for (int k = nbeg; k < nend; ++k)
+		{
+			const int nbot = ls.bots[k];
+			// Skip neightbour if the gap between the spans is too small.
+			if (rcMin(top, (int)ls.tops[k]) - rcMax(bot, nbot) <= ls.walkableHeight)
+				continue;
+			minh = rcMin(minh, nbot - bot);
+			ls.minh[k] = rcMin(ls.minh[k], bot - nbot);
+			// Find min/max accessible neighbour height.
+			if (rcAbs(nbot - bot) <= ls.walkableClimb)
+			{
+				asmin = rcMin(asmin, nbot);
+				asmax = rcMax(asmax, nbot);
+				ls.asmin[k] = rcMin(ls.asmin[k], bot);
+				ls.asmax[k] = rcMax(ls.asmax[k], bot);
+			}
+		}
+		ls.minh[i] = minh;
+		ls.asmin[i] = asmin;
+		ls.asmax[i] = asmax;
+	}
+}
+
+/// @par
+///
+/// The spans are first copied, once, in a column-compacted representation: the floors
+/// (span maximums), the ceilings (next span minimums) and the areas of each column are
+/// contiguous, so the heightfield is walked through its span lists only once.
+/// The ledge filter accumulates the neighbour floor min/max of all the spans in arrays:
+/// since the gap test between two spans is symmetric, each pair of neighbour columns is
+/// visited once, instead of twice, and a column is checked as soon as its last pair is.
+/// The filters are applied in the usual order (#rcFilterLowHangingWalkableObstacles,
+/// #rcFilterLedgeSpans, #rcFilterWalkableLowHeightSpans) and only the changed areas are
+/// written back to the spans.
+///
+/// @see rcHeightfield, rcConfig, rcFilterSpanFlags
+bool rcFilterWalkableSpans(rcContext* ctx, const int filters, const int walkableHeight,
+						   const int walkableClimb, rcHeightfield& solid)
+{
+	rcAssert(ctx);
+	
+	if (!(filters & (RC_FILTER_LOW_HANGING_OBSTACLES | RC_FILTER_LEDGE_SPANS |
+					 RC_FILTER_WALKABLE_LOW_HEIGHT_SPANS)))
+		return true;
+	
+	const int w = solid.width;
+	const int h = solid.height;
+	const int ncols = w*h;
+	const int MAX_HEIGHT = 0xffff;
+	
+	// All the spans are allocated from the pools: their size bounds the span count.
+	int maxSpans = 0;
+	for (rcSpanPool* pool = solid.pools; pool; pool = pool->next)
+		maxSpans += RC_SPANS_PER_POOL;
+	
+	rcScopedDelete<int> first((int*)rcAlloc(sizeof(int)*(ncols+1), RC_ALLOC_TEMP));
+	rcScopedDelete<unsigned short> lowest((unsigned short*)rcAlloc(sizeof(unsigned short)*rcMax(ncols, 1), RC_ALLOC_TEMP));
+	rcScopedDelete<unsigned short> bots((unsigned short*)rcAlloc(sizeof(unsigned short)*rcMax(maxSpans, 1), RC_ALLOC_TEMP));
+	rcScopedDelete<unsigned short> tops((unsigned short*)rcAlloc(sizeof(unsigned short)*rcMax(maxSpans, 1), RC_ALLOC_TEMP));
+	rcScopedDelete<unsigned char> areas((unsigned char*)rcAlloc(sizeof(unsigned char)*rcMax(maxSpans, 1), RC_ALLOC_TEMP));
+	rcScopedDelete<rcSpan*> spans((rcSpan**)rcAlloc(sizeof(rcSpan*)*rcMax(maxSpans, 1), RC_ALLOC_TEMP));
+	if (!first || !lowest || !bots || !tops || !areas || !spans)
+	{
+		ctx->log(RC_LOG_ERROR, "rcFilterWalkableSpans: Out of memory 'spans' (%d).", maxSpans);
+		return false;
+	}
+	
+	// Compact the columns: the spans of column i are first[i]..first[i+1]-1,
+	// lowest[i] is the minimum of the first one.
+	int nspans = 0;
+	for (int i = 0; i < ncols; ++i)
+	{
+		first[i] = nspans;
+		lowest[i] = (unsigned short)(solid.spans[i] ? solid.spans[i]->smin : MAX_HEIGHT);
+		for (rcSpan* s = solid.spans[i]; s; s = s->next, ++nspans)
+		{
+			if (nspans == maxSpans)
+			{
+				ctx->log(RC_LOG_ERROR, "rcFilterWalkableSpans: Too many spans (%d).", maxSpans);
+				return false;
+			}
+			bots[nspans] = (unsigned short)s->smax;
+			tops[nspans] = (unsigned short)(s->next ? s->next->smin : MAX_HEIGHT);
+			areas[nspans] = (unsigned char)s->area;
+			spans[nspans] = s;
+		}
+	}
+	first[ncols] = nspans;
+	
+	if (filters & RC_FILTER_LOW_HANGING_OBSTACLES)
+	{
+		rcScopedTimer timer(ctx, RC_TIMER_FILTER_LOW_OBSTACLES);
+		
+		for (int c = 0; c < ncols; ++c)
+		{
+			bool previousWalkable = false;
+			unsigned char previousArea = RC_NULL_AREA;
+			
+			for (int i = first[c]; i < first[c+1]; ++i)
+			{
+				const bool walkable = areas[i] != RC_NULL_AREA;
+				// If current span is not walkable, but there is walkable
+				// span just below it, mark the span above it walkable too.
+				if (!walkable && previousWalkable)
+				{
+					if (rcAbs(bots[i] - bots[i-1]) <= walkableClimb)
+						areas[i] = previousArea;
+				}
+				// Copy walkable flag so that it cannot propagate
+				// past multiple non-walkable objects.
+				previousWalkable = walkable;
+				previousArea = areas[i];
+			}
+		}
+	}
+	
+	if (filters & RC_FILTER_LEDGE_SPANS)
+	{
+		rcScopedTimer timer(ctx, RC_TIMER_FILTER_BORDER);
+		
+		// Neighbours minimum height, and min and max height of accessible
+		// neighbours, of each span.
+		rcScopedDelete<int> minh((int*)rcAlloc(sizeof(int)*rcMax(nspans, 1), RC_ALLOC_TEMP));
+		rcScopedDelete<int> asmin((int*)rcAlloc(sizeof(int)*rcMax(nspans, 1), RC_ALLOC_TEMP));
+		rcScopedDelete<int> asmax((int*)rcAlloc(sizeof(int)*rcMax(nspans, 1), RC_ALLOC_TEMP));
+		if (!minh || !asmin || !asmax)
+		{
+			ctx->log(RC_LOG_ERROR, "rcFilterWalkableSpans: Out of memory 'minh' (%d).", nspans);
+			return false;
+		}
+		
+		for (int i = 0; i < nspans; ++i)
+		{
+			minh[i] = MAX_HEIGHT;
+			asmin[i] = bots[i];
+			asmax[i] = bots[i];
+		}
+		
+		rcLedgeSpans ls;
+		ls.first = first;
+		ls.bots = bots;
+		ls.tops = tops;
+		ls.minh = minh;
+		ls.asmin = asmin;
+		ls.asmax = asmax;
+		ls.walkableHeight = walkableHeight;
+		ls.walkableClimb = walkableClimb;
+		
+		for (int y = 0; y < h; ++y)
+		{
+			for (int x = 0; x < w; ++x)
+			{
+				const int c = x + y*w;
+				
+				// The gap test between spans is symmetric: update both the
+				// spans of each pair of neighbour columns, along +x and +y.
+				// The -x and -y neighbours are already done then.
+				if (x < w-1)
+					updateLedgeNeighbours(ls, c, c+1);
+				if (y < h-1)
+					updateLedgeNeighbours(ls, c, c+w);
+				
+				// Neighbours which are out of bounds, and the gaps from minus
+				// infinity to the first span of the neighbours: only the one
+				// with the highest ceiling matters.
+				const bool outOfBounds = x == 0 || y == 0 || x == w-1 || y == h-1;
+				int ntop = -1;
+				if (x > 0) ntop = rcMax(ntop, (int)lowest[c-1]);
+				if (x < w-1) ntop = rcMax(ntop, (int)lowest[c+1]);
+				if (y > 0) ntop = rcMax(ntop, (int)lowest[c-w]);
+				if (y < h-1) ntop = rcMax(ntop, (int)lowest[c+w]);
+				
+				for (int i = first[c]; i < first[c+1]; ++i)
+				{
+					const int bot = bots[i];
+					if (outOfBounds ||
+						(ntop >= 0 && rcMin((int)tops[i], ntop) - rcMax(bot, -walkableClimb) > walkableHeight))
+						minh[i] = rcMin(minh[i], -walkableClimb - bot);
+					
+					// The current span is close to a ledge if the drop to any
+					// neighbour span is less than the walkableClimb, or at steep
+					// slope if the difference between all neighbours is too large.
+					if (minh[i] < -walkableClimb || (asmax[i] - asmin[i]) > walkableClimb)
+						areas[i] = RC_NULL_AREA;
+				}
+			}
+		}
+	}
+	
+	if (filters & RC_FILTER_WALKABLE_LOW_HEIGHT_SPANS)
+	{
+		rcScopedTimer timer(ctx, RC_TIMER_FILTER_WALKABLE);
+		
+		// Remove walkable flag from spans which do not have enough
+		// space above them for the agent to stand there.
+		for (int i = 0; i < nspans; ++i)
+			areas[i] = (tops[i] - bots[i]) <= walkableHeight ? (unsigned char)RC_NULL_AREA : areas[i];
+	}
+	
+	// Write back the changed areas.
+	for (int i = 0; i < nspans; ++i)
+	{
+		if (spans[i]->area != areas[i])
+			spans[i]->area = areas[i];
+	}
+	
+	return true;
+}
@@ -22,12 +22,17 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <new>
+#include <atomic>
 #include "Recast.h"
 #include "RecastAlloc.h"
 #include "RecastAssert.h"
+#include "RecastThreads.h"
 
 
 static const unsigned RC_UNSET_HEIGHT = 0xffff;
+/// Minimum number of polygons per thread of the parallel detail mesh build.
+static const int RC_DETAIL_POLYS_PER_THREAD = 64;
 
 struct rcHeightPatch
 {
@@ -1161,14 +1166,369 @@ static unsigned char getTriFlags(const float* va, const float* vb, const float*
 	return flags;
 }
 
+/// Scratch memory used to build the detail mesh of a polygon.
+struct rcPolyDetailScratch
+{
+	inline rcPolyDetailScratch() : edges(64), tris(512), arr(512), samples(512), poly(0) {}
+	inline ~rcPolyDetailScratch() { rcFree(poly); }
+	rcIntArray edges;
+	rcIntArray tris;
+	rcIntArray arr;
+	rcIntArray samples;
+	float verts[256*3];
+	rcHeightPatch hp;
+	float* poly;
+	
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcPolyDetailScratch(const rcPolyDetailScratch&);
+	rcPolyDetailScratch& operator=(const rcPolyDetailScratch&);
+};
+
+static bool allocPolyDetailScratch(rcContext* ctx, rcPolyDetailScratch& s, const int nvp,
+								   const int maxhw, const int maxhh)
+{
+	s.poly = (float*)rcAlloc(sizeof(float)*nvp*3, RC_ALLOC_TEMP);
+	if (!s.poly)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'poly' (%d).", nvp*3);
+		return false;
+	}
+	s.hp.data = (unsigned short*)rcAlloc(sizeof(unsigned short)*maxhw*maxhh, RC_ALLOC_TEMP);
+	if (!s.hp.data)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'hp.data' (%d).", maxhw*maxhh);
+		return false;
+	}
+	return true;
+}
+
+/// Builds the detail mesh of polygon i: its vertices are stored in s.verts and
+/// its triangles in s.tris, and the polygon vertices in s.poly, all in world space.
+static bool buildPolyDetailMesh(rcContext* ctx, const rcPolyMesh& mesh, const rcCompactHeightfield& chf,
+								const int* bounds, const int i,
+								const float sampleDist, const float sampleMaxError,
+								const int heightSearchRadius, rcPolyDetailScratch& s,
+								int& npoly, int& nverts)
+{
+	const int nvp = mesh.nvp;
+	const float cs = mesh.cs;
+	const float ch = mesh.ch;
+	const float* orig = mesh.bmin;
+	const unsigned short* p = &mesh.polys[i*nvp*2];
+	float* poly = s.poly;
+	float* verts = s.verts;
+	
+	// Store polygon vertices for processing.
+	npoly = 0;
+	for (int j = 0; j < nvp; ++j)
+	{
+		if(p[j] == RC_MESH_NULL_IDX) break;
+		const unsigned short* v = &mesh.verts[p[j]*3];
+		poly[j*3+0] = v[0]*cs;
+		poly[j*3+1] = v[1]*ch;
+		poly[j*3+2] = v[2]*cs;
+		npoly++;
+	}
+	
+	// Get the height data from the area of the polygon.
+	s.hp.xmin = bounds[i*4+0];
+	s.hp.ymin = bounds[i*4+2];
+	s.hp.width = bounds[i*4+1]-bounds[i*4+0];
+	s.hp.height = bounds[i*4+3]-bounds[i*4+2];
+	getHeightData(ctx, chf, p, npoly, mesh.verts, mesh.borderSize, s.hp, s.arr, mesh.regs[i]);
+	
+	// Build detail mesh.
+	nverts = 0;
+	if (!buildPolyDetail(ctx, poly, npoly,
+						 sampleDist, sampleMaxError,
+						 heightSearchRadius, chf, s.hp,
+						 verts, nverts, s.tris,
+						 s.edges, s.samples))
+	{
+		return false;
+	}
+	
+	// Move detail verts to world space.
+	for (int j = 0; j < nverts; ++j)
+	{
+		verts[j*3+0] += orig[0];
+		verts[j*3+1] += orig[1] + chf.ch; // Is this offset necessary?
+		verts[j*3+2] += orig[2];
+	}
+	// Offset poly too, will be used to flag checking.
+	for (int j = 0; j < npoly; ++j)
+	{
+		poly[j*3+0] += orig[0];
+		poly[j*3+1] += orig[1];
+		poly[j*3+2] += orig[2];
+	}
+	
+	return true;
+}
+
+/// Appends the detail mesh built in s to the vertices and triangles,
+/// allocating more memory if necessary.
+static bool appendPolyDetailMesh(rcContext* ctx, const rcPolyDetailScratch& s, const int npoly, const int nverts,
+								 float*& dverts, int& dnverts, int& vcap,
+								 unsigned char*& dtris, int& dntris, int& tcap)
+{
+	const float* verts = s.verts;
+	const int ntris = s.tris.size()/4;
+	
+	// Store vertices, allocate more memory if necessary.
+	if (dnverts+nverts > vcap)
+	{
+		while (dnverts+nverts > vcap)
+			vcap += 256;
+		
+		float* newv = (float*)rcAlloc(sizeof(float)*vcap*3, RC_ALLOC_PERM);
+		if (!newv)
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'newv' (%d).", vcap*3);
+			return false;
+		}
+		if (dnverts)
+			memcpy(newv, dverts, sizeof(float)*3*dnverts);
+		rcFree(dverts);
+		dverts = newv;
+	}
+	for (int j = 0; j < nverts; ++j)
+	{
+		dverts[dnverts*3+0] = verts[j*3+0];
+		dverts[dnverts*3+1] = verts[j*3+1];
+		dverts[dnverts*3+2] = verts[j*3+2];
+		dnverts++;
+	}
+	
+	// Store triangles, allocate more memory if necessary.
+	if (dntris+ntris > tcap)
+	{
+		while (dntris+ntris > tcap)
+			tcap += 256;
+		unsigned char* newt = (unsigned char*)rcAlloc(sizeof(unsigned char)*tcap*4, RC_ALLOC_PERM);
+		if (!newt)
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'newt' (%d).", tcap*4);
+			return false;
+		}
+		if (dntris)
+			memcpy(newt, dtris, sizeof(unsigned char)*4*dntris);
+		rcFree(dtris);
+		dtris = newt;
+	}
+	for (int j = 0; j < ntris; ++j)
+	{
+		const int* t = &s.tris[j*4];
+		dtris[dntris*4+0] = (unsigned char)t[0];
+		dtris[dntris*4+1] = (unsigned char)t[1];
+		dtris[dntris*4+2] = (unsigned char)t[2];
+		dtris[dntris*4+3] = getTriFlags(&verts[t[0]*3], &verts[t[1]*3], &verts[t[2]*3], s.poly, npoly);
+		dntris++;
+	}
+	
+	return true;
+}
+
+/// Detail meshes built by a thread, in increasing polygon order.
+struct rcDetailWorker
+{
+	inline rcDetailWorker() : verts(0), nverts(0), vcap(0), tris(0), ntris(0), tcap(0) {}
+	inline ~rcDetailWorker() { rcFree(verts); rcFree(tris); }
+	rcWorkerContext ctx;
+	float* verts;
+	int nverts, vcap;
+	unsigned char* tris;
+	int ntris, tcap;
+};
+
+/// Detail mesh build shared by the threads: polygons are handed out in
+/// increasing order.
+struct rcDetailJob
+{
+	const rcPolyMesh* mesh;
+	const rcCompactHeightfield* chf;
+	const int* bounds;
+	float sampleDist, sampleMaxError;
+	int heightSearchRadius;
+	int maxhw, maxhh;
+	/// Per polygon: the submesh, with offsets into the worker buffers. [(verts, nverts, tris, ntris) * npolys]
+	unsigned int* meshes;
+	/// Per polygon: the worker which built it.
+	int* owners;
+	rcDetailWorker* workers;
+	std::atomic<int> next;
+	std::atomic<bool> failed;
+};
+
+static void runDetailWorker(void* arg, const int w)
+{
+	rcDetailJob* job = (rcDetailJob*)arg;
+	rcDetailWorker& worker = job->workers[w];
+	rcWorkerContext* ctx = &worker.ctx;
+	const int npolys = job->mesh->npolys;
+	
+	// The scratch memory is released by this thread.
+	rcPolyDetailScratch s;
+	ctx->setItem(0);
+	if (!allocPolyDetailScratch(ctx, s, job->mesh->nvp, job->maxhw, job->maxhh))
+	{
+		job->failed = true;
+		return;
+	}
+	
+	for (int i = job->next++; i < npolys && !job->failed; i = job->next++)
+	{
+		ctx->setItem(i);
+		job->owners[i] = w;
+		
+		int npoly = 0, nverts = 0;
+		if (!buildPolyDetailMesh(ctx, *job->mesh, *job->chf, job->bounds, i,
+								 job->sampleDist, job->sampleMaxError,
+								 job->heightSearchRadius, s, npoly, nverts))
+		{
+			job->failed = true;
+			return;
+		}
+		
+		job->meshes[i*4+0] = (unsigned int)worker.nverts;
+		job->meshes[i*4+1] = (unsigned int)nverts;
+		job->meshes[i*4+2] = (unsigned int)worker.ntris;
+		job->meshes[i*4+3] = (unsigned int)(s.tris.size()/4);
+		
+		if (!appendPolyDetailMesh(ctx, s, npoly, nverts,
+								  worker.verts, worker.nverts, worker.vcap,
+								  worker.tris, worker.ntris, worker.tcap))
+		{
+			job->failed = true;
+			return;
+		}
+	}
+}
+
+/// Builds the detail meshes of the polygons on nthreads threads, then compacts
+/// them in polygon order: the result is the same as the one of the serial build.
+static bool buildPolyMeshDetailParallel(rcContext* ctx, const rcPolyMesh& mesh, const rcCompactHeightfield& chf,
+										const int* bounds, const float sampleDist, const float sampleMaxError,
+										const int heightSearchRadius, const int maxhw, const int maxhh,
+										const int nPolyVerts, const int nthreads, rcPolyMeshDetail& dmesh)
+{
+	const int npolys = mesh.npolys;
+	
+	rcScopedDelete<int> owners((int*)rcAlloc(sizeof(int)*npolys, RC_ALLOC_TEMP));
+	if (!owners)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'owners' (%d).", npolys);
+		return false;
+	}
+	rcDetailWorker* workers = (rcDetailWorker*)rcAlloc(sizeof(rcDetailWorker)*nthreads, RC_ALLOC_TEMP);
+	if (!workers)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'workers' (%d).", nthreads);
+		return false;
+	}
+	for (int w = 0; w < nthreads; ++w)
+	{
+		new(&workers[w]) rcDetailWorker;
+		// Share the expected output size among the threads.
+		workers[w].vcap = (nPolyVerts+nPolyVerts/2)/nthreads + 256;
+		workers[w].tcap = workers[w].vcap*2;
+		workers[w].verts = (float*)rcAlloc(sizeof(float)*workers[w].vcap*3, RC_ALLOC_PERM);
+		workers[w].tris = (unsigned char*)rcAlloc(sizeof(unsigned char)*workers[w].tcap*4, RC_ALLOC_PERM);
+	}
+	
+	rcDetailJob job;
+	job.mesh = &mesh;
+	job.chf = &chf;
+	job.bounds = bounds;
+	job.sampleDist = sampleDist;
+	job.sampleMaxError = sampleMaxError;
+	job.heightSearchRadius = heightSearchRadius;
+	job.maxhw = maxhw;
+	job.maxhh = maxhh;
+	job.meshes = dmesh.meshes;
+	job.owners = owners;
+	job.workers = workers;
+	job.next = 0;
+	job.failed = false;
+	for (int w = 0; w < nthreads; ++w)
+	{
+		if (!workers[w].verts || !workers[w].tris)
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'worker' (%d).", workers[w].vcap*3);
+			job.failed = true;
+		}
+	}
+	
+	if (!job.failed)
+		rcRunWorkers(runDetailWorker, &job, nthreads);
+	
+	// Replay the messages in polygon order.
+	int* logPos = (int*)rcAlloc(sizeof(int)*nthreads, RC_ALLOC_TEMP);
+	if (logPos)
+	{
+		memset(logPos, 0, sizeof(int)*nthreads);
+		for (int i = 0; i < npolys; ++i)
+			for (int w = 0; w < nthreads; ++w)
+				workers[w].ctx.replayLog(ctx, i, logPos[w]);
+		rcFree(logPos);
+	}
+	
+	bool ok = !job.failed;
+	if (ok)
+	{
+		// Compact the worker buffers in polygon order.
+		int nverts = 0, ntris = 0;
+		for (int w = 0; w < nthreads; ++w)
+		{
+			nverts += workers[w].nverts;
+			ntris += workers[w].ntris;
+		}
+		dmesh.verts = (float*)rcAlloc(sizeof(float)*rcMax(nverts, 1)*3, RC_ALLOC_PERM);
+		dmesh.tris = (unsigned char*)rcAlloc(sizeof(unsigned char)*rcMax(ntris, 1)*4, RC_ALLOC_PERM);
+		if (!dmesh.verts)
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'dmesh.verts' (%d).", nverts*3);
+			ok = false;
+		}
+		else if (!dmesh.tris)
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'dmesh.tris' (%d).", ntris*4);
+			ok = false;
+		}
+		for (int i = 0; i < npolys && ok; ++i)
+		{
+			const rcDetailWorker& worker = workers[owners[i]];
+			unsigned int* m = &dmesh.meshes[i*4];
+			memcpy(&dmesh.verts[dmesh.nverts*3], &worker.verts[m[0]*3], sizeof(float)*3*m[1]);
+			memcpy(&dmesh.tris[dmesh.ntris*4], &worker.tris[m[2]*4], sizeof(unsigned char)*4*m[3]);
+			m[0] = (unsigned int)dmesh.nverts;
+			m[2] = (unsigned int)dmesh.ntris;
+			dmesh.nverts += (int)m[1];
+			dmesh.ntris += (int)m[3];
+		}
+	}
+	
+	for (int w = 0; w < nthreads; ++w)
+		workers[w].~rcDetailWorker();
+	rcFree(workers);
+	
+	return ok;
+}
+
 /// @par
 ///
 /// See the #rcConfig documentation for more information on the configuration parameters.
 ///
+/// With more than one thread, the polygons are shared among the threads, each
+/// building their detail meshes into its own buffers, then the meshes are
+/// copied in polygon order: the result is the same as with one thread. The
+/// messages logged by the threads are passed on to @p ctx in polygon order too.
+///
 /// @see rcAllocPolyMeshDetail, rcPolyMesh, rcCompactHeightfield, rcPolyMeshDetail, rcConfig
 bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompactHeightfield& chf,
 						   const float sampleDist, const float sampleMaxError,
-						   rcPolyMeshDetail& dmesh)
+						   rcPolyMeshDetail& dmesh, const int nthreads)
 {
 	rcAssert(ctx);
 	
@@ -1178,18 +1538,8 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 		return true;
 	
 	const int nvp = mesh.nvp;
-	const float cs = mesh.cs;
-	const float ch = mesh.ch;
-	const float* orig = mesh.bmin;
-	const int borderSize = mesh.borderSize;
 	const int heightSearchRadius = rcMax(1, (int)ceilf(mesh.maxEdgeError));
 	
-	rcIntArray edges(64);
-	rcIntArray tris(512);
-	rcIntArray arr(512);
-	rcIntArray samples(512);
-	float verts[256*3];
-	rcHeightPatch hp;
 	int nPolyVerts = 0;
 	int maxhw = 0, maxhh = 0;
 	
@@ -1199,12 +1549,6 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'bounds' (%d).", mesh.npolys*4);
 		return false;
 	}
-	rcScopedDelete<float> poly((float*)rcAlloc(sizeof(float)*nvp*3, RC_ALLOC_TEMP));
-	if (!poly)
-	{
-		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'poly' (%d).", nvp*3);
-		return false;
-	}
 	
 	// Find max size for a polygon area.
 	for (int i = 0; i < mesh.npolys; ++i)
@@ -1237,13 +1581,6 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 		maxhh = rcMax(maxhh, ymax-ymin);
 	}
 	
-	hp.data = (unsigned short*)rcAlloc(sizeof(unsigned short)*maxhw*maxhh, RC_ALLOC_TEMP);
-	if (!hp.data)
-	{
-		ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'hp.data' (%d).", maxhw*maxhh);
-		return false;
-	}
-	
 	dmesh.nmeshes = mesh.npolys;
 	dmesh.nverts = 0;
 	dmesh.ntris = 0;
@@ -1254,6 +1591,18 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 		return false;
 	}
 	
+	// Threads are worth it for large meshes only.
+	const int nworkers = rcMin(nthreads, mesh.npolys / RC_DETAIL_POLYS_PER_THREAD);
+	if (nworkers > 1)
+	{
+		return buildPolyMeshDetailParallel(ctx, mesh, chf, bounds, sampleDist, sampleMaxError,
+										   heightSearchRadius, maxhw, maxhh, nPolyVerts, nworkers, dmesh);
+	}
+	
+	rcPolyDetailScratch s;
+	if (!allocPolyDetailScratch(ctx, s, nvp, maxhw, maxhh))
+		return false;
+	
 	int vcap = nPolyVerts+nPolyVerts/2;
 	int tcap = vcap*2;
 	
@@ -1274,110 +1623,25 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 	
 	for (int i = 0; i < mesh.npolys; ++i)
 	{
-		const unsigned short* p = &mesh.polys[i*nvp*2];
-		
-		// Store polygon vertices for processing.
-		int npoly = 0;
-		for (int j = 0; j < nvp; ++j)
-		{
-			if(p[j] == RC_MESH_NULL_IDX) break;
-			const unsigned short* v = &mesh.verts[p[j]*3];
-			poly[j*3+0] = v[0]*cs;
-			poly[j*3+1] = v[1]*ch;
-			poly[j*3+2] = v[2]*cs;
-			npoly++;
-		}
-		
-		// Get the height data from the area of the polygon.
-		hp.xmin = bounds[i*4+0];
-		hp.ymin = bounds[i*4+2];
-		hp.width = bounds[i*4+1]-bounds[i*4+0];
-		hp.height = bounds[i*4+3]-bounds[i*4+2];
-		getHeightData(ctx, chf, p, npoly, mesh.verts, borderSize, hp, arr, mesh.regs[i]);
-		
-		// Build detail mesh.
-		int nverts = 0;
-		if (!buildPolyDetail(ctx, poly, npoly,
-							 sampleDist, sampleMaxError,
-							 heightSearchRadius, chf, hp,
-							 verts, nverts, tris,
-							 edges, samples))
+		int npoly = 0, nverts = 0;
+		if (!buildPolyDetailMesh(ctx, mesh, chf, bounds, i,
+								 sampleDist, sampleMaxError,
+								 heightSearchRadius, s, npoly, nverts))
 		{
 			return false;
 		}
 		
-		// Move detail verts to world space.
-		for (int j = 0; j < nverts; ++j)
-		{
-			verts[j*3+0] += orig[0];
-			verts[j*3+1] += orig[1] + chf.ch; // Is this offset necessary?
-			verts[j*3+2] += orig[2];
-		}
-		// Offset poly too, will be used to flag checking.
-		for (int j = 0; j < npoly; ++j)
-		{
-			poly[j*3+0] += orig[0];
-			poly[j*3+1] += orig[1];
-			poly[j*3+2] += orig[2];
-		}
-		
 		// Store detail submesh.
-		const int ntris = tris.size()/4;
-		
 		dmesh.meshes[i*4+0] = (unsigned int)dmesh.nverts;
 		dmesh.meshes[i*4+1] = (unsigned int)nverts;
 		dmesh.meshes[i*4+2] = (unsigned int)dmesh.ntris;
-		dmesh.meshes[i*4+3] = (unsigned int)ntris;
-		
-		// Store vertices, allocate more memory if necessary.
-		if (dmesh.nverts+nverts > vcap)
-		{
-			while (dmesh.nverts+nverts > vcap)
-				vcap += 256;
-			
-			float* newv = (float*)rcAlloc(sizeof(float)*vcap*3, RC_ALLOC_PERM);
-			if (!newv)
-			{
-				ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'newv' (%d).", vcap*3);
-				return false;
-			}
-			if (dmesh.nverts)
-				memcpy(newv, dmesh.verts, sizeof(float)*3*dmesh.nverts);
-			rcFree(dmesh.verts);
-			dmesh.verts = newv;
-		}
-		for (int j = 0; j < nverts; ++j)
-		{
-			dmesh.verts[dmesh.nverts*3+0] = verts[j*3+0];
-			dmesh.verts[dmesh.nverts*3+1] = verts[j*3+1];
-			dmesh.verts[dmesh.nverts*3+2] = verts[j*3+2];
-			dmesh.nverts++;
-		}
+		dmesh.meshes[i*4+3] = (unsigned int)(s.tris.size()/4);
 		
-		// Store triangles, allocate more memory if necessary.
-		if (dmesh.ntris+ntris > tcap)
+		if (!appendPolyDetailMesh(ctx, s, npoly, nverts,
+								  dmesh.verts, dmesh.nverts, vcap,
+								  dmesh.tris, dmesh.ntris, tcap))
 		{
-			while (dmesh.ntris+ntris > tcap)
-				tcap += 256;
-			unsigned char* newt = (unsigned char*)rcAlloc(sizeof(unsigned char)*tcap*4, RC_ALLOC_PERM);
-			if (!newt)
-			{
-				ctx->log(RC_LOG_ERROR, "rcBuildPolyMeshDetail: Out of memory 'newt' (%d).", tcap*4);
-				return false;
-			}
-			if (dmesh.ntris)
-				memcpy(newt, dmesh.tris, sizeof(unsigned char)*4*dmesh.ntris);
-			rcFree(dmesh.tris);
-			dmesh.tris = newt;
-		}
-		for (int j = 0; j < ntris; ++j)
-		{
-			const int* t = &tris[j*4];
-			dmesh.tris[dmesh.ntris*4+0] = (unsigned char)t[0];
-			dmesh.tris[dmesh.ntris*4+1] = (unsigned char)t[1];
-			dmesh.tris[dmesh.ntris*4+2] = (unsigned char)t[2];
-			dmesh.tris[dmesh.ntris*4+3] = getTriFlags(&verts[t[0]*3], &verts[t[1]*3], &verts[t[2]*3], poly, npoly);
-			dmesh.ntris++;
+			return false;
 		}
 	}
 	
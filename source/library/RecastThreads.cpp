@@ -0,0 +1,163 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <string.h>
+#include <new>
+#include <chrono>
+#include <thread>
+#include "RecastThreads.h"
+#include "RecastAlloc.h"
+#include "RecastAssert.h"
+
+static long long rcGetTimeUsec()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+rcWorkerContext::rcWorkerContext() :
+	m_timerTarget(0),
+	m_item(0),
+	m_log(0),
+	m_logSize(0),
+	m_logCap(0)
+{
+	doResetTimers();
+}
+
+rcWorkerContext::~rcWorkerContext()
+{
+	rcFree(m_log);
+}
+
+void rcWorkerContext::replayLog(rcContext* ctx, const int item, int& pos) const
+{
+	// Messages are stored as (item, category, length) followed by the text.
+	while (pos < m_logSize)
+	{
+		int hdr[3];
+		memcpy(hdr, &m_log[pos], sizeof(hdr));
+		if (hdr[0] != item)
+			break;
+		ctx->log((rcLogCategory)hdr[1], "%s", &m_log[pos+sizeof(hdr)]);
+		pos += (int)sizeof(hdr) + hdr[2] + 1;
+	}
+}
+
+void rcWorkerContext::doResetLog()
+{
+	m_logSize = 0;
+}
+
+void rcWorkerContext::doLog(const rcLogCategory category, const char* msg, const int len)
+{
+	const int hdr[3] = { m_item, (int)category, len };
+	const int size = m_logSize + (int)sizeof(hdr) + len + 1;
+	if (size > m_logCap)
+	{
+		int cap = rcMax(m_logCap*2, 1024);
+		while (cap < size)
+			cap *= 2;
+		char* log = (char*)rcAlloc(cap, RC_ALLOC_PERM);
+		if (!log)
+			return;
+		if (m_logSize)
+			memcpy(log, m_log, m_logSize);
+		rcFree(m_log);
+		m_log = log;
+		m_logCap = cap;
+	}
+	memcpy(&m_log[m_logSize], hdr, sizeof(hdr));
+	memcpy(&m_log[m_logSize+sizeof(hdr)], msg, len);
+	m_log[m_logSize+sizeof(hdr)+len] = '\0';
+	m_logSize = size;
+}
+
+void rcWorkerContext::doResetTimers()
+{
+	for (int i = 0; i < RC_MAX_TIMERS; ++i)
+	{
+		m_startTime[i] = 0;
+		m_accTime[i] = -1;
+	}
+}
+
+void rcWorkerContext::doStartTimer(const rcTimerLabel label)
+{
+	m_startTime[label] = rcGetTimeUsec();
+	if (m_timerTarget)
+		m_timerTarget->startTimer(label);
+}
+
+void rcWorkerContext::doStopTimer(const rcTimerLabel label)
+{
+	const long long deltaTime = rcGetTimeUsec() - m_startTime[label];
+	if (m_accTime[label] == -1)
+		m_accTime[label] = deltaTime;
+	else
+		m_accTime[label] += deltaTime;
+	if (m_timerTarget)
+		m_timerTarget->stopTimer(label);
+}
+
+int rcWorkerContext::doGetAccumulatedTime(const rcTimerLabel label) const
+{
+	return (int)m_accTime[label];
+}
+
+struct rcWorkerThreads
+{
+	void (*worker)(void*, const int);
+	void* arg;
+};
+
+static void rcRunWorkerThread(const rcWorkerThreads* job, const int index)
+{
+	job->worker(job->arg, index);
+}
+
+/// @par
+///
+/// If the threads can't be allocated, all the workers run on the calling thread,
+/// one after the other.
+void rcRunWorkers(void (*worker)(void* arg, const int index), void* arg, const int nthreads)
+{
+	rcAssert(worker);
+	
+	rcWorkerThreads job;
+	job.worker = worker;
+	job.arg = arg;
+	
+	std::thread* threads = nthreads > 1 ? (std::thread*)rcAlloc(sizeof(std::thread)*nthreads, RC_ALLOC_TEMP) : 0;
+	if (!threads)
+	{
+		for (int i = 0; i < nthreads; ++i)
+			worker(arg, i);
+		return;
+	}
+	
+	for (int i = 1; i < nthreads; ++i)
+		new(&threads[i]) std::thread(rcRunWorkerThread, &job, i);
+	worker(arg, 0);
+	for (int i = 1; i < nthreads; ++i)
+	{
+		threads[i].join();
+		threads[i].~thread();
+	}
+	rcFree(threads);
+}
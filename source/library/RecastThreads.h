@@ -0,0 +1,82 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef RECASTTHREADS_H
+#define RECASTTHREADS_H
+
+#include "Recast.h"
+
+/// Context of a thread taking part in a parallel build.
+///
+/// The log messages are kept, tagged with the item (polygon, region...) being
+/// built, so that the calling thread can pass them on in item order, and the
+/// log is the same as the one of a serial build. The timers are accumulated
+/// by the context itself, and can also be forwarded to a context used by the
+/// same thread.
+/// @ingroup recast
+class rcWorkerContext : public rcContext
+{
+public:
+	rcWorkerContext();
+	virtual ~rcWorkerContext();
+	
+	/// Forwards the timers to @p ctx too, which must be used by the same thread.
+	inline void setTimerTarget(rcContext* ctx) { m_timerTarget = ctx; }
+	
+	/// Sets the item which the next messages are about.
+	inline void setItem(const int item) { m_item = item; }
+	
+	/// Passes on to @p ctx the messages about an item.
+	///  @param[in]		ctx		The context receiving the messages.
+	///  @param[in]		item	The item.
+	///  @param[in,out]	pos		The position of the first message to pass on, which
+	///  						is advanced past the messages about the item.
+	void replayLog(rcContext* ctx, const int item, int& pos) const;
+	
+protected:
+	virtual void doResetLog();
+	virtual void doLog(const rcLogCategory category, const char* msg, const int len);
+	virtual void doResetTimers();
+	virtual void doStartTimer(const rcTimerLabel label);
+	virtual void doStopTimer(const rcTimerLabel label);
+	virtual int doGetAccumulatedTime(const rcTimerLabel label) const;
+	
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcWorkerContext(const rcWorkerContext&);
+	rcWorkerContext& operator=(const rcWorkerContext&);
+	
+	rcContext* m_timerTarget;
+	int m_item;
+	char* m_log;
+	int m_logSize;
+	int m_logCap;
+	long long m_startTime[RC_MAX_TIMERS];
+	long long m_accTime[RC_MAX_TIMERS];
+};
+
+/// Runs a parallel build: @p worker is called once for each worker index
+/// in [0, @p nthreads), index 0 on the calling thread and the others on new
+/// threads. Returns when all the workers are done.
+///  @ingroup recast
+///  @param[in]		worker		The worker function.
+///  @param[in]		arg			The argument passed on to the worker function.
+///  @param[in]		nthreads	The number of threads, the calling one included.
+void rcRunWorkers(void (*worker)(void* arg, const int index), void* arg, const int nthreads);
+
+#endif // RECASTTHREADS_H
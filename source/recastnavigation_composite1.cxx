@@ -12,9 +12,11 @@
 #include "library/DetourCommon.cpp"
 #include "library/DetourCrowd.cpp"
 #include "library/DetourDebugDraw.cpp"
+#include "library/DetourFlowField.cpp"
 #include "library/DetourLocalBoundary.cpp"
 #include "library/DetourNavMeshBuilder.cpp"
 #include "library/DetourNavMeshQuery.cpp"
+#include "library/DetourNavMeshSampler.cpp"
 #include "library/DetourNode.cpp"
 #include "library/DetourObstacleAvoidance.cpp"
 #include "library/DetourPathCorridor.cpp"
@@ -32,3 +34,4 @@
 #include "library/RecastMeshDetail.cpp"
 #include "library/RecastRasterization.cpp"
 #include "library/RecastRegion.cpp"
+#include "library/RecastThreads.cpp"
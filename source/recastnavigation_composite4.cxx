@@ -12,7 +12,11 @@
 #include "support/ChunkyTriMesh.cpp"
 #include "support/ConvexVolumeTool.cpp"
 #include "support/DebugInterfaces.cpp"
+#include "support/GeomBucketStore.cpp"
 #include "support/MeshLoaderObj.cpp"
+#include "support/NavMeshAlloc.cpp"
+#include "support/NavMeshBuildCache.cpp"
+#include "support/NavMeshCompressor.cpp"
 #include "support/NavMeshTesterTool.cpp"
 #include "support/NavMeshType.cpp"
 #include "support/NavMeshType_Obstacle.cpp"
@@ -20,4 +24,6 @@
 #include "support/NavMeshType_Tile.cpp"
 #include "support/OffMeshConnectionTool.cpp"
 #include "support/PerfTimer.cpp"
+#include "support/TerrainHeightfield.cpp"
+#include "support/TriMeshBVH.cpp"
 #include "support/fastlz.c"
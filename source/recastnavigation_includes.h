@@ -29,6 +29,8 @@ namespace rnsup
 struct dtNavMesh;
 struct dtNavMeshQuery;
 struct dtCrowd;
+struct dtFlowField;
+struct dtNavMeshSampler;
 struct dtTileCache;
 struct dtCrowdAgentParams;
 typedef unsigned int dtObstacleRef;
@@ -50,6 +50,7 @@ int RNCrowdAgent::set_params(const RNCrowdAgentParams& agentParams)
 
 /**
  * Sets RNCrowdAgent's move target.
+ * A member of a crowd group leaves it (see RNNavMesh::add_crowd_group()).
  * Should be called after addition to a RNNavMesh.
  * Returns a negative number on error.
  */
@@ -80,6 +81,41 @@ int RNCrowdAgent::set_move_velocity(const LVector3f& vel)
 	return mNavMesh->do_set_crowd_agent_velocity(this, vel);
 }
 
+/**
+ * Sets RNCrowdAgent's move flow field: RNCrowdAgent will head to the nearest
+ * goal of the flow field, without requesting paths (see
+ * RNNavMesh::add_flow_field()).
+ * Setting a move target or a move velocity stops following the flow field.
+ * Should be called after addition to a RNNavMesh.
+ * Returns a negative number on error.
+ */
+int RNCrowdAgent::set_move_flow_field(int flowFieldRef)
+{
+	// continue if crowdAgent belongs to a mesh
+	CONTINUE_IF_ELSE_R(mNavMesh, RN_ERROR)
+
+	//request RNNavMesh to update move flow field for this RNCrowdAgent
+	return mNavMesh->do_set_crowd_agent_flow_field(this, flowFieldRef);
+}
+
+/**
+ * Sets the priority of RNCrowdAgent's path requests, in update ticks: a
+ * request with priority p is served as if it had been waiting p updates more,
+ * so requests with lower priority are delayed but never starve (see
+ * RNNavMesh::set_crowd_path_queue_budget()).
+ */
+void RNCrowdAgent::set_path_priority(float priority)
+{
+	mPathPriority = priority;
+
+	// update recast if crowdAgent belongs to a setup mesh
+	if (mNavMesh && mNavMesh->get_recast_crowd() && (mAgentIdx >= 0))
+	{
+		mNavMesh->get_recast_crowd()->setAgentPathPriority(mAgentIdx,
+				mPathPriority);
+	}
+}
+
 /**
  * Sets RNCrowdAgent's movement type (recast native or kinematic).
  */
@@ -119,171 +155,54 @@ RNCrowdAgent::RNCrowdAgentState RNCrowdAgent::get_traversing_state() const
 }
 
 /**
- * Initializes the RNCrowdAgent with starting settings.
+ * Initializes the RNCrowdAgent with starting settings, given by an already
+ * compiled profile.
+ * \note The RNCrowdAgent isn't added to any RNNavMesh here: this is up to the
+ * caller (see RNNavMeshManager).
  * \note Internal use only.
  */
-void RNCrowdAgent::do_initialize()
+void RNCrowdAgent::do_initialize(const RNCrowdAgentProfile& profile)
 {
 	WPT(RNNavMeshManager)mTmpl = RNNavMeshManager::get_global_ptr();
 	//set RNCrowdAgent parameters
-	//register to navmesh objectId
-	string navMeshName = mTmpl->get_parameter_value(RNNavMeshManager::CROWDAGENT, string("add_to_navmesh"));
 	//mov type
-	string movType = mTmpl->get_parameter_value(RNNavMeshManager::CROWDAGENT, string("mov_type"));
-	if (movType == string("kinematic"))
-	{
-		set_mov_type(RECAST_KINEMATIC);
-	}
-	else
-	{
-		set_mov_type(RECAST);
-	}
-	//
-	string param;
-	unsigned int idx, valueNum;
-	pvector<string> paramValuesStr;
-	//move target
-	param = mTmpl->get_parameter_value(RNNavMeshManager::CROWDAGENT, string("move_target"));
-	paramValuesStr = parseCompoundString(param, ',');
-	valueNum = paramValuesStr.size();
-	if (valueNum < 3)
-	{
-		paramValuesStr.resize(3, "0.0");
-	}
-	for (idx = 0; idx < 3; ++idx)
-	{
-		mMoveTarget[idx] = STRTOF(paramValuesStr[idx].c_str(), NULL);
-	}
-	//move velocity
-	param = mTmpl->get_parameter_value(RNNavMeshManager::CROWDAGENT, string("move_velocity"));
-	paramValuesStr = parseCompoundString(param, ',');
-	valueNum = paramValuesStr.size();
-	if (valueNum < 3)
-	{
-		paramValuesStr.resize(3, "0.0");
-	}
-	for (idx = 0; idx < 3; ++idx)
-	{
-		mMoveVelocity[idx] = STRTOF(paramValuesStr[idx].c_str(), NULL);
-	}
-	//
-	float value;
-	int valueInt;
-	//max acceleration
-	value = STRTOF(mTmpl->get_parameter_value(RNNavMeshManager::CROWDAGENT, string("max_acceleration")).c_str(),
-			NULL);
-	mAgentParams.set_maxAcceleration(value >= 0.0 ? value : -value);
-	//max speed
-	value = STRTOF(mTmpl->get_parameter_value(RNNavMeshManager::CROWDAGENT, string("max_speed")).c_str(), NULL);
-	mAgentParams.set_maxSpeed(value >= 0.0 ? value : -value);
-	//collision query range
-	value = STRTOF(
-			mTmpl->get_parameter_value(RNNavMeshManager::CROWDAGENT, string("collision_query_range")).c_str(),
-			NULL);
-	mAgentParams.set_collisionQueryRange(value >= 0.0 ? value : -value);
-	//path optimization range
-	value = STRTOF(
-			mTmpl->get_parameter_value(RNNavMeshManager::CROWDAGENT, string("path_optimization_range")).c_str(),
-			NULL);
-	mAgentParams.set_pathOptimizationRange(value >= 0.0 ? value : -value);
-	//separation weight
-	value = STRTOF(mTmpl->get_parameter_value(RNNavMeshManager::CROWDAGENT, string("separation_weight")).c_str(),
-			NULL);
-	mAgentParams.set_separationWeight(value >= 0.0 ? value : -value);
-	//update flags
-	valueInt = strtol(mTmpl->get_parameter_value(RNNavMeshManager::CROWDAGENT, string("update_flags")).c_str(),
-			NULL, 0);
-	mAgentParams.set_updateFlags(valueInt >= 0.0 ? valueInt : -valueInt);
-	//obstacle avoidance type
-	valueInt = strtol(
-			mTmpl->get_parameter_value(RNNavMeshManager::CROWDAGENT, string("obstacle_avoidance_type")).c_str(),
-			NULL, 0);
-	mAgentParams.set_obstacleAvoidanceType(valueInt >= 0.0 ? valueInt : -valueInt);
-	//thrown events
-	string thrownEventsParam = mTmpl->get_parameter_value(RNNavMeshManager::CROWDAGENT, string("thrown_events"));
-	//
+	set_mov_type(profile.get_kinematic() ? RECAST_KINEMATIC : RECAST);
+	//move target and velocity
+	mMoveTarget = profile.get_move_target();
+	mMoveVelocity = profile.get_move_velocity();
+	//agent params
+	mAgentParams = profile.get_params();
 	//set thrown events if any
-	unsigned int idx1, valueNum1;
-	pvector<string> paramValuesStr1, paramValuesStr2;
-	if (thrownEventsParam != string(""))
+	//get default name prefix
+	string objectType = get_name();
+	ThrowEventData eventData;
+	eventData = profile.get_move_event();
+	if (eventData.mEnable)
 	{
-		//events specified
-		//event1@[event_name1]@[frequency1][:...[:eventN@[event_nameN]@[frequencyN]]]
-		paramValuesStr1 = parseCompoundString(thrownEventsParam, ':');
-		valueNum1 = paramValuesStr1.size();
-		for (idx1 = 0; idx1 < valueNum1; ++idx1)
+		//check name
+		if (eventData.mEventName == "")
 		{
-			//eventX@[event_nameX]@[frequencyX]
-			paramValuesStr2 = parseCompoundString(paramValuesStr1[idx1], '@');
-			if (paramValuesStr2.size() >= 3)
-			{
-				RNEventThrown event;
-				ThrowEventData eventData;
-				//get default name prefix
-				string objectType = get_name();
-				//get name
-				string name = paramValuesStr2[1];
-				//get frequency
-				float frequency = STRTOF(paramValuesStr2[2].c_str(), NULL);
-				if (frequency <= 0.0)
-				{
-					frequency = 30.0;
-				}
-				//get event
-				if (paramValuesStr2[0] == "move")
-				{
-					event = MOVE_EVENT;
-					//check name
-					if (name == "")
-					{
-						//set default name
-						name = objectType + "_CrowdAgent_Move";
-					}
-				}
-				else if (paramValuesStr2[0] == "steady")
-				{
-					event = STEADY_EVENT;
-					//check name
-					if (name == "")
-					{
-						//set default name
-						name = objectType + "_CrowdAgent_Steady";
-					}
-				}
-				else
-				{
-					//paramValuesStr2[0] is not a suitable event:
-					//continue with the next event
-					continue;
-				}
-				//set event data
-				eventData.mEnable = true;
-				eventData.mEventName = name;
-				eventData.mTimeElapsed = 0;
-				eventData.mFrequency = frequency;
-				//enable the event
-				do_enable_crowd_agent_event(event, eventData);
-			}
+			//set default name
+			eventData.mEventName = objectType + "_CrowdAgent_Move";
 		}
+		//enable the event
+		do_enable_crowd_agent_event(MOVE_EVENT, eventData);
 	}
-	//clear all no more needed "Param" variables
-	thrownEventsParam.clear();
-	// set the collide mask to avoid hit with the nav mesh manager ray
-	mThisNP.set_collide_mask(~mTmpl->get_collide_mask() &
-			mThisNP.get_collide_mask());
-	//add to RNNavMesh if requested
-	PT(RNNavMesh) navMesh = NULL;
-	for (int index = 0;
-			index < mTmpl->get_num_nav_meshes();
-			++index)
+	eventData = profile.get_steady_event();
+	if (eventData.mEnable)
 	{
-		navMesh = mTmpl->get_nav_mesh(index);
-		if (navMesh->get_name() == navMeshName)
+		//check name
+		if (eventData.mEventName == "")
 		{
-			navMesh->add_crowd_agent(mThisNP);
-			break;
+			//set default name
+			eventData.mEventName = objectType + "_CrowdAgent_Steady";
 		}
+		//enable the event
+		do_enable_crowd_agent_event(STEADY_EVENT, eventData);
 	}
+	// set the collide mask to avoid hit with the nav mesh manager ray
+	mThisNP.set_collide_mask(~mTmpl->get_collide_mask() &
+			mThisNP.get_collide_mask());
 #ifdef PYTHON_BUILD
 	//Python callback
 	this->ref();
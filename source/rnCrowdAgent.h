@@ -141,6 +141,10 @@ PUBLISHED:
 	INLINE LPoint3f get_move_target() const;
 	int set_move_velocity(const LVector3f& vel);
 	INLINE LVector3f get_move_velocity() const;
+	int set_move_flow_field(int flowFieldRef);
+	INLINE int get_move_flow_field() const;
+	void set_path_priority(float priority);
+	INLINE float get_path_priority() const;
 	LVector3f get_actual_velocity() const;
 	RNCrowdAgentState get_traversing_state() const;
 	///@}
@@ -200,12 +204,15 @@ private:
 	RNCrowdAgentParams mAgentParams;
 	LPoint3f mMoveTarget;
 	LVector3f mMoveVelocity;
+	int mMoveFlowField;
+	float mPathPriority;
+	int mMoveGroup;
 	///@}
 	///Height correction for kinematic RNCrowdAgent(s).
 	LVector3f mHeigthCorrection;
 
 	inline void do_reset();
-	void do_initialize();
+	void do_initialize(const RNCrowdAgentProfile& profile);
 	void do_finalize();
 
 	void do_update_pos_dir(float dt, const LPoint3f& pos, const LVector3f& vel);
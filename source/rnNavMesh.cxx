@@ -13,10 +13,14 @@
 
 #include "rnCrowdAgent.h"
 #include "rnNavMeshManager.h"
+#include "config_module.h"
 #include "camera.h"
+#include "pset.h"
+#include "filename.h"
 
 #ifndef CPPPARSER
 #include "library/DetourCommon.h"
+#include "library/DetourNode.h"
 #include "support/ConvexVolumeTool.h"
 #include "support/NavMeshType_Solo.h"
 #include "support/OffMeshConnectionTool.h"
@@ -65,6 +69,63 @@ void RNNavMesh::set_nav_mesh_settings(const RNNavMeshSettings& settings)
 	}
 }
 
+/**
+ * Sets the directory where the build outputs are cached: on setup, the outputs
+ * (the whole nav mesh for SOLO type, each tile for TILE and OBSTACLE types)
+ * whose inputs (geometry, settings, area flags, convex volumes and off mesh
+ * connections) are unchanged are loaded from it instead of being rebuilt.
+ * The directory is created if needed. An empty string disables the cache.
+ * Should be called before RNNavMesh setup.
+ */
+void RNNavMesh::set_build_cache_dir(const string& dir)
+{
+	CONTINUE_IF_ELSE_V(! mNavMeshType)
+
+	mBuildCacheDir = dir;
+}
+
+/**
+ * Sets the directory where the owner object's triangles are streamed to
+ * (TILE and OBSTACLE).
+ * The triangles are written, bucketed by tile, to a store file in it, instead
+ * of being all kept in memory: each tile build loads only the triangles around
+ * it, so memory scales with the tile size, not with the whole geometry. The
+ * store file is removed with the RNNavMesh.
+ * The directory is created if needed. An empty string disables streaming.
+ * \note With streamed geometry ray_cast_geometry() doesn't hit anything and
+ * refresh_geometry() is not supported.
+ * Should be called before RNNavMesh setup.
+ */
+void RNNavMesh::set_geometry_stream_dir(const string& dir)
+{
+	CONTINUE_IF_ELSE_V(! mNavMeshType)
+
+	mGeometryStreamDir = dir;
+}
+
+/**
+ * Sets a heightfield terrain, voxelized directly column by column instead of
+ * being triangulated and rasterized: the owner object's geometry (i.e. the
+ * props over the terrain, but not the terrain itself) is rasterized on top.
+ * As for a GeoMipTerrain, pixel (x, y) of the heightfield is at (origin.x +
+ * x * scale.x, origin.y + (y_size - 1 - y) * scale.y, origin.z +
+ * brightness(x, y) * scale.z), wrt the reference node, and heights are
+ * bilinearly interpolated; the walkable slope is checked against the height
+ * gradient.
+ * An invalid (empty) image removes the terrain. The terrain isn't saved to bam
+ * files.
+ * Should be called before RNNavMesh setup.
+ */
+void RNNavMesh::set_terrain(const PNMImage& heightfield,
+		const LPoint3f& origin, const LVecBase3f& scale)
+{
+	CONTINUE_IF_ELSE_V(! mNavMeshType)
+
+	mTerrainHeightfield = heightfield;
+	mTerrainOrigin = origin;
+	mTerrainScale = scale;
+}
+
 /**
  * Sets the area's traversal cost.
  */
@@ -131,6 +192,57 @@ void RNNavMesh::set_crowd_exclude_flags(int oredFlags)
 	}
 }
 
+/**
+ * Sets the budget RNCrowdAgents' path requests are served within on each
+ * update: at most maxIters path finder iterations and maxTimeUsec
+ * microseconds (values <= 0 mean no limit). Requests are served by priority
+ * (see RNCrowdAgent::set_path_priority()).
+ */
+void RNNavMesh::set_crowd_path_queue_budget(int maxIters, int maxTimeUsec)
+{
+	mCrowdPathQueueMaxIters = maxIters;
+	mCrowdPathQueueMaxTimeUsec = maxTimeUsec;
+
+	if(mNavMeshType)
+	{
+		//there is a crowd tool because the recast nav mesh
+		//has been completely setup
+		rnsup::CrowdTool* crowdTool =
+				static_cast<rnsup::CrowdTool*>(mNavMeshType->getTool());
+		//set recast crowd path queue budget
+		crowdTool->getState()->getCrowd()->setPathQueueParams(
+				mCrowdPathQueueMaxIters, mCrowdPathQueueMaxTimeUsec,
+				mCrowdPathQueueWorkers);
+	}
+}
+
+/**
+ * Sets the number of worker threads serving RNCrowdAgents' path requests
+ * concurrently during update (0 to serve them on the calling thread only).
+ * Returns a negative number on error.
+ */
+int RNNavMesh::set_crowd_path_queue_workers(int numWorkers)
+{
+	CONTINUE_IF_ELSE_R(numWorkers >= 0, RN_ERROR)
+
+	mCrowdPathQueueWorkers = numWorkers;
+
+	if(mNavMeshType)
+	{
+		//there is a crowd tool because the recast nav mesh
+		//has been completely setup
+		rnsup::CrowdTool* crowdTool =
+				static_cast<rnsup::CrowdTool*>(mNavMeshType->getTool());
+		//set recast crowd path queue workers
+		CONTINUE_IF_ELSE_R(
+				crowdTool->getState()->getCrowd()->setPathQueueParams(
+						mCrowdPathQueueMaxIters, mCrowdPathQueueMaxTimeUsec,
+						mCrowdPathQueueWorkers), RN_ERROR)
+	}
+	//
+	return RN_SUCCESS;
+}
+
 /**
  * Sets the underlying NavMeshType tile settings (only TILE and OBSTACLE).
  */
@@ -255,6 +367,44 @@ void RNNavMesh::do_initialize()
 					string("detail_sample_max_error")).c_str(),
 			NULL);
 	mNavMeshSettings.set_detailSampleMaxError(value >= 0.0 ? value : -value);
+	//allocator
+	valueStr = mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
+			string("allocator"));
+	if (valueStr == string("arena_pool"))
+	{
+		mNavMeshSettings.set_allocatorType(rnsup::NAVMESH_ALLOCATOR_ARENA_POOL);
+	}
+	else
+	{
+		//default
+		mNavMeshSettings.set_allocatorType(rnsup::NAVMESH_ALLOCATOR_DEFAULT);
+	}
+	//detail grid
+	mNavMeshSettings.set_buildDetailGrid(
+			mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
+					string("detail_grid")) == string("false") ?
+					false : true);
+	//build threads
+	valueInt = strtol(
+			mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
+					string("build_threads")).c_str(), NULL, 0);
+	mNavMeshSettings.set_buildThreads(valueInt >= 0 ? valueInt : -valueInt);
+	//parallel contours
+	mNavMeshSettings.set_parallelContours(
+			mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
+					string("parallel_contours")) == string("true") ?
+					true : false);
+	//parallel detail
+	mNavMeshSettings.set_parallelDetail(
+			mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
+					string("parallel_detail")) == string("true") ?
+					true : false);
+	//build cache dir
+	mBuildCacheDir = mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
+			string("build_cache_dir"));
+	//geometry stream dir
+	mGeometryStreamDir = mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
+			string("geometry_stream_dir"));
 	//build all tiles
 	mNavMeshTileSettings.set_buildAllTiles(
 			mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
@@ -276,6 +426,43 @@ void RNNavMesh::do_initialize()
 			mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
 					string("tile_size")).c_str(), NULL);
 	mNavMeshTileSettings.set_tileSize(value >= 0.0 ? value : -value);
+	//tile cache compressor
+	valueStr = mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
+			string("tile_cache_compressor"));
+	if (valueStr == string("none"))
+	{
+		mNavMeshTileSettings.set_compressorType(rnsup::NAVMESH_COMPRESSOR_NONE);
+	}
+	else if (valueStr == string("fastlz_high"))
+	{
+		mNavMeshTileSettings.set_compressorType(
+				rnsup::NAVMESH_COMPRESSOR_FASTLZ_HIGH);
+	}
+	else if (valueStr == string("layer_rle"))
+	{
+		mNavMeshTileSettings.set_compressorType(
+				rnsup::NAVMESH_COMPRESSOR_LAYER_RLE);
+	}
+	else
+	{
+		//fastlz
+		mNavMeshTileSettings.set_compressorType(
+				rnsup::NAVMESH_COMPRESSOR_FASTLZ);
+	}
+	//max obstacles
+	valueInt = strtol(
+			mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
+					string("max_obstacles")).c_str(), NULL, 0);
+	mNavMeshTileSettings.set_maxObstacles(
+			rcMin(valueInt >= 0 ? valueInt : -valueInt,
+					DT_TILECACHE_MAX_OBSTACLES));
+	//max obstacles cap
+	valueInt = strtol(
+			mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
+					string("max_obstacles_cap")).c_str(), NULL, 0);
+	mNavMeshTileSettings.set_maxObstaclesCap(
+			rcMin(valueInt >= 0 ? valueInt : -valueInt,
+					DT_TILECACHE_MAX_OBSTACLES));
 	///
 	//0: get navmesh type
 	valueStr = mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
@@ -381,6 +568,20 @@ void RNNavMesh::do_initialize()
 		//or flag
 		mCrowdExcludeFlags |= flag;
 	}
+	///get crowd path queue budget & workers
+	ieFlagsStr = parseCompoundString(
+			mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
+					string("crowd_path_queue_budget")), ':');
+	mCrowdPathQueueMaxIters = (
+			ieFlagsStr.size() >= 1 ?
+					strtol(ieFlagsStr[0].c_str(), NULL, 0) : 100);
+	mCrowdPathQueueMaxTimeUsec = (
+			ieFlagsStr.size() >= 2 ?
+					strtol(ieFlagsStr[1].c_str(), NULL, 0) : 0);
+	valueInt = strtol(
+			mTmpl->get_parameter_value(RNNavMeshManager::NAVMESH,
+					string("crowd_path_queue_workers")).c_str(), NULL, 0);
+	mCrowdPathQueueWorkers = (valueInt >= 0 ? valueInt : -valueInt);
 
 	///get convex volumes
 	plist<string> mConvexVolumesParam = mTmpl->get_parameter_values(RNNavMeshManager::NAVMESH,
@@ -549,6 +750,9 @@ int RNNavMesh::setup()
 	//setup the build context
 	mCtx = new rnsup::BuildContext;
 
+	//select the Recast/Detour allocator (process wide)
+	rnsup::setNavMeshAllocator(mNavMeshSettings.get_allocatorType());
+
 	//do the real setup
 	//setup navigation mesh, otherwise the same
 	//operations must be performed by program.
@@ -575,6 +779,12 @@ int RNNavMesh::setup()
 			return RN_ERROR;
 		}
 	}
+	//set the terrain, if any: there must be some geometry anyway
+	if (!do_set_terrain())
+	{
+		cleanup();
+		return RN_ERROR;
+	}
 
 	//set up the type of navigation mesh
 	switch (mNavMeshTypeEnum)
@@ -591,7 +801,26 @@ int RNNavMesh::setup()
 		do_create_nav_mesh_type(new rnsup::NavMeshType_Tile());
 		//set navigation mesh settings
 		mNavMeshType->setNavMeshSettings(mNavMeshSettings);
-		//set navigation mesh tile settings
+		//set navigation mesh tile settings...
+		//	fit m_maxTiles & m_maxPolysPerTile into the poly ref bits
+		//	(settings could come from a build with different poly refs)
+		int tileBits = (int) rnsup::ilog2(
+				rnsup::nextPow2(mNavMeshTileSettings.get_maxTiles()));
+		int polyBits = (int) rnsup::ilog2(
+				rnsup::nextPow2(mNavMeshTileSettings.get_maxPolysPerTile()));
+#ifdef DT_POLYREF64
+		tileBits = rcMin(tileBits, (int) DT_TILE_BITS);
+		polyBits = rcMin(polyBits, (int) DT_POLY_BITS);
+#else
+		tileBits = rcMin(tileBits, 14);
+		polyBits = rcMin(polyBits, 22 - tileBits);
+#endif //DT_POLYREF64
+		mNavMeshTileSettings.set_maxTiles(
+				rcMin(mNavMeshTileSettings.get_maxTiles(), 1 << tileBits));
+		mNavMeshTileSettings.set_maxPolysPerTile(
+				rcMin(mNavMeshTileSettings.get_maxPolysPerTile(),
+						1 << polyBits));
+		//...effectively
 		static_cast<rnsup::NavMeshType_Tile*>(mNavMeshType)->setTileSettings(
 				mNavMeshTileSettings);
 	}
@@ -611,6 +840,13 @@ int RNNavMesh::setup()
 		const int tw = (gw + ts - 1) / ts;
 		const int th = (gh + ts - 1) / ts;
 		//	Max tiles and max polys affect how the tile IDs are calculated.
+#ifdef DT_POLYREF64
+		// 	There are DT_TILE_BITS bits available for identifying a tile and
+		//	DT_POLY_BITS bits for identifying a polygon.
+		int tileBits = rcMin((int) rnsup::ilog2(rnsup::nextPow2(tw * th)),
+				(int) DT_TILE_BITS);
+		int polyBits = DT_POLY_BITS;
+#else
 		// 	There are 22 bits available for identifying a tile and a polygon.
 		int tileBits = rcMin((int) rnsup::ilog2(rnsup::nextPow2(tw * th)), 14);
 		if (tileBits > 14)
@@ -618,6 +854,7 @@ int RNNavMesh::setup()
 			tileBits = 14;
 		}
 		int polyBits = 22 - tileBits;
+#endif //DT_POLYREF64
 		mNavMeshTileSettings.set_maxTiles(1 << tileBits);
 		mNavMeshTileSettings.set_maxPolysPerTile(1 << polyBits);
 		//...effectively
@@ -632,6 +869,16 @@ int RNNavMesh::setup()
 	//set recast areas' flags table
 	mNavMeshType->setFlagsAreaTable(mPolyAreaFlags);
 
+	//set the build cache directory, creating it if needed
+	if (!mBuildCacheDir.empty())
+	{
+		Filename cacheDir = Filename::from_os_specific(mBuildCacheDir);
+		cacheDir.make_dir();
+		cacheDir.mkdir();
+		mNavMeshType->setBuildCacheDir(
+				cacheDir.is_directory() ? cacheDir.to_os_specific() : string());
+	}
+
 	{
 		//set recast convex volumes
 		//mConvexVolumes could be modified during iteration so use this pattern:
@@ -805,6 +1052,10 @@ int RNNavMesh::setup()
 			mCrowdIncludeFlags);
 	crowdTool->getState()->getCrowd()->getEditableFilter(0)->setExcludeFlags(
 			mCrowdExcludeFlags);
+	//set recast crowd path queue budget & workers
+	crowdTool->getState()->getCrowd()->setPathQueueParams(
+			mCrowdPathQueueMaxIters, mCrowdPathQueueMaxTimeUsec,
+			mCrowdPathQueueWorkers);
 
 	//initialize the tester tool
 	mTesterTool.init(mNavMeshType,
@@ -833,21 +1084,27 @@ int RNNavMesh::setup()
 	//handle obstacles
 	if (mNavMeshTypeEnum == OBSTACLE)
 	{
-		//add to recast previously added obstacles.
-		//mObstacles could be modified during iteration so use this pattern:
-		PTA(Obstacle)::iterator iter = mObstacles.begin();
-		while (iter != mObstacles.end())
+		//add to recast previously added obstacles, as a batch.
+		if (do_add_obstacles_to_recast(0, mObstacles.size(), buildFromBam)
+				< 0)
 		{
-			//check if adding to recast was successful
-			if (do_add_obstacle_to_recast((*iter).second(),
-							iter - mObstacles.begin(), buildFromBam) < 0)
+			//on failure add them one by one, dropping those which cannot
+			//be added: mObstacles could be modified during iteration so
+			//use this pattern:
+			PTA(Obstacle)::iterator iter = mObstacles.begin();
+			while (iter != mObstacles.end())
 			{
-				//\see http://stackoverflow.com/questions/596162/can-you-remove-elements-from-a-stdlist-while-iterating-through-it
-				iter = mObstacles.erase(iter);
-				continue;
+				//check if adding to recast was successful
+				if (do_add_obstacle_to_recast(iter - mObstacles.begin(),
+								buildFromBam) < 0)
+				{
+					//\see http://stackoverflow.com/questions/596162/can-you-remove-elements-from-a-stdlist-while-iterating-through-it
+					iter = mObstacles.erase(iter);
+					continue;
+				}
+				//increment iterator
+				++iter;
 			}
-			//increment iterator
-			++iter;
 		}
 	}
 	else
@@ -1003,10 +1260,12 @@ int RNNavMesh::do_get_convex_volume_from_point(const LPoint3f& insidePoint) cons
 	int convexVolumeID = RN_ERROR;
 	const rnsup::ConvexVolume* vols =
 			mNavMeshType->getInputGeom()->getConvexVolumes();
-	for (int i = 0; i < mNavMeshType->getInputGeom()->getConvexVolumeCount();
-			++i)
+	std::vector<int> volumes;
+	mNavMeshType->getInputGeom()->queryConvexVolumes(hitPos, hitPos, volumes);
+	for (int k = 0; k < (int) volumes.size(); ++k)
 	{
-		if (rnsup::pointInPoly(vols[i].nverts, vols[i].verts, hitPos)
+		const int i = volumes[k];
+		if (rnsup::pointInPoly(vols[i].nverts, vols[i].verts.data(), hitPos)
 				&& hitPos[1] >= vols[i].hmin && hitPos[1] <= vols[i].hmax)
 		{
 			convexVolumeID = i;
@@ -1027,7 +1286,7 @@ int RNNavMesh::do_find_convex_volume_polys(int convexVolumeID,
 {
 	///https://groups.google.com/forum/?fromgroups#!searchin/recastnavigation/door/recastnavigation/K2C44OCpxGE/a2Zn6nu0dIIJ
 	const float *queryPolyPtr =
-			mNavMeshType->getInputGeom()->getConvexVolumes()[convexVolumeID].verts;
+			mNavMeshType->getInputGeom()->getConvexVolumes()[convexVolumeID].verts.data();
 	int nverts =
 			mNavMeshType->getInputGeom()->getConvexVolumes()[convexVolumeID].nverts;
 
@@ -1172,6 +1431,8 @@ int RNNavMesh::set_convex_volume_settings(const LPoint3f& insidePoint,
 			}
 			convexVolumeID = -1;
 		}
+		// samplers only see tile changes, not poly area/flags ones
+		do_free_samplers();
 	}
 #ifdef RN_DEBUG
 	if (!mDebugCamera.is_empty())
@@ -1522,6 +1783,8 @@ int RNNavMesh::set_off_mesh_connection_settings(const LPoint3f& beginOrEndPoint,
 			mNavMeshType->getNavMesh()->setPolyFlags(poly, oldFlags);
 			offMeshConnectionID = -1;
 		}
+		// samplers only see tile changes, not poly area/flags ones
+		do_free_samplers();
 	}
 
 #ifdef RN_DEBUG
@@ -1689,15 +1952,16 @@ int RNNavMesh::cleanup()
 	// remove all obstacles from recast
 	if (mNavMeshTypeEnum == OBSTACLE)
 	{
+		pvector<dtObstacleRef> obstacleRefs;
 		PTA(Obstacle)::iterator iterO;
 		for (iterO = mObstacles.begin(); iterO != mObstacles.end(); ++iterO)
 		{
-			//could return an error
-			if (do_remove_obstacle_from_recast(iterO->second(),
-					iterO->first().get_ref()) < 0)
-			{
-				result = RN_ERROR;
-			}
+			obstacleRefs.push_back(iterO->first().get_ref());
+		}
+		//could return an error
+		if (do_remove_obstacles_from_recast(obstacleRefs) < 0)
+		{
+			result = RN_ERROR;
 		}
 	}
 
@@ -1708,6 +1972,20 @@ int RNNavMesh::cleanup()
 		do_remove_crowd_agent_from_recast_update(*iterC);
 	}
 
+	// delete flow fields
+	pmap<int, FlowField>::iterator iterF;
+	for (iterF = mFlowFields.begin(); iterF != mFlowFields.end(); ++iterF)
+	{
+		dtFreeFlowField(iterF->second.get_second());
+	}
+	mFlowFields.clear();
+
+	// snapshots refer to this setup
+	mSnapshots.clear();
+
+	// delete random point samplers
+	do_free_samplers();
+
 	//do real cleanup
 	if (mNavMeshType)
 	{
@@ -1777,6 +2055,57 @@ LVecBase2i RNNavMesh::get_tile_indexes(const LPoint3f& pos)
 	return LVecBase2i(tx, ty);
 }
 
+/**
+ * Reloads the owner object's geometry and rebuilds only the tiles whose input
+ * (triangles, convex volumes, off mesh connections and settings) changed
+ * (TILE and OBSTACLE).
+ * The nav mesh bounds are those of the setup: geometry outside them is ignored.
+ * Not supported with streamed geometry (see set_geometry_stream_dir()).
+ * Should be called after RNNavMesh setup.
+ * Returns the number of rebuilt tiles, or a negative number on error.
+ */
+int RNNavMesh::refresh_geometry()
+{
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, RN_ERROR)
+	CONTINUE_IF_ELSE_R(
+			(mNavMeshTypeEnum == TILE) || (mNavMeshTypeEnum == OBSTACLE),
+			RN_ERROR)
+	CONTINUE_IF_ELSE_R(!mOwnerObject.is_empty(), RN_ERROR)
+	//not supported with streamed geometry
+	CONTINUE_IF_ELSE_R(!mGeom->getBucketStore(), RN_ERROR)
+
+	rnsup::rcMeshLoaderObj* mesh = new rnsup::rcMeshLoaderObj;
+	if (!mesh->load(mOwnerObject, mReferenceNP))
+	{
+		delete mesh;
+		return RN_ERROR;
+	}
+	//the geometry owns the mesh from now on
+	int count = mNavMeshType->handleMeshRefresh(mesh);
+	CONTINUE_IF_ELSE_R(count >= 0, RN_ERROR)
+
+	if (count > 0)
+	{
+		//flow fields
+		pmap<int, FlowField>::iterator iterF;
+		for (iterF = mFlowFields.begin(); iterF != mFlowFields.end(); ++iterF)
+		{
+			do_build_flow_field(iterF->second);
+		}
+#ifdef RN_DEBUG
+		if (! mDebugCamera.is_empty())
+		{
+			do_debug_static_render();
+		}
+#endif //RN_DEBUG
+	}
+	PRINT_DEBUG("'" << get_owner_node_path() << "' refresh_geometry : "
+			<< count << " tiles");
+	//
+	return count;
+}
+
 /**
  * Builds a RNNavMesh's tile (TILE).
  * Should be called after RNNavMesh setup.
@@ -1915,7 +2244,56 @@ int RNNavMesh::add_obstacle(NodePath objectNP)
 	CONTINUE_IF_ELSE_R(mNavMeshType, RN_ERROR)
 
 	// return the result of adding obstacle to recast
-	return do_add_obstacle_to_recast(objectNP, mObstacles.size() - 1);
+	return do_add_obstacle_to_recast(mObstacles.size() - 1);
+}
+
+/**
+ * Adds obstacles as NodePaths (OBSTACLE), as a batch: each tile touched by
+ * them is rebuilt only once.
+ * Returns a negative number on error: then no obstacle is added.
+ */
+int RNNavMesh::add_obstacles(const ValueList<NodePath>& objectNPs)
+{
+	// continue if we have OBSTACLE nav mesh type and mReferenceNP is not empty
+	CONTINUE_IF_ELSE_R(
+			(mNavMeshTypeEnum == OBSTACLE) && (! mReferenceNP.is_empty()),
+			RN_ERROR)
+
+	// return error if an objectNP is empty, already present or repeated
+	pset<PandaNode*> objectNodes;
+	pvector<Obstacle>::const_iterator iterO;
+	for (iterO = mObstacles.begin(); iterO < mObstacles.end(); ++iterO)
+	{
+		objectNodes.insert((*iterO).get_second().node());
+	}
+	for (int i = 0; i < objectNPs.size(); ++i)
+	{
+		NodePath objectNP = objectNPs[i];
+		CONTINUE_IF_ELSE_R(
+				(!objectNP.is_empty())
+						&& objectNodes.insert(objectNP.node()).second,
+				RN_ERROR)
+	}
+
+	// insert obstacles with invalid ref: later will be corrected
+	const int first = mObstacles.size();
+	RNObstacleSettings settings;
+	settings.set_ref(RN_ERROR);
+	for (int i = 0; i < objectNPs.size(); ++i)
+	{
+		mObstacles.push_back(Obstacle(settings, objectNPs[i]));
+	}
+
+	// return if nav mesh has not been already setup: they will be added then
+	CONTINUE_IF_ELSE_R(mNavMeshType, RN_SUCCESS)
+
+	// add obstacles to recast, or drop them all
+	if (do_add_obstacles_to_recast(first, objectNPs.size()) < 0)
+	{
+		mObstacles.erase(mObstacles.begin() + first, mObstacles.end());
+		return RN_ERROR;
+	}
+	return RN_SUCCESS;
 }
 
 /**
@@ -1923,65 +2301,116 @@ int RNNavMesh::add_obstacle(NodePath objectNP)
  * Returns a negative number on error.
  * \note Internal use only.
  */
-int RNNavMesh::do_add_obstacle_to_recast(NodePath& objectNP, int index,
+int RNNavMesh::do_add_obstacle_to_recast(int index, bool buildFromBam)
+{
+	// continue if obstacle addition to recast is successful
+	CONTINUE_IF_ELSE_R(
+			do_add_obstacles_to_recast(index, 1, buildFromBam) == RN_SUCCESS,
+			RN_ERROR)
+	// obstacle added: return its ref
+	return (int) mObstacles[index].first().get_ref();
+}
+
+/**
+ * Adds the obstacles [first, first + count) to the underlying nav mesh, as a
+ * batch: the tiles touched by several obstacles are rebuilt only once.
+ * Returns a negative number on error: then no obstacle is added.
+ * \note Internal use only.
+ */
+int RNNavMesh::do_add_obstacles_to_recast(int first, int count,
 		bool buildFromBam)
 {
-	//get obstacle dimensions
-	LVecBase3f modelDims;
-	LVector3f modelDeltaCenter;
-	float modelRadius;
-	if (!buildFromBam)
-	{
-		//compute new obstacle dimensions
-		modelRadius =
-				RNNavMeshManager::get_global_ptr()->get_bounding_dimensions(
-						objectNP, modelDims, modelDeltaCenter);
-	}
-	else
+	CONTINUE_IF_ELSE_R(count > 0, RN_SUCCESS)
+
+	//get obstacles' dimensions and positions wrt reference node path
+	pvector<LVecBase3f> modelDims(count);
+	pvector<float> modelRadius(count), modelHeight(count), recastPos(count * 3);
+	for (int i = 0; i < count; ++i)
 	{
-		modelRadius = mObstacles[index].first().get_radius();
-		modelDims = mObstacles[index].first().get_dims();
+		Obstacle& obstacle = mObstacles[first + i];
+		if (!buildFromBam)
+		{
+			//compute new obstacle dimensions
+			LVector3f modelDeltaCenter;
+			modelRadius[i] =
+					RNNavMeshManager::get_global_ptr()->get_bounding_dimensions(
+							obstacle.second(), modelDims[i], modelDeltaCenter);
+		}
+		else
+		{
+			modelRadius[i] = obstacle.first().get_radius();
+			modelDims[i] = obstacle.first().get_dims();
+		}
+		modelHeight[i] = modelDims[i].get_z();
+		rnsup::LVecBase3fToRecast(obstacle.second().get_pos(mReferenceNP),
+				&recastPos[i * 3]);
 	}
 
-	//the obstacle is reparented to the RNNavMesh's reference node path
-	objectNP.wrt_reparent_to(mReferenceNP);
-
-	//calculate pos wrt reference node path
-	LPoint3f pos = objectNP.get_pos();
-	//add detour obstacle
-	dtObstacleRef obstacleRef;
-	float recastPos[3];
-	rnsup::LVecBase3fToRecast(pos, recastPos);
+	//add detour obstacles
+	pvector<dtObstacleRef> obstacleRefs(count);
 	dtTileCache* tileCache =
 			static_cast<rnsup::NavMeshType_Obstacle*>(mNavMeshType)->getTileCache();
-	// continue if obstacle addition to tile cache is successful
+	// continue if obstacles addition to tile cache is successful
 	CONTINUE_IF_ELSE_R(
-			tileCache->addObstacle(recastPos, modelRadius, modelDims.get_z(),
-					&obstacleRef) == DT_SUCCESS, RN_ERROR)
+			tileCache->addObstacles(&recastPos[0], &modelRadius[0],
+					&modelHeight[0], count, &obstacleRefs[0]) == DT_SUCCESS,
+			RN_ERROR)
 
-	//update tiles cache: repeat for all the tiles touched
-	for (int c = 0; c < DT_MAX_TOUCHED_TILES; ++c)
+	//update tiles cache: each touched tile is rebuilt once
+	if (do_update_tile_cache() != RN_SUCCESS)
 	{
-		tileCache->update(0, mNavMeshType->getNavMesh());
+		//drop the obstacles: they are removed by a later update
+		tileCache->removeObstacles(&obstacleRefs[0], count);
+		return RN_ERROR;
 	}
-	//correct to the obstacle settings
-	if (!buildFromBam)
+
+	for (int i = 0; i < count; ++i)
 	{
-		//update new obstacle dimensions
-		mObstacles[index].first().set_radius(modelRadius);
-		mObstacles[index].first().set_dims(modelDims);
+		Obstacle& obstacle = mObstacles[first + i];
+		//the obstacle is reparented to the RNNavMesh's reference node path
+		obstacle.second().wrt_reparent_to(mReferenceNP);
+		//correct to the obstacle settings
+		if (!buildFromBam)
+		{
+			//update new obstacle dimensions
+			obstacle.first().set_radius(modelRadius[i]);
+			obstacle.first().set_dims(modelDims[i]);
+		}
+		obstacle.first().set_ref(obstacleRefs[i]);
+		PRINT_DEBUG(
+				"'" << get_owner_node_path() << "' add_obstacle: '" << obstacle.second() << "' at pos: " << obstacle.second().get_pos());
 	}
-	mObstacles[index].first().set_ref(obstacleRef);
-	PRINT_DEBUG(
-			"'" << get_owner_node_path() << "' add_obstacle: '" << objectNP << "' at pos: " << pos);
 #ifdef RN_DEBUG
 	if (!mDebugCamera.is_empty())
 	{
 		do_debug_static_render();
 	}
 #endif //RN_DEBUG
-	// obstacle added: return the last index
-	return (int) obstacleRef;
+	return RN_SUCCESS;
+}
+
+/**
+ * Updates the tile cache until the pending obstacle requests are processed:
+ * all the pending requests are processed together, so each touched tile is
+ * rebuilt once.
+ * Returns a negative number on error (e.g. out of memory): then the requests
+ * not yet processed stay pending.
+ * \note Internal use only.
+ */
+int RNNavMesh::do_update_tile_cache()
+{
+	dtTileCache* tileCache =
+			static_cast<rnsup::NavMeshType_Obstacle*>(mNavMeshType)->getTileCache();
+	bool upToDate = false;
+	while (!upToDate)
+	{
+		// continue if the tile cache update is successful
+		CONTINUE_IF_ELSE_R(
+				!dtStatusFailed(
+						tileCache->update(0, mNavMeshType->getNavMesh(),
+								&upToDate)), RN_ERROR)
+	}
+	return RN_SUCCESS;
 }
 
 /**
@@ -2019,6 +2448,57 @@ int RNNavMesh::remove_obstacle(NodePath objectNP)
 	return do_remove_obstacle_from_recast(objectNP, obstacleRef);
 }
 
+/**
+ * Removes obstacles as NodePaths (OBSTACLE), as a batch: each tile touched by
+ * them is rebuilt only once.
+ * Returns a negative number on error: then no obstacle is removed.
+ */
+int RNNavMesh::remove_obstacles(const ValueList<NodePath>& objectNPs)
+{
+	// continue if we have OBSTACLE nav mesh type and mReferenceNP is not empty
+	CONTINUE_IF_ELSE_R(
+			(mNavMeshTypeEnum == OBSTACLE) && (! mReferenceNP.is_empty()),
+			RN_ERROR)
+
+	// return error if an objectNP is not yet present or repeated
+	pset<PandaNode*> objectNodes;
+	for (int i = 0; i < objectNPs.size(); ++i)
+	{
+		NodePath objectNP = objectNPs[i];
+		CONTINUE_IF_ELSE_R(
+				(!objectNP.is_empty())
+						&& objectNodes.insert(objectNP.node()).second,
+				RN_ERROR)
+	}
+	pvector<dtObstacleRef> obstacleRefs;
+	pvector<Obstacle>::iterator iterO;
+	for (iterO = mObstacles.begin(); iterO < mObstacles.end(); ++iterO)
+	{
+		if (objectNodes.count((*iterO).second().node()))
+		{
+			obstacleRefs.push_back((*iterO).first().get_ref());
+		}
+	}
+	CONTINUE_IF_ELSE_R(obstacleRefs.size() == objectNodes.size(), RN_ERROR)
+
+	// remove obstacles: refs are saved for removing from recast
+	for (iterO = mObstacles.begin(); iterO < mObstacles.end();)
+	{
+		if (objectNodes.count((*iterO).second().node()))
+		{
+			iterO = mObstacles.erase(iterO);
+			continue;
+		}
+		++iterO;
+	}
+
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, RN_ERROR)
+
+	// return the result of removing obstacles from recast
+	return do_remove_obstacles_from_recast(obstacleRefs);
+}
+
 /**
  * Removes obstacle from underlying nav mesh.
  * Returns a negative number on error.
@@ -2027,35 +2507,52 @@ int RNNavMesh::remove_obstacle(NodePath objectNP)
 int RNNavMesh::do_remove_obstacle_from_recast(NodePath& objectNP,
 		int obstacleRef)
 {
-	//remove recast obstacle
-	dtTileCache* tileCache =
-			static_cast<rnsup::NavMeshType_Obstacle*>(mNavMeshType)->getTileCache();
-	// continue if obstacle removal from tile cache is successful
-	CONTINUE_IF_ELSE_R(tileCache->removeObstacle(obstacleRef) == DT_SUCCESS, RN_ERROR)
-
-	//update tiles cache: repeat for all the tiles touched
-	for (int c = 0; c < DT_MAX_TOUCHED_TILES; ++c)
-	{
-		tileCache->update(0, mNavMeshType->getNavMesh());
-	}
-	//index and remove from obstacle from the list
+	// continue if obstacle removal from recast is successful
+	CONTINUE_IF_ELSE_R(
+			do_remove_obstacles_from_recast(
+					pvector<dtObstacleRef>(1, (dtObstacleRef) obstacleRef))
+					== RN_SUCCESS, RN_ERROR)
 	PRINT_DEBUG(
 			"'" << get_owner_node_path() << "' remove_obstacle: '" << objectNP << "'");
-#ifdef RN_DEBUG
-	if (! mDebugCamera.is_empty())
-	{
-		do_debug_static_render();
-	}
-#endif //RN_DEBUG
 	// obstacle removed
 	return (int) obstacleRef;
 }
 
 /**
- * Returns the NodePath of the obstacle with the specified unique reference (>0).
- * Return an empty NodePath with the ET_fail error type set on error.
+ * Removes obstacles from underlying nav mesh, as a batch: the tiles touched
+ * by several obstacles are rebuilt only once.
+ * Returns a negative number on error.
+ * \note Internal use only.
  */
-NodePath RNNavMesh::get_obstacle_by_ref(int ref) const
+int RNNavMesh::do_remove_obstacles_from_recast(
+		const pvector<dtObstacleRef>& obstacleRefs)
+{
+	CONTINUE_IF_ELSE_R(!obstacleRefs.empty(), RN_SUCCESS)
+
+	//remove recast obstacles
+	dtTileCache* tileCache =
+			static_cast<rnsup::NavMeshType_Obstacle*>(mNavMeshType)->getTileCache();
+	// continue if obstacles removal from tile cache is successful
+	CONTINUE_IF_ELSE_R(
+			tileCache->removeObstacles(&obstacleRefs[0], obstacleRefs.size())
+					== DT_SUCCESS, RN_ERROR)
+
+	//update tiles cache: each touched tile is rebuilt once
+	CONTINUE_IF_ELSE_R(do_update_tile_cache() == RN_SUCCESS, RN_ERROR)
+#ifdef RN_DEBUG
+	if (! mDebugCamera.is_empty())
+	{
+		do_debug_static_render();
+	}
+#endif //RN_DEBUG
+	return RN_SUCCESS;
+}
+
+/**
+ * Returns the NodePath of the obstacle with the specified unique reference (>0).
+ * Return an empty NodePath with the ET_fail error type set on error.
+ */
+NodePath RNNavMesh::get_obstacle_by_ref(int ref) const
 {
 	NodePath obstacleNP = NodePath::fail();
 	CONTINUE_IF_ELSE_R((mNavMeshTypeEnum == OBSTACLE) && (ref > 0),
@@ -2082,17 +2579,725 @@ int RNNavMesh::remove_all_obstacles()
 {
 	CONTINUE_IF_ELSE_R(mNavMeshTypeEnum == OBSTACLE, RN_ERROR)
 
-	PTA(Obstacle)::iterator iter = mObstacles.begin();
-	while (iter != mObstacles.end())
+	//remove them as a batch
+	ValueList<NodePath> objectNPs;
+	PTA(Obstacle)::const_iterator iter;
+	for (iter = mObstacles.begin(); iter != mObstacles.end(); ++iter)
+	{
+		objectNPs.add_value(iter->get_second());
+	}
+	remove_obstacles(objectNPs);
+
+	//
+	return RN_SUCCESS;
+}
+
+/**
+ * Writes, for each available tile cache compressor, the compressed size and
+ * the (de)compression times of the current tile cache layers to the indicated
+ * output stream. Layers are decompressed the given number of iterations.
+ * The compressor in use is marked with '*' (see "tile_cache_compressor"
+ * parameter).
+ * Should be called after RNNavMesh setup (OBSTACLE type only).
+ */
+void RNNavMesh::output_compressor_benchmark(ostream &out, int iterations) const
+{
+	CONTINUE_IF_ELSE_V(mNavMeshTypeEnum == OBSTACLE)
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_V(mNavMeshType)
+
+	dtTileCache* tileCache =
+			static_cast<rnsup::NavMeshType_Obstacle*>(mNavMeshType)->getTileCache();
+	for (int type = 0; type < rnsup::NAVMESH_COMPRESSOR_NUM; ++type)
+	{
+		rnsup::TileCacheCompressorReport report;
+		bool result = rnsup::benchmarkTileCacheCompressor(tileCache, type,
+				iterations, report);
+		out << (type == mNavMeshTileSettings.get_compressorType() ? "*" : " ")
+				<< rnsup::getTileCacheCompressorName(type) << ": ";
+		if (!result)
+		{
+			out << "error" << endl;
+			continue;
+		}
+		out << "layers: " << report.layerCount << " raw: " << report.rawSize
+				<< " compressed: " << report.compressedSize << " ratio: "
+				<< (report.compressedSize > 0 ?
+						(float) report.rawSize / (float) report.compressedSize :
+						0.0f) << " compress(us): " << report.compressTimeUsec
+				<< " decompress(us): " << report.decompressTimeUsec << endl;
+	}
+}
+
+/**
+ * Writes the statistics of the scratch memory used by tile cache builds to
+ * the indicated output stream. Each building thread has its own arena.
+ * Should be called after RNNavMesh setup (OBSTACLE type only).
+ */
+void RNNavMesh::output_scratch_stats(ostream &out) const
+{
+	CONTINUE_IF_ELSE_V(mNavMeshTypeEnum == OBSTACLE)
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_V(mNavMeshType)
+
+	rnsup::NavMeshType_Obstacle::ScratchStats stats;
+	static_cast<rnsup::NavMeshType_Obstacle*>(mNavMeshType)->getScratchStats(
+			stats);
+	out << "peakUsage: " << stats.peakUsage << endl;
+	out << "reservedSize: " << stats.reservedSize << endl;
+	out << "arenaCount: " << stats.arenaCount << endl;
+	out << "growCount: " << stats.growCount << endl;
+}
+
+/**
+ * Adds a flow field with the given goals: it gives, for every point of the
+ * nav mesh, the cost to reach the nearest goal and the direction to follow,
+ * so that any number of RNCrowdAgents can head to the goals without path
+ * finding (see RNCrowdAgent::set_move_flow_field()).
+ * A flow field with the same goals is shared. Flow fields are repaired on
+ * update when tiles or obstacles change.
+ * Should be called after RNNavMesh setup.
+ * Returns the flow field's unique reference, or a negative number on error.
+ */
+int RNNavMesh::add_flow_field(const ValueList<LPoint3f>& goals)
+{
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType && (goals.size() > 0), RN_ERROR)
+
+	// check if a flow field with the same goals already exists
+	pmap<int, FlowField>::const_iterator iter;
+	for (iter = mFlowFields.begin(); iter != mFlowFields.end(); ++iter)
 	{
-		remove_obstacle(iter->second());
-		iter = mObstacles.begin();
+		if (iter->second.get_first() == goals)
+		{
+			return iter->first;
+		}
 	}
 
+	dtFlowField* field = dtAllocFlowField();
+	CONTINUE_IF_ELSE_R(field, RN_ERROR)
+
+	FlowField flowField(goals, field);
+	if (do_build_flow_field(flowField) != RN_SUCCESS)
+	{
+		dtFreeFlowField(field);
+		return RN_ERROR;
+	}
+	int ref = unique_ref();
+	mFlowFields[ref] = flowField;
+	//
+	return ref;
+}
+
+/**
+ * Builds a flow field from scratch.
+ * \note Internal use only.
+ */
+int RNNavMesh::do_build_flow_field(const FlowField& flowField)
+{
+	dtFlowField* field = flowField.get_second();
+	dtNavMesh* navMesh = mNavMeshType->getNavMesh();
+	if (field->getNavMesh() != navMesh)
+	{
+		CONTINUE_IF_ELSE_R(dtStatusSucceed(field->init(navMesh)), RN_ERROR)
+	}
+
+	//find goal polygons
+	ValueList<LPoint3f> goals = flowField.get_first();
+	int count = goals.size();
+	pvector<float> centers(count * 3), goalPos(count * 3);
+	pvector<dtPolyRef> goalRefs(count);
+	for (int i = 0; i < count; ++i)
+	{
+		rnsup::LVecBase3fToRecast(goals[i], &centers[i * 3]);
+	}
+	dtCrowd* crowd = static_cast<rnsup::CrowdTool*>(mNavMeshType->getTool())->
+			getState()->getCrowd();
+	const dtQueryFilter* filter = crowd->getFilter(0);
+	mNavMeshType->getNavMeshQuery()->findNearestPolys(&centers[0], count,
+			crowd->getQueryExtents(), filter, &goalRefs[0], &goalPos[0]);
+	//build
+	return dtStatusSucceed(
+			field->build(&goalRefs[0], &goalPos[0], count, filter)) ?
+			RN_SUCCESS : RN_ERROR;
+}
+
+/**
+ * Finds the nav mesh polygon nearest to a point, and the nearest point on it.
+ * \note Internal use only.
+ */
+bool RNNavMesh::do_find_nearest_poly(const LPoint3f& pos, dtPolyRef* ref,
+		float* nearestPos) const
+{
+	dtCrowd* crowd = static_cast<rnsup::CrowdTool*>(mNavMeshType->getTool())->
+			getState()->getCrowd();
+	float center[3];
+	rnsup::LVecBase3fToRecast(pos, center);
+	*ref = 0;
+	mNavMeshType->getNavMeshQuery()->findNearestPoly(center,
+			crowd->getQueryExtents(), crowd->getFilter(0), ref, nearestPos);
+	return *ref != 0;
+}
+
+/**
+ * Removes a flow field given its reference: the RNCrowdAgents following it
+ * stop.
+ * Should be called after RNNavMesh setup.
+ * Returns a negative number on error.
+ */
+int RNNavMesh::remove_flow_field(int ref)
+{
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, RN_ERROR)
+
+	pmap<int, FlowField>::iterator iter = mFlowFields.find(ref);
+	CONTINUE_IF_ELSE_R(iter != mFlowFields.end(), RN_ERROR)
+
+	// stop the crowd agents following the flow field
+	dtCrowd* crowd = static_cast<rnsup::CrowdTool*>(mNavMeshType->getTool())->
+			getState()->getCrowd();
+	pvector<PT(RNCrowdAgent)>::iterator iterC;
+	for (iterC = mCrowdAgents.begin(); iterC != mCrowdAgents.end(); ++iterC)
+	{
+		if ((*iterC)->mMoveFlowField != ref)
+		{
+			continue;
+		}
+		if ((*iterC)->mAgentIdx != -1)
+		{
+			crowd->resetMoveTarget((*iterC)->mAgentIdx);
+		}
+		(*iterC)->mMoveFlowField = RN_ERROR;
+	}
+	dtFreeFlowField(iter->second.get_second());
+	mFlowFields.erase(iter);
 	//
 	return RN_SUCCESS;
 }
 
+/**
+ * Returns the goals of a flow field given its reference.
+ * Should be called after RNNavMesh setup.
+ * Returns an empty list on error.
+ */
+ValueList<LPoint3f> RNNavMesh::get_flow_field_goals(int ref) const
+{
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, ValueList<LPoint3f>())
+
+	pmap<int, FlowField>::const_iterator iter = mFlowFields.find(ref);
+	CONTINUE_IF_ELSE_R(iter != mFlowFields.end(), ValueList<LPoint3f>())
+
+	return iter->second.get_first();
+}
+
+/**
+ * Returns the cost to reach the nearest goal of a flow field, given its
+ * reference, from a point.
+ * Should be called after RNNavMesh setup.
+ * Returns a negative number on error, or if no goal can be reached.
+ */
+float RNNavMesh::get_flow_field_cost(int ref, const LPoint3f& pos) const
+{
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, RN_ERROR)
+
+	pmap<int, FlowField>::const_iterator iter = mFlowFields.find(ref);
+	CONTINUE_IF_ELSE_R(iter != mFlowFields.end(), RN_ERROR)
+
+	dtPolyRef polyRef;
+	float nearestPos[3], cost;
+	if (!do_find_nearest_poly(pos, &polyRef, nearestPos)
+			|| !iter->second.get_second()->getCost(polyRef, &cost))
+	{
+		return RN_ERROR;
+	}
+	return cost;
+}
+
+/**
+ * Returns the (normalized) direction to follow from a point, to reach the
+ * nearest goal of a flow field given its reference: it points to the next
+ * polygon of the nav mesh toward the goal, or to the goal itself.
+ * Should be called after RNNavMesh setup.
+ * Returns LVector3f::zero() on error, or if no goal can be reached.
+ */
+LVector3f RNNavMesh::get_flow_field_direction(int ref, const LPoint3f& pos) const
+{
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, LVector3f::zero())
+
+	pmap<int, FlowField>::const_iterator iter = mFlowFields.find(ref);
+	CONTINUE_IF_ELSE_R(iter != mFlowFields.end(), LVector3f::zero())
+
+	dtPolyRef polyRef;
+	float nearestPos[3], targetPos[3];
+	if (!do_find_nearest_poly(pos, &polyRef, nearestPos)
+			|| !iter->second.get_second()->getTargetPos(polyRef, targetPos))
+	{
+		return LVector3f::zero();
+	}
+	LVector3f direction = rnsup::RecastToLVecBase3f(targetPos)
+			- rnsup::RecastToLVecBase3f(nearestPos);
+	direction.normalize();
+	return direction;
+}
+
+/**
+ * Takes an in-memory snapshot of the runtime state of this RNNavMesh: nav
+ * mesh tiles (with polygon flags and areas), obstacles (OBSTACLE type only)
+ * and RNCrowdAgents' states and corridors. The snapshot can be restored
+ * without any rebuild (see restore_snapshot()).
+ * Should be called after RNNavMesh setup.
+ * Returns the snapshot's unique reference, or a negative number on error.
+ */
+int RNNavMesh::take_snapshot()
+{
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, RN_ERROR)
+
+	Snapshot snapshot;
+	//nav mesh tiles
+	const dtNavMesh* navMesh = mNavMeshType->getNavMesh();
+	snapshot.mNavMeshParams = *navMesh->getParams();
+	for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh->getTile(i);
+		if (!(tile->header && tile->data))
+		{
+			continue;
+		}
+		snapshot.mTileRefs.push_back(navMesh->getTileRef(tile));
+		snapshot.mTiles.push_back(
+				pvector<unsigned char>(tile->data, tile->data + tile->dataSize));
+	}
+	//obstacles
+	if (mNavMeshTypeEnum == OBSTACLE)
+	{
+		dtTileCache* tileCache = get_recast_tile_cache();
+		snapshot.mObstacleState.resize(tileCache->getObstacleStateSize());
+		CONTINUE_IF_ELSE_R(
+				dtStatusSucceed(tileCache->storeObstacleState(
+						&snapshot.mObstacleState[0],
+						(int)snapshot.mObstacleState.size())), RN_ERROR)
+		snapshot.mObstacles = mObstacles;
+	}
+	//crowd agents
+	dtCrowd* crowd = static_cast<rnsup::CrowdTool*>(mNavMeshType->getTool())->
+			getState()->getCrowd();
+	pvector<PT(RNCrowdAgent)>::const_iterator iter;
+	for (iter = mCrowdAgents.begin(); iter != mCrowdAgents.end(); ++iter)
+	{
+		CrowdAgentSnapshot agentSnapshot;
+		agentSnapshot.mCrowdAgent = *iter;
+		agentSnapshot.mAgentIdx = (*iter)->mAgentIdx;
+		agentSnapshot.mAgentParams = (*iter)->mAgentParams;
+		agentSnapshot.mMoveTarget = (*iter)->mMoveTarget;
+		agentSnapshot.mMoveVelocity = (*iter)->mMoveVelocity;
+		agentSnapshot.mMoveFlowField = (*iter)->mMoveFlowField;
+		agentSnapshot.mPathPriority = (*iter)->mPathPriority;
+		agentSnapshot.mState.resize(crowd->getAgentStateSize());
+		CONTINUE_IF_ELSE_R(
+				dtStatusSucceed(crowd->storeAgentState((*iter)->mAgentIdx,
+						&agentSnapshot.mState[0],
+						(int)agentSnapshot.mState.size())), RN_ERROR)
+		snapshot.mCrowdAgents.push_back(agentSnapshot);
+	}
+
+	int ref = unique_ref();
+	mSnapshots[ref] = snapshot;
+	return ref;
+}
+
+/**
+ * Restores a snapshot of the runtime state of this RNNavMesh (see
+ * take_snapshot()). Only the tiles changed since the snapshot are replaced, so
+ * no Recast rebuild is done. RNCrowdAgents added after the snapshot keep their
+ * state, while the removed ones are not added again. Flow fields are rebuilt.
+ * 
+ * \note Convex volumes and off mesh connections are not part of the
+ * snapshot: the nav mesh must not have been set up again since the snapshot.
+ * Should be called after RNNavMesh setup.
+ * Returns a negative number on error.
+ */
+int RNNavMesh::restore_snapshot(int ref)
+{
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, RN_ERROR)
+
+	pmap<int, Snapshot>::const_iterator iterS = mSnapshots.find(ref);
+	CONTINUE_IF_ELSE_R(iterS != mSnapshots.end(), RN_ERROR)
+	const Snapshot& snapshot = iterS->second;
+
+	//continue if the nav mesh layout is the same
+	dtNavMesh* navMesh = mNavMeshType->getNavMesh();
+	CONTINUE_IF_ELSE_R(
+			memcmp(navMesh->getParams(), &snapshot.mNavMeshParams,
+					sizeof(dtNavMeshParams)) == 0, RN_ERROR)
+
+	//remove the tiles which changed since the snapshot
+	const dtNavMesh* constNavMesh = navMesh;
+	pvector<bool> keptTiles(snapshot.mTileRefs.size(), false);
+	for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = constNavMesh->getTile(i);
+		if (!(tile->header && tile->data))
+		{
+			continue;
+		}
+		dtTileRef tileRef = navMesh->getTileRef(tile);
+		pvector<dtTileRef>::const_iterator iterT = find(
+				snapshot.mTileRefs.begin(), snapshot.mTileRefs.end(), tileRef);
+		if (iterT != snapshot.mTileRefs.end())
+		{
+			const pvector<unsigned char>& data =
+					snapshot.mTiles[iterT - snapshot.mTileRefs.begin()];
+			if (((int)data.size() == tile->dataSize)
+					&& (memcmp(&data[0], tile->data, tile->dataSize) == 0))
+			{
+				keptTiles[iterT - snapshot.mTileRefs.begin()] = true;
+				continue;
+			}
+		}
+		navMesh->removeTile(tileRef, NULL, NULL);
+	}
+	//add back the snapshot tiles with their references
+	for (int i = 0; i < (int)snapshot.mTileRefs.size(); ++i)
+	{
+		if (keptTiles[i])
+		{
+			continue;
+		}
+		int dataSize = (int)snapshot.mTiles[i].size();
+		unsigned char* data = (unsigned char*) dtAlloc(dataSize,
+				DT_ALLOC_PERM);
+		CONTINUE_IF_ELSE_R(data, RN_ERROR)
+		memcpy(data, &snapshot.mTiles[i][0], dataSize);
+		if (dtStatusFailed(
+				navMesh->addTile(data, dataSize, DT_TILE_FREE_DATA,
+						snapshot.mTileRefs[i], NULL)))
+		{
+			dtFree(data);
+			return RN_ERROR;
+		}
+	}
+
+	//obstacles
+	if (mNavMeshTypeEnum == OBSTACLE)
+	{
+		CONTINUE_IF_ELSE_R(
+				dtStatusSucceed(get_recast_tile_cache()->restoreObstacleState(
+						&snapshot.mObstacleState[0],
+						(int)snapshot.mObstacleState.size())), RN_ERROR)
+		mObstacles = snapshot.mObstacles;
+	}
+
+	//flow fields
+	pmap<int, FlowField>::iterator iterF;
+	for (iterF = mFlowFields.begin(); iterF != mFlowFields.end(); ++iterF)
+	{
+		do_build_flow_field(iterF->second);
+	}
+
+	//crowd agents
+	dtCrowd* crowd = static_cast<rnsup::CrowdTool*>(mNavMeshType->getTool())->
+			getState()->getCrowd();
+	pvector<CrowdAgentSnapshot>::const_iterator iterA;
+	for (iterA = snapshot.mCrowdAgents.begin();
+			iterA != snapshot.mCrowdAgents.end(); ++iterA)
+	{
+		PT(RNCrowdAgent)crowdAgent = iterA->mCrowdAgent;
+		//skip RNCrowdAgents removed or added again since the snapshot
+		if ((crowdAgent->mNavMesh != this)
+				|| (crowdAgent->mAgentIdx != iterA->mAgentIdx))
+		{
+			continue;
+		}
+		if (dtStatusFailed(
+				crowd->restoreAgentState(crowdAgent->mAgentIdx,
+						&iterA->mState[0], (int)iterA->mState.size())))
+		{
+			continue;
+		}
+		crowdAgent->mAgentParams = iterA->mAgentParams;
+		crowdAgent->mMoveTarget = iterA->mMoveTarget;
+		crowdAgent->mMoveVelocity = iterA->mMoveVelocity;
+		crowdAgent->mMoveFlowField = iterA->mMoveFlowField;
+		crowdAgent->mPathPriority = iterA->mPathPriority;
+		//the followed flow field could have been removed
+		if (crowd->getAgent(crowdAgent->mAgentIdx)->targetState
+				== DT_CROWDAGENT_TARGET_FLOW_FIELD)
+		{
+			pmap<int, FlowField>::const_iterator iterFF = mFlowFields.find(
+					crowdAgent->mMoveFlowField);
+			if (iterFF != mFlowFields.end())
+			{
+				crowd->requestMoveFlowField(crowdAgent->mAgentIdx,
+						iterFF->second.get_second());
+			}
+			else
+			{
+				crowd->resetMoveTarget(crowdAgent->mAgentIdx);
+				crowdAgent->mMoveFlowField = RN_ERROR;
+			}
+		}
+		//crowd groups could have changed since the snapshot
+		pmap<int, CrowdGroup>::const_iterator iterG = mCrowdGroups.find(
+				crowdAgent->mMoveGroup);
+		if (iterG != mCrowdGroups.end())
+		{
+			const CrowdGroup& group = iterG->second;
+			do_set_crowd_agent_follow(group,
+					find(group.mMembers.begin(), group.mMembers.end(),
+							crowdAgent) - group.mMembers.begin());
+		}
+		else if (crowd->getAgent(crowdAgent->mAgentIdx)->targetState
+				== DT_CROWDAGENT_TARGET_FOLLOW)
+		{
+			crowd->resetMoveTarget(crowdAgent->mAgentIdx);
+		}
+		//update the position right now
+		crowdAgent->mThisNP.set_pos(
+				rnsup::RecastToLVecBase3f(
+						crowd->getAgent(crowdAgent->mAgentIdx)->npos));
+	}
+#ifdef RN_DEBUG
+	if (!mDebugCamera.is_empty())
+	{
+		do_debug_static_render();
+	}
+#endif //RN_DEBUG
+	//
+	return RN_SUCCESS;
+}
+
+/**
+ * Removes a snapshot (see take_snapshot()).
+ * Returns a negative number on error.
+ */
+int RNNavMesh::remove_snapshot(int ref)
+{
+	CONTINUE_IF_ELSE_R(mSnapshots.erase(ref) > 0, RN_ERROR)
+
+	return RN_SUCCESS;
+}
+
+/**
+ * Adds a group of RNCrowdAgents (already added to this RNNavMesh), moving in
+ * formation behind a leader: only the leader requests paths, while each
+ * member follows a slot, given by an offset relative to the leader's position
+ * and heading (x: right, y: forward, z: unused), with local steering.
+ * If offsets don't match the members, these are placed in rows behind the
+ * leader.
+ * RNCrowdAgents which are already leaders or members of a group are skipped.
+ * Setting a move target, velocity or flow field of a member makes it leave the
+ * group.
+ * Should be called after RNNavMesh setup.
+ * Returns the crowd group's reference, or a negative number on error.
+ */
+int RNNavMesh::add_crowd_group(NodePath leaderNP,
+		const NodePathCollection& memberNPs,
+		const ValueList<LVector3f>& offsets)
+{
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, RN_ERROR)
+	CONTINUE_IF_ELSE_R(
+			(!leaderNP.is_empty())
+					&& (leaderNP.node()->is_of_type(
+							RNCrowdAgent::get_class_type())), RN_ERROR)
+
+	CrowdGroup group;
+	group.mLeader = DCAST(RNCrowdAgent, leaderNP.node());
+	CONTINUE_IF_ELSE_R(
+			(group.mLeader->mNavMesh == this)
+					&& (group.mLeader->mMoveGroup == RN_ERROR), RN_ERROR)
+
+	//collect the RNCrowdAgents of this nav mesh, not already in a group
+	pvector<int> memberIndexes;
+	for (int i = 0; i < memberNPs.get_num_paths(); ++i)
+	{
+		NodePath memberNP = memberNPs.get_path(i);
+		if (memberNP.is_empty()
+				|| (!memberNP.node()->is_of_type(
+						RNCrowdAgent::get_class_type())))
+		{
+			continue;
+		}
+		PT(RNCrowdAgent)member = DCAST(RNCrowdAgent, memberNP.node());
+		if ((member->mNavMesh != this) || (member->mMoveGroup != RN_ERROR)
+				|| (member == group.mLeader)
+				|| (find(group.mMembers.begin(), group.mMembers.end(), member)
+						!= group.mMembers.end()))
+		{
+			continue;
+		}
+		bool isLeader = false;
+		pmap<int, CrowdGroup>::const_iterator iterG;
+		for (iterG = mCrowdGroups.begin(); iterG != mCrowdGroups.end(); ++iterG)
+		{
+			if (iterG->second.mLeader == member)
+			{
+				isLeader = true;
+				break;
+			}
+		}
+		if (isLeader)
+		{
+			continue;
+		}
+		group.mMembers.push_back(member);
+		memberIndexes.push_back(i);
+	}
+	CONTINUE_IF_ELSE_R(!group.mMembers.empty(), RN_ERROR)
+
+	//set the formation offsets
+	int numMembers = (int)group.mMembers.size();
+	if (offsets.size() == memberNPs.get_num_paths())
+	{
+		for (int i = 0; i < numMembers; ++i)
+		{
+			group.mOffsets.push_back(offsets[memberIndexes[i]]);
+		}
+	}
+	else
+	{
+		int columns = (int) ceil(sqrt((float) numMembers));
+		float spacing = group.mLeader->mAgentParams.get_radius() * 3.0;
+		for (int i = 0; i < numMembers; ++i)
+		{
+			int column = i % columns, row = i / columns;
+			group.mOffsets.push_back(
+					LVector3f((column - (columns - 1) * 0.5) * spacing,
+							-(row + 1) * spacing, 0.0));
+		}
+	}
+
+	//start following the leader
+	int ref = unique_ref();
+	for (int i = 0; i < numMembers; ++i)
+	{
+		group.mMembers[i]->mMoveGroup = ref;
+		do_set_crowd_agent_follow(group, i);
+	}
+	mCrowdGroups[ref] = group;
+	return ref;
+}
+
+/**
+ * Removes a crowd group given its reference: the members stop.
+ * Returns a negative number on error.
+ */
+int RNNavMesh::remove_crowd_group(int ref)
+{
+	pmap<int, CrowdGroup>::iterator iter = mCrowdGroups.find(ref);
+	CONTINUE_IF_ELSE_R(iter != mCrowdGroups.end(), RN_ERROR)
+
+	dtCrowd* crowd = get_recast_crowd();
+	pvector<PT(RNCrowdAgent)>::iterator iterM;
+	for (iterM = iter->second.mMembers.begin();
+			iterM != iter->second.mMembers.end(); ++iterM)
+	{
+		if (crowd && ((*iterM)->mAgentIdx != -1))
+		{
+			crowd->resetMoveTarget((*iterM)->mAgentIdx);
+		}
+		(*iterM)->mMoveGroup = RN_ERROR;
+	}
+	mCrowdGroups.erase(iter);
+	//
+	return RN_SUCCESS;
+}
+
+/**
+ * Sets the move target of a crowd group given its reference, ie of its leader.
+ * Should be called after RNNavMesh setup.
+ * Returns a negative number on error.
+ */
+int RNNavMesh::set_crowd_group_move_target(int ref, const LPoint3f& pos)
+{
+	pmap<int, CrowdGroup>::iterator iter = mCrowdGroups.find(ref);
+	CONTINUE_IF_ELSE_R(iter != mCrowdGroups.end(), RN_ERROR)
+
+	return iter->second.mLeader->set_move_target(pos);
+}
+
+/**
+ * Returns the leader of a crowd group given its reference, or an empty
+ * NodePath on error.
+ */
+NodePath RNNavMesh::get_crowd_group_leader(int ref) const
+{
+	pmap<int, CrowdGroup>::const_iterator iter = mCrowdGroups.find(ref);
+	CONTINUE_IF_ELSE_R(iter != mCrowdGroups.end(), NodePath())
+
+	return NodePath::any_path(iter->second.mLeader);
+}
+
+/**
+ * Returns the members of a crowd group given its reference, empty on error.
+ */
+NodePathCollection RNNavMesh::get_crowd_group_members(int ref) const
+{
+	NodePathCollection memberNPs;
+	pmap<int, CrowdGroup>::const_iterator iter = mCrowdGroups.find(ref);
+	CONTINUE_IF_ELSE_R(iter != mCrowdGroups.end(), memberNPs)
+
+	pvector<PT(RNCrowdAgent)>::const_iterator iterM;
+	for (iterM = iter->second.mMembers.begin();
+			iterM != iter->second.mMembers.end(); ++iterM)
+	{
+		memberNPs.add_path(NodePath::any_path(*iterM));
+	}
+	return memberNPs;
+}
+
+/**
+ * Makes a member of a crowd group follow the leader, if both are added to
+ * recast.
+ * Returns false on error.
+ * \note Internal use only.
+ */
+bool RNNavMesh::do_set_crowd_agent_follow(const CrowdGroup& group, int member)
+{
+	dtCrowd* crowd = get_recast_crowd();
+	PT(RNCrowdAgent)crowdAgent = group.mMembers[member];
+	if ((!crowd) || (group.mLeader->mAgentIdx == -1)
+			|| (crowdAgent->mAgentIdx == -1))
+	{
+		return false;
+	}
+	//(right, forward, unused) to recast (right, unused, forward)
+	const LVector3f& offset = group.mOffsets[member];
+	float recastOffset[3] =
+	{ offset.get_x(), 0.0, offset.get_y() };
+	return crowd->requestMoveFollow(crowdAgent->mAgentIdx,
+			group.mLeader->mAgentIdx, recastOffset);
+}
+
+/**
+ * Removes a RNCrowdAgent from the crowd group it is member of, if any.
+ * \note Internal use only.
+ */
+void RNNavMesh::do_leave_crowd_group(PT(RNCrowdAgent)crowdAgent)
+{
+	pmap<int, CrowdGroup>::iterator iter = mCrowdGroups.find(
+			crowdAgent->mMoveGroup);
+	crowdAgent->mMoveGroup = RN_ERROR;
+	if (iter == mCrowdGroups.end())
+	{
+		return;
+	}
+	CrowdGroup& group = iter->second;
+	pvector<PT(RNCrowdAgent)>::iterator iterM = find(group.mMembers.begin(),
+			group.mMembers.end(), crowdAgent);
+	if (iterM != group.mMembers.end())
+	{
+		group.mOffsets.erase(
+				group.mOffsets.begin() + (iterM - group.mMembers.begin()));
+		group.mMembers.erase(iterM);
+	}
+}
+
 /**
  * Adds a RNCrowdAgent to this RNNavMesh (ie to the underlying dtCrowd
  * management mechanism).
@@ -2111,23 +3316,81 @@ int RNNavMesh::add_crowd_agent(NodePath crowdAgentNP)
 	// continue if crowdAgent doesn't belong to any mesh
 	CONTINUE_IF_ELSE_R(! crowdAgent->mNavMesh, RN_ERROR)
 
-	//do real adding to update list
-	do_add_crowd_agent_to_update_list(crowdAgent);
+	//do real adding to update list
+	do_add_crowd_agent_to_update_list(crowdAgent);
+
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, RN_ERROR)
+
+	//do real adding to recast update
+	result = do_add_crowd_agent_to_recast_update(crowdAgent);
+	//check if adding to recast was successful
+	if (! result)
+	{
+		//remove RNCrowdAgent from update too (if previously added)
+		mCrowdAgents.erase(
+				find(mCrowdAgents.begin(), mCrowdAgents.end(), crowdAgent));
+	}
+	//
+	return (result == true ? RN_SUCCESS : RN_ERROR);
+}
+
+/**
+ * Adds a collection of RNCrowdAgents to this RNNavMesh in a single batch.
+ * RNCrowdAgents already belonging to a RNNavMesh are skipped.
+ * Returns the number of RNCrowdAgents added, or a negative number on error.
+ */
+int RNNavMesh::add_crowd_agents(const NodePathCollection& crowdAgentNPs)
+{
+	//collect the RNCrowdAgents not belonging to any mesh
+	pvector<PT(RNCrowdAgent)> crowdAgents;
+	crowdAgents.reserve(crowdAgentNPs.get_num_paths());
+	for (int i = 0; i < crowdAgentNPs.get_num_paths(); ++i)
+	{
+		NodePath crowdAgentNP = crowdAgentNPs.get_path(i);
+		if (crowdAgentNP.is_empty()
+				|| (!crowdAgentNP.node()->is_of_type(
+						RNCrowdAgent::get_class_type())))
+		{
+			continue;
+		}
+		PT(RNCrowdAgent)crowdAgent = DCAST(RNCrowdAgent, crowdAgentNP.node());
+		if (crowdAgent->mNavMesh)
+		{
+			continue;
+		}
+		crowdAgents.push_back(crowdAgent);
+	}
+
+	//do real adding to update list: these RNCrowdAgents don't belong to any
+	//mesh so they cannot be already in the list
+	mCrowdAgents.reserve(mCrowdAgents.size() + crowdAgents.size());
+	pvector<PT(RNCrowdAgent)>::iterator iter;
+	for (iter = crowdAgents.begin(); iter != crowdAgents.end(); ++iter)
+	{
+		(*iter)->mNavMesh = this;
+		mCrowdAgents.push_back(*iter);
+	}
 
 	// continue if nav mesh has been already setup
 	CONTINUE_IF_ELSE_R(mNavMeshType, RN_ERROR)
 
 	//do real adding to recast update
-	result = do_add_crowd_agent_to_recast_update(crowdAgent);
-	//check if adding to recast was successful
-	if (! result)
+	int added = 0;
+	for (iter = crowdAgents.begin(); iter != crowdAgents.end(); ++iter)
 	{
-		//remove RNCrowdAgent from update too (if previously added)
-		mCrowdAgents.erase(
-				find(mCrowdAgents.begin(), mCrowdAgents.end(), crowdAgent));
+		if (do_add_crowd_agent_to_recast_update(*iter))
+		{
+			++added;
+		}
+		else
+		{
+			//remove RNCrowdAgent from update too
+			do_remove_crowd_agent_from_update_list(*iter);
+		}
 	}
 	//
-	return (result == true ? RN_SUCCESS : RN_ERROR);
+	return added;
 }
 
 /**
@@ -2247,6 +3510,20 @@ int RNNavMesh::remove_crowd_agent(NodePath crowdAgentNP)
 	// continue if crowdAgent belongs to this nav mesh
 	CONTINUE_IF_ELSE_R(crowdAgent->mNavMesh == this, RN_ERROR)
 
+	// remove from crowd groups: the groups it leads are removed
+	do_leave_crowd_group(crowdAgent);
+	pmap<int, CrowdGroup>::iterator iterG = mCrowdGroups.begin();
+	while (iterG != mCrowdGroups.end())
+	{
+		int groupRef = iterG->first;
+		bool isLeader = (iterG->second.mLeader == crowdAgent);
+		++iterG;
+		if (isLeader)
+		{
+			remove_crowd_group(groupRef);
+		}
+	}
+
 	// remove from update list
 	do_remove_crowd_agent_from_update_list(crowdAgent);
 
@@ -2360,6 +3637,8 @@ const LPoint3f& moveTarget)
 		getState()->setMoveTarget(crowdAgent->mAgentIdx, p);
 	}
 	crowdAgent->mMoveTarget = moveTarget;
+	crowdAgent->mMoveFlowField = RN_ERROR;
+	do_leave_crowd_group(crowdAgent);
 	//
 	return RN_SUCCESS;
 }
@@ -2387,6 +3666,36 @@ const LVector3f& moveVelocity)
 		getState()->setMoveVelocity(crowdAgent->mAgentIdx, v);
 	}
 	crowdAgent->mMoveVelocity = moveVelocity;
+	crowdAgent->mMoveFlowField = RN_ERROR;
+	do_leave_crowd_group(crowdAgent);
+	//
+	return RN_SUCCESS;
+}
+
+/**
+ * Sets the flow field followed by a given added RNCrowdAgent.
+ * Should be called after RNNavMesh setup.
+ * Returns a negative number on error.
+ * \note Internal use only.
+ */
+int RNNavMesh::do_set_crowd_agent_flow_field(PT(RNCrowdAgent)crowdAgent,
+int flowFieldRef)
+{
+	//continue if NavMeshType has already been setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, RN_ERROR)
+
+	pmap<int, FlowField>::const_iterator iter = mFlowFields.find(flowFieldRef);
+	CONTINUE_IF_ELSE_R(iter != mFlowFields.end(), RN_ERROR)
+
+	//check if crowdAgent has been already added to recast
+	if (crowdAgent->mAgentIdx != -1)
+	{
+		static_cast<rnsup::CrowdTool*>(mNavMeshType->getTool())->
+		getState()->getCrowd()->requestMoveFlowField(crowdAgent->mAgentIdx,
+				iter->second.get_second());
+	}
+	crowdAgent->mMoveFlowField = flowFieldRef;
+	do_leave_crowd_group(crowdAgent);
 	//
 	return RN_SUCCESS;
 }
@@ -2409,6 +3718,30 @@ void RNNavMesh::do_set_crowd_agent_other_settings(PT(RNCrowdAgent)crowdAgent,
 		rnsup::LVecBase3fToRecast(crowdAgent->mMoveVelocity, velocity);
 		crowdTool->getState()->setMoveVelocity(crowdAgent->mAgentIdx, velocity);
 	}
+	//update path priority
+	crowdTool->getState()->getCrowd()->setAgentPathPriority(
+			crowdAgent->mAgentIdx, crowdAgent->mPathPriority);
+	//update move flow field (if any)
+	pmap<int, FlowField>::const_iterator iterF = mFlowFields.find(
+			crowdAgent->mMoveFlowField);
+	if (iterF != mFlowFields.end())
+	{
+		crowdTool->getState()->getCrowd()->requestMoveFlowField(
+				crowdAgent->mAgentIdx, iterF->second.get_second());
+	}
+	//update crowd groups: follow the leader (if any), or be followed
+	pmap<int, CrowdGroup>::const_iterator iterG;
+	for (iterG = mCrowdGroups.begin(); iterG != mCrowdGroups.end(); ++iterG)
+	{
+		const CrowdGroup& group = iterG->second;
+		for (int i = 0; i < (int)group.mMembers.size(); ++i)
+		{
+			if ((group.mLeader == crowdAgent) || (group.mMembers[i] == crowdAgent))
+			{
+				do_set_crowd_agent_follow(group, i);
+			}
+		}
+	}
 }
 
 #ifdef RN_DEBUG
@@ -2487,6 +3820,47 @@ void RNNavMesh::do_debug_static_render_unsetup()
 }
 #endif //RN_DEBUG
 
+/**
+ * Sets the heightfield terrain into the input geometry.
+ * Returns false on error, or if there is no geometry at all.
+ * \note Internal use only.
+ */
+bool RNNavMesh::do_set_terrain()
+{
+	if (mTerrainHeightfield.is_valid())
+	{
+		const int width = mTerrainHeightfield.get_x_size();
+		const int height = mTerrainHeightfield.get_y_size();
+		//image rows go along -y, so along +z in recast
+		pvector<float> heights(width * height);
+		for (int j = 0; j < height; ++j)
+		{
+			for (int i = 0; i < width; ++i)
+			{
+				heights[i + j * width] = mTerrainHeightfield.get_bright(i, j)
+						* mTerrainScale.get_z();
+			}
+		}
+		//the first pixel of the last row is at the recast origin
+		float orig[3];
+		rnsup::LVecBase3fToRecast(
+				LPoint3f(mTerrainOrigin.get_x(),
+						mTerrainOrigin.get_y()
+								+ (height - 1) * mTerrainScale.get_y(),
+						mTerrainOrigin.get_z()), orig);
+		float spacing[2] =
+		{ mTerrainScale.get_x(), mTerrainScale.get_y() };
+		rnsup::TerrainHeightfield* terrain = new rnsup::TerrainHeightfield;
+		if (!terrain->init(&heights[0], width, height, orig, spacing))
+		{
+			delete terrain;
+			return false;
+		}
+		mGeom->setTerrain(terrain);
+	}
+	return mGeom->getMeshBoundsMin()[0] <= mGeom->getMeshBoundsMax()[0];
+}
+
 /**
  * Loads the mesh from a model NodePath.
  * Returns false on error.
@@ -2501,10 +3875,30 @@ bool RNNavMesh::do_load_model_mesh(NodePath model,
 		mGeom = new rnsup::InputGeom;
 	}
 	mMeshName = model.get_name();
+	//stream the triangles to a store file, bucketed by tile (TILE and
+	//OBSTACLE), if requested
+	string storeFile;
+	if ((!meshLoader) && (!mGeometryStreamDir.empty())
+			&& (mNavMeshTypeEnum != SOLO))
+	{
+		Filename streamDir = Filename::from_os_specific(mGeometryStreamDir);
+		streamDir.make_dir();
+		streamDir.mkdir();
+		if (streamDir.is_directory())
+		{
+			storeFile = Filename::temporary(streamDir.get_fullpath(),
+					get_name() + string("_"), string(".rnb")).to_os_specific();
+		}
+	}
 	//
 	if ((!mGeom)
-			|| (!mGeom->loadMesh(mCtx, string(), model, mReferenceNP,
-					meshLoader)))
+			|| (storeFile.empty() ?
+					!mGeom->loadMesh(mCtx, string(), model, mReferenceNP,
+							meshLoader) :
+					!mGeom->loadMeshStreamed(mCtx, model, mReferenceNP,
+							storeFile,
+							mNavMeshTileSettings.get_tileSize()
+									* mNavMeshSettings.get_cellSize())))
 	{
 		delete mGeom;
 		mGeom = NULL;
@@ -2552,6 +3946,19 @@ void RNNavMesh::update(float dt)
 			static_cast<rnsup::CrowdTool*>(mNavMeshType->getTool());
 	dtCrowd* crowd = crowdTool->getState()->getCrowd();
 
+	//repair flow fields after tiles' changes
+	pmap<int, FlowField>::iterator iterF;
+	for (iterF = mFlowFields.begin(); iterF != mFlowFields.end(); ++iterF)
+	{
+		dtStatus status = iterF->second.get_second()->update();
+		if (dtStatusDetail(status, DT_PARTIAL_RESULT))
+		{
+			//some goal polygons were rebuilt: find them again and build
+			//(the only search done for this field)
+			do_build_flow_field(iterF->second);
+		}
+	}
+
 	//update crowd agents' pos/vel
 	mNavMeshType->handleUpdate(dt);
 
@@ -2750,6 +4157,46 @@ LPoint3f RNNavMesh::ray_cast(const LPoint3f& startPos,
 	return hitPoint;
 }
 
+/**
+ * Casts rays from each start point toward the corresponding end point against
+ * the triangles of the model mesh, which are faced by the start points, in a
+ * single batch.
+ * Should be called after RNNavMesh setup.
+ * Returns, for each ray, the distance of the first hit from the start point,
+ * or an "infinite" number if the ray doesn't hit; returns an empty array on
+ * error.
+ */
+PTA_float RNNavMesh::ray_cast_geometry(const ValueList<LPoint3f>& startPoints,
+		const ValueList<LPoint3f>& endPoints)
+{
+	PTA_float distances;
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType && mGeom, distances)
+
+	int count = startPoints.size();
+	CONTINUE_IF_ELSE_R((count > 0) && (endPoints.size() == count), distances)
+
+	//convert to recast
+	pvector<float> src(count * 3), dst(count * 3), tmins(count);
+	pvector<unsigned char> hits(count);
+	for (int i = 0; i < count; ++i)
+	{
+		rnsup::LVecBase3fToRecast(startPoints[i], &src[i * 3]);
+		rnsup::LVecBase3fToRecast(endPoints[i], &dst[i * 3]);
+	}
+	//query
+	mGeom->raycastMeshBatch(&src[0], &dst[0], count, &tmins[0], &hits[0]);
+	//convert back to panda
+	distances.resize(count);
+	for (int i = 0; i < count; ++i)
+	{
+		distances[i] = hits[i] ?
+				tmins[i] * (endPoints[i] - startPoints[i]).length() : FLT_MAX;
+	}
+	//
+	return distances;
+}
+
 /**
  * Finds the distance from the specified position to the nearest polygon wall.
  * Should be called after RNNavMesh setup.
@@ -2783,6 +4230,307 @@ float RNNavMesh::distance_to_wall(const LPoint3f& pos)
 	return distance;
 }
 
+/**
+ * Finds, for each point, the nearest point on the nav mesh, using the crowd
+ * query filter. The queries are performed in a single batch, grouped by tile.
+ * Points too far from the nav mesh are returned unchanged.
+ * Should be called after RNNavMesh setup.
+ * Returns an empty list on error.
+ */
+ValueList<LPoint3f> RNNavMesh::find_nearest_points(
+		const ValueList<LPoint3f>& points)
+{
+	ValueList<LPoint3f> nearestPoints;
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, nearestPoints)
+
+	int count = points.size();
+	CONTINUE_IF_ELSE_R(count > 0, nearestPoints)
+
+	//convert to recast
+	pvector<float> centers(count * 3), nearestPts(count * 3);
+	pvector<dtPolyRef> nearestRefs(count);
+	for (int i = 0; i < count; ++i)
+	{
+		rnsup::LVecBase3fToRecast(points[i], &centers[i * 3]);
+	}
+	//query
+	rnsup::CrowdTool* crowdTool =
+			static_cast<rnsup::CrowdTool*>(mNavMeshType->getTool());
+	const dtQueryFilter* filter =
+			crowdTool->getState()->getCrowd()->getFilter(0);
+	const float polyPickExt[3] =
+	{ 2, 4, 2 };
+	mNavMeshType->getNavMeshQuery()->findNearestPolys(&centers[0], count,
+			polyPickExt, filter, &nearestRefs[0], &nearestPts[0]);
+	//convert back to panda
+	for (int i = 0; i < count; ++i)
+	{
+		nearestPoints.add_value(
+				nearestRefs[i] ?
+						LPoint3f(rnsup::RecastToLVecBase3f(&nearestPts[i * 3])) :
+						points[i]);
+	}
+	//
+	return nearestPoints;
+}
+
+/**
+ * Finds a straight path from the start point to the end point, with one of
+ * the built-in query filters, all based on the crowd's include/exclude flags.
+ * The filter is a compile time parameter of the path search, so its cost
+ * function is inlined into the search.
+ * Should be called after RNNavMesh setup.
+ * Returns a list of points, empty on error.
+ */
+ValueList<LPoint3f> RNNavMesh::path_find_filtered(const LPoint3f& startPos,
+		const LPoint3f& endPos, RNPathFilter filter)
+{
+	ValueList<LPoint3f> pointList;
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, pointList)
+
+	dtNavMeshQuery* navQuery = mNavMeshType->getNavMeshQuery();
+	const dtQueryFilter* crowdFilter = get_recast_crowd()->getFilter(0);
+	//set the extremes
+	float recastStart[3], recastEnd[3];
+	rnsup::LVecBase3fToRecast(startPos, recastStart);
+	rnsup::LVecBase3fToRecast(endPos, recastEnd);
+	const float polyPickExt[3] =
+	{ 2, 4, 2 };
+	dtPolyRef startRef, endRef;
+	float startPt[3], endPt[3];
+	navQuery->findNearestPoly(recastStart, polyPickExt, crowdFilter, &startRef,
+			startPt);
+	navQuery->findNearestPoly(recastEnd, polyPickExt, crowdFilter, &endRef,
+			endPt);
+	CONTINUE_IF_ELSE_R(startRef && endRef, pointList)
+
+	//find the path
+	const int maxPolys = 256;
+	dtPolyRef polys[maxPolys];
+	int npolys = 0;
+	dtStatus status;
+	switch (filter)
+	{
+	case SHORTEST_FILTER:
+	{
+		dtShortestQueryFilter shortestFilter(*crowdFilter);
+		status = navQuery->findPath(startRef, endRef, startPt, endPt,
+				&shortestFilter, polys, &npolys, maxPolys);
+	}
+		break;
+	case DANGER_FILTER:
+	{
+		dtDangerQueryFilter dangerFilter(*crowdFilter);
+		float center[3];
+		pvector<DangerArea>::const_iterator iterD;
+		for (iterD = mDangerAreas.begin(); iterD != mDangerAreas.end(); ++iterD)
+		{
+			rnsup::LVecBase3fToRecast(iterD->mCenter, center);
+			dangerFilter.addDangerArea(center, iterD->mRadius, iterD->mCost);
+		}
+		status = navQuery->findPath(startRef, endRef, startPt, endPt,
+				&dangerFilter, polys, &npolys, maxPolys);
+	}
+		break;
+	case AREA_COST_FILTER:
+	default:
+		status = navQuery->findPath(startRef, endRef, startPt, endPt,
+				crowdFilter, polys, &npolys, maxPolys);
+		break;
+	}
+	CONTINUE_IF_ELSE_R(dtStatusSucceed(status) && (npolys > 0), pointList)
+
+	//in case of partial path, make sure the end point is clamped to the last polygon
+	if (polys[npolys - 1] != endRef)
+	{
+		navQuery->closestPointOnPoly(polys[npolys - 1], recastEnd, endPt, 0);
+	}
+	float straightPath[maxPolys * 3];
+	int nstraightPath = 0;
+	navQuery->findStraightPath(startPt, endPt, polys, npolys, straightPath, 0,
+			0, &nstraightPath, maxPolys);
+	//convert back to panda
+	for (int i = 0; i < nstraightPath; ++i)
+	{
+		pointList.add_value(rnsup::RecastToLVecBase3f(&straightPath[i * 3]));
+	}
+	//
+	return pointList;
+}
+
+/**
+ * Adds a danger area, used by path_find_filtered() with DANGER_FILTER: the
+ * cost of a path segment crossing the circle of the given center and radius
+ * is multiplied by cost (>= 1.0), the largest if crossing more areas.
+ * Returns the danger area's index, or a negative number on error.
+ */
+int RNNavMesh::add_danger_area(const LPoint3f& center, float radius, float cost)
+{
+	CONTINUE_IF_ELSE_R(
+			(radius > 0.0) && (cost >= 1.0) && ((int)mDangerAreas.size() < DT_MAX_DANGER_AREAS),
+			RN_ERROR)
+
+	DangerArea dangerArea;
+	dangerArea.mCenter = center;
+	dangerArea.mRadius = radius;
+	dangerArea.mCost = cost;
+	mDangerAreas.push_back(dangerArea);
+	return (int)mDangerAreas.size() - 1;
+}
+
+/**
+ * Removes all the danger areas.
+ * Returns a negative number on error.
+ */
+int RNNavMesh::clear_danger_areas()
+{
+	mDangerAreas.clear();
+	return RN_SUCCESS;
+}
+
+/**
+ * Deletes the random point samplers.
+ * \note Internal use only.
+ */
+void RNNavMesh::do_free_samplers()
+{
+	pmap<LVecBase3i, dtNavMeshSampler*>::iterator iterS;
+	for (iterS = mSamplers.begin(); iterS != mSamplers.end(); ++iterS)
+	{
+		dtFreeNavMeshSampler(iterS->second);
+	}
+	mSamplers.clear();
+}
+
+/**
+ * Returns the random point sampler for the given area mask and include/exclude
+ * flags, creating it if needed, and updated to the current tiles.
+ * A negative area mask means all areas, negative flags mean the crowd ones.
+ * Returns NULL on error.
+ * \note Internal use only.
+ */
+dtNavMeshSampler* RNNavMesh::do_get_sampler(int areaMask, int includeFlags,
+		int excludeFlags)
+{
+	includeFlags = (includeFlags < 0 ? mCrowdIncludeFlags : includeFlags);
+	excludeFlags = (excludeFlags < 0 ? mCrowdExcludeFlags : excludeFlags);
+	LVecBase3i key(areaMask, includeFlags, excludeFlags);
+
+	dtNavMeshSampler* sampler = NULL;
+	pmap<LVecBase3i, dtNavMeshSampler*>::iterator iterS = mSamplers.find(key);
+	if (iterS != mSamplers.end())
+	{
+		sampler = iterS->second;
+		// the tables are rebuilt only for the changed tiles
+		if ((sampler->getNavMesh() == mNavMeshType->getNavMesh())
+				&& dtStatusSucceed(sampler->update()))
+		{
+			return sampler;
+		}
+	}
+	else
+	{
+		sampler = dtAllocNavMeshSampler();
+		CONTINUE_IF_ELSE_R(sampler, NULL)
+		mSamplers[key] = sampler;
+	}
+	// (re)initialize
+	dtQueryFilter filter;
+	filter.setIncludeFlags(includeFlags);
+	filter.setExcludeFlags(excludeFlags);
+	unsigned long long mask = (areaMask < 0 ? ~0ULL : (unsigned long long) areaMask);
+	CONTINUE_IF_ELSE_R(
+			dtStatusSucceed(sampler->init(mNavMeshType->getNavMeshQuery(), &filter, mask)),
+			NULL)
+	return sampler;
+}
+
+///Random number in [0..1), for random point sampling.
+static float randomPointFrand()
+{
+	return (float) rand() / ((float) RAND_MAX + 1.0f);
+}
+
+/**
+ * Finds random points on the RNNavMesh, uniformly distributed over its
+ * surface, returned as a flat array.
+ * The points lie on polygons whose area is in areaMask (a bit per area, see
+ * RNNavMeshPolyAreasEnum), and whose flags pass includeFlags and excludeFlags.
+ * A negative areaMask means all areas, negative flags mean the crowd's.
+ * Polygon areas are precomputed, and recomputed only for the changed tiles,
+ * so each point is found in constant time.
+ * Should be called after RNNavMesh setup. Returns an empty array on error.
+ */
+PTA_LVecBase3f RNNavMesh::find_random_points(int count, int areaMask,
+		int includeFlags, int excludeFlags)
+{
+	PTA_LVecBase3f randomPoints;
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, randomPoints)
+	CONTINUE_IF_ELSE_R(count > 0, randomPoints)
+
+	dtNavMeshSampler* sampler = do_get_sampler(areaMask, includeFlags,
+			excludeFlags);
+	CONTINUE_IF_ELSE_R(sampler, randomPoints)
+
+	//query
+	pvector<float> points(count * 3);
+	int npoints = 0;
+	CONTINUE_IF_ELSE_R(
+			dtStatusSucceed(sampler->samplePoints(count, randomPointFrand, NULL, &points[0], &npoints)),
+			randomPoints)
+	//convert back to panda
+	randomPoints.resize(npoints);
+	for (int i = 0; i < npoints; ++i)
+	{
+		randomPoints[i] = rnsup::RecastToLVecBase3f(&points[i * 3]);
+	}
+	//
+	return randomPoints;
+}
+
+/**
+ * Finds random points on the RNNavMesh within radius of center, uniformly
+ * distributed over its surface, returned as a flat array.
+ * The points lie on polygons overlapping the circle, which may be not
+ * connected to center, and are filtered as in find_random_points().
+ * Fewer than count points are returned if the circle is barely covered.
+ * Should be called after RNNavMesh setup. Returns an empty array on error.
+ */
+PTA_LVecBase3f RNNavMesh::find_random_points_around(int count,
+		const LPoint3f& center, float radius, int areaMask, int includeFlags,
+		int excludeFlags)
+{
+	PTA_LVecBase3f randomPoints;
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_R(mNavMeshType, randomPoints)
+	CONTINUE_IF_ELSE_R((count > 0) && (radius > 0.0), randomPoints)
+
+	dtNavMeshSampler* sampler = do_get_sampler(areaMask, includeFlags,
+			excludeFlags);
+	CONTINUE_IF_ELSE_R(sampler, randomPoints)
+
+	//convert to recast
+	float pos[3];
+	rnsup::LVecBase3fToRecast(center, pos);
+	//query
+	pvector<float> points(count * 3);
+	int npoints = 0;
+	CONTINUE_IF_ELSE_R(
+			dtStatusSucceed(sampler->samplePointsAroundCircle(pos, radius, count, randomPointFrand, NULL, &points[0], &npoints)),
+			randomPoints)
+	//convert back to panda
+	randomPoints.resize(npoints);
+	for (int i = 0; i < npoints; ++i)
+	{
+		randomPoints[i] = rnsup::RecastToLVecBase3f(&points[i * 3]);
+	}
+	//
+	return randomPoints;
+}
+
 /**
  * Writes a sensible description of the RNNavMesh to the indicated output
  * stream.
@@ -2792,6 +4540,95 @@ void RNNavMesh::output(ostream &out) const
 	out << get_type() << " " << get_name();
 }
 
+/**
+ * Writes the size of the polygon references (32 or 64 bits, see DT_POLYREF64)
+ * and the memory used by the nav mesh and its query to the indicated output
+ * stream, in bytes.
+ * Should be called after RNNavMesh setup.
+ */
+void RNNavMesh::output_memory_usage(ostream &out) const
+{
+	out << "polyRefBits: " << sizeof(dtPolyRef) * 8 << endl;
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_V(mNavMeshType)
+
+	const dtNavMesh* navMesh = mNavMeshType->getNavMesh();
+	int tileCount = 0, polyCount = 0, linkCount = 0;
+	size_t tileDataSize = 0;
+	for (int i = 0; i < navMesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = navMesh->getTile(i);
+		if (!tile->header)
+		{
+			continue;
+		}
+		tileCount++;
+		polyCount += tile->header->polyCount;
+		linkCount += tile->header->maxLinkCount;
+		tileDataSize += tile->dataSize;
+	}
+	const dtNodePool* nodePool = mNavMeshType->getNavMeshQuery()->getNodePool();
+	out << "tiles: " << tileCount << endl;
+	out << "polys: " << polyCount << endl;
+	out << "tileData: " << tileDataSize << endl;
+	out << "links: " << linkCount * sizeof(dtLink) << endl;
+	out << "tileTable: " << navMesh->getMaxTiles() * sizeof(dtMeshTile)
+			<< endl;
+	out << "queryNodePool: " << nodePool->getMemUsed() << endl;
+}
+
+/**
+ * Writes the statistics of the RNCrowdAgents' path request queue to the
+ * indicated output stream: latencies go from the request to the path
+ * completion, over the last completed requests.
+ * Should be called after RNNavMesh setup.
+ */
+void RNNavMesh::output_path_queue_stats(ostream &out) const
+{
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_V(mNavMeshType)
+
+	dtCrowd* crowd = static_cast<rnsup::CrowdTool*>(mNavMeshType->getTool())->
+			getState()->getCrowd();
+	dtPathQueueStats stats;
+	crowd->getPathQueue()->getStats(&stats);
+	out << "requestCount: " << stats.requestCount << endl;
+	out << "capacity: " << stats.capacity << endl;
+	out << "maxRequestCount: " << stats.maxRequestCount << endl;
+	out << "completedCount: " << stats.completedCount << endl;
+	out << "latency(us) p50: " << stats.latencyUsec[0] << " p90: "
+			<< stats.latencyUsec[1] << " p99: " << stats.latencyUsec[2]
+			<< " max: " << stats.latencyUsec[3] << endl;
+	out << "latency(updates) p50: " << stats.latencyUpdates[0] << " p90: "
+			<< stats.latencyUpdates[1] << " p99: " << stats.latencyUpdates[2]
+			<< " max: " << stats.latencyUpdates[3] << endl;
+	out << "searchCount: " << stats.searchCount << endl;
+	out << "nodes avg: " << stats.avgSearchNodes << " peak: "
+			<< stats.peakSearchNodes << " poolSize: " << stats.maxSearchNodes
+			<< " outOfNodes: " << stats.outOfNodesCount << endl;
+}
+
+/**
+ * Writes the statistics of the search node pool of the RNNavMesh's query
+ * (used by path finding and the other graph searches) to the indicated
+ * output stream: the number of searches and the nodes they touched. The
+ * pool grows up to its cap when a search needs more nodes.
+ * Should be called after RNNavMesh setup.
+ */
+void RNNavMesh::output_query_stats(ostream &out) const
+{
+	// continue if nav mesh has been already setup
+	CONTINUE_IF_ELSE_V(mNavMeshType)
+
+	const dtNodePool* nodePool = mNavMeshType->getNavMeshQuery()->getNodePool();
+	out << "searchCount: " << nodePool->getSearchCount() << endl;
+	out << "nodes avg: " << nodePool->getAverageNodesTouched() << " peak: "
+			<< nodePool->getPeakNodes() << endl;
+	out << "poolSize: " << nodePool->getMaxNodes() << " cap: "
+			<< nodePool->getMaxNodesCap() << endl;
+	out << "outOfNodes: " << nodePool->getOutOfNodesCount() << endl;
+}
+
 #ifdef PYTHON_BUILD
 /**
  * Sets the update callback as a python function taking this RNNavMesh as
@@ -3027,13 +4864,35 @@ void RNNavMesh::write_datagram(BamWriter *manager, Datagram &dg)
 		}
 	}
 
+	///Streamed geometry: the triangles are loaded only to be saved; if they
+	///can't be, the nav mesh is saved as not set up.
+	rnsup::rcMeshLoaderObj streamedMesh;
+	bool hasGeometry = (mNavMeshType != NULL);
+	if (hasGeometry && mNavMeshType->getInputGeom()->getBucketStore())
+	{
+		hasGeometry = streamedMesh.load(mOwnerObject, mReferenceNP);
+		if (!hasGeometry)
+		{
+			recastnavigation_cat.warning() << "RNNavMesh " << get_name()
+					<< ": could not load the streamed geometry to be saved: "
+					<< "the nav mesh is saved without it." << endl;
+		}
+	}
+
 	///Current underlying NavMeshType: saved as a flag.
-	mNavMeshType ? dg.add_bool(true) : dg.add_bool(false);
+	hasGeometry ? dg.add_bool(true) : dg.add_bool(false);
 
 	///Used for saving underlying geometry (see TypedWritable API).
-	if(mNavMeshType)
+	if(hasGeometry)
 	{
-		mNavMeshType->getInputGeom()->getMesh()->write_datagram(dg);
+		if (mNavMeshType->getInputGeom()->getBucketStore())
+		{
+			streamedMesh.write_datagram(dg);
+		}
+		else
+		{
+			mNavMeshType->getInputGeom()->getMesh()->write_datagram(dg);
+		}
 	}
 
 	///Unique ref.
@@ -11,6 +11,11 @@
 #include "rnTools.h"
 #include "recastnavigation_includes.h"
 #include "nodePath.h"
+#include "nodePathCollection.h"
+#include "pmap.h"
+#include "pta_LVecBase3.h"
+#include "pta_float.h"
+#include "pnmImage.h"
 
 #ifndef CPPPARSER
 #include "support/CrowdTool.h"
@@ -18,6 +23,9 @@
 #include "support/NavMeshType_Obstacle.h"
 #include "support/NavMeshTesterTool.h"
 #include "library/DetourTileCache.h"
+#include "library/DetourFlowField.h"
+#include "library/DetourNavMeshSampler.h"
+#include "library/DetourQueryFilters.h"
 #endif //CPPPARSER
 
 class RNCrowdAgent;
@@ -59,13 +67,25 @@ class RNCrowdAgent;
  * | *verts_per_poly*				|single| 6.0 | -
  * | *detail_sample_dist*			|single| 6.0 | -
  * | *detail_sample_max_error*		|single| 1.0 | -
+ * | *allocator*					|single| *default* | values: default,arena_pool (process wide, see RNNavMeshManager::output_allocator_stats())
+ * | *detail_grid*					|single| *true* | per polygon grids over the detail triangles, for faster height queries
+ * | *build_threads*				|single| 0 | threads building the nav mesh (OBSTACLE tiles and, with parallel_contours and parallel_detail, SOLO and TILE contours and detail meshes), 0 means one per hardware thread
+ * | *parallel_contours*			|single| *false* | traces the contours of SOLO and TILE nav meshes with build_threads threads: it pays off only with many regions per tile
+ * | *parallel_detail*			|single| *false* | builds the detail meshes of SOLO and TILE nav meshes with build_threads threads: it pays off with many polygons and a small detail_sample_dist (see samples/python/detail_benchmark.py)
+ * | *build_cache_dir*				|single| - | directory caching the build outputs (whole nav mesh for SOLO, per tile for TILE and OBSTACLE), keyed by the hash of their inputs: unchanged ones are loaded instead of rebuilt; empty means no cache
+ * | *geometry_stream_dir*			|single| - | directory of the on-disk store the owner object's triangles are streamed to, bucketed per tile, so each tile build loads only its triangles (TILE and OBSTACLE types only); empty means the triangles are all kept in memory
  * | *build_all_tiles*				|single| *false* | -
  * | *max_tiles*					|single| 128 | -
  * | *max_polys_per_tile*			|single| 32768 | -
  * | *tile_size*					|single| 32 | -
+ * | *tile_cache_compressor*		|single| *fastlz* | values: fastlz,none,fastlz_high,layer_rle (OBSTACLE type only)
+ * | *max_obstacles*				|single| 128 | initial obstacle capacity (OBSTACLE type only)
+ * | *max_obstacles_cap*			|single| 65536 | obstacle capacity limit, grown on demand up to it (OBSTACLE type only), 0 means fixed capacity
  * | *area_flags_cost*				|multiple| - | each one specified as "area_type@flag1[:flag2...:flagN]@cost" note: flags are or-ed
  * | *crowd_include_flags*			|single| - | specified as "flag1[:flag2...:flagN]" note: flags are or-ed
  * | *crowd_exclude_flags*			|single| - | specified as "flag1[:flag2...:flagN]" note: flags are or-ed
+ * | *crowd_path_queue_budget*		|single| 100:0 | specified as "max_iterations[:max_time_usec]" note: values <= 0 mean no limit
+ * | *crowd_path_queue_workers*		|single| 0 | threads serving path requests besides the calling one
  * | *convex_volume*				|multiple| - | each one specified as "x1,y1,z1[:x2,y2,z2...:xN,yN,zN]@area_type"
  * | *offmesh_connection*			|multiple| - | each one specified as "xB,yB,zB:xE,yE,zE@bidirectional" with bidirectional=true,false
  *
@@ -80,6 +100,8 @@ public:
 	typedef Pair<ValueList<LPoint3f>,RNOffMeshConnectionSettings> PointPairOffMeshConnectionSettings;
 	///obstacles
 	typedef Pair<RNObstacleSettings, NodePath> Obstacle;
+	///flow fields
+	typedef Pair<ValueList<LPoint3f>, dtFlowField*> FlowField;
 	///tester queries
 	typedef ValueList<Pair<LPoint3f, unsigned char> > PointFlagList;
 
@@ -152,6 +174,34 @@ PUBLISHED:
 #endif //CPPPARSER
 	};
 
+	/**
+	 * Equivalent to rnsup::NavMeshAllocatorEnum.
+	 */
+	enum RNNavMeshAllocatorEnum
+	{
+#ifndef CPPPARSER
+		ALLOCATOR_DEFAULT = rnsup::NAVMESH_ALLOCATOR_DEFAULT,
+		ALLOCATOR_ARENA_POOL = rnsup::NAVMESH_ALLOCATOR_ARENA_POOL,
+#else
+		ALLOCATOR_DEFAULT,ALLOCATOR_ARENA_POOL,
+#endif //CPPPARSER
+	};
+
+	/**
+	 * Equivalent to rnsup::NavMeshCompressorEnum.
+	 */
+	enum RNNavMeshCompressorEnum
+	{
+#ifndef CPPPARSER
+		COMPRESSOR_FASTLZ = rnsup::NAVMESH_COMPRESSOR_FASTLZ,
+		COMPRESSOR_NONE = rnsup::NAVMESH_COMPRESSOR_NONE,
+		COMPRESSOR_FASTLZ_HIGH = rnsup::NAVMESH_COMPRESSOR_FASTLZ_HIGH,
+		COMPRESSOR_LAYER_RLE = rnsup::NAVMESH_COMPRESSOR_LAYER_RLE,
+#else
+		COMPRESSOR_FASTLZ,COMPRESSOR_NONE,COMPRESSOR_FASTLZ_HIGH,COMPRESSOR_LAYER_RLE,
+#endif //CPPPARSER
+	};
+
 	// To avoid interrogatedb warning.
 #ifdef CPPPARSER
 	virtual ~RNNavMesh();
@@ -200,6 +250,13 @@ PUBLISHED:
 	INLINE RNNavMeshSettings get_nav_mesh_settings() const;
 	INLINE void set_area_flags(int area, int oredFlags);
 	INLINE int get_area_flags(int area) const;
+	void set_build_cache_dir(const string& dir);
+	INLINE string get_build_cache_dir() const;
+	void set_geometry_stream_dir(const string& dir);
+	INLINE string get_geometry_stream_dir() const;
+	void set_terrain(const PNMImage& heightfield, const LPoint3f& origin,
+			const LVecBase3f& scale);
+	INLINE bool has_terrain() const;
 	///@}
 
 	/**
@@ -212,6 +269,11 @@ PUBLISHED:
 	INLINE int get_crowd_include_flags() const;
 	void set_crowd_exclude_flags(int oredFlags);
 	INLINE int get_crowd_exclude_flags() const;
+	void set_crowd_path_queue_budget(int maxIters, int maxTimeUsec = 0);
+	INLINE int get_crowd_path_queue_max_iters() const;
+	INLINE int get_crowd_path_queue_max_time() const;
+	int set_crowd_path_queue_workers(int numWorkers);
+	INLINE int get_crowd_path_queue_workers() const;
 	///@}
 
 	/**
@@ -261,6 +323,7 @@ PUBLISHED:
 	void set_nav_mesh_tile_settings(const RNNavMeshTileSettings& settings);
 	INLINE RNNavMeshTileSettings get_nav_mesh_tile_settings() const;
 	LVecBase2i get_tile_indexes(const LPoint3f& pos);
+	int refresh_geometry();
 	///@}
 
 	/**
@@ -281,11 +344,50 @@ PUBLISHED:
 	///@{
 	int add_obstacle(NodePath objectNP);
 	int remove_obstacle(NodePath objectNP);
+	int add_obstacles(const ValueList<NodePath>& objectNPs);
+	int remove_obstacles(const ValueList<NodePath>& objectNPs);
 	NodePath get_obstacle_by_ref(int ref) const;
 	INLINE int get_obstacle(int index) const;
 	INLINE int get_num_obstacles() const;
 	MAKE_SEQ(get_obstacles, get_num_obstacles, get_obstacle);
 	int remove_all_obstacles();
+	void output_compressor_benchmark(ostream &out, int iterations = 10) const;
+	void output_scratch_stats(ostream &out) const;
+	///@}
+
+	/**
+	 * \name FLOW FIELDS
+	 */
+	///@{
+	int add_flow_field(const ValueList<LPoint3f>& goals);
+	int remove_flow_field(int ref);
+	ValueList<LPoint3f> get_flow_field_goals(int ref) const;
+	float get_flow_field_cost(int ref, const LPoint3f& pos) const;
+	LVector3f get_flow_field_direction(int ref, const LPoint3f& pos) const;
+	INLINE int get_num_flow_fields() const;
+	///@}
+
+	/**
+	 * \name SNAPSHOTS
+	 */
+	///@{
+	int take_snapshot();
+	int restore_snapshot(int ref);
+	int remove_snapshot(int ref);
+	INLINE int get_num_snapshots() const;
+	///@}
+
+	/**
+	 * \name CROWD GROUPS
+	 */
+	///@{
+	int add_crowd_group(NodePath leaderNP, const NodePathCollection& memberNPs,
+			const ValueList<LVector3f>& offsets = ValueList<LVector3f>());
+	int remove_crowd_group(int ref);
+	int set_crowd_group_move_target(int ref, const LPoint3f& pos);
+	NodePath get_crowd_group_leader(int ref) const;
+	NodePathCollection get_crowd_group_members(int ref) const;
+	INLINE int get_num_crowd_groups() const;
 	///@}
 
 	/**
@@ -293,6 +395,7 @@ PUBLISHED:
 	 */
 	///@{
 	int add_crowd_agent(NodePath crowdAgentNP);
+	int add_crowd_agents(const NodePathCollection& crowdAgentNPs);
 	int remove_crowd_agent(NodePath crowdAgentNP);
 	INLINE PT(RNCrowdAgent) get_crowd_agent(int index) const;
 	INLINE int get_num_crowd_agents() const;
@@ -329,6 +432,16 @@ PUBLISHED:
 #endif //CPPPARSER
 	};
 
+	/**
+	 * Built-in query filters for path_find_filtered().
+	 */
+	enum RNPathFilter
+	{
+		AREA_COST_FILTER = 0, //crowd flags and area costs (dtQueryFilter).
+		SHORTEST_FILTER, //crowd flags only (dtShortestQueryFilter).
+		DANGER_FILTER //crowd flags, area costs and danger areas (dtDangerQueryFilter).
+	};
+
 	/**
 	 * \name TESTER QUERIES
 	 */
@@ -340,7 +453,20 @@ PUBLISHED:
 	PointFlagList path_find_straight(const LPoint3f& startPos,
 		const LPoint3f& endPos, RNStraightPathOptions crossingOptions = NONE_CROSSINGS);
 	LPoint3f ray_cast(const LPoint3f& startPos, const LPoint3f& endPos);
+	PTA_float ray_cast_geometry(const ValueList<LPoint3f>& startPoints,
+			const ValueList<LPoint3f>& endPoints);
 	float distance_to_wall(const LPoint3f& pos);
+	ValueList<LPoint3f> find_nearest_points(const ValueList<LPoint3f>& points);
+	ValueList<LPoint3f> path_find_filtered(const LPoint3f& startPos,
+		const LPoint3f& endPos, RNPathFilter filter = AREA_COST_FILTER);
+	int add_danger_area(const LPoint3f& center, float radius, float cost);
+	int clear_danger_areas();
+	INLINE int get_num_danger_areas() const;
+	PTA_LVecBase3f find_random_points(int count, int areaMask = -1,
+			int includeFlags = -1, int excludeFlags = -1);
+	PTA_LVecBase3f find_random_points_around(int count, const LPoint3f& center,
+			float radius, int areaMask = -1, int includeFlags = -1,
+			int excludeFlags = -1);
 	///@}
 
 	/**
@@ -348,6 +474,9 @@ PUBLISHED:
 	 */
 	///@{
 	void output(ostream &out) const;
+	void output_memory_usage(ostream &out) const;
+	void output_path_queue_stats(ostream &out) const;
+	void output_query_stats(ostream &out) const;
 	///@}
 
 	/**
@@ -423,16 +552,66 @@ private:
 	RNNavMeshTileSettings mNavMeshTileSettings;
 	///Area types with ability flags settings (see support/NavMeshType.h).
 	rnsup::NavMeshPolyAreaFlags mPolyAreaFlags;
+	///Build cache directory (see support/NavMeshBuildCache.h).
+	string mBuildCacheDir;
+	///Streamed geometry store directory (see support/GeomBucketStore.h).
+	string mGeometryStreamDir;
+	///Heightfield terrain (see support/TerrainHeightfield.h).
+	PNMImage mTerrainHeightfield;
+	LPoint3f mTerrainOrigin;
+	LVecBase3f mTerrainScale;
 	///Area types with cost settings (see support/NavMeshType.h).
 	rnsup::NavMeshPolyAreaCost mPolyAreaCost;
 	///Crowd include & exclude flags settings (see library/DetourNavMeshQuery.h).
 	int mCrowdIncludeFlags, mCrowdExcludeFlags;
+	///Crowd path queue budget & workers (see library/DetourPathQueue.h).
+	int mCrowdPathQueueMaxIters, mCrowdPathQueueMaxTimeUsec, mCrowdPathQueueWorkers;
 	///Convex volumes (see support/ConvexVolumeTool.h).
 	pvector<PointListConvexVolumeSettings> mConvexVolumes;
 	///Off mesh connections (see support/OffMeshConnectionTool.h).
 	pvector<PointPairOffMeshConnectionSettings> mOffMeshConnections;
 	///Obstacles.
 	pvector<Obstacle> mObstacles;
+	///Flow fields by reference (see library/DetourFlowField.h).
+	pmap<int, FlowField> mFlowFields;
+	int do_build_flow_field(const FlowField& flowField);
+	///Snapshots by reference (see take_snapshot()).
+	struct CrowdAgentSnapshot
+	{
+		PT(RNCrowdAgent) mCrowdAgent;
+		int mAgentIdx;
+		RNCrowdAgentParams mAgentParams;
+		LPoint3f mMoveTarget;
+		LVector3f mMoveVelocity;
+		int mMoveFlowField;
+		float mPathPriority;
+		pvector<unsigned char> mState;
+	};
+	struct Snapshot
+	{
+		dtNavMeshParams mNavMeshParams;
+		pvector<dtTileRef> mTileRefs;
+		pvector<pvector<unsigned char> > mTiles;
+		pvector<unsigned char> mObstacleState;
+		pvector<Obstacle> mObstacles;
+		pvector<CrowdAgentSnapshot> mCrowdAgents;
+	};
+	pmap<int, Snapshot> mSnapshots;
+	///Random point samplers by (area mask, include flags, exclude flags)
+	///(see library/DetourNavMeshSampler.h).
+	pmap<LVecBase3i, dtNavMeshSampler*> mSamplers;
+	///Danger areas (see library/DetourQueryFilters.h).
+	struct DangerArea
+	{
+		LPoint3f mCenter;
+		float mRadius, mCost;
+	};
+	pvector<DangerArea> mDangerAreas;
+	void do_free_samplers();
+	dtNavMeshSampler* do_get_sampler(int areaMask, int includeFlags,
+			int excludeFlags);
+	bool do_find_nearest_poly(const LPoint3f& pos, dtPolyRef* ref,
+			float* nearestPos) const;
 	///Crowd related data.
 	//The RNCrowdAgents added to and handled by this RNNavMesh.
 	pvector<PT(RNCrowdAgent)> mCrowdAgents;
@@ -442,6 +621,19 @@ private:
 			const LPoint3f& moveTarget);
 	int do_set_crowd_agent_velocity(PT(RNCrowdAgent)crowdAgent,
 			const LVector3f& moveVelocity);
+	int do_set_crowd_agent_flow_field(PT(RNCrowdAgent)crowdAgent,
+			int flowFieldRef);
+	///Crowd groups by reference (see add_crowd_group()).
+	struct CrowdGroup
+	{
+		PT(RNCrowdAgent) mLeader;
+		pvector<PT(RNCrowdAgent)> mMembers;
+		///Formation offsets (leader's right, forward, unused).
+		pvector<LVector3f> mOffsets;
+	};
+	pmap<int, CrowdGroup> mCrowdGroups;
+	bool do_set_crowd_agent_follow(const CrowdGroup& group, int member);
+	void do_leave_crowd_group(PT(RNCrowdAgent)crowdAgent);
 
 	///Used for saving underlying geometry (see TypedWritable API).
 	rnsup::rcMeshLoaderObj mMeshLoader;
@@ -456,6 +648,7 @@ private:
 	void do_initialize();
 	void do_finalize();
 
+	bool do_set_terrain();
 	bool do_load_model_mesh(NodePath model,
 		rnsup::rcMeshLoaderObj* meshLoader = NULL);
 	void do_create_nav_mesh_type(rnsup::NavMeshType* navMeshType);
@@ -477,9 +670,12 @@ private:
 	void do_find_off_mesh_connection_poly(int offMeshConnectionID,
 			dtPolyRef* poly) const;
 
-	int do_add_obstacle_to_recast(NodePath& objectNP, int index,
+	int do_add_obstacle_to_recast(int index, bool buildFromBam = false);
+	int do_add_obstacles_to_recast(int first, int count,
 			bool buildFromBam = false);
 	int do_remove_obstacle_from_recast(NodePath& objectNP, int obstacleRef);
+	int do_remove_obstacles_from_recast(const pvector<dtObstacleRef>& obstacleRefs);
+	int do_update_tile_cache();
 
 #ifdef RN_DEBUG
 	/// Recast debug node path.
@@ -162,6 +162,7 @@ PT(RNNavMesh) RNNavMeshManager::get_nav_mesh(int index) const
 
 /**
  * Creates a RNCrowdAgent with a given (mandatory and not empty) name.
+ * The current RNCrowdAgent's textual parameters are used for the creation.
  * Returns a NodePath to the new RNCrowdAgent,or an empty NodePath with the
  * ET_fail error type set on error.
  */
@@ -169,20 +170,229 @@ NodePath RNNavMeshManager::create_crowd_agent(const string& name)
 {
 	nassertr_always(! name.empty(), NodePath::fail())
 
-	PT(RNCrowdAgent) newCrowdAgent = new RNCrowdAgent(name);
+	//compile the current parameters
+	RNCrowdAgentProfile profile = compile_crowd_agent_profile();
+	PT(RNCrowdAgent) newCrowdAgent = do_create_crowd_agent(name, profile);
 	nassertr_always(newCrowdAgent, NodePath::fail())
 
+	//add to RNNavMesh if requested
+	PT(RNNavMesh) navMesh = do_find_nav_mesh(profile.get_nav_mesh_name());
+	if (navMesh)
+	{
+		navMesh->add_crowd_agent(newCrowdAgent->mThisNP);
+	}
+	//
+	return newCrowdAgent->mThisNP;
+}
+
+/**
+ * Creates count RNCrowdAgents from an already compiled profile (see
+ * compile_crowd_agent_profile()): they are named namePrefix_0, ...,
+ * namePrefix_N with N = count - 1.\n
+ * If the profile specifies an RNNavMesh, all the new RNCrowdAgents are added
+ * to it in a single batch (see RNNavMesh::add_crowd_agents()).
+ * Returns the collection of the NodePaths to the new RNCrowdAgents (empty on
+ * error).
+ */
+NodePathCollection RNNavMeshManager::create_crowd_agents(
+		const RNCrowdAgentProfile& profile, int count,
+		const string& namePrefix)
+{
+	NodePathCollection crowdAgentNPs;
+	nassertr_always((count > 0) && (! namePrefix.empty()), crowdAgentNPs)
+
+	mCrowdAgents.reserve(mCrowdAgents.size() + count);
+	for (int i = 0; i < count; ++i)
+	{
+		PT(RNCrowdAgent) newCrowdAgent = do_create_crowd_agent(
+				namePrefix + "_" + str(i), profile);
+		nassertr_always(newCrowdAgent, crowdAgentNPs)
+
+		crowdAgentNPs.add_path(newCrowdAgent->mThisNP);
+	}
+	//add to RNNavMesh if requested
+	PT(RNNavMesh) navMesh = do_find_nav_mesh(profile.get_nav_mesh_name());
+	if (navMesh)
+	{
+		navMesh->add_crowd_agents(crowdAgentNPs);
+	}
+	//
+	return crowdAgentNPs;
+}
+
+/**
+ * Creates and initializes a RNCrowdAgent given its name and profile, and adds
+ * it to the inner list.
+ * Returns NULL on error.
+ * \note Internal use only.
+ */
+PT(RNCrowdAgent) RNNavMeshManager::do_create_crowd_agent(const string& name,
+		const RNCrowdAgentProfile& profile)
+{
+	PT(RNCrowdAgent) newCrowdAgent = new RNCrowdAgent(name);
+	CONTINUE_IF_ELSE_R(newCrowdAgent, NULL)
+
 	// set reference node
 	newCrowdAgent->mReferenceNP = mReferenceNP;
 	// reparent to reference node and set "this" NodePath
 	newCrowdAgent->mThisNP = mReferenceNP.attach_new_node(newCrowdAgent);
 	//initialize the new CrowdAgent
-	newCrowdAgent->do_initialize();
+	newCrowdAgent->do_initialize(profile);
 
 	//add the new CrowdAgent to the inner list
 	mCrowdAgents.push_back(newCrowdAgent);
 	//
-	return newCrowdAgent->mThisNP;
+	return newCrowdAgent;
+}
+
+/**
+ * Returns the first RNNavMesh with the given name, or NULL if none.
+ * \note Internal use only.
+ */
+PT(RNNavMesh) RNNavMeshManager::do_find_nav_mesh(const string& name) const
+{
+	CONTINUE_IF_ELSE_R(! name.empty(), NULL)
+
+	NavMeshList::const_iterator iter;
+	for (iter = mNavMeshes.begin(); iter != mNavMeshes.end(); ++iter)
+	{
+		if ((*iter)->get_name() == name)
+		{
+			return *iter;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Compiles the current RNCrowdAgent's textual parameters into a typed
+ * profile, which can be used to create many RNCrowdAgents without parsing the
+ * parameters again (see create_crowd_agents()).
+ */
+RNCrowdAgentProfile RNNavMeshManager::compile_crowd_agent_profile() const
+{
+	RNCrowdAgentProfile profile;
+	//register to navmesh objectId
+	profile.set_nav_mesh_name(
+			get_parameter_value(CROWDAGENT, string("add_to_navmesh")));
+	//mov type
+	profile.set_kinematic(
+			get_parameter_value(CROWDAGENT, string("mov_type"))
+					== string("kinematic"));
+	//
+	string param;
+	unsigned int idx, valueNum;
+	pvector<string> paramValuesStr;
+	//move target
+	param = get_parameter_value(CROWDAGENT, string("move_target"));
+	paramValuesStr = parseCompoundString(param, ',');
+	valueNum = paramValuesStr.size();
+	if (valueNum < 3)
+	{
+		paramValuesStr.resize(3, "0.0");
+	}
+	LPoint3f moveTarget;
+	for (idx = 0; idx < 3; ++idx)
+	{
+		moveTarget[idx] = STRTOF(paramValuesStr[idx].c_str(), NULL);
+	}
+	profile.set_move_target(moveTarget);
+	//move velocity
+	param = get_parameter_value(CROWDAGENT, string("move_velocity"));
+	paramValuesStr = parseCompoundString(param, ',');
+	valueNum = paramValuesStr.size();
+	if (valueNum < 3)
+	{
+		paramValuesStr.resize(3, "0.0");
+	}
+	LVector3f moveVelocity;
+	for (idx = 0; idx < 3; ++idx)
+	{
+		moveVelocity[idx] = STRTOF(paramValuesStr[idx].c_str(), NULL);
+	}
+	profile.set_move_velocity(moveVelocity);
+	//
+	RNCrowdAgentParams agentParams;
+	float value;
+	int valueInt;
+	//max acceleration
+	value = STRTOF(get_parameter_value(CROWDAGENT, string("max_acceleration")).c_str(),
+			NULL);
+	agentParams.set_maxAcceleration(value >= 0.0 ? value : -value);
+	//max speed
+	value = STRTOF(get_parameter_value(CROWDAGENT, string("max_speed")).c_str(), NULL);
+	agentParams.set_maxSpeed(value >= 0.0 ? value : -value);
+	//collision query range
+	value = STRTOF(
+			get_parameter_value(CROWDAGENT, string("collision_query_range")).c_str(),
+			NULL);
+	agentParams.set_collisionQueryRange(value >= 0.0 ? value : -value);
+	//path optimization range
+	value = STRTOF(
+			get_parameter_value(CROWDAGENT, string("path_optimization_range")).c_str(),
+			NULL);
+	agentParams.set_pathOptimizationRange(value >= 0.0 ? value : -value);
+	//separation weight
+	value = STRTOF(get_parameter_value(CROWDAGENT, string("separation_weight")).c_str(),
+			NULL);
+	agentParams.set_separationWeight(value >= 0.0 ? value : -value);
+	//update flags
+	valueInt = strtol(get_parameter_value(CROWDAGENT, string("update_flags")).c_str(),
+			NULL, 0);
+	agentParams.set_updateFlags(valueInt >= 0.0 ? valueInt : -valueInt);
+	//obstacle avoidance type
+	valueInt = strtol(
+			get_parameter_value(CROWDAGENT, string("obstacle_avoidance_type")).c_str(),
+			NULL, 0);
+	agentParams.set_obstacleAvoidanceType(valueInt >= 0.0 ? valueInt : -valueInt);
+	profile.set_params(agentParams);
+	//thrown events
+	string thrownEventsParam = get_parameter_value(CROWDAGENT, string("thrown_events"));
+	//
+	//set thrown events if any: event names are left empty when not
+	//specified, and are defaulted on RNCrowdAgent's initialization
+	unsigned int idx1, valueNum1;
+	pvector<string> paramValuesStr1, paramValuesStr2;
+	if (thrownEventsParam != string(""))
+	{
+		//events specified
+		//event1@[event_name1]@[frequency1][:...[:eventN@[event_nameN]@[frequencyN]]]
+		paramValuesStr1 = parseCompoundString(thrownEventsParam, ':');
+		valueNum1 = paramValuesStr1.size();
+		for (idx1 = 0; idx1 < valueNum1; ++idx1)
+		{
+			//eventX@[event_nameX]@[frequencyX]
+			paramValuesStr2 = parseCompoundString(paramValuesStr1[idx1], '@');
+			if (paramValuesStr2.size() >= 3)
+			{
+				ThrowEventData eventData;
+				//get frequency
+				float frequency = STRTOF(paramValuesStr2[2].c_str(), NULL);
+				if (frequency <= 0.0)
+				{
+					frequency = 30.0;
+				}
+				//set event data
+				eventData.mEnable = true;
+				eventData.mEventName = paramValuesStr2[1];
+				eventData.mTimeElapsed = 0;
+				eventData.mFrequency = frequency;
+				//get event
+				if (paramValuesStr2[0] == "move")
+				{
+					profile.set_move_event(eventData);
+				}
+				else if (paramValuesStr2[0] == "steady")
+				{
+					profile.set_steady_event(eventData);
+				}
+				//else paramValuesStr2[0] is not a suitable event:
+				//continue with the next event
+			}
+		}
+	}
+	//
+	return profile;
 }
 
 /**
@@ -386,6 +596,20 @@ void RNNavMeshManager::set_parameters_defaults(RNType type)
 				ParameterNameValue("detail_sample_dist", "6.0"));
 		mNavMeshesParameterTable.insert(
 				ParameterNameValue("detail_sample_max_error", "1.0"));
+		mNavMeshesParameterTable.insert(
+				ParameterNameValue("allocator", "default"));
+		mNavMeshesParameterTable.insert(
+				ParameterNameValue("detail_grid", "true"));
+		mNavMeshesParameterTable.insert(
+				ParameterNameValue("build_threads", "0"));
+		mNavMeshesParameterTable.insert(
+				ParameterNameValue("parallel_contours", "false"));
+		mNavMeshesParameterTable.insert(
+				ParameterNameValue("parallel_detail", "false"));
+		mNavMeshesParameterTable.insert(
+				ParameterNameValue("build_cache_dir", ""));
+		mNavMeshesParameterTable.insert(
+				ParameterNameValue("geometry_stream_dir", ""));
 		//nav mesh tile
 		mNavMeshesParameterTable.insert(
 				ParameterNameValue("build_all_tiles", "false"));
@@ -393,6 +617,12 @@ void RNNavMeshManager::set_parameters_defaults(RNType type)
 		mNavMeshesParameterTable.insert(
 				ParameterNameValue("max_polys_per_tile", "32768"));
 		mNavMeshesParameterTable.insert(ParameterNameValue("tile_size", "32"));
+		mNavMeshesParameterTable.insert(
+				ParameterNameValue("tile_cache_compressor", "fastlz"));
+		mNavMeshesParameterTable.insert(
+				ParameterNameValue("max_obstacles", "128"));
+		mNavMeshesParameterTable.insert(
+				ParameterNameValue("max_obstacles_cap", "65536"));
 		//area flags cost
 		//NAVMESH_POLYAREA_GROUND@NAVMESH_POLYFLAGS_WALK@1.0
 		mNavMeshesParameterTable.insert(ParameterNameValue("area_flags_cost", "0@0x01@1.0"));
@@ -410,6 +640,9 @@ void RNNavMeshManager::set_parameters_defaults(RNType type)
 		mNavMeshesParameterTable.insert(ParameterNameValue("crowd_include_flags", "0xffef"));
 		//crowd exclude flags = NAVMESH_POLYFLAGS_DISABLED = 0x10
 		mNavMeshesParameterTable.insert(ParameterNameValue("crowd_exclude_flags", "0x10"));
+		//crowd path queue budget = 100 iterations, no time limit
+		mNavMeshesParameterTable.insert(ParameterNameValue("crowd_path_queue_budget", "100:0"));
+		mNavMeshesParameterTable.insert(ParameterNameValue("crowd_path_queue_workers", "0"));
 	}
 	else if (type == CROWDAGENT)
 	{
@@ -547,6 +780,37 @@ Pair<bool,float> RNNavMeshManager::get_collision_height(const LPoint3f& rayOrigi
 	return Pair<bool,float>(false, 0.0);
 }
 
+/**
+ * Writes the Recast/Detour allocation statistics to the indicated output
+ * stream (see RNNavMesh's "allocator" parameter).
+ */
+void RNNavMeshManager::output_allocator_stats(ostream &out) const
+{
+	rnsup::NavMeshAllocStats stats;
+	rnsup::getNavMeshAllocStats(stats);
+	out << "allocator: "
+			<< (rnsup::getNavMeshAllocator()
+					== rnsup::NAVMESH_ALLOCATOR_ARENA_POOL ?
+					"arena_pool" : "default") << endl;
+	out << "tempAllocs: " << stats.tempAllocs << endl;
+	out << "tempOverflows: " << stats.tempOverflows << endl;
+	out << "tempArenaResets: " << stats.tempArenaResets << endl;
+	out << "tempArenaHighWater: " << stats.tempArenaHighWater << endl;
+	out << "permPoolAllocs: " << stats.permPoolAllocs << endl;
+	out << "permPoolBytes: " << stats.permPoolBytes << endl;
+	out << "heapAllocs: " << stats.heapAllocs << endl;
+	out << "heapFrees: " << stats.heapFrees << endl;
+	out << "heapLiveBytes: " << stats.heapLiveBytes << endl;
+}
+
+/**
+ * Resets the Recast/Detour allocation counters.
+ */
+void RNNavMeshManager::reset_allocator_stats()
+{
+	rnsup::resetNavMeshAllocStats();
+}
+
 /**
  * Draws the specified primitive, given the points, the color (RGBA) and point's size.
  */
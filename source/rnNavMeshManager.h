@@ -13,6 +13,7 @@
 #include "collisionTraverser.h"
 #include "collisionHandlerQueue.h"
 #include "collisionRay.h"
+#include "nodePathCollection.h"
 
 class RNNavMesh;
 class RNCrowdAgent;
@@ -55,6 +56,9 @@ PUBLISHED:
 	 */
 	///@{
 	NodePath create_crowd_agent(const string& name);
+	RNCrowdAgentProfile compile_crowd_agent_profile() const;
+	NodePathCollection create_crowd_agents(const RNCrowdAgentProfile& profile,
+			int count, const string& namePrefix = string("CrowdAgent"));
 	bool destroy_crowd_agent(NodePath crowdAgentNP);
 	PT(RNCrowdAgent) get_crowd_agent(int index) const;
 	INLINE int get_num_crowd_agents() const;
@@ -113,6 +117,14 @@ PUBLISHED:
 	INLINE CollisionRay* get_collision_ray() const;
 	///@}
 
+	/**
+	 * \name ALLOCATOR STATISTICS
+	 */
+	///@{
+	void output_allocator_stats(ostream &out) const;
+	void reset_allocator_stats();
+	///@}
+
 	/**
 	 * \name SERIALIZATION
 	 */
@@ -161,6 +173,10 @@ private:
 	CrowdAgentList mCrowdAgents;
 	///RNCrowdAgents' parameter table.
 	ParameterTable mCrowdAgentsParameterTable;
+	///Helpers.
+	PT(RNCrowdAgent) do_create_crowd_agent(const string& name,
+			const RNCrowdAgentProfile& profile);
+	PT(RNNavMesh) do_find_nav_mesh(const string& name) const;
 
 	///@{
 	///A task data for step simulation update.
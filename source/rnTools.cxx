@@ -146,6 +146,11 @@ void RNNavMeshSettings::write_datagram(Datagram &dg) const
 	dg.add_stdfloat(get_detailSampleDist());
 	dg.add_stdfloat(get_detailSampleMaxError());
 	dg.add_int32(get_partitionType());
+	dg.add_int32(get_allocatorType());
+	dg.add_bool(get_buildDetailGrid());
+	dg.add_int32(get_buildThreads());
+	dg.add_bool(get_parallelContours());
+	dg.add_bool(get_parallelDetail());
 }
 
 /**
@@ -167,6 +172,11 @@ void RNNavMeshSettings::read_datagram(DatagramIterator &scan)
 	set_detailSampleDist(scan.get_stdfloat());
 	set_detailSampleMaxError(scan.get_stdfloat());
 	set_partitionType(scan.get_int32());
+	set_allocatorType(scan.get_int32());
+	set_buildDetailGrid(scan.get_bool());
+	set_buildThreads(scan.get_int32());
+	set_parallelContours(scan.get_bool());
+	set_parallelDetail(scan.get_bool());
 }
 
 /**
@@ -189,6 +199,11 @@ void RNNavMeshSettings::output(ostream &out) const
 	out << "detailSampleDist: " << get_detailSampleDist() << endl;
 	out << "detailSampleMaxError: " << get_detailSampleMaxError() << endl;
 	out << "partitionType: " << get_partitionType() << endl;
+	out << "allocatorType: " << get_allocatorType() << endl;
+	out << "buildDetailGrid: " << get_buildDetailGrid() << endl;
+	out << "buildThreads: " << get_buildThreads() << endl;
+	out << "parallelContours: " << get_parallelContours() << endl;
+	out << "parallelDetail: " << get_parallelDetail() << endl;
 }
 
 ///NavMeshTileSettings
@@ -208,6 +223,9 @@ void RNNavMeshTileSettings::write_datagram(Datagram &dg) const
 	dg.add_int32(get_maxTiles());
 	dg.add_int32(get_maxPolysPerTile());
 	dg.add_stdfloat(get_tileSize());
+	dg.add_int32(get_compressorType());
+	dg.add_int32(get_maxObstacles());
+	dg.add_int32(get_maxObstaclesCap());
 }
 /**
  * Restores the NavMeshTileSettings from the datagram.
@@ -218,6 +236,9 @@ void RNNavMeshTileSettings::read_datagram(DatagramIterator &scan)
 	set_maxTiles(scan.get_int32());
 	set_maxPolysPerTile(scan.get_int32());
 	set_tileSize(scan.get_stdfloat());
+	set_compressorType(scan.get_int32());
+	set_maxObstacles(scan.get_int32());
+	set_maxObstaclesCap(scan.get_int32());
 }
 
 /**
@@ -230,6 +251,9 @@ void RNNavMeshTileSettings::output(ostream &out) const
 	out << "maxTiles: " << get_maxTiles() << endl;
 	out << "maxPolysPerTile: " << get_maxPolysPerTile() << endl;
 	out << "tileSize: " << get_tileSize() << endl;
+	out << "compressorType: " << get_compressorType() << endl;
+	out << "maxObstacles: " << get_maxObstacles() << endl;
+	out << "maxObstaclesCap: " << get_maxObstaclesCap() << endl;
 }
 
 ///Convex volume settings.
@@ -423,6 +447,34 @@ void RNCrowdAgentParams::output(ostream &out) const
 	out << "userData: " << get_userData() << endl;
 }
 
+///CrowdAgent profile
+/**
+ *
+ */
+RNCrowdAgentProfile::RNCrowdAgentProfile() :
+		_params(RNCrowdAgentParams()), _navMeshName(string("")), _kinematic(
+				false), _moveTarget(LPoint3f::zero()), _moveVelocity(
+				LVector3f::zero())
+{
+}
+
+/**
+ * Writes a sensible description of the RNCrowdAgentProfile to the indicated
+ * output stream.
+ */
+void RNCrowdAgentProfile::output(ostream &out) const
+{
+	out << "params: " << endl << get_params();
+	out << "navMeshName: " << get_nav_mesh_name() << endl;
+	out << "kinematic: " << get_kinematic() << endl;
+	out << "moveTarget: " << get_move_target() << endl;
+	out << "moveVelocity: " << get_move_velocity() << endl;
+	out << "moveEvent: " << (_moveEvent.mEnable ? _moveEvent.mEventName : "-")
+			<< endl;
+	out << "steadyEvent: "
+			<< (_steadyEvent.mEnable ? _steadyEvent.mEventName : "-") << endl;
+}
+
 ///ValueList template
 // Tell GCC that we'll take care of the instantiation explicitly here.
 #ifdef __GNUC__
@@ -372,6 +372,16 @@ PUBLISHED:
 	INLINE void set_detailSampleMaxError(float value);
 	INLINE int get_partitionType() const;
 	INLINE void set_partitionType(int value);
+	INLINE int get_allocatorType() const;
+	INLINE void set_allocatorType(int value);
+	INLINE bool get_buildDetailGrid() const;
+	INLINE void set_buildDetailGrid(bool value);
+	INLINE int get_buildThreads() const;
+	INLINE void set_buildThreads(int value);
+	INLINE bool get_parallelContours() const;
+	INLINE void set_parallelContours(bool value);
+	INLINE bool get_parallelDetail() const;
+	INLINE void set_parallelDetail(bool value);
 	void output(ostream &out) const;
 private:
 #ifndef CPPPARSER
@@ -407,6 +417,12 @@ PUBLISHED:
 	INLINE void set_maxPolysPerTile(int value);
 	INLINE float get_tileSize() const;
 	INLINE void set_tileSize(float value);
+	INLINE int get_compressorType() const;
+	INLINE void set_compressorType(int value);
+	INLINE int get_maxObstacles() const;
+	INLINE void set_maxObstacles(int value);
+	INLINE int get_maxObstaclesCap() const;
+	INLINE void set_maxObstaclesCap(int value);
 	void output(ostream &out) const;
 private:
 #ifndef CPPPARSER
@@ -557,6 +573,41 @@ public:
 };
 INLINE ostream &operator << (ostream &out, const RNCrowdAgentParams & params);
 
+///CrowdAgent profile: RNCrowdAgent creation parameters, parsed once.
+struct EXPORT_CLASS RNCrowdAgentProfile
+{
+PUBLISHED:
+	RNCrowdAgentProfile();
+
+	INLINE RNCrowdAgentParams get_params() const;
+	INLINE void set_params(const RNCrowdAgentParams& value);
+	INLINE string get_nav_mesh_name() const;
+	INLINE void set_nav_mesh_name(const string& value);
+	INLINE bool get_kinematic() const;
+	INLINE void set_kinematic(bool value);
+	INLINE LPoint3f get_move_target() const;
+	INLINE void set_move_target(const LPoint3f& value);
+	INLINE LVector3f get_move_velocity() const;
+	INLINE void set_move_velocity(const LVector3f& value);
+	void output(ostream &out) const;
+private:
+	RNCrowdAgentParams _params;
+	string _navMeshName;
+	bool _kinematic;
+	LPoint3f _moveTarget;
+	LVector3f _moveVelocity;
+#ifndef CPPPARSER
+	ThrowEventData _moveEvent, _steadyEvent;
+#endif //CPPPARSER
+
+public:
+	INLINE const ThrowEventData& get_move_event() const;
+	INLINE void set_move_event(const ThrowEventData& value);
+	INLINE const ThrowEventData& get_steady_event() const;
+	INLINE void set_steady_event(const ThrowEventData& value);
+};
+INLINE ostream &operator << (ostream &out, const RNCrowdAgentProfile & profile);
+
 ///ValueList template
 template<typename Type>
 class ValueList
@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <algorithm>
 
 struct BoundsItem
 {
@@ -34,27 +35,18 @@ struct BoundsItem
 	int i;
 };
 
-static int compareItemX(const void* va, const void* vb)
+// Orders the items along an axis, ties broken by triangle index, so that
+// the tree does not depend on the sort implementation.
+struct CompareItem
 {
-	const BoundsItem* a = (const BoundsItem*)va;
-	const BoundsItem* b = (const BoundsItem*)vb;
-	if (a->bmin[0] < b->bmin[0])
-		return -1;
-	if (a->bmin[0] > b->bmin[0])
-		return 1;
-	return 0;
-}
-
-static int compareItemY(const void* va, const void* vb)
-{
-	const BoundsItem* a = (const BoundsItem*)va;
-	const BoundsItem* b = (const BoundsItem*)vb;
-	if (a->bmin[1] < b->bmin[1])
-		return -1;
-	if (a->bmin[1] > b->bmin[1])
-		return 1;
-	return 0;
-}
+	int axis;
+	inline bool operator()(const BoundsItem& a, const BoundsItem& b) const
+	{
+		if (a.bmin[axis] != b.bmin[axis])
+			return a.bmin[axis] < b.bmin[axis];
+		return a.i < b.i;
+	}
+};
 
 static void calcExtends(const BoundsItem* items, const int /*nitems*/,
 						const int imin, const int imax,
@@ -84,7 +76,7 @@ inline int longestAxis(float x, float y)
 
 static void subdivide(BoundsItem* items, int nitems, int imin, int imax, int trisPerChunk,
 					  int& curNode, rnsup::rcChunkyTriMeshNode* nodes, const int maxNodes,
-					  int& curTri, int* outTris, const int* inTris)
+					  int& curTri, int* outTris, const int* inTris, const int parentAxis)
 {
 	int inum = imax - imin;
 	int icur = curNode;
@@ -99,6 +91,16 @@ static void subdivide(BoundsItem* items, int nitems, int imin, int imax, int tri
 		// Leaf
 		calcExtends(items, nitems, imin, imax, node.bmin, node.bmax);
 		
+		// The parent only partitioned the items: sort the leaf along the
+		// parent axis, so that the triangles are in the same order as if the
+		// whole range was sorted.
+		if (parentAxis >= 0)
+		{
+			CompareItem compare;
+			compare.axis = parentAxis;
+			std::sort(items+imin, items+imax, compare);
+		}
+		
 		// Copy triangles.
 		node.i = curTri;
 		node.n = inum;
@@ -121,23 +123,17 @@ static void subdivide(BoundsItem* items, int nitems, int imin, int imax, int tri
 		int	axis = longestAxis(node.bmax[0] - node.bmin[0],
 							   node.bmax[1] - node.bmin[1]);
 		
-		if (axis == 0)
-		{
-			// Sort along x-axis
-			qsort(items+imin, static_cast<size_t>(inum), sizeof(BoundsItem), compareItemX);
-		}
-		else if (axis == 1)
-		{
-			// Sort along y-axis
-			qsort(items+imin, static_cast<size_t>(inum), sizeof(BoundsItem), compareItemY);
-		}
-		
+		// Partition around the median along the axis, a full sort is not
+		// needed to split.
 		int isplit = imin+inum/2;
+		CompareItem compare;
+		compare.axis = axis;
+		std::nth_element(items+imin, items+isplit, items+imax, compare);
 		
 		// Left
-		subdivide(items, nitems, imin, isplit, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, inTris);
+		subdivide(items, nitems, imin, isplit, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, inTris, axis);
 		// Right
-		subdivide(items, nitems, isplit, imax, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, inTris);
+		subdivide(items, nitems, isplit, imax, trisPerChunk, curNode, nodes, maxNodes, curTri, outTris, inTris, axis);
 		
 		int iescape = curNode - icur;
 		// Negative index means escape.
@@ -151,6 +147,15 @@ namespace rnsup
 bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
 						   int trisPerChunk, rcChunkyTriMesh* cm)
 {
+	if (!ntris)
+	{
+		// Empty mesh (i.e. only a terrain): no nodes.
+		cm->ntris = 0;
+		cm->nnodes = 0;
+		cm->maxTrisPerChunk = 0;
+		return true;
+	}
+	
 	int nchunks = (ntris + trisPerChunk-1) / trisPerChunk;
 
 	cm->nodes = new rcChunkyTriMeshNode[nchunks*4];
@@ -189,7 +194,7 @@ bool rcCreateChunkyTriMesh(const float* verts, const int* tris, int ntris,
 
 	int curTri = 0;
 	int curNode = 0;
-	subdivide(items, ntris, 0, ntris, trisPerChunk, curNode, cm->nodes, nchunks*4, curTri, cm->tris, tris);
+	subdivide(items, ntris, 0, ntris, trisPerChunk, curNode, cm->nodes, nchunks*4, curTri, cm->tris, tris, -1);
 	
 	delete [] items;
 	
@@ -181,7 +181,7 @@ void ConvexVolumeTool::handleClick(const float* /*s*/, const float* p, bool shif
 		const ConvexVolume* vols = geom->getConvexVolumes();
 		for (int i = 0; i < geom->getConvexVolumeCount(); ++i)
 		{
-			if (pointInPoly(vols[i].nverts, vols[i].verts, p) &&
+			if (pointInPoly(vols[i].nverts, vols[i].verts.data(), p) &&
 							p[1] >= vols[i].hmin && p[1] <= vols[i].hmax)
 			{
 				nearestIndex = i;
@@ -0,0 +1,343 @@
+/**
+ * \file GeomBucketStore.cpp
+ *
+ * \date 2026-10-19
+ * \author consultit
+ */
+
+#include <math.h>
+#include "GeomBucketStore.h"
+
+namespace rnsup
+{
+
+namespace
+{
+
+///Triangles buffered before being spilled.
+const int BUCKET_SPILL_TRIS = 4096;
+///Triangles sorted into buckets in memory per pass over the spill file (a
+///single bucket holding more is sorted alone).
+const int BUCKET_PASS_TRIS = 1 << 20;
+
+int seekBucketFile(FILE* fp, const long long offset)
+{
+#ifdef _WIN32
+	return _fseeki64(fp, offset, SEEK_SET);
+#else
+	return fseeko(fp, (off_t) offset, SEEK_SET);
+#endif
+}
+
+inline int clampBucket(const int v, const int mn, const int mx)
+{
+	return v < mn ? mn : (v > mx ? mx : v);
+}
+
+void calcTriangleBounds(const float* v, float* bmin, float* bmax)
+{
+	// xz-bounds of the triangle with vertices v[0..8].
+	bmin[0] = bmax[0] = v[0];
+	bmin[1] = bmax[1] = v[2];
+	for (int i = 1; i < 3; ++i)
+	{
+		const float* p = &v[i * 3];
+		bmin[0] = p[0] < bmin[0] ? p[0] : bmin[0];
+		bmax[0] = p[0] > bmax[0] ? p[0] : bmax[0];
+		bmin[1] = p[2] < bmin[1] ? p[2] : bmin[1];
+		bmax[1] = p[2] > bmax[1] ? p[2] : bmax[1];
+	}
+}
+
+}
+
+GeomBucketStore::GeomBucketStore() :
+		m_file(NULL), m_spill(NULL), m_bucketSize(0), m_width(0),
+		m_height(0), m_triCount(0), m_failed(false)
+{
+	m_bmin[0] = m_bmin[1] = 0;
+}
+
+GeomBucketStore::~GeomBucketStore()
+{
+	if (m_file)
+	{
+		fclose(m_file);
+	}
+	if (m_spill)
+	{
+		fclose(m_spill);
+		remove(m_spillPath.c_str());
+	}
+	if (!m_path.empty())
+	{
+		remove(m_path.c_str());
+	}
+}
+
+bool GeomBucketStore::create(const std::string& path, const float* bmin,
+		const float* bmax, const float bucketSize)
+{
+	if (m_file || !m_path.empty() || (bucketSize <= 0))
+	{
+		return false;
+	}
+	m_file = fopen(path.c_str(), "wb");
+	if (!m_file)
+	{
+		return false;
+	}
+	m_path = path;
+	m_spillPath = path + ".spill";
+	m_spill = fopen(m_spillPath.c_str(), "w+b");
+	if (!m_spill)
+	{
+		fclose(m_file);
+		m_file = NULL;
+		remove(m_path.c_str());
+		m_path.clear();
+		return false;
+	}
+	m_bmin[0] = bmin[0];
+	m_bmin[1] = bmin[2];
+	m_bucketSize = bucketSize;
+	m_width = (int) ceilf((bmax[0] - bmin[0]) / bucketSize);
+	m_height = (int) ceilf((bmax[2] - bmin[2]) / bucketSize);
+	m_width = m_width > 0 ? m_width : 1;
+	m_height = m_height > 0 ? m_height : 1;
+	Bucket empty = { 0, 0 };
+	m_buckets.assign(m_width * m_height, empty);
+	m_spillBuffer.reserve(BUCKET_SPILL_TRIS * 9);
+	return true;
+}
+
+void GeomBucketStore::getBucketRange(const float* bmin, const float* bmax,
+		int* r) const
+{
+	const float inv = 1.0f / m_bucketSize;
+	r[0] = clampBucket((int) floorf((bmin[0] - m_bmin[0]) * inv), 0, m_width - 1);
+	r[1] = clampBucket((int) floorf((bmin[1] - m_bmin[1]) * inv), 0, m_height - 1);
+	r[2] = clampBucket((int) floorf((bmax[0] - m_bmin[0]) * inv), 0, m_width - 1);
+	r[3] = clampBucket((int) floorf((bmax[1] - m_bmin[1]) * inv), 0, m_height - 1);
+}
+
+void GeomBucketStore::addTriangle(const float* v0, const float* v1,
+		const float* v2)
+{
+	if (!m_spill || m_failed)
+	{
+		return;
+	}
+	float v[9] =
+	{ v0[0], v0[1], v0[2], v1[0], v1[1], v1[2], v2[0], v2[1], v2[2] };
+	float tbmin[2], tbmax[2];
+	calcTriangleBounds(v, tbmin, tbmax);
+	int r[4];
+	getBucketRange(tbmin, tbmax, r);
+	for (int y = r[1]; y <= r[3]; ++y)
+	{
+		for (int x = r[0]; x <= r[2]; ++x)
+		{
+			++m_buckets[x + y * m_width].ntris;
+		}
+	}
+	m_spillBuffer.insert(m_spillBuffer.end(), v, v + 9);
+	if ((int) m_spillBuffer.size() >= BUCKET_SPILL_TRIS * 9)
+	{
+		flushSpill();
+	}
+	++m_triCount;
+}
+
+bool GeomBucketStore::flushSpill()
+{
+	if (m_spillBuffer.empty())
+	{
+		return true;
+	}
+	if (fwrite(&m_spillBuffer[0], sizeof(float), m_spillBuffer.size(), m_spill)
+			!= m_spillBuffer.size())
+	{
+		m_failed = true;
+		return false;
+	}
+	m_spillBuffer.clear();
+	return true;
+}
+
+bool GeomBucketStore::writeBuckets(FILE* spill, const int b0, const int b1,
+		std::vector<float>& buffer)
+{
+	// Bucket b goes at (m_buckets[b].offset - base) in the buffer: ntris is
+	// recounted while filling it.
+	const long long base = m_buckets[b0].offset;
+	const long long end = b1 < (int) m_buckets.size() ?
+			m_buckets[b1].offset : m_buckets[b1 - 1].offset
+					+ (long long) sizeof(float) * 9 * m_buckets[b1 - 1].ntris;
+	buffer.resize((size_t) ((end - base) / sizeof(float)));
+	for (int b = b0; b < b1; ++b)
+	{
+		m_buckets[b].ntris = 0;
+	}
+	if (seekBucketFile(spill, 0) != 0)
+	{
+		return false;
+	}
+	// The bucket rows touched by [b0, b1).
+	const int y0 = b0 / m_width, y1 = (b1 - 1) / m_width;
+	std::vector<float> block(BUCKET_SPILL_TRIS * 9);
+	size_t nread;
+	while ((nread = fread(&block[0], sizeof(float), block.size(), spill)) > 0)
+	{
+		for (size_t t = 0; t + 9 <= nread; t += 9)
+		{
+			const float* v = &block[t];
+			float tbmin[2], tbmax[2];
+			calcTriangleBounds(v, tbmin, tbmax);
+			int r[4];
+			getBucketRange(tbmin, tbmax, r);
+			if ((r[3] < y0) || (r[1] > y1))
+			{
+				continue;
+			}
+			for (int y = r[1]; y <= r[3]; ++y)
+			{
+				for (int x = r[0]; x <= r[2]; ++x)
+				{
+					const int b = x + y * m_width;
+					if ((b < b0) || (b >= b1))
+					{
+						continue;
+					}
+					Bucket& bucket = m_buckets[b];
+					float* dst = &buffer[(size_t) ((bucket.offset - base)
+							/ sizeof(float)) + bucket.ntris * 9];
+					for (int k = 0; k < 9; ++k)
+					{
+						dst[k] = v[k];
+					}
+					++bucket.ntris;
+				}
+			}
+		}
+	}
+	if (ferror(spill))
+	{
+		return false;
+	}
+	return buffer.empty()
+			|| (fwrite(&buffer[0], sizeof(float), buffer.size(), m_file)
+					== buffer.size());
+}
+
+bool GeomBucketStore::finish()
+{
+	if (!m_file)
+	{
+		return false;
+	}
+	if (!m_failed && flushSpill() && (fflush(m_spill) != 0))
+	{
+		m_failed = true;
+	}
+	std::vector<float>().swap(m_spillBuffer);
+	// Lay out the buckets one after the other, then write them a range at a
+	// time, each range sorted in memory.
+	long long offset = 0;
+	for (int b = 0; b < (int) m_buckets.size(); ++b)
+	{
+		m_buckets[b].offset = offset;
+		offset += (long long) sizeof(float) * 9 * m_buckets[b].ntris;
+	}
+	std::vector<float> buffer;
+	for (int b0 = 0, b1; (b0 < (int) m_buckets.size()) && !m_failed; b0 = b1)
+	{
+		long long ntris = m_buckets[b0].ntris;
+		for (b1 = b0 + 1; b1 < (int) m_buckets.size(); ++b1)
+		{
+			if (ntris + m_buckets[b1].ntris > BUCKET_PASS_TRIS)
+			{
+				break;
+			}
+			ntris += m_buckets[b1].ntris;
+		}
+		if ((ntris > 0) && !writeBuckets(m_spill, b0, b1, buffer))
+		{
+			m_failed = true;
+		}
+	}
+	fclose(m_spill);
+	m_spill = NULL;
+	remove(m_spillPath.c_str());
+	m_failed = (fclose(m_file) != 0) || m_failed;
+	m_file = NULL;
+	return !m_failed;
+}
+
+bool GeomBucketStore::loadTriangles(const float* bmin, const float* bmax,
+		std::vector<float>& verts, std::vector<int>& tris) const
+{
+	verts.clear();
+	tris.clear();
+	if (m_file || m_failed || m_path.empty())
+	{
+		return false;
+	}
+	FILE* fp = fopen(m_path.c_str(), "rb");
+	if (!fp)
+	{
+		return false;
+	}
+	int r[4];
+	getBucketRange(bmin, bmax, r);
+	std::vector<float> buffer;
+	bool result = true;
+	for (int y = r[1]; (y <= r[3]) && result; ++y)
+	{
+		for (int x = r[0]; (x <= r[2]) && result; ++x)
+		{
+			const Bucket& bucket = m_buckets[x + y * m_width];
+			if (bucket.ntris > 0)
+			{
+				buffer.resize(bucket.ntris * 9);
+				result = (seekBucketFile(fp, bucket.offset) == 0)
+						&& (fread(&buffer[0], sizeof(float), buffer.size(), fp)
+								== buffer.size());
+				for (int t = 0; (t < bucket.ntris) && result; ++t)
+				{
+					const float* v = &buffer[t * 9];
+					float tbmin[2], tbmax[2];
+					calcTriangleBounds(v, tbmin, tbmax);
+					if (tbmin[0] > bmax[0] || tbmax[0] < bmin[0]
+							|| tbmin[1] > bmax[1] || tbmax[1] < bmin[1])
+					{
+						continue;
+					}
+					// A triangle is met in all the buckets it spans: load it
+					// only from the first one shared with the area.
+					int tr[4];
+					getBucketRange(tbmin, tbmax, tr);
+					if ((x != (tr[0] > r[0] ? tr[0] : r[0]))
+							|| (y != (tr[1] > r[1] ? tr[1] : r[1])))
+					{
+						continue;
+					}
+					for (int k = 0; k < 3; ++k)
+					{
+						tris.push_back((int) verts.size() / 3);
+						verts.insert(verts.end(), v + k * 3, v + k * 3 + 3);
+					}
+				}
+			}
+		}
+	}
+	fclose(fp);
+	if (!result)
+	{
+		verts.clear();
+		tris.clear();
+	}
+	return result;
+}
+
+} // namespace rnsup
@@ -0,0 +1,83 @@
+/**
+ * \file GeomBucketStore.h
+ *
+ * \date 2026-10-19
+ * \author consultit
+ */
+
+#ifndef GEOMBUCKETSTORE_H_
+#define GEOMBUCKETSTORE_H_
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace rnsup
+{
+
+///On-disk triangle store, bucketed by a regular grid on the xz-plane: each
+///triangle is stored (as its 3 vertices) in every bucket its bounds overlap.
+///Triangles are streamed in, then the ones overlapping an area are loaded
+///reading only the buckets it covers, so memory scales with the area and not
+///with the whole geometry.
+///While streaming, triangles are spilled as they come to a side file and only
+///counted per bucket; finish() then writes each bucket contiguously, a range
+///of buckets at a time, so the memory used in building is bounded too.
+class GeomBucketStore
+{
+public:
+	GeomBucketStore();
+	///Removes the store file.
+	~GeomBucketStore();
+
+	///Creates the store file at path, with a grid of bucketSize x bucketSize
+	///buckets over the bounds [bmin, bmax].
+	bool create(const std::string& path, const float* bmin, const float* bmax,
+			const float bucketSize);
+	///Adds a triangle: it should be within the bounds.
+	void addTriangle(const float* v0, const float* v1, const float* v2);
+	///Sorts the spilled triangles into buckets: only then the store can be
+	///loaded.
+	bool finish();
+
+	int getTriCount() const { return m_triCount; }
+	const std::string& getPath() const { return m_path; }
+
+	///Loads the triangles overlapping the xz-bounds [bmin, bmax] (2D), each
+	///once, as unindexed vertices (tris[i] = i). Can be called concurrently.
+	bool loadTriangles(const float* bmin, const float* bmax,
+			std::vector<float>& verts, std::vector<int>& tris) const;
+
+private:
+	///Where the triangles of a bucket are in the store file.
+	struct Bucket
+	{
+		long long offset;
+		int ntris;
+	};
+
+	void getBucketRange(const float* bmin, const float* bmax, int* r) const;
+	bool flushSpill();
+	///Writes the buckets [b0, b1) reading back the whole spill file.
+	bool writeBuckets(FILE* spill, const int b0, const int b1,
+			std::vector<float>& buffer);
+
+	std::string m_path, m_spillPath;
+	FILE* m_file;
+	FILE* m_spill;
+	std::vector<float> m_spillBuffer;
+	float m_bmin[2];
+	float m_bucketSize;
+	int m_width, m_height;
+	std::vector<Bucket> m_buckets;
+	int m_triCount;
+	bool m_failed;
+
+	// Explicitly disabled copy constructor and copy assignment operator.
+	GeomBucketStore(const GeomBucketStore&);
+	GeomBucketStore& operator=(const GeomBucketStore&);
+};
+
+} // namespace rnsup
+
+#endif /* GEOMBUCKETSTORE_H_ */
@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <string.h>
+#include <float.h>
 #include <algorithm>
 #include <Recast.h>
 #include <DebugDraw.h>
@@ -35,48 +36,9 @@
 #include "NavMeshType.h"
 #include "InputGeom.h"
 #include "ChunkyTriMesh.h"
+#include "TriMeshBVH.h"
 #include "MeshLoaderObj.h"
 
-static bool intersectSegmentTriangle(const float* sp, const float* sq,
-									 const float* a, const float* b, const float* c,
-									 float &t)
-{
-	float v, w;
-	float ab[3], ac[3], qp[3], ap[3], norm[3], e[3];
-	rcVsub(ab, b, a);
-	rcVsub(ac, c, a);
-	rcVsub(qp, sp, sq);
-	
-	// Compute triangle normal. Can be precalculated or cached if
-	// intersecting multiple segments against the same triangle
-	rcVcross(norm, ab, ac);
-	
-	// Compute denominator d. If d <= 0, segment is parallel to or points
-	// away from triangle, so exit early
-	float d = rcVdot(qp, norm);
-	if (d <= 0.0f) return false;
-	
-	// Compute intersection t value of pq with plane of triangle. A ray
-	// intersects iff 0 <= t. Segment intersects iff 0 <= t <= 1. Delay
-	// dividing by d until intersection has been found to pierce triangle
-	rcVsub(ap, sp, a);
-	t = rcVdot(ap, norm);
-	if (t < 0.0f) return false;
-	if (t > d) return false; // For segment; exclude this code line for a ray test
-	
-	// Compute barycentric coordinate components and test if within bounds
-	rcVcross(e, qp, ap);
-	v = rcVdot(ac, e);
-	if (v < 0.0f || v > d) return false;
-	w = -rcVdot(ab, e);
-	if (w < 0.0f || v + w > d) return false;
-	
-	// Segment/ray intersects triangle. Perform delayed division
-	t /= d;
-	
-	return true;
-}
-
 static char* parseRow(char* buf, char* bufEnd, char* row, int len)
 {
 	bool start = true;
@@ -112,34 +74,204 @@ static char* parseRow(char* buf, char* bufEnd, char* row, int len)
 
 namespace rnsup
 {
+static const int MAX_ITEMGRID_SIZE = 1024;
+
+ItemGrid2D::ItemGrid2D() :
+	m_ics(1.0f),
+	m_width(0),
+	m_height(0)
+{
+	m_bmin[0] = m_bmin[1] = 0.0f;
+}
+
+static inline int itemGridCoord(const float v, const float orig, const float ics, const int size)
+{
+	const float f = (v - orig) * ics;
+	if (!(f > 0.0f))
+		return 0;
+	if (f >= (float)size)
+		return size-1;
+	return (int)f;
+}
+
+inline void ItemGrid2D::getCellRange(const float* b, int* r) const
+{
+	r[0] = itemGridCoord(b[0], m_bmin[0], m_ics, m_width);
+	r[1] = itemGridCoord(b[1], m_bmin[1], m_ics, m_height);
+	r[2] = itemGridCoord(b[2], m_bmin[0], m_ics, m_width);
+	r[3] = itemGridCoord(b[3], m_bmin[1], m_ics, m_height);
+}
+
+void ItemGrid2D::clear()
+{
+	m_width = m_height = 0;
+	m_cellStart.clear();
+	m_cellItems.clear();
+	m_bounds.clear();
+}
+
+void ItemGrid2D::build(const float* bounds, const int n)
+{
+	clear();
+	if (n <= 0)
+		return;
+	m_bounds.assign(bounds, bounds + n*4);
+	
+	float bmax[2];
+	m_bmin[0] = bmax[0] = bounds[0];
+	m_bmin[1] = bmax[1] = bounds[1];
+	for (int i = 0; i < n; ++i)
+	{
+		const float* b = &bounds[i*4];
+		m_bmin[0] = rcMin(m_bmin[0], b[0]);
+		m_bmin[1] = rcMin(m_bmin[1], b[1]);
+		bmax[0] = rcMax(bmax[0], b[2]);
+		bmax[1] = rcMax(bmax[1], b[3]);
+	}
+	
+	// About one cell per item. Cells are made coarser while the items
+	// spanning many cells would store too many entries.
+	const float w = bmax[0] - m_bmin[0];
+	const float h = bmax[1] - m_bmin[1];
+	float cs = sqrtf(w*h / (float)n);
+	cs = rcMax(cs, rcMax(w, h) / (float)(MAX_ITEMGRID_SIZE-1));
+	cs = rcMax(cs, 1e-3f);
+	long long entries = 0;
+	for (;;)
+	{
+		m_ics = 1.0f / cs;
+		m_width = rcMin((int)(w * m_ics) + 1, MAX_ITEMGRID_SIZE);
+		m_height = rcMin((int)(h * m_ics) + 1, MAX_ITEMGRID_SIZE);
+		entries = 0;
+		for (int i = 0; i < n; ++i)
+		{
+			int r[4];
+			getCellRange(&bounds[i*4], r);
+			entries += (long long)(r[2]-r[0]+1) * (r[3]-r[1]+1);
+		}
+		if (entries <= 16LL*n || (m_width == 1 && m_height == 1))
+			break;
+		cs *= 2.0f;
+	}
+	
+	// Bucket the items by cell, in ascending order within each cell.
+	const int ncells = m_width*m_height;
+	m_cellStart.assign(ncells+1, 0);
+	for (int i = 0; i < n; ++i)
+	{
+		int r[4];
+		getCellRange(&bounds[i*4], r);
+		for (int y = r[1]; y <= r[3]; ++y)
+			for (int x = r[0]; x <= r[2]; ++x)
+				m_cellStart[x + y*m_width + 1]++;
+	}
+	for (int c = 0; c < ncells; ++c)
+		m_cellStart[c+1] += m_cellStart[c];
+	m_cellItems.resize((size_t)entries);
+	std::vector<int> fill(m_cellStart.begin(), m_cellStart.end()-1);
+	for (int i = 0; i < n; ++i)
+	{
+		int r[4];
+		getCellRange(&bounds[i*4], r);
+		for (int y = r[1]; y <= r[3]; ++y)
+			for (int x = r[0]; x <= r[2]; ++x)
+				m_cellItems[fill[x + y*m_width]++] = i;
+	}
+}
+
+void ItemGrid2D::query(const float* bmin, const float* bmax, std::vector<int>& items) const
+{
+	if (m_cellStart.empty())
+		return;
+	const float q[4] = { bmin[0], bmin[2], bmax[0], bmax[2] };
+	int qr[4];
+	getCellRange(q, qr);
+	
+	const size_t first = items.size();
+	for (int y = qr[1]; y <= qr[3]; ++y)
+	{
+		for (int x = qr[0]; x <= qr[2]; ++x)
+		{
+			const int c = x + y*m_width;
+			for (int k = m_cellStart[c]; k < m_cellStart[c+1]; ++k)
+			{
+				const int i = m_cellItems[k];
+				const float* b = &m_bounds[i*4];
+				if (b[0] > q[2] || b[2] < q[0] || b[1] > q[3] || b[3] < q[1])
+					continue;
+				// An item is met in all the cells it spans: report it only
+				// in the first cell shared with the query.
+				int r[4];
+				getCellRange(b, r);
+				if (x != rcMax(r[0], qr[0]) || y != rcMax(r[1], qr[1]))
+					continue;
+				items.push_back(i);
+			}
+		}
+	}
+	std::sort(items.begin() + first, items.end());
+}
+
+static void calcConvexVolumeBounds(const ConvexVolume* vol, float* bmin, float* bmax)
+{
+	if (vol->nverts <= 0)
+	{
+		bmin[0] = bmin[1] = bmin[2] = FLT_MAX;
+		bmax[0] = bmax[1] = bmax[2] = -FLT_MAX;
+		return;
+	}
+	rcCalcBounds(vol->verts.data(), vol->nverts, bmin, bmax);
+}
+
 InputGeom::InputGeom() :
 	m_chunkyMesh(0),
+	m_bvh(0),
 	m_mesh(0),
+	m_store(0),
+	m_terrain(0),
 	m_hasBuildSettings(false),
 	m_offMeshConCount(0),
-	m_volumeCount(0)
+	m_offMeshConGridDirty(false),
+	m_volumeCount(0),
+	m_volumeGridDirty(false)
 {
 }
 
 InputGeom::~InputGeom()
 {
 	delete m_chunkyMesh;
+	delete m_bvh;
+	delete m_mesh;
+	delete m_store;
+	delete m_terrain;
+}
+
+void InputGeom::resetMesh()
+{
+	delete m_chunkyMesh;
+	m_chunkyMesh = 0;
+	delete m_bvh;
+	m_bvh = 0;
 	delete m_mesh;
+	m_mesh = 0;
+	delete m_store;
+	m_store = 0;
+	delete m_terrain;
+	m_terrain = 0;
+	resizeOffMeshConnections(0);
+	m_offMeshConGrid.clear();
+	m_offMeshConGridDirty = false;
+	m_volumes.clear();
+	m_volumeCount = 0;
+	m_volumeGrid.clear();
+	m_volumeGridDirty = false;
 }
 		
 bool InputGeom::loadMesh(rcContext* ctx, const std::string& filepath,
 		NodePath model, NodePath referenceNP, rcMeshLoaderObj* mesh,
 		float scale, float* translation)
 {
-	if (m_mesh)
-	{
-		delete m_chunkyMesh;
-		m_chunkyMesh = 0;
-		delete m_mesh;
-		m_mesh = 0;
-	}
-	m_offMeshConCount = 0;
-	m_volumeCount = 0;
+	resetMesh();
 	
 	m_mesh = new rcMeshLoaderObj;
 	if (!m_mesh)
@@ -178,7 +310,16 @@ bool InputGeom::loadMesh(rcContext* ctx, const std::string& filepath,
 		return false;
 	}
 
-	rcCalcBounds(m_mesh->getVerts(), m_mesh->getVertCount(), m_meshBMin, m_meshBMax);
+	if (m_mesh->getVertCount())
+	{
+		rcCalcBounds(m_mesh->getVerts(), m_mesh->getVertCount(), m_meshBMin, m_meshBMax);
+	}
+	else
+	{
+		// Empty bounds: there could be only a terrain.
+		m_meshBMin[0] = m_meshBMin[1] = m_meshBMin[2] = FLT_MAX;
+		m_meshBMax[0] = m_meshBMax[1] = m_meshBMax[2] = -FLT_MAX;
+	}
 
 	m_chunkyMesh = new rcChunkyTriMesh;
 	if (!m_chunkyMesh)
@@ -195,6 +336,81 @@ bool InputGeom::loadMesh(rcContext* ctx, const std::string& filepath,
 	return true;
 }
 
+bool InputGeom::loadMeshStreamed(rcContext* ctx, NodePath model,
+		NodePath referenceNP, const std::string& storePath,
+		const float bucketSize)
+{
+	resetMesh();
+	
+	// Empty: the triangles are in the store.
+	m_mesh = new rcMeshLoaderObj;
+	if (!rcMeshLoaderObj::calcBounds(model, referenceNP, m_meshBMin, m_meshBMax))
+	{
+		// Nothing to stream: the mesh is loaded empty, as there could be
+		// only a terrain (the caller checks there is some geometry).
+		return loadMesh(ctx, std::string(), model, referenceNP);
+	}
+	m_store = new GeomBucketStore;
+	if (!m_store->create(storePath, m_meshBMin, m_meshBMax, bucketSize))
+	{
+		CTXLOG1(ctx, RC_LOG_ERROR, "loadMeshStreamed: Could not create '%s'.", storePath.c_str());
+		delete m_store;
+		m_store = 0;
+		return false;
+	}
+	if (!rcMeshLoaderObj::stream(model, referenceNP, *m_store) || !m_store->finish())
+	{
+		CTXLOG1(ctx, RC_LOG_ERROR, "loadMeshStreamed: Could not write '%s'.", storePath.c_str());
+		delete m_store;
+		m_store = 0;
+		return false;
+	}
+	
+	return true;
+}
+
+void InputGeom::setTerrain(TerrainHeightfield* terrain)
+{
+	delete m_terrain;
+	m_terrain = terrain;
+	if (m_terrain)
+	{
+		rcVmin(m_meshBMin, m_terrain->getBoundsMin());
+		rcVmax(m_meshBMax, m_terrain->getBoundsMax());
+	}
+}
+
+bool InputGeom::reloadMesh(rcContext* ctx, rcMeshLoaderObj* mesh)
+{
+	rcChunkyTriMesh* chunkyMesh = new rcChunkyTriMesh;
+	if (!chunkyMesh)
+	{
+		CTXLOG(ctx, RC_LOG_ERROR, "reloadMesh: Out of memory 'chunkyMesh'.");
+		delete mesh;
+		return false;
+	}
+	if (!rcCreateChunkyTriMesh(mesh->getVerts(), mesh->getTris(), mesh->getTriCount(), 256, chunkyMesh))
+	{
+		CTXLOG(ctx, RC_LOG_ERROR, "reloadMesh: Failed to build chunky mesh.");
+		delete chunkyMesh;
+		delete mesh;
+		return false;
+	}
+	
+	// The bounds are kept, so are the tiles: geometry outside them is
+	// ignored.
+	delete m_chunkyMesh;
+	m_chunkyMesh = chunkyMesh;
+	delete m_bvh;
+	m_bvh = 0;
+	delete m_mesh;
+	m_mesh = mesh;
+	delete m_store;
+	m_store = 0;
+	
+	return true;
+}
+
 bool InputGeom::loadGeomSet(rcContext* ctx, const std::string& filepath)
 {
 	char* buf = 0;
@@ -234,7 +450,8 @@ bool InputGeom::loadGeomSet(rcContext* ctx, const std::string& filepath)
 		return false;
 	}
 	
-	m_offMeshConCount = 0;
+	resizeOffMeshConnections(0);
+	m_volumes.clear();
 	m_volumeCount = 0;
 	delete m_mesh;
 	m_mesh = 0;
@@ -266,33 +483,30 @@ bool InputGeom::loadGeomSet(rcContext* ctx, const std::string& filepath)
 		else if (row[0] == 'c')
 		{
 			// Off-mesh connection
-			if (m_offMeshConCount < MAX_OFFMESH_CONNECTIONS)
-			{
-				float* v = &m_offMeshConVerts[m_offMeshConCount*3*2];
-				int bidir, area = 0, flags = 0;
-				float rad;
-				sscanf(row+1, "%f %f %f  %f %f %f %f %d %d %d",
-					   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &rad, &bidir, &area, &flags);
-				m_offMeshConRads[m_offMeshConCount] = rad;
-				m_offMeshConDirs[m_offMeshConCount] = (unsigned char)bidir;
-				m_offMeshConAreas[m_offMeshConCount] = (unsigned char)area;
-				m_offMeshConFlags[m_offMeshConCount] = (unsigned short)flags;
-				m_offMeshConCount++;
-			}
+			float v[6];
+			int bidir, area = 0, flags = 0;
+			float rad;
+			sscanf(row+1, "%f %f %f  %f %f %f %f %d %d %d",
+				   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &rad, &bidir, &area, &flags);
+			addOffMeshConnection(&v[0], &v[3], rad, (unsigned char)bidir,
+								 (unsigned char)area, (unsigned short)flags);
 		}
 		else if (row[0] == 'v')
 		{
 			// Convex volumes
-			if (m_volumeCount < MAX_VOLUMES)
+			m_volumes.push_back(ConvexVolume());
+			m_volumeCount++;
+			m_volumeGridDirty = true;
+			ConvexVolume* vol = &m_volumes.back();
+			vol->nverts = 0;
+			sscanf(row+1, "%d %d %f %f", &vol->nverts, &vol->area, &vol->hmin, &vol->hmax);
+			vol->nverts = rcMax(vol->nverts, 0);
+			vol->verts.resize(vol->nverts*3);
+			for (int i = 0; i < vol->nverts; ++i)
 			{
-				ConvexVolume* vol = &m_volumes[m_volumeCount++];
-				sscanf(row+1, "%d %d %f %f", &vol->nverts, &vol->area, &vol->hmin, &vol->hmax);
-				for (int i = 0; i < vol->nverts; ++i)
-				{
-					row[0] = '\0';
-					src = parseRow(src, srcEnd, row, sizeof(row)/sizeof(char));
-					sscanf(row, "%f %f %f", &vol->verts[i*3+0], &vol->verts[i*3+1], &vol->verts[i*3+2]);
-				}
+				row[0] = '\0';
+				src = parseRow(src, srcEnd, row, sizeof(row)/sizeof(char));
+				sscanf(row, "%f %f %f", &vol->verts[i*3+0], &vol->verts[i*3+1], &vol->verts[i*3+2]);
 			}
 		}
 		else if (row[0] == 's')
@@ -407,7 +621,7 @@ bool InputGeom::saveGeomSet(const BuildSettings* settings)
 	// Convex volumes
 	for (int i = 0; i < m_volumeCount; ++i)
 	{
-		ConvexVolume* vol = &m_volumes[i];
+		const ConvexVolume* vol = &m_volumes[i];
 		fprintf(fp, "v %d %d %f %f\n", vol->nverts, vol->area, vol->hmin, vol->hmax);
 		for (int j = 0; j < vol->nverts; ++j)
 			fprintf(fp, "%f %f %f\n", vol->verts[j*3+0], vol->verts[j*3+1], vol->verts[j*3+2]);
@@ -456,80 +670,148 @@ static bool isectSegAABB(const float* sp, const float* sq,
 
 namespace rnsup
 {
+bool InputGeom::buildBVH()
+{
+	if (m_bvh)
+		return true;
+	if (!m_mesh || !m_mesh->getTriCount())
+		return false;
+	m_bvh = new rcTriMeshBVH;
+	if (!m_bvh)
+		return false;
+	if (!rcCreateTriMeshBVH(m_mesh->getVerts(), m_mesh->getTris(), m_mesh->getTriCount(), 2, m_bvh))
+	{
+		delete m_bvh;
+		m_bvh = 0;
+		return false;
+	}
+	return true;
+}
+
 bool InputGeom::raycastMesh(float* src, float* dst, float& tmin)
 {
-	float dir[3];
-	rcVsub(dir, dst, src);
+	// The BVH is built on the first raycast.
+	if (!buildBVH())
+		return false;
 
 	// Prune hit ray.
 	float btmin, btmax;
 	if (!isectSegAABB(src, dst, m_meshBMin, m_meshBMax, btmin, btmax))
 		return false;
-	float p[2], q[2];
-	p[0] = src[0] + (dst[0]-src[0])*btmin;
-	p[1] = src[2] + (dst[2]-src[2])*btmin;
-	q[0] = src[0] + (dst[0]-src[0])*btmax;
-	q[1] = src[2] + (dst[2]-src[2])*btmax;
-	
-	int cid[512];
-	const int ncid = rcGetChunksOverlappingSegment(m_chunkyMesh, p, q, cid, 512);
-	if (!ncid)
-		return false;
-	
-	tmin = 1.0f;
-	bool hit = false;
-	const float* verts = m_mesh->getVerts();
-	
-	for (int i = 0; i < ncid; ++i)
-	{
-		const rcChunkyTriMeshNode& node = m_chunkyMesh->nodes[cid[i]];
-		const int* tris = &m_chunkyMesh->tris[node.i*3];
-		const int ntris = node.n;
 
-		for (int j = 0; j < ntris*3; j += 3)
-		{
-			float t = 1;
-			if (intersectSegmentTriangle(src, dst,
-										 &verts[tris[j]*3],
-										 &verts[tris[j+1]*3],
-										 &verts[tris[j+2]*3], t))
-			{
-				if (t < tmin)
-					tmin = t;
-				hit = true;
-			}
-		}
+	return rcRaycastTriMeshBVH(m_bvh, src, dst, tmin);
+}
+
+int InputGeom::raycastMeshBatch(const float* src, const float* dst, const int nrays,
+								float* tmins, unsigned char* hits)
+{
+	int nhits = 0;
+	for (int i = 0; i < nrays; ++i)
+	{
+		float sp[3], sq[3];
+		rcVcopy(sp, &src[i*3]);
+		rcVcopy(sq, &dst[i*3]);
+		float t = 1.0f;
+		const bool hit = raycastMesh(sp, sq, t);
+		tmins[i] = hit ? t : 1.0f;
+		if (hits)
+			hits[i] = hit ? 1 : 0;
+		if (hit)
+			nhits++;
 	}
-	
-	return hit;
+	return nhits;
+}
+
+void InputGeom::resizeOffMeshConnections(const int n)
+{
+	m_offMeshConVerts.resize(n*3*2);
+	m_offMeshConRads.resize(n);
+	m_offMeshConDirs.resize(n);
+	m_offMeshConAreas.resize(n);
+	m_offMeshConFlags.resize(n);
+	m_offMeshConId.resize(n);
+	m_offMeshConCount = n;
+	m_offMeshConGridDirty = true;
 }
 
 void InputGeom::addOffMeshConnection(const float* spos, const float* epos, const float rad,
 									 unsigned char bidir, unsigned char area, unsigned short flags)
 {
-	if (m_offMeshConCount >= MAX_OFFMESH_CONNECTIONS) return;
-	float* v = &m_offMeshConVerts[m_offMeshConCount*3*2];
-	m_offMeshConRads[m_offMeshConCount] = rad;
-	m_offMeshConDirs[m_offMeshConCount] = bidir;
-	m_offMeshConAreas[m_offMeshConCount] = area;
-	m_offMeshConFlags[m_offMeshConCount] = flags;
-	m_offMeshConId[m_offMeshConCount] = 1000 + m_offMeshConCount;
+	const int i = m_offMeshConCount;
+	resizeOffMeshConnections(i+1);
+	float* v = &m_offMeshConVerts[i*3*2];
+	m_offMeshConRads[i] = rad;
+	m_offMeshConDirs[i] = bidir;
+	m_offMeshConAreas[i] = area;
+	m_offMeshConFlags[i] = flags;
+	m_offMeshConId[i] = 1000 + i;
 	rcVcopy(&v[0], spos);
 	rcVcopy(&v[3], epos);
-	m_offMeshConCount++;
 }
 
 void InputGeom::deleteOffMeshConnection(int i)
 {
-	m_offMeshConCount--;
-	float* src = &m_offMeshConVerts[m_offMeshConCount*3*2];
+	const int last = m_offMeshConCount-1;
+	float* src = &m_offMeshConVerts[last*3*2];
 	float* dst = &m_offMeshConVerts[i*3*2];
 	rcVcopy(&dst[0], &src[0]);
 	rcVcopy(&dst[3], &src[3]);
-	m_offMeshConRads[i] = m_offMeshConRads[m_offMeshConCount];
-	m_offMeshConDirs[i] = m_offMeshConDirs[m_offMeshConCount];
-	m_offMeshConAreas[i] = m_offMeshConAreas[m_offMeshConCount];
-	m_offMeshConFlags[i] = m_offMeshConFlags[m_offMeshConCount];
+	m_offMeshConRads[i] = m_offMeshConRads[last];
+	m_offMeshConDirs[i] = m_offMeshConDirs[last];
+	m_offMeshConAreas[i] = m_offMeshConAreas[last];
+	m_offMeshConFlags[i] = m_offMeshConFlags[last];
+	// The ids aren't moved: they stay 1000 + index, so they are unique.
+	resizeOffMeshConnections(last);
+}
+
+int InputGeom::gatherOffMeshConnections(const float* bmin, const float* bmax, OffMeshConnectionSet& set) const
+{
+	// Connection indexes, from the endpoints in the bounds.
+	std::vector<int>& items = set.items;
+	items.clear();
+	if (!m_offMeshConGridDirty)
+	{
+		m_offMeshConGrid.query(bmin, bmax, items);
+		for (int i = 0; i < (int)items.size(); ++i)
+			items[i] >>= 1;
+		items.erase(std::unique(items.begin(), items.end()), items.end());
+	}
+	else
+	{
+		for (int i = 0; i < m_offMeshConCount; ++i)
+		{
+			const float* v = &m_offMeshConVerts[i*3*2];
+			for (int j = 0; j < 2; ++j)
+			{
+				const float* p = &v[j*3];
+				if (p[0] >= bmin[0] && p[0] <= bmax[0] && p[2] >= bmin[2] && p[2] <= bmax[2])
+				{
+					items.push_back(i);
+					break;
+				}
+			}
+		}
+	}
+	
+	const int n = (int)items.size();
+	set.verts.resize(n*3*2);
+	set.rads.resize(n);
+	set.dirs.resize(n);
+	set.areas.resize(n);
+	set.flags.resize(n);
+	set.ids.resize(n);
+	for (int k = 0; k < n; ++k)
+	{
+		const int i = items[k];
+		memcpy(&set.verts[k*3*2], &m_offMeshConVerts[i*3*2], sizeof(float)*3*2);
+		set.rads[k] = m_offMeshConRads[i];
+		set.dirs[k] = m_offMeshConDirs[i];
+		set.areas[k] = m_offMeshConAreas[i];
+		set.flags[k] = m_offMeshConFlags[i];
+		set.ids[k] = m_offMeshConId[i];
+	}
+	set.count = n;
+	return n;
 }
 
 void InputGeom::drawOffMeshConnections(duDebugDraw* dd, bool hilight)
@@ -566,10 +848,11 @@ void InputGeom::drawOffMeshConnections(duDebugDraw* dd, bool hilight)
 void InputGeom::addConvexVolume(const float* verts, const int nverts,
 								const float minh, const float maxh, unsigned char area)
 {
-	if (m_volumeCount >= MAX_VOLUMES) return;
-	ConvexVolume* vol = &m_volumes[m_volumeCount++];
-	memset(vol, 0, sizeof(ConvexVolume));
-	memcpy(vol->verts, verts, sizeof(float)*3*nverts);
+	m_volumes.push_back(ConvexVolume());
+	m_volumeCount++;
+	m_volumeGridDirty = true;
+	ConvexVolume* vol = &m_volumes.back();
+	vol->verts.assign(verts, verts + 3*nverts);
 	vol->hmin = minh;
 	vol->hmax = maxh;
 	vol->nverts = nverts;
@@ -579,7 +862,78 @@ void InputGeom::addConvexVolume(const float* verts, const int nverts,
 void InputGeom::deleteConvexVolume(int i)
 {
 	m_volumeCount--;
-	m_volumes[i] = m_volumes[m_volumeCount];
+	if (i != m_volumeCount)
+		m_volumes[i].verts.swap(m_volumes[m_volumeCount].verts);
+	m_volumes[i].hmin = m_volumes[m_volumeCount].hmin;
+	m_volumes[i].hmax = m_volumes[m_volumeCount].hmax;
+	m_volumes[i].nverts = m_volumes[m_volumeCount].nverts;
+	m_volumes[i].area = m_volumes[m_volumeCount].area;
+	m_volumes.pop_back();
+	m_volumeGridDirty = true;
+}
+
+void InputGeom::queryConvexVolumes(const float* bmin, const float* bmax, std::vector<int>& volumes) const
+{
+	if (!m_volumeGridDirty)
+	{
+		m_volumeGrid.query(bmin, bmax, volumes);
+		return;
+	}
+	for (int i = 0; i < m_volumeCount; ++i)
+	{
+		const ConvexVolume* vol = &m_volumes[i];
+		float vmin[3], vmax[3];
+		calcConvexVolumeBounds(vol, vmin, vmax);
+		if (vmin[0] <= bmax[0] && vmax[0] >= bmin[0] && vmin[2] <= bmax[2] && vmax[2] >= bmin[2])
+			volumes.push_back(i);
+	}
+}
+
+void InputGeom::markConvexVolumes(rcContext* ctx, rcCompactHeightfield& chf) const
+{
+	// Volumes are marked in index order: later ones win where they overlap.
+	std::vector<int> volumes;
+	queryConvexVolumes(chf.bmin, chf.bmax, volumes);
+	for (int k = 0; k < (int)volumes.size(); ++k)
+	{
+		const ConvexVolume* vol = &m_volumes[volumes[k]];
+		rcMarkConvexPolyArea(ctx, vol->verts.data(), vol->nverts, vol->hmin, vol->hmax,
+							 (unsigned char)vol->area, chf);
+	}
+}
+
+void InputGeom::updateSpatialIndexes()
+{
+	if (m_offMeshConGridDirty)
+	{
+		std::vector<float> bounds(m_offMeshConCount*2*4);
+		for (int i = 0; i < m_offMeshConCount*2; ++i)
+		{
+			const float* p = &m_offMeshConVerts[i*3];
+			bounds[i*4+0] = p[0];
+			bounds[i*4+1] = p[2];
+			bounds[i*4+2] = p[0];
+			bounds[i*4+3] = p[2];
+		}
+		m_offMeshConGrid.build(bounds.data(), m_offMeshConCount*2);
+		m_offMeshConGridDirty = false;
+	}
+	if (m_volumeGridDirty)
+	{
+		std::vector<float> bounds(m_volumeCount*4);
+		for (int i = 0; i < m_volumeCount; ++i)
+		{
+			const ConvexVolume* vol = &m_volumes[i];
+			float vmin[3], vmax[3];
+			calcConvexVolumeBounds(vol, vmin, vmax);
+			bounds[i*4+0] = vmin[0];
+			bounds[i*4+1] = vmin[2];
+			bounds[i*4+2] = vmax[0];
+			bounds[i*4+3] = vmax[2];
+		}
+		m_volumeGrid.build(bounds.data(), m_volumeCount);
+		m_volumeGridDirty = false;
+	}
 }
 
 void InputGeom::drawConvexVolumes(struct duDebugDraw* dd, bool /*hilight*/)
@@ -30,19 +30,59 @@
 #include <Recast.h>
 #include <DebugDraw.h>
 #include "ChunkyTriMesh.h"
+#include "TriMeshBVH.h"
 #include "MeshLoaderObj.h"
+#include "GeomBucketStore.h"
+#include "TerrainHeightfield.h"
+#include <vector>
 
 namespace rnsup
 {
-static const int MAX_CONVEXVOL_PTS = 12;
 struct ConvexVolume
 {
-	float verts[MAX_CONVEXVOL_PTS*3];
+	std::vector<float> verts;	///< [(x, y, z) * nverts]
 	float hmin, hmax;
 	int nverts;
 	int area;
 };
 
+/// Uniform grid over the xz-plane, indexing items by their xz-bounds, to
+/// gather the items overlapping an area in time proportional to the local
+/// density. Queries are const and can run concurrently.
+class ItemGrid2D
+{
+	float m_bmin[2];
+	float m_ics;					///< Inverse cell size.
+	int m_width, m_height;
+	std::vector<int> m_cellStart;	///< Per cell: first index into m_cellItems. [Size: width*height+1]
+	std::vector<int> m_cellItems;	///< Items of each cell, in ascending order.
+	std::vector<float> m_bounds;	///< Per item: (minx, minz, maxx, maxz).
+
+	inline void getCellRange(const float* b, int* r) const;
+public:
+	ItemGrid2D();
+	/// Builds the grid over n items, given their bounds. [(minx, minz, maxx, maxz) * n]
+	void build(const float* bounds, const int n);
+	void clear();
+	/// Appends, in ascending order and without duplicates, the items whose
+	/// bounds overlap the xz-bounds [bmin, bmax].
+	void query(const float* bmin, const float* bmax, std::vector<int>& items) const;
+};
+
+/// Off-mesh connections gathered for a tile, in the layout expected by
+/// dtNavMeshCreateParams.
+struct OffMeshConnectionSet
+{
+	std::vector<float> verts;
+	std::vector<float> rads;
+	std::vector<unsigned char> dirs;
+	std::vector<unsigned char> areas;
+	std::vector<unsigned short> flags;
+	std::vector<unsigned int> ids;
+	std::vector<int> items;		///< Scratch: gathered connection indexes.
+	int count;
+};
+
 struct BuildSettings
 {
 	// Cell size in world units
@@ -84,31 +124,40 @@ struct BuildSettings
 class InputGeom
 {
 	rcChunkyTriMesh* m_chunkyMesh;
+	rcTriMeshBVH* m_bvh;
 	rcMeshLoaderObj* m_mesh;
+	GeomBucketStore* m_store;
+	TerrainHeightfield* m_terrain;
 	float m_meshBMin[3], m_meshBMax[3];
 	BuildSettings m_buildSettings;
 	bool m_hasBuildSettings;
 	
 	/// @name Off-Mesh connections.
 	///@{
-	static const int MAX_OFFMESH_CONNECTIONS = 256;
-	float m_offMeshConVerts[MAX_OFFMESH_CONNECTIONS*3*2];
-	float m_offMeshConRads[MAX_OFFMESH_CONNECTIONS];
-	unsigned char m_offMeshConDirs[MAX_OFFMESH_CONNECTIONS];
-	unsigned char m_offMeshConAreas[MAX_OFFMESH_CONNECTIONS];
-	unsigned short m_offMeshConFlags[MAX_OFFMESH_CONNECTIONS];
-	unsigned int m_offMeshConId[MAX_OFFMESH_CONNECTIONS];
+	std::vector<float> m_offMeshConVerts;
+	std::vector<float> m_offMeshConRads;
+	std::vector<unsigned char> m_offMeshConDirs;
+	std::vector<unsigned char> m_offMeshConAreas;
+	std::vector<unsigned short> m_offMeshConFlags;
+	std::vector<unsigned int> m_offMeshConId;
 	int m_offMeshConCount;
+	ItemGrid2D m_offMeshConGrid;		///< Indexes the endpoints: item = connection*2 + endpoint.
+	bool m_offMeshConGridDirty;
 	///@}
 
 	/// @name Convex Volumes.
 	///@{
-	static const int MAX_VOLUMES = 256;
-	ConvexVolume m_volumes[MAX_VOLUMES];
+	std::vector<ConvexVolume> m_volumes;
 	int m_volumeCount;
+	ItemGrid2D m_volumeGrid;
+	bool m_volumeGridDirty;
 	///@}
 	
+	void resizeOffMeshConnections(const int n);
+	void resetMesh();
+	
 	bool loadGeomSet(class rcContext* ctx, const std::string& filepath);
+	bool buildBVH();
 public:
 	InputGeom();
 	~InputGeom();
@@ -117,6 +166,16 @@ public:
 			NodePath model = NodePath(), NodePath referenceNP = NodePath(),
 			rcMeshLoaderObj* mesh = NULL, float scale = 1.0,
 			float* translation = NULL);
+	/// Streams the model's triangles into an on-disk store at storePath,
+	/// bucketed by bucketSize (world units): the mesh is left empty and there
+	/// is no chunky mesh, the tiles load their triangles from the store.
+	/// A model without triangles is loaded as by loadMesh, with no store.
+	bool loadMeshStreamed(class rcContext* ctx, NodePath model,
+			NodePath referenceNP, const std::string& storePath,
+			const float bucketSize);
+	/// Replaces the mesh with the given one (deleted by this), keeping the
+	/// bounds, the off-mesh connections and the convex volumes.
+	bool reloadMesh(class rcContext* ctx, rcMeshLoaderObj* mesh);
 	
 	bool load(class rcContext* ctx, const std::string& filepath);
 	bool saveGeomSet(const BuildSettings* settings);
@@ -128,34 +187,58 @@ public:
 	const float* getNavMeshBoundsMin() const { return m_hasBuildSettings ? m_buildSettings.navMeshBMin : m_meshBMin; }
 	const float* getNavMeshBoundsMax() const { return m_hasBuildSettings ? m_buildSettings.navMeshBMax : m_meshBMax; }
 	const rcChunkyTriMesh* getChunkyMesh() const { return m_chunkyMesh; }
+	/// The triangle store of a streamed mesh, or null.
+	const GeomBucketStore* getBucketStore() const { return m_store; }
+	/// Sets the terrain (deleted by this, null to remove it), voxelized along
+	/// with the mesh: the bounds are extended to include it.
+	void setTerrain(TerrainHeightfield* terrain);
+	const TerrainHeightfield* getTerrain() const { return m_terrain; }
 	const BuildSettings* getBuildSettings() const { return m_hasBuildSettings ? &m_buildSettings : 0; }
 	bool raycastMesh(float* src, float* dst, float& tmin);
+	/// Raycasts many segments [src, dst] against the mesh.
+	/// tmins[i] is the parameter of the nearest hit along segment i, or 1 if
+	/// none; hits (opt) flags the segments that hit. Returns the number of hits.
+	int raycastMeshBatch(const float* src, const float* dst, const int nrays,
+						 float* tmins, unsigned char* hits = 0);
 
 	/// @name Off-Mesh connections.
 	///@{
 	int getOffMeshConnectionCount() const { return m_offMeshConCount; }
-	const float* getOffMeshConnectionVerts() const { return m_offMeshConVerts; }
-	const float* getOffMeshConnectionRads() const { return m_offMeshConRads; }
-	const unsigned char* getOffMeshConnectionDirs() const { return m_offMeshConDirs; }
-	const unsigned char* getOffMeshConnectionAreas() const { return m_offMeshConAreas; }
-	const unsigned short* getOffMeshConnectionFlags() const { return m_offMeshConFlags; }
-	const unsigned int* getOffMeshConnectionId() const { return m_offMeshConId; }
+	const float* getOffMeshConnectionVerts() const { return m_offMeshConVerts.data(); }
+	const float* getOffMeshConnectionRads() const { return m_offMeshConRads.data(); }
+	const unsigned char* getOffMeshConnectionDirs() const { return m_offMeshConDirs.data(); }
+	const unsigned char* getOffMeshConnectionAreas() const { return m_offMeshConAreas.data(); }
+	const unsigned short* getOffMeshConnectionFlags() const { return m_offMeshConFlags.data(); }
+	const unsigned int* getOffMeshConnectionId() const { return m_offMeshConId.data(); }
 	void addOffMeshConnection(const float* spos, const float* epos, const float rad,
 							  unsigned char bidir, unsigned char area, unsigned short flags);
 	void deleteOffMeshConnection(int i);
+	/// Gathers, in index order, the off-mesh connections with an endpoint
+	/// within the xz-bounds [bmin, bmax]. Returns their number.
+	int gatherOffMeshConnections(const float* bmin, const float* bmax, OffMeshConnectionSet& set) const;
 	void drawOffMeshConnections(struct duDebugDraw* dd, bool hilight = false);
 	///@}
 
 	/// @name Box Volumes.
 	///@{
 	int getConvexVolumeCount() const { return m_volumeCount; }
-	const ConvexVolume* getConvexVolumes() const { return m_volumes; }
+	const ConvexVolume* getConvexVolumes() const { return m_volumes.data(); }
 	void addConvexVolume(const float* verts, const int nverts,
 						 const float minh, const float maxh, unsigned char area);
 	void deleteConvexVolume(int i);
+	/// Appends, in index order, the convex volumes overlapping the
+	/// xz-bounds [bmin, bmax].
+	void queryConvexVolumes(const float* bmin, const float* bmax, std::vector<int>& volumes) const;
+	/// Marks the convex volumes overlapping the compact heightfield.
+	void markConvexVolumes(class rcContext* ctx, rcCompactHeightfield& chf) const;
 	void drawConvexVolumes(struct duDebugDraw* dd, bool hilight = false);
 	///@}
 	
+	/// Rebuilds the spatial indexes of the off-mesh connections and convex
+	/// volumes, if edited. Until then the queries scan them all: call this
+	/// before building tiles, mostly before concurrent builds.
+	void updateSpatialIndexes();
+	
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
 	InputGeom(const InputGeom&);
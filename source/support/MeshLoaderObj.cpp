@@ -23,6 +23,7 @@
  */
 
 #include "MeshLoaderObj.h"
+#include "GeomBucketStore.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -30,6 +31,7 @@
 #include <math.h>
 #include <nodePathCollection.h>
 #include <geomVertexReader.h>
+#include <Recast.h>
 
 namespace rnsup
 {
@@ -441,6 +443,110 @@ void rcMeshLoaderObj::processPrimitive(CPT(GeomPrimitive)primitive, unsigned int
 	}
 }
 
+static NodePathCollection getModelGeomNodes(NodePath model)
+{
+	NodePathCollection geomNodeCollection;
+	// check if model is GeomNode itself (i.e. when procedurally generated)
+	if (model.node()->is_of_type(GeomNode::get_class_type()))
+	{
+		geomNodeCollection.add_path(model);
+	}
+	else
+	{
+		//get all GeomNodes for the hierarchy below model
+		geomNodeCollection = model.find_all_matches("**/+GeomNode");
+	}
+	return geomNodeCollection;
+}
+
+bool rcMeshLoaderObj::calcBounds(NodePath model, NodePath referenceNP,
+		float* bmin, float* bmax)
+{
+	//all transform are applied wrt reference node (as by load())
+	LMatrix4f transformMat = model.get_transform(referenceNP)->get_mat();
+	NodePathCollection geomNodeCollection = getModelGeomNodes(model);
+	bool found = false;
+	for (int i = 0; i < geomNodeCollection.get_num_paths(); i++)
+	{
+		PT(GeomNode)geomNode = DCAST(GeomNode,geomNodeCollection.get_path(i).node());
+		for (int j = 0; j < geomNode->get_num_geoms(); j++)
+		{
+			CPT(Geom)geom = geomNode->get_geom(j);
+			if (geom->get_primitive_type() != GeomEnums::PT_polygons)
+			{
+				continue;
+			}
+			GeomVertexReader vertexReader = GeomVertexReader(
+					geom->get_vertex_data(), "vertex");
+			while (!vertexReader.is_at_end())
+			{
+				LVector3f vertex = vertexReader.get_data3f();
+				transformMat.xform_point_in_place(vertex);
+				float pvertex[3];
+				LVecBase3fToRecast(vertex, pvertex);
+				if (!found)
+				{
+					rcVcopy(bmin, pvertex);
+					rcVcopy(bmax, pvertex);
+					found = true;
+				}
+				rcVmin(bmin, pvertex);
+				rcVmax(bmax, pvertex);
+			}
+		}
+	}
+	return found;
+}
+
+bool rcMeshLoaderObj::stream(NodePath model, NodePath referenceNP,
+		GeomBucketStore& store)
+{
+	//all transform are applied wrt reference node (as by load())
+	LMatrix4f transformMat = model.get_transform(referenceNP)->get_mat();
+	NodePathCollection geomNodeCollection = getModelGeomNodes(model);
+	//only the vertices of the current vertex data are kept
+	CPT(GeomVertexData)currentVertexData;
+	std::vector<float> verts;
+	for (int i = 0; i < geomNodeCollection.get_num_paths(); i++)
+	{
+		PT(GeomNode)geomNode = DCAST(GeomNode,geomNodeCollection.get_path(i).node());
+		for (int j = 0; j < geomNode->get_num_geoms(); j++)
+		{
+			CPT(Geom)geom = geomNode->get_geom(j);
+			if (geom->get_primitive_type() != GeomEnums::PT_polygons)
+			{
+				continue;
+			}
+			CPT(GeomVertexData)vertexData = geom->get_vertex_data();
+			if (vertexData != currentVertexData)
+			{
+				currentVertexData = vertexData;
+				verts.resize(vertexData->get_num_rows() * 3);
+				GeomVertexReader vertexReader = GeomVertexReader(vertexData, "vertex");
+				for (int v = 0; !vertexReader.is_at_end(); ++v)
+				{
+					LVector3f vertex = vertexReader.get_data3f();
+					transformMat.xform_point_in_place(vertex);
+					LVecBase3fToRecast(vertex, &verts[v * 3]);
+				}
+			}
+			for (int k = 0; k < geom->get_num_primitives(); k++)
+			{
+				//decompose to triangles
+				CPT(GeomPrimitive)primitiveDec = geom->get_primitive(k)->decompose();
+				for (int t = 0; t < primitiveDec->get_num_primitives(); t++)
+				{
+					int s = primitiveDec->get_primitive_start(t);
+					store.addTriangle(&verts[primitiveDec->get_vertex(s) * 3],
+							&verts[primitiveDec->get_vertex(s + 1) * 3],
+							&verts[primitiveDec->get_vertex(s + 2) * 3]);
+				}
+			}
+		}
+	}
+	return store.getTriCount() > 0;
+}
+
 rcMeshLoaderObj& rcMeshLoaderObj::operator=(const rcMeshLoaderObj& copy)
 {
 	m_filename = copy.m_filename;
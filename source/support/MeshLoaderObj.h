@@ -46,6 +46,13 @@ public:
 
 	//Model stuff
 	bool load(NodePath model, NodePath referenceNP);
+	///Streamed model stuff: the triangles are not kept in memory.
+	///Computes the bounds of the model's (triangle) vertices, as load() does.
+	static bool calcBounds(NodePath model, NodePath referenceNP, float* bmin,
+			float* bmax);
+	///Adds the model's triangles to the store.
+	static bool stream(NodePath model, NodePath referenceNP,
+			class GeomBucketStore& store);
 
 	const float* getVerts() const { return m_verts; }
 	const float* getNormals() const { return m_normals; }
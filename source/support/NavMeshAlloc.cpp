@@ -0,0 +1,363 @@
+/**
+ * \file NavMeshAlloc.cpp
+ *
+ * \date 2016-03-16
+ * \author consultit
+ */
+
+#include "NavMeshAlloc.h"
+#include <RecastAlloc.h>
+#include <DetourAlloc.h>
+#include <stdlib.h>
+#include <atomic>
+#include <mutex>
+
+namespace rnsup
+{
+
+namespace
+{
+
+///Block kinds, stored into the block header.
+enum BlockKind
+{
+	BLOCK_HEAP = 0x48454150,
+	BLOCK_ARENA = 0x4152454e,
+	BLOCK_POOL = 0x504f4f4c,
+};
+
+struct TempArena;
+
+///Header in front of every block: 16 bytes keep the user data aligned.
+struct BlockHeader
+{
+	union
+	{
+		TempArena* arena;	// BLOCK_ARENA
+		size_t size;		// BLOCK_HEAP
+	};
+	unsigned int kind;
+	unsigned int sizeClass;	// BLOCK_POOL
+};
+static const size_t HEADER_SIZE = 16;
+
+inline size_t align16(size_t size)
+{
+	return (size + 15) & ~(size_t)15;
+}
+
+///Statistics.
+std::atomic<int> s_allocatorType(NAVMESH_ALLOCATOR_DEFAULT);
+std::atomic<unsigned int> s_tempAllocs(0);
+std::atomic<unsigned int> s_tempOverflows(0);
+std::atomic<unsigned int> s_tempArenaResets(0);
+std::atomic<size_t> s_tempArenaHighWater(0);
+std::atomic<unsigned int> s_permPoolAllocs(0);
+std::atomic<size_t> s_permPoolBytes(0);
+std::atomic<unsigned int> s_heapAllocs(0);
+std::atomic<unsigned int> s_heapFrees(0);
+std::atomic<size_t> s_heapLiveBytes(0);
+
+void updateMax(std::atomic<size_t>& value, size_t newValue)
+{
+	size_t old = value.load(std::memory_order_relaxed);
+	while (old < newValue &&
+			!value.compare_exchange_weak(old, newValue, std::memory_order_relaxed))
+		;
+}
+
+///Heap blocks.
+void* heapAlloc(size_t size)
+{
+	unsigned char* mem = (unsigned char*)malloc(HEADER_SIZE + size);
+	if (!mem)
+		return 0;
+	BlockHeader* hdr = (BlockHeader*)mem;
+	hdr->size = size;
+	hdr->kind = BLOCK_HEAP;
+	hdr->sizeClass = 0;
+	s_heapAllocs.fetch_add(1, std::memory_order_relaxed);
+	s_heapLiveBytes.fetch_add(size, std::memory_order_relaxed);
+	return mem + HEADER_SIZE;
+}
+
+void heapFree(BlockHeader* hdr)
+{
+	s_heapFrees.fetch_add(1, std::memory_order_relaxed);
+	s_heapLiveBytes.fetch_sub(hdr->size, std::memory_order_relaxed);
+	free(hdr);
+}
+
+///Per thread bump arena for temp blocks.
+static const size_t ARENA_INITIAL_CAPACITY = 256 * 1024;
+static const size_t ARENA_MAX_CAPACITY = 64 * 1024 * 1024;
+
+struct TempArena
+{
+	unsigned char* buffer;
+	size_t capacity;
+	size_t top;
+	// Highest top (overflowing blocks included) since the last reset.
+	size_t demand;
+	// Overflowing bytes since the last reset.
+	size_t spill;
+	// Blocks still in use: only the owner thread rewinds the arena, but
+	// blocks could be freed by any thread.
+	std::atomic<int> live;
+
+	TempArena() :
+			buffer(0), capacity(0), top(0), demand(0), spill(0), live(0)
+	{
+	}
+};
+
+struct TempArenaHolder
+{
+	TempArena* arena;
+
+	TempArenaHolder() :
+			arena(0)
+	{
+	}
+	~TempArenaHolder()
+	{
+		// Leak the arena if any of its blocks is still alive.
+		if (arena && arena->live.load() == 0)
+		{
+			free(arena->buffer);
+			delete arena;
+		}
+	}
+};
+
+thread_local TempArenaHolder t_arenaHolder;
+
+TempArena* getTempArena()
+{
+	if (!t_arenaHolder.arena)
+		t_arenaHolder.arena = new TempArena;
+	return t_arenaHolder.arena;
+}
+
+void growTempArena(TempArena* arena, size_t capacity)
+{
+	size_t newCapacity = arena->capacity ? arena->capacity : ARENA_INITIAL_CAPACITY;
+	while (newCapacity < capacity && newCapacity < ARENA_MAX_CAPACITY)
+		newCapacity *= 2;
+	if (newCapacity == arena->capacity)
+		return;
+	unsigned char* buffer = (unsigned char*)malloc(newCapacity);
+	if (!buffer)
+		return;
+	free(arena->buffer);
+	arena->buffer = buffer;
+	arena->capacity = newCapacity;
+}
+
+void* arenaAlloc(size_t size)
+{
+	TempArena* arena = getTempArena();
+	const size_t need = HEADER_SIZE + align16(size);
+	if (arena->live.load(std::memory_order_acquire) == 0)
+		arena->top = 0;
+	if (!arena->buffer)
+		growTempArena(arena, ARENA_INITIAL_CAPACITY);
+	if (arena->buffer && arena->top + need <= arena->capacity)
+	{
+		BlockHeader* hdr = (BlockHeader*)(arena->buffer + arena->top);
+		hdr->arena = arena;
+		hdr->kind = BLOCK_ARENA;
+		hdr->sizeClass = 0;
+		arena->top += need;
+		arena->live.fetch_add(1, std::memory_order_relaxed);
+		if (arena->top > arena->demand)
+			arena->demand = arena->top;
+		updateMax(s_tempArenaHighWater, arena->top);
+		s_tempAllocs.fetch_add(1, std::memory_order_relaxed);
+		return (unsigned char*)hdr + HEADER_SIZE;
+	}
+	// Doesn't fit: remember how much would have been needed, so that the
+	// arena can grow on the next reset.
+	arena->spill += need;
+	if (arena->top + arena->spill > arena->demand)
+		arena->demand = arena->top + arena->spill;
+	s_tempOverflows.fetch_add(1, std::memory_order_relaxed);
+	return heapAlloc(size);
+}
+
+void arenaFree(BlockHeader* hdr)
+{
+	hdr->arena->live.fetch_sub(1, std::memory_order_release);
+}
+
+///Size-class pools for perm blocks: block sizes (header included) are
+///32, 64, ..., 4096 bytes.
+static const int POOL_MIN_SHIFT = 5;
+static const int POOL_NUM_CLASSES = 8;
+static const size_t POOL_PAGE_SIZE = 64 * 1024;
+
+struct SizeClassPool
+{
+	std::mutex lock;
+	void* freeList;
+
+	SizeClassPool() :
+			freeList(0)
+	{
+	}
+};
+
+SizeClassPool s_pools[POOL_NUM_CLASSES];
+
+int getSizeClass(size_t size)
+{
+	const size_t blockSize = HEADER_SIZE + size;
+	for (int i = 0; i < POOL_NUM_CLASSES; ++i)
+	{
+		if (blockSize <= ((size_t)1 << (POOL_MIN_SHIFT + i)))
+			return i;
+	}
+	return -1;
+}
+
+void* poolAlloc(size_t size)
+{
+	const int sizeClass = getSizeClass(size);
+	if (sizeClass < 0)
+		return heapAlloc(size);
+
+	SizeClassPool& pool = s_pools[sizeClass];
+	const size_t blockSize = (size_t)1 << (POOL_MIN_SHIFT + sizeClass);
+	unsigned char* block = 0;
+	{
+		std::lock_guard<std::mutex> guard(pool.lock);
+		if (!pool.freeList)
+		{
+			// Carve a new page into blocks.
+			unsigned char* page = (unsigned char*)malloc(POOL_PAGE_SIZE);
+			if (!page)
+				return 0;
+			s_permPoolBytes.fetch_add(POOL_PAGE_SIZE, std::memory_order_relaxed);
+			const size_t n = POOL_PAGE_SIZE / blockSize;
+			for (size_t i = 0; i < n; ++i)
+			{
+				void** b = (void**)(page + (n - 1 - i) * blockSize);
+				*b = pool.freeList;
+				pool.freeList = b;
+			}
+		}
+		block = (unsigned char*)pool.freeList;
+		pool.freeList = *(void**)block;
+	}
+	BlockHeader* hdr = (BlockHeader*)block;
+	hdr->arena = 0;
+	hdr->kind = BLOCK_POOL;
+	hdr->sizeClass = (unsigned int)sizeClass;
+	s_permPoolAllocs.fetch_add(1, std::memory_order_relaxed);
+	return block + HEADER_SIZE;
+}
+
+void poolFree(BlockHeader* hdr)
+{
+	SizeClassPool& pool = s_pools[hdr->sizeClass];
+	std::lock_guard<std::mutex> guard(pool.lock);
+	*(void**)hdr = pool.freeList;
+	pool.freeList = hdr;
+}
+
+///Allocation functions.
+void* navMeshAlloc(size_t size, bool temp)
+{
+	if (s_allocatorType.load(std::memory_order_relaxed) != NAVMESH_ALLOCATOR_ARENA_POOL)
+		return heapAlloc(size);
+	return temp ? arenaAlloc(size) : poolAlloc(size);
+}
+
+void navMeshFree(void* ptr)
+{
+	if (!ptr)
+		return;
+	BlockHeader* hdr = (BlockHeader*)((unsigned char*)ptr - HEADER_SIZE);
+	switch (hdr->kind)
+	{
+	case BLOCK_ARENA:
+		arenaFree(hdr);
+		break;
+	case BLOCK_POOL:
+		poolFree(hdr);
+		break;
+	default:
+		heapFree(hdr);
+		break;
+	}
+}
+
+void* rcNavMeshAlloc(size_t size, rcAllocHint hint)
+{
+	return navMeshAlloc(size, hint == RC_ALLOC_TEMP);
+}
+
+void* dtNavMeshAlloc(size_t size, dtAllocHint hint)
+{
+	return navMeshAlloc(size, hint == DT_ALLOC_TEMP);
+}
+
+} // namespace
+
+void installNavMeshAllocator()
+{
+	rcAllocSetCustom(rcNavMeshAlloc, navMeshFree);
+	dtAllocSetCustom(dtNavMeshAlloc, navMeshFree);
+}
+
+void setNavMeshAllocator(int type)
+{
+	if (type != NAVMESH_ALLOCATOR_ARENA_POOL)
+		type = NAVMESH_ALLOCATOR_DEFAULT;
+	s_allocatorType.store(type);
+}
+
+int getNavMeshAllocator()
+{
+	return s_allocatorType.load();
+}
+
+void resetNavMeshTempArena()
+{
+	TempArena* arena = t_arenaHolder.arena;
+	if (!arena || arena->live.load(std::memory_order_acquire) != 0)
+		return;
+	if (arena->demand > arena->capacity)
+		growTempArena(arena, arena->demand);
+	arena->top = 0;
+	arena->demand = 0;
+	arena->spill = 0;
+	s_tempArenaResets.fetch_add(1, std::memory_order_relaxed);
+}
+
+void getNavMeshAllocStats(NavMeshAllocStats& stats)
+{
+	stats.tempAllocs = s_tempAllocs.load();
+	stats.tempOverflows = s_tempOverflows.load();
+	stats.tempArenaResets = s_tempArenaResets.load();
+	stats.tempArenaHighWater = s_tempArenaHighWater.load();
+	stats.permPoolAllocs = s_permPoolAllocs.load();
+	stats.permPoolBytes = s_permPoolBytes.load();
+	stats.heapAllocs = s_heapAllocs.load();
+	stats.heapFrees = s_heapFrees.load();
+	stats.heapLiveBytes = s_heapLiveBytes.load();
+}
+
+void resetNavMeshAllocStats()
+{
+	// Pool bytes and heap live bytes describe the current state: keep them.
+	s_tempAllocs.store(0);
+	s_tempOverflows.store(0);
+	s_tempArenaResets.store(0);
+	s_tempArenaHighWater.store(0);
+	s_permPoolAllocs.store(0);
+	s_heapAllocs.store(0);
+	s_heapFrees.store(0);
+}
+
+} // namespace rnsup
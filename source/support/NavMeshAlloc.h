@@ -0,0 +1,68 @@
+/**
+ * \file NavMeshAlloc.h
+ *
+ * \date 2016-03-16
+ * \author consultit
+ */
+
+#ifndef NAVMESHALLOC_H_
+#define NAVMESHALLOC_H_
+
+#include <stddef.h>
+
+namespace rnsup
+{
+
+///Allocators usable by Recast (rcAlloc) and Detour (dtAlloc).
+enum NavMeshAllocatorEnum
+{
+	NAVMESH_ALLOCATOR_DEFAULT,		// malloc/free for every block.
+	NAVMESH_ALLOCATOR_ARENA_POOL,	// Temp blocks from a per thread bump arena,
+									// perm blocks from size-class pools.
+};
+
+///Allocation statistics (a snapshot).
+struct NavMeshAllocStats
+{
+	// Temp blocks served by the per thread arenas.
+	unsigned int tempAllocs;
+	// Temp blocks which didn't fit into the arena (served by the heap).
+	unsigned int tempOverflows;
+	// Arena resets (one per built tile).
+	unsigned int tempArenaResets;
+	// Largest amount of memory used in an arena between two resets.
+	size_t tempArenaHighWater;
+	// Perm blocks served by the size-class pools.
+	unsigned int permPoolAllocs;
+	// Memory held by the size-class pools (pages are never released).
+	size_t permPoolBytes;
+	// Blocks served by the heap (malloc).
+	unsigned int heapAllocs;
+	// Blocks returned to the heap (free).
+	unsigned int heapFrees;
+	// Heap memory currently in use.
+	size_t heapLiveBytes;
+};
+
+/// Installs the custom allocation functions into Recast and Detour.
+/// Must be called before any rcAlloc/dtAlloc: every block carries a small
+/// header telling rcFree/dtFree how it was allocated, so the allocator type
+/// can be switched at any time afterwards.
+void installNavMeshAllocator();
+
+/// Selects the allocator type (see NavMeshAllocatorEnum) for the next
+/// allocations. This is a process wide setting.
+void setNavMeshAllocator(int type);
+int getNavMeshAllocator();
+
+/// Rewinds the calling thread's temp arena. Should be called after each
+/// tile build: it is a no-op if there are temp blocks still in use, and
+/// it grows the arena to the last high-water mark if it overflowed.
+void resetNavMeshTempArena();
+
+void getNavMeshAllocStats(NavMeshAllocStats& stats);
+void resetNavMeshAllocStats();
+
+} // namespace rnsup
+
+#endif /* NAVMESHALLOC_H_ */
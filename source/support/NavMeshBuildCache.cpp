@@ -0,0 +1,177 @@
+/**
+ * \file NavMeshBuildCache.cpp
+ *
+ * \date 2026-10-19
+ * \author consultit
+ */
+
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include "NavMeshBuildCache.h"
+#include <DetourAlloc.h>
+
+namespace rnsup
+{
+
+namespace
+{
+
+const int BUILD_CACHE_MAGIC = 'R' << 24 | 'N' << 16 | 'B' << 8 | 'C';
+const int BUILD_CACHE_VERSION = 1;
+
+///Header of a cache file, followed by the data.
+struct BuildCacheHeader
+{
+	int magic;
+	int version;
+	uint64_t key;
+	int dataSize;
+	int reserved;
+	uint64_t checksum;
+};
+
+uint64_t checksum(const unsigned char* data, const int dataSize)
+{
+	NavMeshBuildHash hash;
+	hash.add(data, dataSize);
+	return hash.get();
+}
+
+///Stores done by this process, which with its id make the temporary file
+///names unique across the caches and processes sharing a directory.
+std::atomic<int> processStores(0);
+
+int processId()
+{
+#ifdef _WIN32
+	return _getpid();
+#else
+	return (int) getpid();
+#endif
+}
+
+}
+
+NavMeshBuildHash::NavMeshBuildHash() :
+		m_hash(UINT64_C(14695981039346656037))
+{
+}
+
+void NavMeshBuildHash::add(const void* data, const int size)
+{
+	const unsigned char* bytes = (const unsigned char*) data;
+	uint64_t h = m_hash;
+	for (int i = 0; i < size; ++i)
+	{
+		h ^= bytes[i];
+		h *= UINT64_C(1099511628211);
+	}
+	m_hash = h;
+}
+
+NavMeshBuildCache::NavMeshBuildCache() :
+		m_hits(0), m_misses(0)
+{
+}
+
+std::string NavMeshBuildCache::getPath(const uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.rnc", (unsigned long long) key);
+	std::string path(m_dir);
+	if (path[path.size() - 1] != '/')
+	{
+		path += '/';
+	}
+	return path + name;
+}
+
+bool NavMeshBuildCache::load(const uint64_t key, unsigned char** data,
+		int* dataSize)
+{
+	*data = 0;
+	*dataSize = 0;
+	if (!isEnabled())
+	{
+		return false;
+	}
+	FILE* fp = fopen(getPath(key).c_str(), "rb");
+	if (!fp)
+	{
+		++m_misses;
+		return false;
+	}
+	BuildCacheHeader header;
+	unsigned char* buffer = 0;
+	bool valid = (fread(&header, sizeof(header), 1, fp) == 1)
+			&& (header.magic == BUILD_CACHE_MAGIC)
+			&& (header.version == BUILD_CACHE_VERSION)
+			&& (header.key == key) && (header.dataSize > 0);
+	if (valid)
+	{
+		buffer = (unsigned char*) dtAlloc(header.dataSize, DT_ALLOC_PERM);
+		valid = buffer
+				&& (fread(buffer, header.dataSize, 1, fp) == 1)
+				&& (checksum(buffer, header.dataSize) == header.checksum);
+	}
+	fclose(fp);
+	if (!valid)
+	{
+		dtFree(buffer);
+		++m_misses;
+		return false;
+	}
+	*data = buffer;
+	*dataSize = header.dataSize;
+	++m_hits;
+	return true;
+}
+
+bool NavMeshBuildCache::store(const uint64_t key, const unsigned char* data,
+		const int dataSize)
+{
+	if (!isEnabled() || !data || dataSize <= 0)
+	{
+		return false;
+	}
+	// Write to a temporary file then rename it: a concurrent load never
+	// sees a partially written file.
+	const std::string path = getPath(key);
+	char suffix[48];
+	snprintf(suffix, sizeof(suffix), ".%d.%d.tmp", processId(), (int) processStores++);
+	const std::string tmpPath = path + suffix;
+	FILE* fp = fopen(tmpPath.c_str(), "wb");
+	if (!fp)
+	{
+		return false;
+	}
+	BuildCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = BUILD_CACHE_MAGIC;
+	header.version = BUILD_CACHE_VERSION;
+	header.key = key;
+	header.dataSize = dataSize;
+	header.checksum = checksum(data, dataSize);
+	bool written = (fwrite(&header, sizeof(header), 1, fp) == 1)
+			&& (fwrite(data, dataSize, 1, fp) == 1);
+	written = (fclose(fp) == 0) && written;
+	if (written && (rename(tmpPath.c_str(), path.c_str()) != 0))
+	{
+		// Where rename doesn't replace files, the existing one is dropped
+		// first: it holds the same data anyway.
+		remove(path.c_str());
+		written = (rename(tmpPath.c_str(), path.c_str()) == 0);
+	}
+	if (!written)
+	{
+		remove(tmpPath.c_str());
+	}
+	return written;
+}
+
+} // namespace rnsup
@@ -0,0 +1,82 @@
+/**
+ * \file NavMeshBuildCache.h
+ *
+ * \date 2026-10-19
+ * \author consultit
+ */
+
+#ifndef NAVMESHBUILDCACHE_H_
+#define NAVMESHBUILDCACHE_H_
+
+#include <stdint.h>
+#include <string>
+#include <atomic>
+
+namespace rnsup
+{
+
+///Outputs stored in the build cache.
+enum NavMeshBuildOutputEnum
+{
+	NAVMESH_BUILD_OUTPUT_SOLO,		// Nav mesh data of a solo nav mesh.
+	NAVMESH_BUILD_OUTPUT_TILE,		// Nav mesh data of a tile.
+	NAVMESH_BUILD_OUTPUT_LAYERS,	// Compressed tile cache layers of a tile.
+};
+
+///Content hash (64 bit FNV-1a) of the inputs of a build: equal inputs give
+///equal hashes, so the hash is the key of the build outputs.
+class NavMeshBuildHash
+{
+public:
+	NavMeshBuildHash();
+
+	void add(const void* data, const int size);
+	void addInt(const int value) { add(&value, sizeof(value)); }
+	void addFloat(const float value) { add(&value, sizeof(value)); }
+	uint64_t get() const { return m_hash; }
+
+private:
+	uint64_t m_hash;
+};
+
+///On-disk cache of build outputs (nav mesh tiles, tile cache layers), stored
+///one per file under their key, in a directory. Loads and stores of different
+///keys can be done concurrently.
+class NavMeshBuildCache
+{
+public:
+	NavMeshBuildCache();
+
+	///Sets the cache directory, which must exist: an empty one disables the
+	///cache.
+	void setDirectory(const std::string& dir) { m_dir = dir; }
+	const std::string& getDirectory() const { return m_dir; }
+	bool isEnabled() const { return !m_dir.empty(); }
+
+	///Loads the data stored under the key: on success data is allocated with
+	///dtAlloc() and is owned by the caller. Missing, stale or corrupted files
+	///are misses.
+	bool load(const uint64_t key, unsigned char** data, int* dataSize);
+	///Stores the data under the key, replacing any previous one.
+	bool store(const uint64_t key, const unsigned char* data,
+			const int dataSize);
+
+	int getHitCount() const { return m_hits; }
+	int getMissCount() const { return m_misses; }
+	void resetStats() { m_hits = 0; m_misses = 0; }
+
+private:
+	std::string getPath(const uint64_t key) const;
+
+	std::string m_dir;
+	std::atomic<int> m_hits;
+	std::atomic<int> m_misses;
+
+	// Explicitly disabled copy constructor and copy assignment operator.
+	NavMeshBuildCache(const NavMeshBuildCache&);
+	NavMeshBuildCache& operator=(const NavMeshBuildCache&);
+};
+
+} // namespace rnsup
+
+#endif /* NAVMESHBUILDCACHE_H_ */
@@ -0,0 +1,340 @@
+/**
+ * \file NavMeshCompressor.cpp
+ *
+ * \date 2016-03-16
+ * \author consultit
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include "NavMeshCompressor.h"
+#include "PerfTimer.h"
+#include "fastlz.h"
+#include <DetourAlloc.h>
+
+namespace rnsup
+{
+
+namespace
+{
+
+///Layer buffers are the concatenation of heights, areas and connections
+///grids (see dtBuildTileCacheLayer()): heights of neighbor cells are close,
+///so they are stored as deltas. Returns the size of the heights grid.
+inline int heightsSize(const int bufferSize)
+{
+	return (bufferSize % 3) == 0 ? bufferSize / 3 : 0;
+}
+
+inline unsigned char filteredByte(const unsigned char* buffer, const int i,
+		const int hsize)
+{
+	return (i > 0 && i < hsize) ?
+			(unsigned char) (buffer[i] - buffer[i - 1]) : buffer[i];
+}
+
+void deltaEncode(const unsigned char* buffer, const int bufferSize,
+		unsigned char* filtered)
+{
+	const int hsize = heightsSize(bufferSize);
+	for (int i = 0; i < bufferSize; ++i)
+		filtered[i] = filteredByte(buffer, i, hsize);
+}
+
+void deltaDecode(unsigned char* buffer, const int bufferSize)
+{
+	const int hsize = heightsSize(bufferSize);
+	for (int i = 1; i < hsize; ++i)
+		buffer[i] = (unsigned char) (buffer[i] + buffer[i - 1]);
+}
+
+struct FastLZCompressor: public dtTileCacheCompressor
+{
+	virtual int maxCompressedSize(const int bufferSize)
+	{
+		// FastLZ output may be 5% larger than input, and at least 66 bytes.
+		return (int) (bufferSize * 1.05f) + 66;
+	}
+
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+			unsigned char* compressed, const int /*maxCompressedSize*/,
+			int* compressedSize)
+	{
+		*compressedSize = fastlz_compress((const void*) buffer,
+				bufferSize, compressed);
+		return DT_SUCCESS;
+	}
+
+	virtual dtStatus decompress(const unsigned char* compressed,
+			const int compressedSize, unsigned char* buffer,
+			const int maxBufferSize, int* bufferSize)
+	{
+		*bufferSize = fastlz_decompress(compressed, compressedSize, buffer,
+				maxBufferSize);
+		return *bufferSize < 0 ? DT_FAILURE : DT_SUCCESS;
+	}
+};
+
+struct NoneCompressor: public dtTileCacheCompressor
+{
+	virtual int maxCompressedSize(const int bufferSize)
+	{
+		return bufferSize;
+	}
+
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+			unsigned char* compressed, const int maxCompressedSize,
+			int* compressedSize)
+	{
+		if (bufferSize > maxCompressedSize)
+			return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+		memcpy(compressed, buffer, bufferSize);
+		*compressedSize = bufferSize;
+		return DT_SUCCESS;
+	}
+
+	virtual dtStatus decompress(const unsigned char* compressed,
+			const int compressedSize, unsigned char* buffer,
+			const int maxBufferSize, int* bufferSize)
+	{
+		if (compressedSize > maxBufferSize)
+			return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+		memcpy(buffer, compressed, compressedSize);
+		*bufferSize = compressedSize;
+		return DT_SUCCESS;
+	}
+};
+
+struct FastLZHighCompressor: public dtTileCacheCompressor
+{
+	virtual int maxCompressedSize(const int bufferSize)
+	{
+		return (int) (bufferSize * 1.05f) + 66;
+	}
+
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+			unsigned char* compressed, const int /*maxCompressedSize*/,
+			int* compressedSize)
+	{
+		unsigned char* filtered = (unsigned char*) dtAlloc(bufferSize,
+				DT_ALLOC_TEMP);
+		if (!filtered)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		deltaEncode(buffer, bufferSize, filtered);
+		*compressedSize = fastlz_compress_level(2, filtered, bufferSize,
+				compressed);
+		dtFree(filtered);
+		return DT_SUCCESS;
+	}
+
+	virtual dtStatus decompress(const unsigned char* compressed,
+			const int compressedSize, unsigned char* buffer,
+			const int maxBufferSize, int* bufferSize)
+	{
+		*bufferSize = fastlz_decompress(compressed, compressedSize, buffer,
+				maxBufferSize);
+		if (*bufferSize <= 0)
+			return DT_FAILURE;
+		deltaDecode(buffer, *bufferSize);
+		return DT_SUCCESS;
+	}
+};
+
+///Run length encoding of the filtered buffer: a control byte c < 128 is
+///followed by c+1 literal bytes, a control byte c >= 128 is followed by
+///one byte repeated (c-128)+MIN_RUN times.
+static const int MIN_RUN = 3;
+static const int MAX_RUN = 127 + MIN_RUN;
+static const int MAX_LITERALS = 128;
+
+struct LayerRLECompressor: public dtTileCacheCompressor
+{
+	virtual int maxCompressedSize(const int bufferSize)
+	{
+		return bufferSize + (bufferSize + MAX_LITERALS - 1) / MAX_LITERALS;
+	}
+
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+			unsigned char* compressed, const int maxCompressedSize,
+			int* compressedSize)
+	{
+		const int hsize = heightsSize(bufferSize);
+		int n = 0;
+		int literals = 0;
+		int i = 0;
+		while (i < bufferSize)
+		{
+			// Measure the run starting at i.
+			const unsigned char b = filteredByte(buffer, i, hsize);
+			int run = 1;
+			while (i + run < bufferSize && run < MAX_RUN
+					&& filteredByte(buffer, i + run, hsize) == b)
+				run++;
+			if (run >= MIN_RUN)
+			{
+				if (n + 2 > maxCompressedSize)
+					return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+				compressed[n++] = (unsigned char) (128 + run - MIN_RUN);
+				compressed[n++] = b;
+				literals = 0;
+				i += run;
+				continue;
+			}
+			// Append a literal, starting a new literal block if needed.
+			if (literals == 0 || literals == MAX_LITERALS)
+			{
+				if (n + 1 > maxCompressedSize)
+					return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+				literals = 0;
+				compressed[n++] = 0;
+			}
+			if (n + 1 > maxCompressedSize)
+				return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+			compressed[n - literals - 1] = (unsigned char) literals;
+			compressed[n++] = b;
+			literals++;
+			i++;
+		}
+		*compressedSize = n;
+		return DT_SUCCESS;
+	}
+
+	virtual dtStatus decompress(const unsigned char* compressed,
+			const int compressedSize, unsigned char* buffer,
+			const int maxBufferSize, int* bufferSize)
+	{
+		int n = 0;
+		int i = 0;
+		while (i < compressedSize)
+		{
+			const int c = compressed[i++];
+			if (c < 128)
+			{
+				const int count = c + 1;
+				if (i + count > compressedSize || n + count > maxBufferSize)
+					return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+				memcpy(buffer + n, compressed + i, count);
+				i += count;
+				n += count;
+			}
+			else
+			{
+				const int count = c - 128 + MIN_RUN;
+				if (i + 1 > compressedSize || n + count > maxBufferSize)
+					return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+				memset(buffer + n, compressed[i++], count);
+				n += count;
+			}
+		}
+		deltaDecode(buffer, n);
+		*bufferSize = n;
+		return DT_SUCCESS;
+	}
+};
+
+} // namespace
+
+dtTileCacheCompressor* createTileCacheCompressor(int type)
+{
+	switch (type)
+	{
+	case NAVMESH_COMPRESSOR_NONE:
+		return new NoneCompressor;
+	case NAVMESH_COMPRESSOR_FASTLZ_HIGH:
+		return new FastLZHighCompressor;
+	case NAVMESH_COMPRESSOR_LAYER_RLE:
+		return new LayerRLECompressor;
+	default:
+		return new FastLZCompressor;
+	}
+}
+
+const char* getTileCacheCompressorName(int type)
+{
+	switch (type)
+	{
+	case NAVMESH_COMPRESSOR_NONE:
+		return "none";
+	case NAVMESH_COMPRESSOR_FASTLZ_HIGH:
+		return "fastlz_high";
+	case NAVMESH_COMPRESSOR_LAYER_RLE:
+		return "layer_rle";
+	default:
+		return "fastlz";
+	}
+}
+
+bool benchmarkTileCacheCompressor(dtTileCache* tileCache, int type,
+		int iterations, TileCacheCompressorReport& report)
+{
+	memset(&report, 0, sizeof(report));
+	report.compressorType = type;
+	if (!tileCache || !tileCache->getCompressor())
+		return false;
+	if (iterations < 1)
+		iterations = 1;
+
+	dtTileCacheCompressor* current = tileCache->getCompressor();
+	dtTileCacheCompressor* comp = createTileCacheCompressor(type);
+	TimeVal compressTime = 0, decompressTime = 0;
+	bool result = true;
+	for (int i = 0; i < tileCache->getTileCount() && result; ++i)
+	{
+		const dtCompressedTile* tile = tileCache->getTile(i);
+		if (!tile->header || !tile->compressed)
+			continue;
+
+		const int bufferSize = (int) tile->header->width
+				* (int) tile->header->height * 3;
+		const int maxCompressedSize = comp->maxCompressedSize(bufferSize);
+		unsigned char* raw = (unsigned char*) dtAlloc(bufferSize,
+				DT_ALLOC_TEMP);
+		unsigned char* restored = (unsigned char*) dtAlloc(bufferSize,
+				DT_ALLOC_TEMP);
+		unsigned char* compressed = (unsigned char*) dtAlloc(
+				maxCompressedSize, DT_ALLOC_TEMP);
+		int size = 0, compressedSize = 0;
+		// Get the original grid data back with the current compressor.
+		result = raw && restored && compressed
+				&& dtStatusSucceed(
+						current->decompress(tile->compressed,
+								tile->compressedSize, raw, bufferSize, &size))
+				&& size == bufferSize;
+		if (result)
+		{
+			const TimeVal t0 = getPerfTime();
+			result = dtStatusSucceed(
+					comp->compress(raw, bufferSize, compressed,
+							maxCompressedSize, &compressedSize));
+			compressTime += getPerfTime() - t0;
+		}
+		if (result)
+		{
+			const TimeVal t0 = getPerfTime();
+			for (int j = 0; j < iterations && result; ++j)
+			{
+				result = dtStatusSucceed(
+						comp->decompress(compressed, compressedSize, restored,
+								bufferSize, &size));
+			}
+			decompressTime += getPerfTime() - t0;
+			result = result && size == bufferSize
+					&& memcmp(raw, restored, bufferSize) == 0;
+		}
+		if (result)
+		{
+			report.layerCount++;
+			report.rawSize += bufferSize;
+			report.compressedSize += compressedSize;
+		}
+		dtFree(compressed);
+		dtFree(restored);
+		dtFree(raw);
+	}
+	delete comp;
+	report.compressTimeUsec = getPerfTimeUsec(compressTime);
+	report.decompressTimeUsec = getPerfTimeUsec(decompressTime) / iterations;
+	return result;
+}
+
+} // namespace rnsup
@@ -0,0 +1,55 @@
+/**
+ * \file NavMeshCompressor.h
+ *
+ * \date 2016-03-16
+ * \author consultit
+ */
+
+#ifndef NAVMESHCOMPRESSOR_H_
+#define NAVMESHCOMPRESSOR_H_
+
+#include <DetourTileCache.h>
+#include <DetourTileCacheBuilder.h>
+
+namespace rnsup
+{
+
+///Compressors usable for dtTileCache layers.
+enum NavMeshCompressorEnum
+{
+	NAVMESH_COMPRESSOR_FASTLZ,		// FastLZ (level 1): the original codec.
+	NAVMESH_COMPRESSOR_NONE,		// Plain copy: fastest decompression.
+	NAVMESH_COMPRESSOR_FASTLZ_HIGH,	// Height deltas + FastLZ level 2: higher ratio.
+	NAVMESH_COMPRESSOR_LAYER_RLE,	// Height deltas + run length encoding.
+	NAVMESH_COMPRESSOR_NUM
+};
+
+/// Creates a compressor of the given type (see NavMeshCompressorEnum),
+/// to be deleted by the caller. Unknown types give a FastLZ compressor.
+dtTileCacheCompressor* createTileCacheCompressor(int type);
+const char* getTileCacheCompressorName(int type);
+
+///Result of a compressor benchmark over the layers of a tile cache.
+struct TileCacheCompressorReport
+{
+	int compressorType;
+	int layerCount;
+	// Uncompressed grid data (heights, areas, connections) of all layers.
+	int rawSize;
+	// Compressed grid data of all layers.
+	int compressedSize;
+	// Total times (microseconds) to compress all layers once, and to
+	// decompress all layers once (averaged over the iterations).
+	int compressTimeUsec;
+	int decompressTimeUsec;
+};
+
+/// Recompresses every layer of the tile cache with a compressor of the
+/// given type, and measures sizes and times. Every layer is checked to be
+/// restored exactly. Returns false on error.
+bool benchmarkTileCacheCompressor(dtTileCache* tileCache, int type,
+		int iterations, TileCacheCompressorReport& report);
+
+} // namespace rnsup
+
+#endif /* NAVMESHCOMPRESSOR_H_ */
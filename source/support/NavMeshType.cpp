@@ -29,6 +29,10 @@
 #include "InputGeom.h"
 #include <DetourDebugDraw.h>
 #include <RecastDebugDraw.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 #ifdef WIN32
 #	define snprintf _snprintf
@@ -190,6 +194,11 @@ void NavMeshType::resetNavMeshSettings()
 	m_detailSampleDist = 6.0f;
 	m_detailSampleMaxError = 1.0f;
 	m_partitionType = NAVMESH_PARTITION_WATERSHED;
+	m_allocatorType = NAVMESH_ALLOCATOR_DEFAULT;
+	m_buildDetailGrid = true;
+	m_buildThreads = 0;
+	m_parallelContours = false;
+	m_parallelDetail = false;
 }
 
 //void NavMeshType::handleCommonSettings()
@@ -276,6 +285,12 @@ bool NavMeshType::handleBuild()
 	return true;
 }
 
+int NavMeshType::handleMeshRefresh(rcMeshLoaderObj* mesh)
+{
+	delete mesh;
+	return -1;
+}
+
 void NavMeshType::handleUpdate(const float dt)
 {
 	if (m_tool)
@@ -345,6 +360,11 @@ void NavMeshType::setNavMeshSettings(const NavMeshSettings& settings)
 	m_detailSampleDist = settings.m_detailSampleDist;
 	m_detailSampleMaxError = settings.m_detailSampleMaxError;
 	m_partitionType = settings.m_partitionType;
+	m_allocatorType = settings.m_allocatorType;
+	m_buildDetailGrid = settings.m_buildDetailGrid;
+	m_buildThreads = settings.m_buildThreads;
+	m_parallelContours = settings.m_parallelContours;
+	m_parallelDetail = settings.m_parallelDetail;
 } 
 NavMeshSettings NavMeshType::getNavMeshSettings()
 { 
@@ -363,9 +383,200 @@ NavMeshSettings NavMeshType::getNavMeshSettings()
 	settings.m_detailSampleDist = m_detailSampleDist;
 	settings.m_detailSampleMaxError = m_detailSampleMaxError;
 	settings.m_partitionType = m_partitionType;
+	settings.m_allocatorType = m_allocatorType;
+	settings.m_buildDetailGrid = m_buildDetailGrid;
+	settings.m_buildThreads = m_buildThreads;
+	settings.m_parallelContours = m_parallelContours;
+	settings.m_parallelDetail = m_parallelDetail;
 	return settings;
 } 
 
+int NavMeshType::getBuildThreadCount() const
+{
+	if (m_buildThreads > 0)
+		return m_buildThreads;
+	const int n = (int)std::thread::hardware_concurrency();
+	return n > 0 ? n : 1;
+}
+
+void NavMeshType::hashBuildSettings(const int output, NavMeshBuildHash& hash) const
+{
+	hash.addInt(output);
+	hash.addInt(DT_NAVMESH_VERSION);
+	hash.addInt(DT_TILECACHE_VERSION);
+	hash.addInt(m_partitionType);
+	hash.addInt(m_buildDetailGrid);
+	hash.addInt(m_filterLowHangingObstacles);
+	hash.addInt(m_filterLedgeSpans);
+	hash.addInt(m_filterWalkableLowHeightSpans);
+	// The agent sizes are stored into the nav mesh data as they are.
+	hash.addFloat(m_agentHeight);
+	hash.addFloat(m_agentRadius);
+	hash.addFloat(m_agentMaxClimb);
+	hash.addInt((int)m_flagsAreaTable.size());
+	for (NavMeshPolyAreaFlags::const_iterator iter = m_flagsAreaTable.begin();
+			iter != m_flagsAreaTable.end(); ++iter)
+	{
+		hash.addInt(iter->first);
+		hash.addInt(iter->second);
+	}
+}
+
+void NavMeshType::hashConvexVolumes(const float* bmin, const float* bmax,
+		NavMeshBuildHash& hash) const
+{
+	// In index order, which is the marking one.
+	std::vector<int> volumes;
+	m_geom->queryConvexVolumes(bmin, bmax, volumes);
+	hash.addInt((int)volumes.size());
+	for (int i = 0; i < (int)volumes.size(); ++i)
+	{
+		const ConvexVolume* vol = &m_geom->getConvexVolumes()[volumes[i]];
+		hash.addInt(vol->nverts);
+		hash.add(vol->verts.data(), sizeof(float)*3*vol->nverts);
+		hash.addFloat(vol->hmin);
+		hash.addFloat(vol->hmax);
+		hash.addInt(vol->area);
+	}
+}
+
+// Appends the hashes of the triangles whose xz-bounds overlap [bmin, bmax]
+// (2D), one per triangle: sorted, they don't depend on the order of the
+// triangles in the mesh, nor on those outside the bounds.
+static void hashOverlappingTriangles(const float* verts, const int* tris,
+		const int ntris, const float* bmin, const float* bmax,
+		std::vector<uint64_t>& hashes)
+{
+	for (int i = 0; i < ntris; ++i)
+	{
+		const float* va = &verts[tris[i*3+0]*3];
+		const float* vb = &verts[tris[i*3+1]*3];
+		const float* vc = &verts[tris[i*3+2]*3];
+		if (rcMax(va[0], rcMax(vb[0], vc[0])) < bmin[0] ||
+			rcMin(va[0], rcMin(vb[0], vc[0])) > bmax[0] ||
+			rcMax(va[2], rcMax(vb[2], vc[2])) < bmin[1] ||
+			rcMin(va[2], rcMin(vb[2], vc[2])) > bmax[1])
+			continue;
+		NavMeshBuildHash hash;
+		hash.add(va, sizeof(float)*3);
+		hash.add(vb, sizeof(float)*3);
+		hash.add(vc, sizeof(float)*3);
+		hashes.push_back(hash.get());
+	}
+}
+
+void NavMeshType::hashTerrain(const float* bmin, const float* bmax,
+		NavMeshBuildHash& hash) const
+{
+	const TerrainHeightfield* terrain = m_geom->getTerrain();
+	int r[4];
+	if (!terrain || !terrain->getSampleRange(bmin, bmax, r))
+	{
+		hash.addInt(0);
+		return;
+	}
+	hash.addInt(1);
+	hash.add(terrain->getOrigin(), sizeof(float)*3);
+	hash.add(terrain->getSpacing(), sizeof(float)*2);
+	hash.add(r, sizeof(r));
+	for (int j = r[1]; j <= r[3]; ++j)
+		hash.add(&terrain->getHeights()[r[0] + j*terrain->getWidth()], sizeof(float)*(r[2]-r[0]+1));
+}
+
+bool NavMeshType::hashTileInput(const rcConfig& cfg, const bool offMeshCons,
+		NavMeshBuildHash& hash, const std::vector<float>* streamedVerts) const
+{
+	// rcConfig has only ints and floats, so no padding bytes.
+	hash.add(&cfg, sizeof(cfg));
+	
+	// The triangles rasterized by the tile, by their vertices: the same
+	// geometry in the tile bounds gives the same hash, whatever the indexing
+	// of the mesh, the order of its triangles or the chunks they fall in.
+	float tbmin[2] = { cfg.bmin[0], cfg.bmin[2] };
+	float tbmax[2] = { cfg.bmax[0], cfg.bmax[2] };
+	std::vector<uint64_t> triHashes;
+	if (const GeomBucketStore* store = m_geom->getBucketStore())
+	{
+		// Streamed mesh: the triangles are unindexed already (tris[i] = i).
+		std::vector<float> sverts;
+		std::vector<int> stris;
+		if (!streamedVerts)
+		{
+			if (!store->loadTriangles(tbmin, tbmax, sverts, stris))
+				return false;
+			streamedVerts = &sverts;
+		}
+		const int ntris = (int)streamedVerts->size()/9;
+		stris.resize(ntris*3);
+		for (int i = 0; i < ntris*3; ++i)
+			stris[i] = i;
+		hashOverlappingTriangles(streamedVerts->data(), stris.data(), ntris,
+				tbmin, tbmax, triHashes);
+	}
+	else
+	{
+		const float* verts = m_geom->getMesh()->getVerts();
+		const rcChunkyTriMesh* chunkyMesh = m_geom->getChunkyMesh();
+		int cid[512];
+		const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid, 512);
+		for (int i = 0; i < ncid; ++i)
+		{
+			const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
+			hashOverlappingTriangles(verts, &chunkyMesh->tris[node.i*3], node.n,
+					tbmin, tbmax, triHashes);
+		}
+	}
+	std::sort(triHashes.begin(), triHashes.end());
+	hash.addInt((int)triHashes.size());
+	hash.add(triHashes.data(), sizeof(uint64_t)*(int)triHashes.size());
+	
+	hashTerrain(cfg.bmin, cfg.bmax, hash);
+	hashConvexVolumes(cfg.bmin, cfg.bmax, hash);
+	
+	if (offMeshCons)
+	{
+		OffMeshConnectionSet set;
+		m_geom->gatherOffMeshConnections(cfg.bmin, cfg.bmax, set);
+		hash.addInt(set.count);
+		hash.add(set.verts.data(), sizeof(float)*3*2*set.count);
+		hash.add(set.rads.data(), sizeof(float)*set.count);
+		hash.add(set.dirs.data(), sizeof(unsigned char)*set.count);
+		hash.add(set.areas.data(), sizeof(unsigned char)*set.count);
+		hash.add(set.flags.data(), sizeof(unsigned short)*set.count);
+		hash.add(set.ids.data(), sizeof(unsigned int)*set.count);
+	}
+	return true;
+}
+
+bool NavMeshType::loadStreamedTriangles(rcContext* ctx, const rcConfig& cfg,
+		std::vector<float>& verts, std::vector<int>& tris) const
+{
+	float tbmin[2] = { cfg.bmin[0], cfg.bmin[2] };
+	float tbmax[2] = { cfg.bmax[0], cfg.bmax[2] };
+	if (!m_geom->getBucketStore()->loadTriangles(tbmin, tbmax, verts, tris))
+	{
+		CTXLOG(ctx, RC_LOG_ERROR, "buildNavigation: Could not load the streamed triangles.");
+		return false;
+	}
+	return true;
+}
+
+int NavMeshType::rasterizeStreamedTriangles(rcContext* ctx, const rcConfig& cfg,
+		const std::vector<float>& verts, const std::vector<int>& tris,
+		rcHeightfield& solid) const
+{
+	const int nverts = (int)verts.size()/3;
+	const int ntris = (int)tris.size()/3;
+	if (!ntris)
+		return 0;
+	std::vector<unsigned char> triareas(ntris, 0);
+	rcMarkWalkableTriangles(ctx, cfg.walkableSlopeAngle,
+							verts.data(), nverts, tris.data(), ntris, triareas.data());
+	if (!rcRasterizeTriangles(ctx, verts.data(), nverts, tris.data(), triareas.data(), ntris, solid, cfg.walkableClimb))
+		return -1;
+	return ntris;
+}
+
 const float* NavMeshType::getBoundsMin()
 {
 	if (!m_geom) return 0;
@@ -378,4 +589,22 @@ const float* NavMeshType::getBoundsMax()
 	return m_geom->getMeshBoundsMax();
 }
 
+void runBuildJobs(const int count, const int nthreads,
+		const std::function<void(int, int)>& job)
+{
+	std::atomic<int> next(0);
+	auto worker = [&](const int w)
+	{
+		for (int i = next++; i < count; i = next++)
+			job(w, i);
+	};
+	const int n = rcMin(nthreads, count);
+	std::vector<std::thread> threads;
+	for (int w = 1; w < n; ++w)
+		threads.push_back(std::thread(worker, w));
+	worker(0);
+	for (size_t w = 0; w < threads.size(); ++w)
+		threads[w].join();
+}
+
 } // namespace rnsup
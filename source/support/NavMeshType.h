@@ -28,8 +28,12 @@
 
 #include "InputGeom.h"
 #include "DebugInterfaces.h"
+#include "NavMeshAlloc.h"
+#include "NavMeshCompressor.h"
+#include "NavMeshBuildCache.h"
 #include <DetourNavMeshQuery.h>
 #include <DetourCrowd.h>
+#include <functional>
 
 namespace rnsup
 {
@@ -88,6 +92,16 @@ enum NavMeshPartitionType
 	NAVMESH_PARTITION_MONOTONE,
 	NAVMESH_PARTITION_LAYERS,
 };
+///Initial and maximum search nodes of the nav mesh query: its node pool
+///grows on the searches needing more nodes.
+static const int NAVMESH_QUERY_NODES = 2048;
+static const int NAVMESH_QUERY_NODES_CAP = 16384;
+
+///Runs job(worker, index) for each index in [0, count), on up to nthreads
+///threads (worker 0 is the calling one). Indices are handed out in
+///increasing order, and the call returns when all jobs are done.
+void runBuildJobs(const int count, const int nthreads,
+		const std::function<void(int, int)>& job);
 ///Table giving for each area the corresponding (or'ed) flags.
 typedef std::map<int,int> NavMeshPolyAreaFlags;
 ///Table giving for each area the corresponding cost (for dtCrowd).
@@ -134,6 +148,11 @@ struct NavMeshSettings
 	float m_detailSampleDist;
 	float m_detailSampleMaxError;
 	int m_partitionType;
+	int m_allocatorType;
+	bool m_buildDetailGrid;
+	int m_buildThreads;
+	bool m_parallelContours;
+	bool m_parallelDetail;
 };
 
 ///NavMesh tile settings.
@@ -143,6 +162,9 @@ struct NavMeshTileSettings
 	int m_maxTiles;
 	int m_maxPolysPerTile;
 	float m_tileSize;
+	int m_compressorType;
+	int m_maxObstacles;
+	int m_maxObstaclesCap;
 };
 
 class NavMeshType
@@ -169,6 +191,11 @@ protected:
 	float m_detailSampleDist;
 	float m_detailSampleMaxError;
 	int m_partitionType;
+	int m_allocatorType;
+	bool m_buildDetailGrid;
+	int m_buildThreads;
+	bool m_parallelContours;
+	bool m_parallelDetail;
 
 	bool m_filterLowHangingObstacles;
 	bool m_filterLedgeSpans;
@@ -177,6 +204,7 @@ protected:
 	NavMeshTypeTool* m_tool;
 	NavMeshTypeToolState* m_toolStates[MAX_TOOLS];
 	NavMeshPolyAreaFlags m_flagsAreaTable;
+	NavMeshBuildCache m_buildCache;
 	
 	BuildContext* m_ctx;
 
@@ -207,6 +235,10 @@ public:
 	virtual bool handleBuild();
 	virtual void handleUpdate(const float dt);
 	virtual void collectSettings(struct BuildSettings& settings);
+	///Replaces the input mesh (then owned by the geometry, which keeps its
+	///bounds) and rebuilds only the tiles whose input hash changed. Returns
+	///the number of rebuilt tiles, or -1 on error (or if unsupported).
+	virtual int handleMeshRefresh(class rcMeshLoaderObj* mesh);
 
 	virtual class InputGeom* getInputGeom() { return m_geom; }
 	virtual class dtNavMesh* getNavMesh() { return m_navMesh; }
@@ -218,6 +250,10 @@ public:
 	void setNavMeshSettings(const NavMeshSettings& settings);
 	NavMeshSettings getNavMeshSettings();
 	void resetNavMeshSettings();
+	///Returns the number of threads building tiles, contours (if
+	///m_parallelContours) and detail meshes (if m_parallelDetail):
+	///m_buildThreads, or the number of hardware threads if it is 0.
+	int getBuildThreadCount() const;
 
 	virtual const float* getBoundsMin();
 	virtual const float* getBoundsMax();
@@ -235,6 +271,37 @@ public:
 //	void handleCommonSettings();
 
 	void setFlagsAreaTable(const NavMeshPolyAreaFlags& flagsAreaTable) { m_flagsAreaTable = flagsAreaTable; }
+	///Sets the directory of the build cache (empty to disable it).
+	void setBuildCacheDir(const std::string& dir) { m_buildCache.setDirectory(dir); }
+	NavMeshBuildCache& getBuildCache() { return m_buildCache; }
+
+protected:
+	///Adds to the hash what all the build outputs depend on, other than
+	///the rcConfig and the input geometry (see NavMeshBuildOutputEnum).
+	void hashBuildSettings(const int output, NavMeshBuildHash& hash) const;
+	///Adds to the hash the convex volumes overlapping the bounds.
+	void hashConvexVolumes(const float* bmin, const float* bmax,
+			NavMeshBuildHash& hash) const;
+	///Adds to the hash the terrain samples overlapping the bounds.
+	void hashTerrain(const float* bmin, const float* bmax,
+			NavMeshBuildHash& hash) const;
+	///Adds to the hash the inputs of the tile built with cfg: the config,
+	///the triangles overlapping its bounds (in any order), the terrain, the
+	///convex volumes and, if offMeshCons is true, the off-mesh connections in its bounds.
+	///With a streamed mesh the triangles of the tile are streamedVerts, if
+	///already loaded, or are loaded here. Returns false if they can't be.
+	bool hashTileInput(const struct rcConfig& cfg, const bool offMeshCons,
+			NavMeshBuildHash& hash, const std::vector<float>* streamedVerts = 0) const;
+	///Loads the triangles of a streamed mesh overlapping the bounds of cfg,
+	///and only them (see GeomBucketStore). Can be called concurrently.
+	bool loadStreamedTriangles(class rcContext* ctx, const struct rcConfig& cfg,
+			std::vector<float>& verts, std::vector<int>& tris) const;
+	///Rasterizes into solid the triangles loaded by loadStreamedTriangles.
+	///Returns their number, or -1 on error. Can be called concurrently.
+	int rasterizeStreamedTriangles(class rcContext* ctx, const struct rcConfig& cfg,
+			const std::vector<float>& verts, const std::vector<int>& tris,
+			struct rcHeightfield& solid) const;
+
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
 	NavMeshType(const NavMeshType&);
@@ -28,12 +28,16 @@
 #include <string.h>
 #include <float.h>
 #include <new>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "NavMeshType_Obstacle.h"
 #include "DebugInterfaces.h"
 #include "InputGeom.h"
 #include "ChunkyTriMesh.h"
 #include "ConvexVolumeTool.h"
-#include "fastlz.h"
 #include <Recast.h>
 #include <DetourNavMeshBuilder.h>
 #include <DetourDebugDraw.h>
@@ -100,73 +104,249 @@ namespace rnsup
 
 
 
-struct FastLZCompressor : public dtTileCacheCompressor
+///Tile cache scratch memory: each thread gets its own arena, made of
+///chunks which are allocated on demand. On reset, an arena which needed
+///more than one chunk is replaced by a single chunk as big as its
+///high-water mark, so steady state builds don't allocate at all. Arenas
+///are given back when their thread exits, and reused by the next ones.
+struct LinearArena
 {
-	virtual int maxCompressedSize(const int bufferSize)
+	struct Chunk
 	{
-		return (int)(bufferSize* 1.05f);
+		Chunk* next;
+		size_t capacity;
+		size_t top;
+	};
+	static const size_t CHUNK_HEADER_SIZE = (sizeof(Chunk) + 15) & ~(size_t)15;
+
+	Chunk* chunks;
+	size_t used;
+	size_t high;
+	int growCount;
+
+	LinearArena(const size_t cap) :
+			chunks(0), used(0), high(0), growCount(0)
+	{
+		addChunk(cap);
+	}
+
+	~LinearArena()
+	{
+		freeChunks();
+	}
+
+	void freeChunks()
+	{
+		while (chunks)
+		{
+			Chunk* next = chunks->next;
+			dtFree(chunks);
+			chunks = next;
+		}
+	}
+
+	bool addChunk(const size_t cap)
+	{
+		Chunk* chunk = (Chunk*)dtAlloc(CHUNK_HEADER_SIZE + cap, DT_ALLOC_PERM);
+		if (!chunk)
+			return false;
+		chunk->next = chunks;
+		chunk->capacity = cap;
+		chunk->top = 0;
+		chunks = chunk;
+		return true;
+	}
+
+	void reset()
+	{
+		high = dtMax(high, used);
+		if (chunks && chunks->next)
+		{
+			// Presize to the high-water mark.
+			freeChunks();
+			addChunk(high);
+		}
+		else if (chunks)
+		{
+			chunks->top = 0;
+		}
+		used = 0;
 	}
+
+	void* alloc(const size_t size)
+	{
+		const size_t alignedSize = (size + 15) & ~(size_t)15;
+		if (!chunks || chunks->top + alignedSize > chunks->capacity)
+		{
+			// Grow: double the current capacity.
+			size_t cap = chunks ? chunks->capacity * 2 : alignedSize;
+			if (cap < alignedSize)
+				cap = alignedSize;
+			if (!addChunk(cap))
+				return 0;
+			growCount++;
+		}
+		unsigned char* mem = (unsigned char*)chunks + CHUNK_HEADER_SIZE + chunks->top;
+		chunks->top += alignedSize;
+		used += alignedSize;
+		return mem;
+	}
+
+	size_t reserved() const
+	{
+		size_t size = 0;
+		for (const Chunk* chunk = chunks; chunk; chunk = chunk->next)
+			size += chunk->capacity;
+		return size;
+	}
+};
+
+///Arenas of a LinearAllocator: shared with the threads holding one of
+///them, so it outlives the allocator until they give them back.
+struct LinearArenaPool
+{
+	std::mutex lock;
+	std::vector<LinearArena*> arenas;
+	std::vector<LinearArena*> freeArenas;
 	
-	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
-							  unsigned char* compressed, const int /*maxCompressedSize*/, int* compressedSize)
+	~LinearArenaPool()
 	{
-		*compressedSize = fastlz_compress((const void *const)buffer, bufferSize, compressed);
-		return DT_SUCCESS;
+		for (size_t i = 0; i < arenas.size(); ++i)
+			delete arenas[i];
 	}
 	
-	virtual dtStatus decompress(const unsigned char* compressed, const int compressedSize,
-								unsigned char* buffer, const int maxBufferSize, int* bufferSize)
+	void giveBack(LinearArena* arena)
+	{
+		arena->reset();
+		std::lock_guard<std::mutex> guard(lock);
+		freeArenas.push_back(arena);
+	}
+};
+
+///The arenas held by a thread, given back to their pools on thread exit
+///(build workers are short lived).
+struct LinearArenaLeases
+{
+	struct Lease
+	{
+		std::shared_ptr<LinearArenaPool> pool;
+		unsigned int id;
+		LinearArena* arena;
+	};
+	std::vector<Lease> leases;
+	
+	~LinearArenaLeases()
 	{
-		*bufferSize = fastlz_decompress(compressed, compressedSize, buffer, maxBufferSize);
-		return *bufferSize < 0 ? DT_FAILURE : DT_SUCCESS;
+		for (size_t i = 0; i < leases.size(); ++i)
+			leases[i].pool->giveBack(leases[i].arena);
 	}
 };
 
+static thread_local LinearArenaLeases t_arenaLeases;
+// Per thread cache of the last arena used.
+static thread_local unsigned int t_cachedAllocatorId = 0;
+static thread_local LinearArena* t_cachedArena = 0;
+
 struct LinearAllocator : public dtTileCacheAlloc
 {
-	unsigned char* buffer;
-	size_t capacity;
-	size_t top;
-	size_t high;
+	std::shared_ptr<LinearArenaPool> pool;
+	const size_t initialCapacity;
+	const unsigned int id;
 	
-	LinearAllocator(const size_t cap) : buffer(0), capacity(0), top(0), high(0)
+	LinearAllocator(const size_t cap) : pool(std::make_shared<LinearArenaPool>()),
+			initialCapacity(cap), id(nextId()++)
 	{
-		resize(cap);
 	}
 	
 	~LinearAllocator()
 	{
-		dtFree(buffer);
+		// The calling thread's arena is freed with the pool, the other
+		// threads' ones when they exit.
+		std::vector<LinearArenaLeases::Lease>& leases = t_arenaLeases.leases;
+		for (size_t i = 0; i < leases.size(); ++i)
+		{
+			if (leases[i].id == id)
+			{
+				pool->giveBack(leases[i].arena);
+				leases.erase(leases.begin() + i);
+				break;
+			}
+		}
+		if (t_cachedAllocatorId == id)
+			t_cachedAllocatorId = 0;
+	}
+	
+	static std::atomic<unsigned int>& nextId()
+	{
+		static std::atomic<unsigned int> value(1);
+		return value;
 	}
 
-	void resize(const size_t cap)
+	///Returns the calling thread's arena.
+	LinearArena* getArena()
 	{
-		if (buffer) dtFree(buffer);
-		buffer = (unsigned char*)dtAlloc(cap, DT_ALLOC_PERM);
-		capacity = cap;
+		if (t_cachedAllocatorId == id)
+			return t_cachedArena;
+		
+		std::vector<LinearArenaLeases::Lease>& leases = t_arenaLeases.leases;
+		LinearArena* arena = 0;
+		for (size_t i = 0; i < leases.size() && !arena; ++i)
+		{
+			if (leases[i].id == id)
+				arena = leases[i].arena;
+		}
+		if (!arena)
+		{
+			{
+				std::lock_guard<std::mutex> guard(pool->lock);
+				if (!pool->freeArenas.empty())
+				{
+					arena = pool->freeArenas.back();
+					pool->freeArenas.pop_back();
+				}
+				else
+				{
+					arena = new LinearArena(initialCapacity);
+					pool->arenas.push_back(arena);
+				}
+			}
+			LinearArenaLeases::Lease lease = { pool, id, arena };
+			leases.push_back(lease);
+		}
+		t_cachedAllocatorId = id;
+		t_cachedArena = arena;
+		return arena;
 	}
 	
 	virtual void reset()
 	{
-		high = dtMax(high, top);
-		top = 0;
+		getArena()->reset();
 	}
 	
 	virtual void* alloc(const size_t size)
 	{
-		if (!buffer)
-			return 0;
-		if (top+size > capacity)
-			return 0;
-		unsigned char* mem = &buffer[top];
-		top += size;
-		return mem;
+		return getArena()->alloc(size);
 	}
 	
 	virtual void free(void* /*ptr*/)
 	{
 		// Empty
 	}
+
+	void getStats(NavMeshType_Obstacle::ScratchStats& stats)
+	{
+		memset(&stats, 0, sizeof(stats));
+		std::lock_guard<std::mutex> guard(pool->lock);
+		const std::vector<LinearArena*>& arenas = pool->arenas;
+		stats.arenaCount = (int)arenas.size();
+		for (size_t i = 0; i < arenas.size(); ++i)
+		{
+			stats.peakUsage = dtMax(stats.peakUsage,
+					dtMax(arenas[i]->high, arenas[i]->used));
+			stats.reservedSize += arenas[i]->reserved();
+			stats.growCount += arenas[i]->growCount;
+		}
+	}
 };
 
 struct MeshProcess : public dtTileCacheMeshProcess
@@ -195,8 +375,12 @@ struct MeshProcess : public dtTileCacheMeshProcess
 			//set polyFlags for polyAreas only if m_flagsAreaTable not empty
 			if (! (*m_flagsAreaTable).empty())
 			{ 
-				// get flags from a table indexed by areas
-				polyFlags[i] = (*m_flagsAreaTable)[polyAreas[i]];
+				// get flags from a table indexed by areas: read only, since
+				// tiles are processed concurrently; unlisted areas get none
+				NavMeshPolyAreaFlags::const_iterator iter =
+						m_flagsAreaTable->find(polyAreas[i]);
+				polyFlags[i] = iter != m_flagsAreaTable->end() ?
+						(unsigned short)iter->second : 0;
 			} 
 			else
 			{ 
@@ -218,16 +402,20 @@ struct MeshProcess : public dtTileCacheMeshProcess
 			} 
 		}
 
-		// Pass in off-mesh connections.
+		// Pass in off-mesh connections: only the ones with an endpoint in
+		// the tile matter. Tiles can be processed concurrently, so each
+		// thread gathers into its own set, used until the tile is created.
 		if (m_geom)
 		{
-			params->offMeshConVerts = m_geom->getOffMeshConnectionVerts();
-			params->offMeshConRad = m_geom->getOffMeshConnectionRads();
-			params->offMeshConDir = m_geom->getOffMeshConnectionDirs();
-			params->offMeshConAreas = m_geom->getOffMeshConnectionAreas();
-			params->offMeshConFlags = m_geom->getOffMeshConnectionFlags();
-			params->offMeshConUserID = m_geom->getOffMeshConnectionId();
-			params->offMeshConCount = m_geom->getOffMeshConnectionCount();	
+			static thread_local OffMeshConnectionSet offMeshCons;
+			m_geom->gatherOffMeshConnections(params->bmin, params->bmax, offMeshCons);
+			params->offMeshConVerts = offMeshCons.verts.data();
+			params->offMeshConRad = offMeshCons.rads.data();
+			params->offMeshConDir = offMeshCons.dirs.data();
+			params->offMeshConAreas = offMeshCons.areas.data();
+			params->offMeshConFlags = offMeshCons.flags.data();
+			params->offMeshConUserID = offMeshCons.ids.data();
+			params->offMeshConCount = offMeshCons.count;
 		}
 	}
 };
@@ -279,139 +467,330 @@ struct RasterizationContext
 	int ntiles;
 };
 
+void NavMeshType_Obstacle::initConfig(rcConfig& cfg) const
+{
+	const float* bmin = m_geom->getNavMeshBoundsMin();
+	const float* bmax = m_geom->getNavMeshBoundsMax();
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.cs = m_cellSize;
+	cfg.ch = m_cellHeight;
+	cfg.walkableSlopeAngle = m_agentMaxSlope;
+	cfg.walkableHeight = (int)ceilf(m_agentHeight / cfg.ch);
+	cfg.walkableClimb = (int)floorf(m_agentMaxClimb / cfg.ch);
+	cfg.walkableRadius = (int)ceilf(m_agentRadius / cfg.cs);
+	cfg.maxEdgeLen = (int)(m_edgeMaxLen / m_cellSize);
+	cfg.maxSimplificationError = m_edgeMaxError;
+	cfg.minRegionArea = (int)rcSqr(m_regionMinSize);		// Note: area = size*size
+	cfg.mergeRegionArea = (int)rcSqr(m_regionMergeSize);	// Note: area = size*size
+	cfg.maxVertsPerPoly = (int)m_vertsPerPoly;
+	cfg.tileSize = (int)m_tileSize;
+	cfg.borderSize = cfg.walkableRadius + 3; // Reserve enough padding.
+	cfg.width = cfg.tileSize + cfg.borderSize*2;
+	cfg.height = cfg.tileSize + cfg.borderSize*2;
+	cfg.detailSampleDist = m_detailSampleDist < 0.9f ? 0 : m_cellSize * m_detailSampleDist;
+	cfg.detailSampleMaxError = m_cellHeight * m_detailSampleMaxError;
+	rcVcopy(cfg.bmin, bmin);
+	rcVcopy(cfg.bmax, bmax);
+}
+
+void NavMeshType_Obstacle::initTileConfig(const rcConfig& cfg, const int tx, const int ty, rcConfig& tcfg) const
+{
+	// Tile bounds.
+	const float tcs = cfg.tileSize * cfg.cs;
+	
+	memcpy(&tcfg, &cfg, sizeof(tcfg));
+
+	tcfg.bmin[0] = cfg.bmin[0] + tx*tcs;
+	tcfg.bmin[1] = cfg.bmin[1];
+	tcfg.bmin[2] = cfg.bmin[2] + ty*tcs;
+	tcfg.bmax[0] = cfg.bmin[0] + (tx+1)*tcs;
+	tcfg.bmax[1] = cfg.bmax[1];
+	tcfg.bmax[2] = cfg.bmin[2] + (ty+1)*tcs;
+	tcfg.bmin[0] -= tcfg.borderSize*tcfg.cs;
+	tcfg.bmin[2] -= tcfg.borderSize*tcfg.cs;
+	tcfg.bmax[0] += tcfg.borderSize*tcfg.cs;
+	tcfg.bmax[2] += tcfg.borderSize*tcfg.cs;
+}
+
+// Returns 0 if the inputs of the tile can't be loaded.
+uint64_t NavMeshType_Obstacle::getTileHash(const rcConfig& cfg, const int tx, const int ty,
+		const std::vector<float>* streamedVerts) const
+{
+	rcConfig tcfg;
+	initTileConfig(cfg, tx, ty, tcfg);
+	NavMeshBuildHash hash;
+	hashBuildSettings(NAVMESH_BUILD_OUTPUT_LAYERS, hash);
+	hash.addInt(m_compressorType);
+	hash.addInt(tx);
+	hash.addInt(ty);
+	// The off-mesh connections are added when building the nav mesh tiles.
+	if (!hashTileInput(tcfg, false, hash, streamedVerts))
+		return 0;
+	return hash.get();
+}
+
+void NavMeshType_Obstacle::hashTiles(const rcConfig& cfg, const int tw, const int th, std::vector<uint64_t>& hashes) const
+{
+	// Read only access to the geometry: the tiles are hashed in parallel.
+	const int ntiles = tw*th;
+	hashes.assign(ntiles, 0);
+	const int nthreads = rcMax(rcMin(getBuildThreadCount(), ntiles), 1);
+	runBuildJobs(ntiles, nthreads, [&](int /*w*/, int i)
+	{
+		hashes[i] = getTileHash(cfg, i % tw, i / tw);
+	});
+}
+
+void NavMeshType_Obstacle::rasterizeTilesLayers(const rcConfig& cfg, const int tw,
+		const std::vector<int>& tiles, std::vector<TileCacheData>& layers, std::vector<int>& nlayers)
+{
+	// Each thread has its own context and compressor, the calling one uses
+	// m_ctx and m_tcomp.
+	const int ntiles = (int)tiles.size();
+	const int nthreads = rcMax(rcMin(getBuildThreadCount(), ntiles), 1);
+	std::vector<rcContext*> ctxs(nthreads, (rcContext*)0);
+	std::vector<dtTileCacheCompressor*> comps(nthreads, (dtTileCacheCompressor*)0);
+	ctxs[0] = m_ctx;
+	comps[0] = m_tcomp;
+	for (int w = 1; w < nthreads; ++w)
+	{
+		ctxs[w] = new rcContext(false);
+		comps[w] = createTileCacheCompressor(m_compressorType);
+	}
+	TileCacheData empty = { 0, 0 };
+	layers.assign(ntiles*MAX_LAYERS, empty);
+	nlayers.assign(ntiles, 0);
+	runBuildJobs(ntiles, nthreads, [&](int w, int i)
+	{
+		nlayers[i] = rasterizeTileLayers(ctxs[w], comps[w], tiles[i] % tw, tiles[i] / tw,
+				cfg, &layers[i*MAX_LAYERS], MAX_LAYERS);
+		// Recycle temp memory used by this tile.
+		resetNavMeshTempArena();
+	});
+	for (int w = 1; w < nthreads; ++w)
+	{
+		delete ctxs[w];
+		delete comps[w];
+	}
+}
+
+void NavMeshType_Obstacle::buildNavMeshTiles(const std::vector<dtCompressedTileRef>& refs)
+{
+	// The tile data in parallel, then the tiles are added to the nav mesh in
+	// order.
+	const int nthreads = rcMax(rcMin(getBuildThreadCount(), (int)refs.size()), 1);
+	std::vector<unsigned char*> navData(refs.size(), (unsigned char*)0);
+	std::vector<int> navDataSize(refs.size(), 0);
+	std::vector<dtStatus> navStatus(refs.size(), DT_FAILURE);
+	runBuildJobs((int)refs.size(), nthreads, [&](int /*w*/, int i)
+	{
+		navStatus[i] = m_tileCache->buildNavMeshTileData(refs[i], &navData[i],
+				&navDataSize[i]);
+		resetNavMeshTempArena();
+	});
+	for (size_t i = 0; i < refs.size(); ++i)
+	{
+		if (dtStatusFailed(navStatus[i]))
+		{
+			dtFree(navData[i]);
+			continue;
+		}
+		m_tileCache->replaceNavMeshTile(refs[i], navData[i], navDataSize[i], m_navMesh);
+	}
+}
+
 int NavMeshType_Obstacle::rasterizeTileLayers(
+							   rcContext* ctx, dtTileCacheCompressor* comp,
 							   const int tx, const int ty,
 							   const rcConfig& cfg,
 							   rnsup::TileCacheData* tiles,
 							   const int maxTiles)
 {
-	if (!m_geom || !m_geom->getMesh() || !m_geom->getChunkyMesh())
+	if (!m_geom || !m_geom->getMesh() || (!m_geom->getChunkyMesh() && !m_geom->getBucketStore()))
 	{
-		CTXLOG(m_ctx, RC_LOG_ERROR, "buildTile: Input mesh is not specified.");
+		CTXLOG(ctx, RC_LOG_ERROR, "buildTile: Input mesh is not specified.");
 		return 0;
 	}
 	
-	rnsup::FastLZCompressor comp;
 	rnsup::RasterizationContext rc;
 	
 	const float* verts = m_geom->getMesh()->getVerts();
 	const int nverts = m_geom->getMesh()->getVertCount();
 	const rnsup::rcChunkyTriMesh* chunkyMesh = m_geom->getChunkyMesh();
 	
-	// Tile bounds.
-	const float tcs = cfg.tileSize * cfg.cs;
-	
 	rcConfig tcfg;
-	memcpy(&tcfg, &cfg, sizeof(tcfg));
-
-	tcfg.bmin[0] = cfg.bmin[0] + tx*tcs;
-	tcfg.bmin[1] = cfg.bmin[1];
-	tcfg.bmin[2] = cfg.bmin[2] + ty*tcs;
-	tcfg.bmax[0] = cfg.bmin[0] + (tx+1)*tcs;
-	tcfg.bmax[1] = cfg.bmax[1];
-	tcfg.bmax[2] = cfg.bmin[2] + (ty+1)*tcs;
-	tcfg.bmin[0] -= tcfg.borderSize*tcfg.cs;
-	tcfg.bmin[2] -= tcfg.borderSize*tcfg.cs;
-	tcfg.bmax[0] += tcfg.borderSize*tcfg.cs;
-	tcfg.bmax[2] += tcfg.borderSize*tcfg.cs;
+	initTileConfig(cfg, tx, ty, tcfg);
+	
+	// The layers are keyed by the inputs of the tile: on a build cache hit
+	// they are read back, as (size, data) pairs preceded by their count.
+	// A streamed mesh is loaded once, for both the key and the rasterization.
+	std::vector<float> sverts;
+	std::vector<int> stris;
+	if (m_geom->getBucketStore() && !loadStreamedTriangles(ctx, tcfg, sverts, stris))
+		return 0;
+	uint64_t cacheKey = 0;
+	if (m_buildCache.isEnabled())
+	{
+		cacheKey = getTileHash(cfg, tx, ty, &sverts);
+		
+		unsigned char* data = 0;
+		int dataSize = 0;
+		if (m_buildCache.load(cacheKey, &data, &dataSize))
+		{
+			int n = 0, pos = 0;
+			int count = 0;
+			if (dataSize >= (int)sizeof(int))
+			{
+				memcpy(&count, data, sizeof(int));
+				pos += sizeof(int);
+			}
+			for (; n < rcMin(count, maxTiles); ++n)
+			{
+				int size = 0;
+				if (pos + (int)sizeof(int) > dataSize)
+					break;
+				memcpy(&size, data + pos, sizeof(int));
+				pos += sizeof(int);
+				if (size <= 0 || pos + size > dataSize)
+					break;
+				tiles[n].data = (unsigned char*)dtAlloc(size, DT_ALLOC_PERM);
+				if (!tiles[n].data)
+					break;
+				memcpy(tiles[n].data, data + pos, size);
+				tiles[n].dataSize = size;
+				pos += size;
+			}
+			dtFree(data);
+			if (n == rcMin(count, maxTiles))
+				return n;
+			// Malformed: drop the layers read and build them.
+			for (int i = 0; i < n; ++i)
+			{
+				dtFree(tiles[i].data);
+				tiles[i].data = 0;
+				tiles[i].dataSize = 0;
+			}
+		}
+	}
 	
 	// Allocate voxel heightfield where we rasterize our input data to.
 	rc.solid = rcAllocHeightfield();
 	if (!rc.solid)
 	{
-		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Out of memory 'solid'.");
+		CTXLOG(ctx, RC_LOG_ERROR, "buildNavigation: Out of memory 'solid'.");
 		return 0;
 	}
-	if (!rcCreateHeightfield(m_ctx, *rc.solid, tcfg.width, tcfg.height, tcfg.bmin, tcfg.bmax, tcfg.cs, tcfg.ch))
+	if (!rcCreateHeightfield(ctx, *rc.solid, tcfg.width, tcfg.height, tcfg.bmin, tcfg.bmax, tcfg.cs, tcfg.ch))
 	{
-		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Could not create solid heightfield.");
+		CTXLOG(ctx, RC_LOG_ERROR, "buildNavigation: Could not create solid heightfield.");
 		return 0;
 	}
 	
-	// Allocate array that can hold triangle flags.
-	// If you have multiple meshes you need to process, allocate
-	// and array which can hold the max number of triangles you need to process.
-	rc.triareas = new unsigned char[chunkyMesh->maxTrisPerChunk];
-	if (!rc.triareas)
-	{
-		CTXLOG1(m_ctx, RC_LOG_ERROR, "buildNavigation: Out of memory 'm_triareas' (%d).", chunkyMesh->maxTrisPerChunk);
-		return 0;
-	}
+	// A tile is empty without triangles and terrain.
+	const TerrainHeightfield* terrain = m_geom->getTerrain();
+	int terrainRange[4];
+	const bool hasTerrain = terrain && terrain->getSampleRange(tcfg.bmin, tcfg.bmax, terrainRange);
 	
-	float tbmin[2], tbmax[2];
-	tbmin[0] = tcfg.bmin[0];
-	tbmin[1] = tcfg.bmin[2];
-	tbmax[0] = tcfg.bmax[0];
-	tbmax[1] = tcfg.bmax[2];
-	int cid[512];// TODO: Make grow when returning too many items.
-	const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid, 512);
-	if (!ncid)
+	if (m_geom->getBucketStore())
 	{
-		return 0; // empty
+		// Streamed mesh: only the triangles of this tile are loaded.
+		const int ntris = rasterizeStreamedTriangles(ctx, tcfg, sverts, stris, *rc.solid);
+		if (ntris < 0 || (!ntris && !hasTerrain))
+		{
+			return 0; // empty
+		}
 	}
-	
-	for (int i = 0; i < ncid; ++i)
+	else
 	{
-		const rnsup::rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
-		const int* tris = &chunkyMesh->tris[node.i*3];
-		const int ntris = node.n;
+		// Allocate array that can hold triangle flags.
+		// If you have multiple meshes you need to process, allocate
+		// and array which can hold the max number of triangles you need to process.
+		rc.triareas = new unsigned char[chunkyMesh->maxTrisPerChunk];
+		if (!rc.triareas)
+		{
+			CTXLOG1(ctx, RC_LOG_ERROR, "buildNavigation: Out of memory 'm_triareas' (%d).", chunkyMesh->maxTrisPerChunk);
+			return 0;
+		}
 		
-		memset(rc.triareas, 0, ntris*sizeof(unsigned char));
-		rcMarkWalkableTriangles(m_ctx, tcfg.walkableSlopeAngle,
-								verts, nverts, tris, ntris, rc.triareas);
+		float tbmin[2], tbmax[2];
+		tbmin[0] = tcfg.bmin[0];
+		tbmin[1] = tcfg.bmin[2];
+		tbmax[0] = tcfg.bmax[0];
+		tbmax[1] = tcfg.bmax[2];
+		int cid[512];// TODO: Make grow when returning too many items.
+		const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid, 512);
+		if (!ncid && !hasTerrain)
+		{
+			return 0; // empty
+		}
 		
-		if (!rcRasterizeTriangles(m_ctx, verts, nverts, tris, rc.triareas, ntris, *rc.solid, tcfg.walkableClimb))
-			return 0;
+		for (int i = 0; i < ncid; ++i)
+		{
+			const rnsup::rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
+			const int* tris = &chunkyMesh->tris[node.i*3];
+			const int ntris = node.n;
+		
+			memset(rc.triareas, 0, ntris*sizeof(unsigned char));
+			rcMarkWalkableTriangles(ctx, tcfg.walkableSlopeAngle,
+									verts, nverts, tris, ntris, rc.triareas);
+		
+			if (!rcRasterizeTriangles(ctx, verts, nverts, tris, rc.triareas, ntris, *rc.solid, tcfg.walkableClimb))
+				return 0;
+		}
 	}
+	// The terrain is voxelized directly, column by column.
+	if (hasTerrain && !terrain->rasterize(ctx, tcfg.walkableSlopeAngle, tcfg.walkableClimb, *rc.solid))
+		return 0;
 	
 	// Once all geometry is rasterized, we do initial pass of filtering to
 	// remove unwanted overhangs caused by the conservative rasterization
 	// as well as filter spans where the character cannot possibly stand.
+	// The filters share a single column-compacted copy of the spans.
+	int filters = 0;
 	if (m_filterLowHangingObstacles)
-		rcFilterLowHangingWalkableObstacles(m_ctx, tcfg.walkableClimb, *rc.solid);
+		filters |= RC_FILTER_LOW_HANGING_OBSTACLES;
 	if (m_filterLedgeSpans)
-		rcFilterLedgeSpans(m_ctx, tcfg.walkableHeight, tcfg.walkableClimb, *rc.solid);
+		filters |= RC_FILTER_LEDGE_SPANS;
 	if (m_filterWalkableLowHeightSpans)
-		rcFilterWalkableLowHeightSpans(m_ctx, tcfg.walkableHeight, *rc.solid);
+		filters |= RC_FILTER_WALKABLE_LOW_HEIGHT_SPANS;
+	if (!rcFilterWalkableSpans(ctx, filters, tcfg.walkableHeight, tcfg.walkableClimb, *rc.solid))
+	{
+		CTXLOG(ctx, RC_LOG_ERROR, "buildNavigation: Could not filter walkable spans.");
+		return 0;
+	}
 	
 	
 	rc.chf = rcAllocCompactHeightfield();
 	if (!rc.chf)
 	{
-		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Out of memory 'chf'.");
+		CTXLOG(ctx, RC_LOG_ERROR, "buildNavigation: Out of memory 'chf'.");
 		return 0;
 	}
-	if (!rcBuildCompactHeightfield(m_ctx, tcfg.walkableHeight, tcfg.walkableClimb, *rc.solid, *rc.chf))
+	if (!rcBuildCompactHeightfield(ctx, tcfg.walkableHeight, tcfg.walkableClimb, *rc.solid, *rc.chf))
 	{
-		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Could not build compact data.");
+		CTXLOG(ctx, RC_LOG_ERROR, "buildNavigation: Could not build compact data.");
 		return 0;
 	}
 	
 	// Erode the walkable area by agent radius.
-	if (!rcErodeWalkableArea(m_ctx, tcfg.walkableRadius, *rc.chf))
+	if (!rcErodeWalkableArea(ctx, tcfg.walkableRadius, *rc.chf))
 	{
-		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Could not erode.");
+		CTXLOG(ctx, RC_LOG_ERROR, "buildNavigation: Could not erode.");
 		return 0;
 	}
 	
 	// (Optional) Mark areas.
-	const rnsup::ConvexVolume* vols = m_geom->getConvexVolumes();
-	for (int i  = 0; i < m_geom->getConvexVolumeCount(); ++i)
-	{
-		rcMarkConvexPolyArea(m_ctx, vols[i].verts, vols[i].nverts,
-							 vols[i].hmin, vols[i].hmax,
-							 (unsigned char)vols[i].area, *rc.chf);
-	}
+	m_geom->markConvexVolumes(ctx, *rc.chf);
 	
 	rc.lset = rcAllocHeightfieldLayerSet();
 	if (!rc.lset)
 	{
-		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Out of memory 'lset'.");
+		CTXLOG(ctx, RC_LOG_ERROR, "buildNavigation: Out of memory 'lset'.");
 		return 0;
 	}
-	if (!rcBuildHeightfieldLayers(m_ctx, *rc.chf, tcfg.borderSize, tcfg.walkableHeight, *rc.lset))
+	if (!rcBuildHeightfieldLayers(ctx, *rc.chf, tcfg.borderSize, tcfg.walkableHeight, *rc.lset))
 	{
-		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Could not build heighfield layers.");
+		CTXLOG(ctx, RC_LOG_ERROR, "buildNavigation: Could not build heighfield layers.");
 		return 0;
 	}
 	
@@ -443,7 +822,7 @@ int NavMeshType_Obstacle::rasterizeTileLayers(
 		header.hmin = (unsigned short)layer->hmin;
 		header.hmax = (unsigned short)layer->hmax;
 
-		dtStatus status = dtBuildTileCacheLayer(&comp, &header, layer->heights, layer->areas, layer->cons,
+		dtStatus status = dtBuildTileCacheLayer(comp, &header, layer->heights, layer->areas, layer->cons,
 												&tile->data, &tile->dataSize);
 		if (dtStatusFailed(status))
 		{
@@ -451,6 +830,20 @@ int NavMeshType_Obstacle::rasterizeTileLayers(
 		}
 	}
 
+	if (m_buildCache.isEnabled())
+	{
+		std::vector<unsigned char> data(sizeof(int));
+		memcpy(data.data(), &rc.ntiles, sizeof(int));
+		for (int i = 0; i < rc.ntiles; ++i)
+		{
+			const int pos = (int)data.size();
+			data.resize(pos + sizeof(int) + rc.tiles[i].dataSize);
+			memcpy(&data[pos], &rc.tiles[i].dataSize, sizeof(int));
+			memcpy(&data[pos + sizeof(int)], rc.tiles[i].data, rc.tiles[i].dataSize);
+		}
+		m_buildCache.store(cacheKey, data.data(), (int)data.size());
+	}
+	
 	// Transfer ownsership of tile data from build context to the caller.
 	int n = 0;
 	for (int i = 0; i < rcMin(rc.ntiles, maxTiles); ++i)
@@ -842,12 +1235,15 @@ NavMeshType_Obstacle::NavMeshType_Obstacle() :
 	m_drawMode(DRAWMODE_NAVMESH),
 	m_maxTiles(0),
 	m_maxPolysPerTile(0),
-	m_tileSize(48)
+	m_tileSize(48),
+	m_compressorType(NAVMESH_COMPRESSOR_FASTLZ),
+	m_maxObstacles(128),
+	m_maxObstaclesCap(DT_TILECACHE_MAX_OBSTACLES)
 {
 	resetNavMeshSettings();
 	
 	m_talloc = new LinearAllocator(32000);
-	m_tcomp = new FastLZCompressor;
+	m_tcomp = createTileCacheCompressor(m_compressorType);
 	m_tmproc = new MeshProcess;
 	m_tmproc->m_flagsAreaTable = &m_flagsAreaTable;
 	
@@ -859,6 +1255,8 @@ NavMeshType_Obstacle::~NavMeshType_Obstacle()
 	dtFreeNavMesh(m_navMesh);
 	m_navMesh = 0;
 	dtFreeTileCache(m_tileCache);
+	delete m_tcomp;
+	delete m_talloc;
 }
 
 //void NavMeshType_Obstacle::handleSettings()
@@ -1214,6 +1612,9 @@ bool NavMeshType_Obstacle::handleBuild()
 	}
 
 	m_tmproc->init(m_geom);
+	// Off-mesh connections and convex volumes are gathered per tile, even
+	// concurrently: index them first.
+	m_geom->updateSpatialIndexes();
 	
 	// Init cache
 	const float* bmin = m_geom->getNavMeshBoundsMin();
@@ -1226,26 +1627,7 @@ bool NavMeshType_Obstacle::handleBuild()
 
 	// Generation params.
 	rcConfig cfg;
-	memset(&cfg, 0, sizeof(cfg));
-	cfg.cs = m_cellSize;
-	cfg.ch = m_cellHeight;
-	cfg.walkableSlopeAngle = m_agentMaxSlope;
-	cfg.walkableHeight = (int)ceilf(m_agentHeight / cfg.ch);
-	cfg.walkableClimb = (int)floorf(m_agentMaxClimb / cfg.ch);
-	cfg.walkableRadius = (int)ceilf(m_agentRadius / cfg.cs);
-	cfg.maxEdgeLen = (int)(m_edgeMaxLen / m_cellSize);
-	cfg.maxSimplificationError = m_edgeMaxError;
-	cfg.minRegionArea = (int)rcSqr(m_regionMinSize);		// Note: area = size*size
-	cfg.mergeRegionArea = (int)rcSqr(m_regionMergeSize);	// Note: area = size*size
-	cfg.maxVertsPerPoly = (int)m_vertsPerPoly;
-	cfg.tileSize = (int)m_tileSize;
-	cfg.borderSize = cfg.walkableRadius + 3; // Reserve enough padding.
-	cfg.width = cfg.tileSize + cfg.borderSize*2;
-	cfg.height = cfg.tileSize + cfg.borderSize*2;
-	cfg.detailSampleDist = m_detailSampleDist < 0.9f ? 0 : m_cellSize * m_detailSampleDist;
-	cfg.detailSampleMaxError = m_cellHeight * m_detailSampleMaxError;
-	rcVcopy(cfg.bmin, bmin);
-	rcVcopy(cfg.bmax, bmax);
+	initConfig(cfg);
 	
 	// Tile cache params.
 	dtTileCacheParams tcparams;
@@ -1260,10 +1642,15 @@ bool NavMeshType_Obstacle::handleBuild()
 	tcparams.walkableClimb = m_agentMaxClimb;
 	tcparams.maxSimplificationError = m_edgeMaxError;
 	tcparams.maxTiles = tw*th*EXPECTED_LAYERS_PER_TILE;
-	tcparams.maxObstacles = 128;
+	tcparams.maxObstacles = m_maxObstacles;
+	tcparams.maxObstaclesCap = m_maxObstaclesCap;
 
 	dtFreeTileCache(m_tileCache);
 	
+	// Layers compressor (no tile cache refers to it now).
+	delete m_tcomp;
+	m_tcomp = createTileCacheCompressor(m_compressorType);
+	
 	m_tileCache = dtAllocTileCache();
 	if (!m_tileCache)
 	{
@@ -1301,7 +1688,7 @@ bool NavMeshType_Obstacle::handleBuild()
 		return false;
 	}
 	
-	status = m_navQuery->init(m_navMesh, 2048);
+	status = m_navQuery->init(m_navMesh, NAVMESH_QUERY_NODES, NAVMESH_QUERY_NODES_CAP);
 	if (dtStatusFailed(status))
 	{
 		CTXLOG(m_ctx, RC_LOG_ERROR, "buildTiledNavigation: Could not init Detour navmesh query");
@@ -1318,46 +1705,62 @@ bool NavMeshType_Obstacle::handleBuild()
 	m_cacheRawSize = 0;
 #endif
 	
-	for (int y = 0; y < th; ++y)
+	// Rasterize and compress the layers of all the tiles in parallel.
+	const int ntiles = tw*th;
+	std::vector<int> tiles(ntiles);
+	for (int i = 0; i < ntiles; ++i)
+		tiles[i] = i;
+	std::vector<TileCacheData> layers;
+	std::vector<int> nlayers;
+	rasterizeTilesLayers(cfg, tw, tiles, layers, nlayers);
+
+	// Add the layers in tile order, so the tile cache is the same as if
+	// they were built serially.
+	for (int i = 0; i < ntiles; ++i)
 	{
-		for (int x = 0; x < tw; ++x)
+		for (int j = 0; j < nlayers[i]; ++j)
 		{
-			TileCacheData tiles[MAX_LAYERS];
-			memset(tiles, 0, sizeof(tiles));
-			int ntiles = rasterizeTileLayers(x, y, cfg, tiles, MAX_LAYERS);
-
-			for (int i = 0; i < ntiles; ++i)
+			TileCacheData* tile = &layers[i*MAX_LAYERS + j];
+			status = m_tileCache->addTile(tile->data, tile->dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0);
+			if (dtStatusFailed(status))
 			{
-				TileCacheData* tile = &tiles[i];
-				status = m_tileCache->addTile(tile->data, tile->dataSize, DT_COMPRESSEDTILE_FREE_DATA, 0);
-				if (dtStatusFailed(status))
-				{
-					dtFree(tile->data);
-					tile->data = 0;
-					continue;
-				}
-				
+				dtFree(tile->data);
+				tile->data = 0;
+				continue;
+			}
+			
 #ifdef RN_DEBUG
-				m_cacheLayerCount++;
-				m_cacheCompressedSize += tile->dataSize;
-				m_cacheRawSize += calcLayerBufferSize(tcparams.width, tcparams.height);
+			m_cacheLayerCount++;
+			m_cacheCompressedSize += tile->dataSize;
+			m_cacheRawSize += calcLayerBufferSize(tcparams.width, tcparams.height);
 #endif
-			}
 		}
 	}
 
-	// Build initial meshes
+	// Build initial meshes: the tile data in parallel, then the tiles are
+	// added to the nav mesh in tile order.
 #ifdef RN_DEBUG
 	m_ctx->startTimer(RC_TIMER_TOTAL);
 #endif
+	std::vector<dtCompressedTileRef> refs;
+	refs.reserve(m_tileCache->getTileCount());
 	for (int y = 0; y < th; ++y)
+	{
 		for (int x = 0; x < tw; ++x)
-			m_tileCache->buildNavMeshTilesAt(x,y, m_navMesh);
+		{
+			dtCompressedTileRef tileRefs[MAX_LAYERS];
+			const int n = m_tileCache->getTilesAt(x, y, tileRefs, MAX_LAYERS);
+			refs.insert(refs.end(), tileRefs, tileRefs + n);
+		}
+	}
+	buildNavMeshTiles(refs);
 #ifdef RN_DEBUG
 	m_ctx->stopTimer(RC_TIMER_TOTAL);
 	
 	m_cacheBuildTimeMs = m_ctx->getAccumulatedTime(RC_TIMER_TOTAL)/1000.0f;
-	m_cacheBuildMemUsage = m_talloc->high;
+	ScratchStats scratchStats;
+	m_talloc->getStats(scratchStats);
+	m_cacheBuildMemUsage = (int)scratchStats.peakUsage;
 	
 
 	const dtNavMesh* nav = m_navMesh;
@@ -1388,6 +1791,108 @@ void NavMeshType_Obstacle::handleUpdate(const float dt)
 		return;
 	
 	m_tileCache->update(dt, m_navMesh);
+	resetNavMeshTempArena();
+}
+
+int NavMeshType_Obstacle::handleMeshRefresh(rcMeshLoaderObj* mesh)
+{
+	if (!m_geom || !m_navMesh || !m_tileCache)
+	{
+		delete mesh;
+		return -1;
+	}
+	
+	// Complete the pending obstacle requests: the obstacles must be in the
+	// tile cache before its tiles are replaced.
+	bool upToDate = false;
+	while (!upToDate)
+	{
+		if (dtStatusFailed(m_tileCache->update(0, m_navMesh, &upToDate)))
+		{
+			CTXLOG(m_ctx, RC_LOG_ERROR, "handleMeshRefresh: Could not update the tile cache.");
+			delete mesh;
+			return -1;
+		}
+	}
+	
+	// The geometry keeps its bounds, so does the tile grid.
+	const float* bmin = m_geom->getNavMeshBoundsMin();
+	const float* bmax = m_geom->getNavMeshBoundsMax();
+	int gw = 0, gh = 0;
+	rcCalcGridSize(bmin, bmax, m_cellSize, &gw, &gh);
+	const int ts = (int)m_tileSize;
+	const int tw = (gw + ts-1) / ts;
+	const int th = (gh + ts-1) / ts;
+	rcConfig cfg;
+	initConfig(cfg);
+	
+	m_geom->updateSpatialIndexes();
+	std::vector<uint64_t> oldHashes;
+	hashTiles(cfg, tw, th, oldHashes);
+	if (!m_geom->reloadMesh(m_ctx, mesh))
+	{
+		return -1;
+	}
+	std::vector<uint64_t> newHashes;
+	hashTiles(cfg, tw, th, newHashes);
+	
+	std::vector<int> tiles;
+	for (int i = 0; i < tw*th; ++i)
+	{
+		// Tiles whose inputs couldn't be hashed are rebuilt anyway.
+		if (!newHashes[i] || newHashes[i] != oldHashes[i])
+			tiles.push_back(i);
+	}
+	if (tiles.empty())
+	{
+		return 0;
+	}
+	
+	// Rasterize the layers of the changed tiles in parallel.
+	std::vector<TileCacheData> layers;
+	std::vector<int> nlayers;
+	rasterizeTilesLayers(cfg, tw, tiles, layers, nlayers);
+	
+	// Replace the layers of each tile, and remove its nav mesh tiles, since
+	// it could have less layers than before.
+	std::vector<dtCompressedTileRef> refs;
+	for (size_t t = 0; t < tiles.size(); ++t)
+	{
+		const int tx = tiles[t] % tw;
+		const int ty = tiles[t] / tw;
+		const dtMeshTile* navTiles[MAX_LAYERS];
+		const int n = m_navMesh->getTilesAt(tx, ty, navTiles, MAX_LAYERS);
+		for (int j = 0; j < n; ++j)
+		{
+			m_navMesh->removeTile(m_navMesh->getTileRef(navTiles[j]), 0, 0);
+		}
+		
+		unsigned char* data[MAX_LAYERS];
+		int dataSize[MAX_LAYERS];
+		dtCompressedTileRef tileRefs[MAX_LAYERS];
+		for (int j = 0; j < nlayers[t]; ++j)
+		{
+			data[j] = layers[t*MAX_LAYERS + j].data;
+			dataSize[j] = layers[t*MAX_LAYERS + j].dataSize;
+		}
+		dtStatus status = m_tileCache->replaceTilesAt(tx, ty, data, dataSize, nlayers[t],
+				DT_COMPRESSEDTILE_FREE_DATA, tileRefs);
+		if (dtStatusFailed(status))
+		{
+			CTXLOG2(m_ctx, RC_LOG_ERROR, "handleMeshRefresh: Could not replace the tiles at (%d,%d).", tx, ty);
+		}
+		for (int j = 0; j < nlayers[t]; ++j)
+		{
+			if (tileRefs[j])
+				refs.push_back(tileRefs[j]);
+			else
+				dtFree(data[j]);
+		}
+	}
+	
+	// Build the nav mesh tiles of the new layers.
+	buildNavMeshTiles(refs);
+	return (int)tiles.size();
 }
 
 void NavMeshType_Obstacle::getTilePos(const float* pos, int& tx, int& ty)
@@ -1404,11 +1909,18 @@ dtTileCache* NavMeshType_Obstacle::getTileCache()
 {
 	return m_tileCache;
 }
+void NavMeshType_Obstacle::getScratchStats(ScratchStats& stats)
+{
+	m_talloc->getStats(stats);
+}
 void NavMeshType_Obstacle::setTileSettings(const NavMeshTileSettings& settings)
 {
 	m_maxTiles = settings.m_maxTiles;
 	m_maxPolysPerTile = settings.m_maxPolysPerTile;
 	m_tileSize = settings.m_tileSize;
+	m_compressorType = settings.m_compressorType;
+	m_maxObstacles = settings.m_maxObstacles;
+	m_maxObstaclesCap = settings.m_maxObstaclesCap;
 }
 NavMeshTileSettings NavMeshType_Obstacle::getTileSettings()
 {
@@ -1416,6 +1928,9 @@ NavMeshTileSettings NavMeshType_Obstacle::getTileSettings()
 	settings.m_maxTiles = m_maxTiles;
 	settings.m_maxPolysPerTile = m_maxPolysPerTile;
 	settings.m_tileSize = m_tileSize;
+	settings.m_compressorType = m_compressorType;
+	settings.m_maxObstacles = m_maxObstacles;
+	settings.m_maxObstaclesCap = m_maxObstaclesCap;
 	return settings;
 }
 } //rnsup
@@ -40,7 +40,7 @@ protected:
 	bool m_keepInterResults;
 
 	struct LinearAllocator* m_talloc;
-	struct FastLZCompressor* m_tcomp;
+	struct dtTileCacheCompressor* m_tcomp;
 	struct MeshProcess* m_tmproc;
 
 	class dtTileCache* m_tileCache;
@@ -69,6 +69,9 @@ protected:
 	int m_maxTiles;
 	int m_maxPolysPerTile;
 	float m_tileSize;
+	int m_compressorType;
+	int m_maxObstacles;
+	int m_maxObstaclesCap;
 	
 public:
 	NavMeshType_Obstacle();
@@ -82,11 +85,26 @@ public:
 	virtual void handleMeshChanged(class InputGeom* geom);
 	virtual bool handleBuild();
 	virtual void handleUpdate(const float dt);
+	virtual int handleMeshRefresh(class rcMeshLoaderObj* mesh);
 
 	void setTileSettings(const NavMeshTileSettings& settings);
 	NavMeshTileSettings getTileSettings();
 	dtTileCache* getTileCache();
 
+	///Tile cache scratch memory statistics (all threads).
+	struct ScratchStats
+	{
+		// Highest amount of scratch memory used by a single tile build.
+		size_t peakUsage;
+		// Memory currently held by the per thread arenas.
+		size_t reservedSize;
+		// Number of per thread arenas.
+		int arenaCount;
+		// Times an arena had to allocate a new chunk while building.
+		int growCount;
+	};
+	void getScratchStats(ScratchStats& stats);
+
 	void getTilePos(const float* pos, int& tx, int& ty);
 	
 	void renderCachedTile(duDebugDraw& dd, const int tx, const int ty, const int type);
@@ -104,7 +122,16 @@ private:
 	NavMeshType_Obstacle(const NavMeshType_Obstacle&);
 	NavMeshType_Obstacle& operator=(const NavMeshType_Obstacle&);
 
-	int rasterizeTileLayers(const int tx, const int ty, const rcConfig& cfg, struct TileCacheData* tiles, const int maxTiles);
+	void initConfig(rcConfig& cfg) const;
+	void initTileConfig(const rcConfig& cfg, const int tx, const int ty, rcConfig& tcfg) const;
+	uint64_t getTileHash(const rcConfig& cfg, const int tx, const int ty,
+			const std::vector<float>* streamedVerts = 0) const;
+	void hashTiles(const rcConfig& cfg, const int tw, const int th, std::vector<uint64_t>& hashes) const;
+	void rasterizeTilesLayers(const rcConfig& cfg, const int tw, const std::vector<int>& tiles,
+			std::vector<struct TileCacheData>& layers, std::vector<int>& nlayers);
+	void buildNavMeshTiles(const std::vector<dtCompressedTileRef>& refs);
+	int rasterizeTileLayers(rcContext* ctx, struct dtTileCacheCompressor* comp,
+			const int tx, const int ty, const rcConfig& cfg, struct TileCacheData* tiles, const int maxTiles);
 };
 
 } // namespace rnsup
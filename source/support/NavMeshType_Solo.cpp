@@ -361,6 +361,35 @@ void NavMeshType_Solo::handleMeshChanged(class InputGeom* geom)
 }
 
 
+bool NavMeshType_Solo::initNavMesh(unsigned char* navData, const int navDataSize)
+{
+	m_navMesh = dtAllocNavMesh();
+	if (!m_navMesh)
+	{
+		dtFree(navData);
+		CTXLOG(m_ctx, RC_LOG_ERROR, "Could not create Detour navmesh");
+		return false;
+	}
+	
+	dtStatus status;
+	
+	status = m_navMesh->init(navData, navDataSize, DT_TILE_FREE_DATA);
+	if (dtStatusFailed(status))
+	{
+		dtFree(navData);
+		CTXLOG(m_ctx, RC_LOG_ERROR, "Could not init Detour navmesh");
+		return false;
+	}
+	
+	status = m_navQuery->init(m_navMesh, NAVMESH_QUERY_NODES, NAVMESH_QUERY_NODES_CAP);
+	if (dtStatusFailed(status))
+	{
+		CTXLOG(m_ctx, RC_LOG_ERROR, "Could not init Detour navmesh query");
+		return false;
+	}
+	return true;
+}
+
 bool NavMeshType_Solo::handleBuild()
 {
 	if (!m_geom || !m_geom->getMesh())
@@ -417,6 +446,44 @@ bool NavMeshType_Solo::handleBuild()
 	CTXLOG2(m_ctx, RC_LOG_PROGRESS, " - %.1fK verts, %.1fK tris", nverts/1000.0f, ntris/1000.0f);
 #endif
 	
+	// The nav mesh data is keyed by all the build inputs: on a build cache
+	// hit the next steps are skipped.
+	NavMeshBuildHash cacheKey;
+	if (m_buildCache.isEnabled())
+	{
+		hashBuildSettings(NAVMESH_BUILD_OUTPUT_SOLO, cacheKey);
+		cacheKey.add(&m_cfg, sizeof(m_cfg));
+		cacheKey.add(verts, sizeof(float)*3*nverts);
+		cacheKey.add(tris, sizeof(int)*3*ntris);
+		hashTerrain(m_cfg.bmin, m_cfg.bmax, cacheKey);
+		hashConvexVolumes(m_cfg.bmin, m_cfg.bmax, cacheKey);
+		const int noffMeshCons = m_geom->getOffMeshConnectionCount();
+		cacheKey.addInt(noffMeshCons);
+		cacheKey.add(m_geom->getOffMeshConnectionVerts(), sizeof(float)*3*2*noffMeshCons);
+		cacheKey.add(m_geom->getOffMeshConnectionRads(), sizeof(float)*noffMeshCons);
+		cacheKey.add(m_geom->getOffMeshConnectionDirs(), sizeof(unsigned char)*noffMeshCons);
+		cacheKey.add(m_geom->getOffMeshConnectionAreas(), sizeof(unsigned char)*noffMeshCons);
+		cacheKey.add(m_geom->getOffMeshConnectionFlags(), sizeof(unsigned short)*noffMeshCons);
+		cacheKey.add(m_geom->getOffMeshConnectionId(), sizeof(unsigned int)*noffMeshCons);
+		
+		unsigned char* navData = 0;
+		int navDataSize = 0;
+		if (m_buildCache.load(cacheKey.get(), &navData, &navDataSize))
+		{
+			if (!initNavMesh(navData, navDataSize))
+				return false;
+#ifdef RN_DEBUG
+			m_ctx->stopTimer(RC_TIMER_TOTAL);
+			CTXLOG1(m_ctx, RC_LOG_PROGRESS, ">> Loaded from the build cache: %d bytes", navDataSize);
+			m_totalBuildTimeMs = m_ctx->getAccumulatedTime(RC_TIMER_TOTAL)/1000.0f;
+#endif
+			if (m_tool)
+				m_tool->init(this);
+			initToolStates(this);
+			return true;
+		}
+	}
+	
 	//
 	// Step 2. Rasterize input polygon soup.
 	//
@@ -454,6 +521,13 @@ bool NavMeshType_Solo::handleBuild()
 		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Could not rasterize triangles.");
 		return false;
 	}
+	// The terrain is voxelized directly, column by column.
+	if (m_geom->getTerrain() &&
+		!m_geom->getTerrain()->rasterize(m_ctx, m_cfg.walkableSlopeAngle, m_cfg.walkableClimb, *m_solid))
+	{
+		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Could not rasterize the terrain.");
+		return false;
+	}
 
 	if (!m_keepInterResults)
 	{
@@ -468,12 +542,19 @@ bool NavMeshType_Solo::handleBuild()
 	// Once all geoemtry is rasterized, we do initial pass of filtering to
 	// remove unwanted overhangs caused by the conservative rasterization
 	// as well as filter spans where the character cannot possibly stand.
+	// The filters share a single column-compacted copy of the spans.
+	int filters = 0;
 	if (m_filterLowHangingObstacles)
-		rcFilterLowHangingWalkableObstacles(m_ctx, m_cfg.walkableClimb, *m_solid);
+		filters |= RC_FILTER_LOW_HANGING_OBSTACLES;
 	if (m_filterLedgeSpans)
-		rcFilterLedgeSpans(m_ctx, m_cfg.walkableHeight, m_cfg.walkableClimb, *m_solid);
+		filters |= RC_FILTER_LEDGE_SPANS;
 	if (m_filterWalkableLowHeightSpans)
-		rcFilterWalkableLowHeightSpans(m_ctx, m_cfg.walkableHeight, *m_solid);
+		filters |= RC_FILTER_WALKABLE_LOW_HEIGHT_SPANS;
+	if (!rcFilterWalkableSpans(m_ctx, filters, m_cfg.walkableHeight, m_cfg.walkableClimb, *m_solid))
+	{
+		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Could not filter walkable spans.");
+		return false;
+	}
 
 
 	//
@@ -509,9 +590,7 @@ bool NavMeshType_Solo::handleBuild()
 	}
 
 	// (Optional) Mark areas.
-	const ConvexVolume* vols = m_geom->getConvexVolumes();
-	for (int i  = 0; i < m_geom->getConvexVolumeCount(); ++i)
-		rcMarkConvexPolyArea(m_ctx, vols[i].verts, vols[i].nverts, vols[i].hmin, vols[i].hmax, (unsigned char)vols[i].area, *m_chf);
+	m_geom->markConvexVolumes(m_ctx, *m_chf);
 
 	
 	// Partition the heightfield so that we can use simple algorithm later to triangulate the walkable areas.
@@ -587,7 +666,8 @@ bool NavMeshType_Solo::handleBuild()
 		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Out of memory 'cset'.");
 		return false;
 	}
-	if (!rcBuildContours(m_ctx, *m_chf, m_cfg.maxSimplificationError, m_cfg.maxEdgeLen, *m_cset))
+	if (!rcBuildContours(m_ctx, *m_chf, m_cfg.maxSimplificationError, m_cfg.maxEdgeLen, *m_cset,
+			RC_CONTOUR_TESS_WALL_EDGES, m_parallelContours ? getBuildThreadCount() : 1))
 	{
 		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Could not create contours.");
 		return false;
@@ -621,7 +701,8 @@ bool NavMeshType_Solo::handleBuild()
 		return false;
 	}
 
-	if (!rcBuildPolyMeshDetail(m_ctx, *m_pmesh, *m_chf, m_cfg.detailSampleDist, m_cfg.detailSampleMaxError, *m_dmesh))
+	if (!rcBuildPolyMeshDetail(m_ctx, *m_pmesh, *m_chf, m_cfg.detailSampleDist, m_cfg.detailSampleMaxError, *m_dmesh,
+			m_parallelDetail ? getBuildThreadCount() : 1))
 	{
 		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Could not build detail mesh.");
 		return false;
@@ -710,6 +791,7 @@ bool NavMeshType_Solo::handleBuild()
 		params.cs = m_cfg.cs;
 		params.ch = m_cfg.ch;
 		params.buildBvTree = true;
+		params.buildDetailGrid = m_buildDetailGrid;
 		
 		if (!dtCreateNavMeshData(&params, &navData, &navDataSize))
 		{
@@ -717,30 +799,10 @@ bool NavMeshType_Solo::handleBuild()
 			return false;
 		}
 		
-		m_navMesh = dtAllocNavMesh();
-		if (!m_navMesh)
-		{
-			dtFree(navData);
-			CTXLOG(m_ctx, RC_LOG_ERROR, "Could not create Detour navmesh");
-			return false;
-		}
-		
-		dtStatus status;
-		
-		status = m_navMesh->init(navData, navDataSize, DT_TILE_FREE_DATA);
-		if (dtStatusFailed(status))
-		{
-			dtFree(navData);
-			CTXLOG(m_ctx, RC_LOG_ERROR, "Could not init Detour navmesh");
-			return false;
-		}
+		m_buildCache.store(cacheKey.get(), navData, navDataSize);
 		
-		status = m_navQuery->init(m_navMesh, 2048);
-		if (dtStatusFailed(status))
-		{
-			CTXLOG(m_ctx, RC_LOG_ERROR, "Could not init Detour navmesh query");
+		if (!initNavMesh(navData, navDataSize))
 			return false;
-		}
 	}
 	
 #ifdef RN_DEBUG
@@ -753,6 +815,9 @@ bool NavMeshType_Solo::handleBuild()
 	m_totalBuildTimeMs = m_ctx->getAccumulatedTime(RC_TIMER_TOTAL)/1000.0f;
 #endif
 	
+	// Recycle temp memory used by the build.
+	resetNavMeshTempArena();
+
 	if (m_tool)
 		m_tool->init(this);
 	initToolStates(this);
@@ -70,6 +70,7 @@ protected:
 	DrawMode m_drawMode;
 	
 	void cleanup();
+	bool initNavMesh(unsigned char* navData, const int navDataSize);
 		
 public:
 	NavMeshType_Solo();
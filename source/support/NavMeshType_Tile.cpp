@@ -744,7 +744,7 @@ bool NavMeshType_Tile::handleBuild()
 		return false;
 	}
 	
-	status = m_navQuery->init(m_navMesh, 2048);
+	status = m_navQuery->init(m_navMesh, NAVMESH_QUERY_NODES, NAVMESH_QUERY_NODES_CAP);
 	if (dtStatusFailed(status))
 	{
 		CTXLOG(m_ctx, RC_LOG_ERROR, "buildTiledNavigation: Could not init Detour navmesh query");
@@ -795,6 +795,8 @@ void NavMeshType_Tile::buildTile(const float* pos)
 #endif
 	int dataSize = 0;
 	unsigned char* data = buildTileMesh(tx, ty, m_lastBuiltTileBmin, m_lastBuiltTileBmax, dataSize);
+	// Recycle temp memory used by this tile.
+	resetNavMeshTempArena();
 
 	// Remove any previous data (navmesh owns and deletes the data).
 	m_navMesh->removeTile(m_navMesh->getTileRefAt(tx,ty,0),0,0);
@@ -883,6 +885,8 @@ void NavMeshType_Tile::buildAllTiles()
 			
 			int dataSize = 0;
 			unsigned char* data = buildTileMesh(x, y, m_lastBuiltTileBmin, m_lastBuiltTileBmax, dataSize);
+			// Recycle temp memory used by this tile.
+			resetNavMeshTempArena();
 			if (data)
 			{
 				// Remove any previous data (navmesh owns and deletes the data).
@@ -923,43 +927,27 @@ void NavMeshType_Tile::removeAllTiles()
 }
 
 
-unsigned char* NavMeshType_Tile::buildTileMesh(const int tx, const int ty, const float* bmin, const float* bmax, int& dataSize)
+void NavMeshType_Tile::initTileConfig(const float* bmin, const float* bmax, rcConfig& cfg) const
 {
-	if (!m_geom || !m_geom->getMesh() || !m_geom->getChunkyMesh())
-	{
-		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Input mesh is not specified.");
-		return 0;
-	}
-	
-	m_tileMemUsage = 0;
-	m_tileBuildTime = 0;
-	
-	cleanup();
-	
-	const float* verts = m_geom->getMesh()->getVerts();
-	const int nverts = m_geom->getMesh()->getVertCount();
-	const int ntris = m_geom->getMesh()->getTriCount();
-	const rcChunkyTriMesh* chunkyMesh = m_geom->getChunkyMesh();
-		
 	// Init build configuration from GUI
-	memset(&m_cfg, 0, sizeof(m_cfg));
-	m_cfg.cs = m_cellSize;
-	m_cfg.ch = m_cellHeight;
-	m_cfg.walkableSlopeAngle = m_agentMaxSlope;
-	m_cfg.walkableHeight = (int)ceilf(m_agentHeight / m_cfg.ch);
-	m_cfg.walkableClimb = (int)floorf(m_agentMaxClimb / m_cfg.ch);
-	m_cfg.walkableRadius = (int)ceilf(m_agentRadius / m_cfg.cs);
-	m_cfg.maxEdgeLen = (int)(m_edgeMaxLen / m_cellSize);
-	m_cfg.maxSimplificationError = m_edgeMaxError;
-	m_cfg.minRegionArea = (int)rcSqr(m_regionMinSize);		// Note: area = size*size
-	m_cfg.mergeRegionArea = (int)rcSqr(m_regionMergeSize);	// Note: area = size*size
-	m_cfg.maxVertsPerPoly = (int)m_vertsPerPoly;
-	m_cfg.tileSize = (int)m_tileSize;
-	m_cfg.borderSize = m_cfg.walkableRadius + 3; // Reserve enough padding.
-	m_cfg.width = m_cfg.tileSize + m_cfg.borderSize*2;
-	m_cfg.height = m_cfg.tileSize + m_cfg.borderSize*2;
-	m_cfg.detailSampleDist = m_detailSampleDist < 0.9f ? 0 : m_cellSize * m_detailSampleDist;
-	m_cfg.detailSampleMaxError = m_cellHeight * m_detailSampleMaxError;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.cs = m_cellSize;
+	cfg.ch = m_cellHeight;
+	cfg.walkableSlopeAngle = m_agentMaxSlope;
+	cfg.walkableHeight = (int)ceilf(m_agentHeight / cfg.ch);
+	cfg.walkableClimb = (int)floorf(m_agentMaxClimb / cfg.ch);
+	cfg.walkableRadius = (int)ceilf(m_agentRadius / cfg.cs);
+	cfg.maxEdgeLen = (int)(m_edgeMaxLen / m_cellSize);
+	cfg.maxSimplificationError = m_edgeMaxError;
+	cfg.minRegionArea = (int)rcSqr(m_regionMinSize);		// Note: area = size*size
+	cfg.mergeRegionArea = (int)rcSqr(m_regionMergeSize);	// Note: area = size*size
+	cfg.maxVertsPerPoly = (int)m_vertsPerPoly;
+	cfg.tileSize = (int)m_tileSize;
+	cfg.borderSize = cfg.walkableRadius + 3; // Reserve enough padding.
+	cfg.width = cfg.tileSize + cfg.borderSize*2;
+	cfg.height = cfg.tileSize + cfg.borderSize*2;
+	cfg.detailSampleDist = m_detailSampleDist < 0.9f ? 0 : m_cellSize * m_detailSampleDist;
+	cfg.detailSampleMaxError = m_cellHeight * m_detailSampleMaxError;
 	
 	// Expand the heighfield bounding box by border size to find the extents of geometry we need to build this tile.
 	//
@@ -982,12 +970,142 @@ unsigned char* NavMeshType_Tile::buildTileMesh(const int tx, const int ty, const
 	// For example if you build a navmesh for terrain, and want the navmesh tiles to match the terrain tile size
 	// you will need to pass in data from neighbour terrain tiles too! In a simple case, just pass in all the 8 neighbours,
 	// or use the bounding box below to only pass in a sliver of each of the 8 neighbours.
-	rcVcopy(m_cfg.bmin, bmin);
-	rcVcopy(m_cfg.bmax, bmax);
-	m_cfg.bmin[0] -= m_cfg.borderSize*m_cfg.cs;
-	m_cfg.bmin[2] -= m_cfg.borderSize*m_cfg.cs;
-	m_cfg.bmax[0] += m_cfg.borderSize*m_cfg.cs;
-	m_cfg.bmax[2] += m_cfg.borderSize*m_cfg.cs;
+	rcVcopy(cfg.bmin, bmin);
+	rcVcopy(cfg.bmax, bmax);
+	cfg.bmin[0] -= cfg.borderSize*cfg.cs;
+	cfg.bmin[2] -= cfg.borderSize*cfg.cs;
+	cfg.bmax[0] += cfg.borderSize*cfg.cs;
+	cfg.bmax[2] += cfg.borderSize*cfg.cs;
+}
+
+void NavMeshType_Tile::calcTileBounds(const int tx, const int ty, float* bmin, float* bmax) const
+{
+	const float* nbmin = m_geom->getNavMeshBoundsMin();
+	const float* nbmax = m_geom->getNavMeshBoundsMax();
+	const float tcs = m_tileSize*m_cellSize;
+	
+	bmin[0] = nbmin[0] + tx*tcs;
+	bmin[1] = nbmin[1];
+	bmin[2] = nbmin[2] + ty*tcs;
+	
+	bmax[0] = nbmin[0] + (tx+1)*tcs;
+	bmax[1] = nbmax[1];
+	bmax[2] = nbmin[2] + (ty+1)*tcs;
+}
+
+// Returns 0 if the inputs of the tile can't be loaded.
+uint64_t NavMeshType_Tile::getTileHash(const int tx, const int ty, const float* bmin, const float* bmax,
+		const std::vector<float>* streamedVerts) const
+{
+	rcConfig cfg;
+	initTileConfig(bmin, bmax, cfg);
+	NavMeshBuildHash hash;
+	hashBuildSettings(NAVMESH_BUILD_OUTPUT_TILE, hash);
+	hash.addInt(tx);
+	hash.addInt(ty);
+	if (!hashTileInput(cfg, true, hash, streamedVerts))
+		return 0;
+	return hash.get();
+}
+
+void NavMeshType_Tile::hashTiles(const int tw, const int th, std::vector<uint64_t>& hashes) const
+{
+	// Read only access to the geometry: the tiles are hashed in parallel.
+	const int ntiles = tw*th;
+	hashes.assign(ntiles, 0);
+	const int nthreads = rcMax(rcMin(getBuildThreadCount(), ntiles), 1);
+	runBuildJobs(ntiles, nthreads, [&](int /*w*/, int i)
+	{
+		float tbmin[3], tbmax[3];
+		calcTileBounds(i % tw, i / tw, tbmin, tbmax);
+		hashes[i] = getTileHash(i % tw, i / tw, tbmin, tbmax);
+	});
+}
+
+int NavMeshType_Tile::handleMeshRefresh(rcMeshLoaderObj* mesh)
+{
+	if (!m_geom || !m_navMesh)
+	{
+		delete mesh;
+		return -1;
+	}
+	
+	// The geometry keeps its bounds, so does the tile grid.
+	const float* bmin = m_geom->getNavMeshBoundsMin();
+	const float* bmax = m_geom->getNavMeshBoundsMax();
+	int gw = 0, gh = 0;
+	rcCalcGridSize(bmin, bmax, m_cellSize, &gw, &gh);
+	const int ts = (int)m_tileSize;
+	const int tw = (gw + ts-1) / ts;
+	const int th = (gh + ts-1) / ts;
+	
+	m_geom->updateSpatialIndexes();
+	std::vector<uint64_t> oldHashes;
+	hashTiles(tw, th, oldHashes);
+	if (!m_geom->reloadMesh(m_ctx, mesh))
+	{
+		return -1;
+	}
+	std::vector<uint64_t> newHashes;
+	hashTiles(tw, th, newHashes);
+	
+	// Rebuild the changed tiles: only those already built, unless all the
+	// tiles are.
+	int count = 0;
+	for (int y = 0; y < th; ++y)
+	{
+		for (int x = 0; x < tw; ++x)
+		{
+			const int i = x + y*tw;
+			// Tiles whose inputs couldn't be hashed are rebuilt anyway.
+			if (newHashes[i] && newHashes[i] == oldHashes[i])
+				continue;
+			const dtTileRef ref = m_navMesh->getTileRefAt(x,y,0);
+			if (!ref && !m_buildAll)
+				continue;
+			
+			calcTileBounds(x, y, m_lastBuiltTileBmin, m_lastBuiltTileBmax);
+			int dataSize = 0;
+			unsigned char* data = buildTileMesh(x, y, m_lastBuiltTileBmin, m_lastBuiltTileBmax, dataSize);
+			// Recycle temp memory used by this tile.
+			resetNavMeshTempArena();
+			// Remove the previous data (navmesh owns and deletes the data),
+			// also when the tile is now empty.
+			m_navMesh->removeTile(ref,0,0);
+			if (data)
+			{
+				// Let the navmesh own the data.
+				dtStatus status = m_navMesh->addTile(data,dataSize,DT_TILE_FREE_DATA,0,0);
+				if (dtStatusFailed(status))
+					dtFree(data);
+			}
+			++count;
+		}
+	}
+	return count;
+}
+
+unsigned char* NavMeshType_Tile::buildTileMesh(const int tx, const int ty, const float* bmin, const float* bmax, int& dataSize)
+{
+	if (!m_geom || !m_geom->getMesh() || (!m_geom->getChunkyMesh() && !m_geom->getBucketStore()))
+	{
+		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Input mesh is not specified.");
+		return 0;
+	}
+	// Off-mesh connections and convex volumes are gathered per tile.
+	m_geom->updateSpatialIndexes();
+	
+	m_tileMemUsage = 0;
+	m_tileBuildTime = 0;
+	
+	cleanup();
+	
+	const float* verts = m_geom->getMesh()->getVerts();
+	const int nverts = m_geom->getMesh()->getVertCount();
+	const int ntris = m_geom->getMesh()->getTriCount();
+	const rcChunkyTriMesh* chunkyMesh = m_geom->getChunkyMesh();
+		
+	initTileConfig(bmin, bmax, m_cfg);
 	
 #ifdef RN_DEBUG
 	// Reset build times gathering.
@@ -1001,6 +1119,32 @@ unsigned char* NavMeshType_Tile::buildTileMesh(const int tx, const int ty, const
 	CTXLOG2(m_ctx,RC_LOG_PROGRESS, " - %.1fK verts, %.1fK tris", nverts/1000.0f, ntris/1000.0f);
 	
 #endif
+	// The tile data is keyed by the inputs of the tile: on a build cache hit
+	// the build is skipped, so only the tiles whose inputs changed are rebuilt.
+	// A streamed mesh is loaded once, for both the key and the rasterization.
+	std::vector<float> sverts;
+	std::vector<int> stris;
+	if (m_geom->getBucketStore() && !loadStreamedTriangles(m_ctx, m_cfg, sverts, stris))
+		return 0;
+	uint64_t cacheKey = 0;
+	if (m_buildCache.isEnabled())
+	{
+		cacheKey = getTileHash(tx, ty, bmin, bmax, &sverts);
+		
+		unsigned char* navData = 0;
+		int navDataSize = 0;
+		if (m_buildCache.load(cacheKey, &navData, &navDataSize))
+		{
+			m_tileMemUsage = navDataSize/1024.0f;
+#ifdef RN_DEBUG
+			m_ctx->stopTimer(RC_TIMER_TOTAL);
+			m_tileBuildTime = m_ctx->getAccumulatedTime(RC_TIMER_TOTAL)/1000.0f;
+#endif
+			dataSize = navDataSize;
+			return navData;
+		}
+	}
+	
 	// Allocate voxel heightfield where we rasterize our input data to.
 	m_solid = rcAllocHeightfield();
 	if (!m_solid)
@@ -1014,43 +1158,61 @@ unsigned char* NavMeshType_Tile::buildTileMesh(const int tx, const int ty, const
 		return 0;
 	}
 	
-	// Allocate array that can hold triangle flags.
-	// If you have multiple meshes you need to process, allocate
-	// and array which can hold the max number of triangles you need to process.
-	m_triareas = new unsigned char[chunkyMesh->maxTrisPerChunk];
-	if (!m_triareas)
+	// A tile is empty without triangles and terrain.
+	const TerrainHeightfield* terrain = m_geom->getTerrain();
+	int terrainRange[4];
+	const bool hasTerrain = terrain && terrain->getSampleRange(m_cfg.bmin, m_cfg.bmax, terrainRange);
+	
+	if (m_geom->getBucketStore())
 	{
-		CTXLOG1(m_ctx, RC_LOG_ERROR, "buildNavigation: Out of memory 'm_triareas' (%d).", chunkyMesh->maxTrisPerChunk);
-		return 0;
+		// Streamed mesh: only the triangles of this tile are loaded.
+		m_tileTriCount = rasterizeStreamedTriangles(m_ctx, m_cfg, sverts, stris, *m_solid);
+		if (m_tileTriCount < 0 || (!m_tileTriCount && !hasTerrain))
+			return 0;
 	}
-	
-	float tbmin[2], tbmax[2];
-	tbmin[0] = m_cfg.bmin[0];
-	tbmin[1] = m_cfg.bmin[2];
-	tbmax[0] = m_cfg.bmax[0];
-	tbmax[1] = m_cfg.bmax[2];
-	int cid[512];// TODO: Make grow when returning too many items.
-	const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid, 512);
-	if (!ncid)
-		return 0;
-	
-	m_tileTriCount = 0;
-	
-	for (int i = 0; i < ncid; ++i)
+	else
 	{
-		const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
-		const int* ctris = &chunkyMesh->tris[node.i*3];
-		const int nctris = node.n;
+		// Allocate array that can hold triangle flags.
+		// If you have multiple meshes you need to process, allocate
+		// and array which can hold the max number of triangles you need to process.
+		m_triareas = new unsigned char[chunkyMesh->maxTrisPerChunk];
+		if (!m_triareas)
+		{
+			CTXLOG1(m_ctx, RC_LOG_ERROR, "buildNavigation: Out of memory 'm_triareas' (%d).", chunkyMesh->maxTrisPerChunk);
+			return 0;
+		}
 		
-		m_tileTriCount += nctris;
+		float tbmin[2], tbmax[2];
+		tbmin[0] = m_cfg.bmin[0];
+		tbmin[1] = m_cfg.bmin[2];
+		tbmax[0] = m_cfg.bmax[0];
+		tbmax[1] = m_cfg.bmax[2];
+		int cid[512];// TODO: Make grow when returning too many items.
+		const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid, 512);
+		if (!ncid && !hasTerrain)
+			return 0;
 		
-		memset(m_triareas, 0, nctris*sizeof(unsigned char));
-		rcMarkWalkableTriangles(m_ctx, m_cfg.walkableSlopeAngle,
-								verts, nverts, ctris, nctris, m_triareas);
+		m_tileTriCount = 0;
 		
-		if (!rcRasterizeTriangles(m_ctx, verts, nverts, ctris, m_triareas, nctris, *m_solid, m_cfg.walkableClimb))
-			return 0;
+		for (int i = 0; i < ncid; ++i)
+		{
+			const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
+			const int* ctris = &chunkyMesh->tris[node.i*3];
+			const int nctris = node.n;
+		
+			m_tileTriCount += nctris;
+		
+			memset(m_triareas, 0, nctris*sizeof(unsigned char));
+			rcMarkWalkableTriangles(m_ctx, m_cfg.walkableSlopeAngle,
+									verts, nverts, ctris, nctris, m_triareas);
+		
+			if (!rcRasterizeTriangles(m_ctx, verts, nverts, ctris, m_triareas, nctris, *m_solid, m_cfg.walkableClimb))
+				return 0;
+		}
 	}
+	// The terrain is voxelized directly, column by column.
+	if (hasTerrain && !terrain->rasterize(m_ctx, m_cfg.walkableSlopeAngle, m_cfg.walkableClimb, *m_solid))
+		return 0;
 	
 	if (!m_keepInterResults)
 	{
@@ -1061,12 +1223,19 @@ unsigned char* NavMeshType_Tile::buildTileMesh(const int tx, const int ty, const
 	// Once all geometry is rasterized, we do initial pass of filtering to
 	// remove unwanted overhangs caused by the conservative rasterization
 	// as well as filter spans where the character cannot possibly stand.
+	// The filters share a single column-compacted copy of the spans.
+	int filters = 0;
 	if (m_filterLowHangingObstacles)
-		rcFilterLowHangingWalkableObstacles(m_ctx, m_cfg.walkableClimb, *m_solid);
+		filters |= RC_FILTER_LOW_HANGING_OBSTACLES;
 	if (m_filterLedgeSpans)
-		rcFilterLedgeSpans(m_ctx, m_cfg.walkableHeight, m_cfg.walkableClimb, *m_solid);
+		filters |= RC_FILTER_LEDGE_SPANS;
 	if (m_filterWalkableLowHeightSpans)
-		rcFilterWalkableLowHeightSpans(m_ctx, m_cfg.walkableHeight, *m_solid);
+		filters |= RC_FILTER_WALKABLE_LOW_HEIGHT_SPANS;
+	if (!rcFilterWalkableSpans(m_ctx, filters, m_cfg.walkableHeight, m_cfg.walkableClimb, *m_solid))
+	{
+		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Could not filter walkable spans.");
+		return 0;
+	}
 	
 	// Compact the heightfield so that it is faster to handle from now on.
 	// This will result more cache coherent data as well as the neighbours
@@ -1097,9 +1266,7 @@ unsigned char* NavMeshType_Tile::buildTileMesh(const int tx, const int ty, const
 	}
 
 	// (Optional) Mark areas.
-	const ConvexVolume* vols = m_geom->getConvexVolumes();
-	for (int i  = 0; i < m_geom->getConvexVolumeCount(); ++i)
-		rcMarkConvexPolyArea(m_ctx, vols[i].verts, vols[i].nverts, vols[i].hmin, vols[i].hmax, (unsigned char)vols[i].area, *m_chf);
+	m_geom->markConvexVolumes(m_ctx, *m_chf);
 	
 	
 	// Partition the heightfield so that we can use simple algorithm later to triangulate the walkable areas.
@@ -1171,7 +1338,8 @@ unsigned char* NavMeshType_Tile::buildTileMesh(const int tx, const int ty, const
 		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Out of memory 'cset'.");
 		return 0;
 	}
-	if (!rcBuildContours(m_ctx, *m_chf, m_cfg.maxSimplificationError, m_cfg.maxEdgeLen, *m_cset))
+	if (!rcBuildContours(m_ctx, *m_chf, m_cfg.maxSimplificationError, m_cfg.maxEdgeLen, *m_cset,
+			RC_CONTOUR_TESS_WALL_EDGES, m_parallelContours ? getBuildThreadCount() : 1))
 	{
 		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Could not create contours.");
 		return 0;
@@ -1205,7 +1373,7 @@ unsigned char* NavMeshType_Tile::buildTileMesh(const int tx, const int ty, const
 	
 	if (!rcBuildPolyMeshDetail(m_ctx, *m_pmesh, *m_chf,
 							   m_cfg.detailSampleDist, m_cfg.detailSampleMaxError,
-							   *m_dmesh))
+							   *m_dmesh, m_parallelDetail ? getBuildThreadCount() : 1))
 	{
 		CTXLOG(m_ctx, RC_LOG_ERROR, "buildNavigation: Could build polymesh detail.");
 		return 0;
@@ -1275,13 +1443,15 @@ unsigned char* NavMeshType_Tile::buildTileMesh(const int tx, const int ty, const
 		params.detailVertsCount = m_dmesh->nverts;
 		params.detailTris = m_dmesh->tris;
 		params.detailTriCount = m_dmesh->ntris;
-		params.offMeshConVerts = m_geom->getOffMeshConnectionVerts();
-		params.offMeshConRad = m_geom->getOffMeshConnectionRads();
-		params.offMeshConDir = m_geom->getOffMeshConnectionDirs();
-		params.offMeshConAreas = m_geom->getOffMeshConnectionAreas();
-		params.offMeshConFlags = m_geom->getOffMeshConnectionFlags();
-		params.offMeshConUserID = m_geom->getOffMeshConnectionId();
-		params.offMeshConCount = m_geom->getOffMeshConnectionCount();
+		// Only the off-mesh connections with an endpoint in the tile matter.
+		m_geom->gatherOffMeshConnections(m_pmesh->bmin, m_pmesh->bmax, m_offMeshCons);
+		params.offMeshConVerts = m_offMeshCons.verts.data();
+		params.offMeshConRad = m_offMeshCons.rads.data();
+		params.offMeshConDir = m_offMeshCons.dirs.data();
+		params.offMeshConAreas = m_offMeshCons.areas.data();
+		params.offMeshConFlags = m_offMeshCons.flags.data();
+		params.offMeshConUserID = m_offMeshCons.ids.data();
+		params.offMeshConCount = m_offMeshCons.count;
 		params.walkableHeight = m_agentHeight;
 		params.walkableRadius = m_agentRadius;
 		params.walkableClimb = m_agentMaxClimb;
@@ -1293,12 +1463,15 @@ unsigned char* NavMeshType_Tile::buildTileMesh(const int tx, const int ty, const
 		params.cs = m_cfg.cs;
 		params.ch = m_cfg.ch;
 		params.buildBvTree = true;
+		params.buildDetailGrid = m_buildDetailGrid;
 		
 		if (!dtCreateNavMeshData(&params, &navData, &navDataSize))
 		{
 			CTXLOG(m_ctx, RC_LOG_ERROR, "Could not build Detour navmesh.");
 			return 0;
 		}		
+		
+		m_buildCache.store(cacheKey, navData, navDataSize);
 	}
 	m_tileMemUsage = navDataSize/1024.0f;
 	
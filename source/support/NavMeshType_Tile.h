@@ -82,9 +82,15 @@ protected:
 	float m_lastBuiltTileBmax[3];
 	float m_tileBuildTime;
 	float m_tileMemUsage;
+	OffMeshConnectionSet m_offMeshCons;
 	int m_tileTriCount;
 
 	unsigned char* buildTileMesh(const int tx, const int ty, const float* bmin, const float* bmax, int& dataSize);
+	void initTileConfig(const float* bmin, const float* bmax, rcConfig& cfg) const;
+	void calcTileBounds(const int tx, const int ty, float* bmin, float* bmax) const;
+	uint64_t getTileHash(const int tx, const int ty, const float* bmin, const float* bmax,
+			const std::vector<float>* streamedVerts = 0) const;
+	void hashTiles(const int tw, const int th, std::vector<uint64_t>& hashes) const;
 	
 	void cleanup();
 	
@@ -103,6 +109,7 @@ public:
 	virtual void handleMeshChanged(class InputGeom* geom);
 	virtual bool handleBuild();
 	virtual void collectSettings(struct BuildSettings& settings);
+	virtual int handleMeshRefresh(class rcMeshLoaderObj* mesh);
 	
 	void setTileSettings(const NavMeshTileSettings& settings);
 	NavMeshTileSettings getTileSettings();
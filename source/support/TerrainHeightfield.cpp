@@ -0,0 +1,198 @@
+/**
+ * \file TerrainHeightfield.cpp
+ *
+ * \date 2026-10-19
+ * \author consultit
+ */
+
+#include <math.h>
+#include "TerrainHeightfield.h"
+#include <Recast.h>
+#include <RecastAssert.h>
+
+namespace rnsup
+{
+
+TerrainHeightfield::TerrainHeightfield() :
+		m_width(0), m_height(0)
+{
+	m_orig[0] = m_orig[1] = m_orig[2] = 0;
+	m_spacing[0] = m_spacing[1] = 0;
+	m_bmin[0] = m_bmin[1] = m_bmin[2] = 0;
+	m_bmax[0] = m_bmax[1] = m_bmax[2] = 0;
+}
+
+bool TerrainHeightfield::init(const float* heights, const int width,
+		const int height, const float* orig, const float* spacing)
+{
+	if ((width < 2) || (height < 2) || (spacing[0] <= 0) || (spacing[1] <= 0))
+	{
+		return false;
+	}
+	m_heights.assign(heights, heights + width * height);
+	m_width = width;
+	m_height = height;
+	rcVcopy(m_orig, orig);
+	m_spacing[0] = spacing[0];
+	m_spacing[1] = spacing[1];
+	float hmin = m_heights[0], hmax = m_heights[0];
+	for (int i = 1; i < width * height; ++i)
+	{
+		hmin = rcMin(hmin, m_heights[i]);
+		hmax = rcMax(hmax, m_heights[i]);
+	}
+	m_bmin[0] = orig[0];
+	m_bmin[1] = orig[1] + hmin;
+	m_bmin[2] = orig[2];
+	m_bmax[0] = orig[0] + (width - 1) * spacing[0];
+	m_bmax[1] = orig[1] + hmax;
+	m_bmax[2] = orig[2] + (height - 1) * spacing[1];
+	return true;
+}
+
+bool TerrainHeightfield::getSampleRange(const float* bmin, const float* bmax,
+		int* r) const
+{
+	if (m_heights.empty() || (bmin[0] > m_bmax[0]) || (bmax[0] < m_bmin[0])
+			|| (bmin[2] > m_bmax[2]) || (bmax[2] < m_bmin[2]))
+	{
+		return false;
+	}
+	r[0] = rcClamp((int) floorf((bmin[0] - m_orig[0]) / m_spacing[0]), 0, m_width - 1);
+	r[1] = rcClamp((int) floorf((bmin[2] - m_orig[2]) / m_spacing[1]), 0, m_height - 1);
+	r[2] = rcClamp((int) ceilf((bmax[0] - m_orig[0]) / m_spacing[0]), 0, m_width - 1);
+	r[3] = rcClamp((int) ceilf((bmax[2] - m_orig[2]) / m_spacing[1]), 0, m_height - 1);
+	return true;
+}
+
+void TerrainHeightfield::getCell(const float x, const float z, int& i, int& j,
+		float& tx, float& tz) const
+{
+	const float fx = rcClamp((x - m_orig[0]) / m_spacing[0], 0.0f, (float) (m_width - 1));
+	const float fz = rcClamp((z - m_orig[2]) / m_spacing[1], 0.0f, (float) (m_height - 1));
+	i = rcMin((int) fx, m_width - 2);
+	j = rcMin((int) fz, m_height - 2);
+	tx = fx - i;
+	tz = fz - j;
+}
+
+float TerrainHeightfield::getHeightAt(const float x, const float z) const
+{
+	int i, j;
+	float tx, tz;
+	getCell(x, z, i, j, tx, tz);
+	const float* h = &m_heights[i + j * m_width];
+	const float h0 = h[0] + (h[1] - h[0]) * tx;
+	const float h1 = h[m_width] + (h[m_width + 1] - h[m_width]) * tx;
+	return m_orig[1] + h0 + (h1 - h0) * tz;
+}
+
+bool TerrainHeightfield::rasterize(rcContext* ctx, const float walkableSlopeAngle,
+		const int flagMergeThr, rcHeightfield& solid) const
+{
+	rcAssert(ctx);
+
+	rcScopedTimer timer(ctx, RC_TIMER_RASTERIZE_TRIANGLES);
+
+	if (m_heights.empty())
+	{
+		return true;
+	}
+	const float walkableThr = cosf(walkableSlopeAngle / 180.0f * RC_PI);
+	const float cs = solid.cs;
+	const float ics = 1.0f / solid.cs;
+	const float ich = 1.0f / solid.ch;
+	const float by = solid.bmax[1] - solid.bmin[1];
+
+	// The columns over the terrain.
+	const int x0 = rcMax((int) floorf((m_bmin[0] - solid.bmin[0]) * ics), 0);
+	const int x1 = rcMin((int) floorf((m_bmax[0] - solid.bmin[0]) * ics), solid.width - 1);
+	const int z0 = rcMax((int) floorf((m_bmin[2] - solid.bmin[2]) * ics), 0);
+	const int z1 = rcMin((int) floorf((m_bmax[2] - solid.bmin[2]) * ics), solid.height - 1);
+
+	// The extremes of a bilinear patch over a rectangle are at its corners:
+	// those of the column are at its corners, at the samples within it and
+	// where the sample rows and columns cross its sides.
+	std::vector<float> xs, zs;
+	for (int z = z0; z <= z1; ++z)
+	{
+		const float cz0 = rcMax(solid.bmin[2] + z * cs, m_bmin[2]);
+		const float cz1 = rcMin(solid.bmin[2] + (z + 1) * cs, m_bmax[2]);
+		if (cz0 >= cz1)
+			continue;
+		zs.clear();
+		zs.push_back(cz0);
+		for (int j = (int) ceilf((cz0 - m_orig[2]) / m_spacing[1]);
+				m_orig[2] + j * m_spacing[1] < cz1; ++j)
+		{
+			const float sz = m_orig[2] + j * m_spacing[1];
+			if (sz > cz0)
+				zs.push_back(sz);
+		}
+		zs.push_back(cz1);
+
+		for (int x = x0; x <= x1; ++x)
+		{
+			const float cx0 = rcMax(solid.bmin[0] + x * cs, m_bmin[0]);
+			const float cx1 = rcMin(solid.bmin[0] + (x + 1) * cs, m_bmax[0]);
+			if (cx0 >= cx1)
+				continue;
+			xs.clear();
+			xs.push_back(cx0);
+			for (int i = (int) ceilf((cx0 - m_orig[0]) / m_spacing[0]);
+					m_orig[0] + i * m_spacing[0] < cx1; ++i)
+			{
+				const float sx = m_orig[0] + i * m_spacing[0];
+				if (sx > cx0)
+					xs.push_back(sx);
+			}
+			xs.push_back(cx1);
+
+			float smin = getHeightAt(xs[0], zs[0]);
+			float smax = smin;
+			for (int k = 0; k < (int) zs.size(); ++k)
+			{
+				for (int l = 0; l < (int) xs.size(); ++l)
+				{
+					const float h = getHeightAt(xs[l], zs[k]);
+					smin = rcMin(smin, h);
+					smax = rcMax(smax, h);
+				}
+			}
+
+			// Slope at the column center, from the gradient of the patch:
+			// the normal is (-dh/dx, 1, -dh/dz) normalized.
+			int i, j;
+			float tx, tz;
+			getCell((cx0 + cx1) * 0.5f, (cz0 + cz1) * 0.5f, i, j, tx, tz);
+			const float* h = &m_heights[i + j * m_width];
+			const float gx = ((h[1] - h[0]) * (1.0f - tz)
+					+ (h[m_width + 1] - h[m_width]) * tz) / m_spacing[0];
+			const float gz = ((h[m_width] - h[0]) * (1.0f - tx)
+					+ (h[m_width + 1] - h[1]) * tx) / m_spacing[1];
+			const unsigned char area =
+					1.0f / sqrtf(1.0f + gx * gx + gz * gz) > walkableThr ?
+							RC_WALKABLE_AREA : RC_NULL_AREA;
+
+			// As for the triangles.
+			smin -= solid.bmin[1];
+			smax -= solid.bmin[1];
+			// Skip the span if it is outside the heightfield bbox
+			if (smax < 0.0f) continue;
+			if (smin > by) continue;
+			// Clamp the span to the heightfield bbox.
+			if (smin < 0.0f) smin = 0;
+			if (smax > by) smax = by;
+
+			// Snap the span to the heightfield height grid.
+			unsigned short ismin = (unsigned short)rcClamp((int)floorf(smin * ich), 0, RC_SPAN_MAX_HEIGHT);
+			unsigned short ismax = (unsigned short)rcClamp((int)ceilf(smax * ich), (int)ismin+1, RC_SPAN_MAX_HEIGHT);
+
+			if (!rcAddSpan(ctx, solid, x, z, ismin, ismax, area, flagMergeThr))
+				return false;
+		}
+	}
+	return true;
+}
+
+} // namespace rnsup
@@ -0,0 +1,68 @@
+/**
+ * \file TerrainHeightfield.h
+ *
+ * \date 2026-10-19
+ * \author consultit
+ */
+
+#ifndef TERRAINHEIGHTFIELD_H_
+#define TERRAINHEIGHTFIELD_H_
+
+#include <vector>
+
+struct rcHeightfield;
+class rcContext;
+
+namespace rnsup
+{
+
+///Terrain given as a regular grid of height samples, bilinearly interpolated.
+///It is voxelized directly, column by column, instead of being triangulated
+///and rasterized: its cost depends on the number of columns, not of
+///triangles.
+class TerrainHeightfield
+{
+public:
+	TerrainHeightfield();
+
+	///Sets the width x height (at least 2 x 2) height samples, row major:
+	///sample (i, j) is at (orig[0] + i*spacing[0], orig[1] + heights[i+j*width],
+	///orig[2] + j*spacing[1]).
+	bool init(const float* heights, const int width, const int height,
+			const float* orig, const float* spacing);
+
+	int getWidth() const { return m_width; }
+	int getHeight() const { return m_height; }
+	const float* getHeights() const { return m_heights.data(); }
+	const float* getOrigin() const { return m_orig; }
+	const float* getSpacing() const { return m_spacing; }
+	const float* getBoundsMin() const { return m_bmin; }
+	const float* getBoundsMax() const { return m_bmax; }
+
+	///Gets the range of samples (i0, j0, i1, j1) whose cells overlap the
+	///xz-bounds [bmin, bmax] (3D). Returns false if there is none.
+	bool getSampleRange(const float* bmin, const float* bmax, int* r) const;
+	///Returns the height at the xz-position, clamped to the terrain.
+	float getHeightAt(const float x, const float z) const;
+
+	///Adds to solid a span for each of its columns over the terrain, from the
+	///lowest to the highest terrain height in the column. The span is walkable
+	///if the slope at the column center, from the height gradient, is less
+	///than walkableSlopeAngle (degrees). Can be called concurrently.
+	bool rasterize(rcContext* ctx, const float walkableSlopeAngle,
+			const int flagMergeThr, rcHeightfield& solid) const;
+
+private:
+	void getCell(const float x, const float z, int& i, int& j, float& tx,
+			float& tz) const;
+
+	std::vector<float> m_heights;
+	int m_width, m_height;
+	float m_orig[3];
+	float m_spacing[2];
+	float m_bmin[3], m_bmax[3];
+};
+
+} // namespace rnsup
+
+#endif /* TERRAINHEIGHTFIELD_H_ */
@@ -0,0 +1,531 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+/**
+ * \file TriMeshBVH.cpp
+ *
+ * \date 2026-10-19
+ * \author consultit
+ */
+
+#include "TriMeshBVH.h"
+#include <Recast.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#	include <xmmintrin.h>
+#	define RC_BVH_SSE
+#endif
+
+// Number of bins per axis for the SAH.
+static const int BVH_NUM_BINS = 16;
+// Depth past which nodes are split at the median, to bound the traversal stack.
+static const int BVH_MAX_SAH_DEPTH = 32;
+static const int BVH_MAX_STACK = 64;
+// Relative costs of a node traversal and of a packet test.
+static const float BVH_TRAVERSAL_COST = 1.0f;
+static const float BVH_PACKET_COST = 1.0f;
+
+struct BVHItem
+{
+	float bmin[3];
+	float bmax[3];
+	float c[3];
+};
+
+struct BVHBuildContext
+{
+	const BVHItem* items;
+	int* ids;
+	rnsup::rcTriMeshBVHNode* nodes;
+	int nnodes;
+	int* leafTris;
+	int maxTrisPerLeaf;
+	int npackets;
+};
+
+inline int bvhPacketCount(const int ntris)
+{
+	return (ntris + rnsup::RC_BVH_PACKET_SIZE-1) / rnsup::RC_BVH_PACKET_SIZE;
+}
+
+inline void bvhResetBounds(float* bmin, float* bmax)
+{
+	bmin[0] = bmin[1] = bmin[2] = FLT_MAX;
+	bmax[0] = bmax[1] = bmax[2] = -FLT_MAX;
+}
+
+inline void bvhGrowBounds(float* bmin, float* bmax, const float* imin, const float* imax)
+{
+	for (int k = 0; k < 3; ++k)
+	{
+		if (imin[k] < bmin[k]) bmin[k] = imin[k];
+		if (imax[k] > bmax[k]) bmax[k] = imax[k];
+	}
+}
+
+inline float bvhHalfArea(const float* bmin, const float* bmax)
+{
+	const float dx = bmax[0] - bmin[0];
+	const float dy = bmax[1] - bmin[1];
+	const float dz = bmax[2] - bmin[2];
+	return dx*dy + dy*dz + dz*dx;
+}
+
+struct BVHBinPredicate
+{
+	const BVHItem* items;
+	int axis;
+	float cmin, scale;
+	int split;
+	bool operator()(const int id) const
+	{
+		int b = (int)((items[id].c[axis] - cmin) * scale);
+		if (b >= BVH_NUM_BINS) b = BVH_NUM_BINS-1;
+		return b < split;
+	}
+};
+
+struct BVHCentroidLess
+{
+	const BVHItem* items;
+	int axis;
+	bool operator()(const int a, const int b) const
+	{
+		// Ties broken by index, for a deterministic tree.
+		if (items[a].c[axis] != items[b].c[axis])
+			return items[a].c[axis] < items[b].c[axis];
+		return a < b;
+	}
+};
+
+// Finds the best SAH split of ids[imin, imax), returns the position of the
+// split, or -1 if keeping a leaf is cheaper.
+static int findSAHSplit(BVHBuildContext& ctx, const int imin, const int imax,
+						const float* bmin, const float* bmax,
+						const float* cmin, const float* cmax, int& axis)
+{
+	const int n = imax - imin;
+	const float leafCost = bvhPacketCount(n) * BVH_PACKET_COST;
+	float bestCost = FLT_MAX;
+	int bestAxis = -1, bestSplit = -1;
+
+	for (int k = 0; k < 3; ++k)
+	{
+		const float extent = cmax[k] - cmin[k];
+		if (extent <= 0.0f)
+			continue;
+		const float scale = BVH_NUM_BINS / extent;
+
+		int counts[BVH_NUM_BINS];
+		float binMin[BVH_NUM_BINS][3], binMax[BVH_NUM_BINS][3];
+		for (int b = 0; b < BVH_NUM_BINS; ++b)
+		{
+			counts[b] = 0;
+			bvhResetBounds(binMin[b], binMax[b]);
+		}
+		for (int i = imin; i < imax; ++i)
+		{
+			const BVHItem& it = ctx.items[ctx.ids[i]];
+			int b = (int)((it.c[k] - cmin[k]) * scale);
+			if (b >= BVH_NUM_BINS) b = BVH_NUM_BINS-1;
+			counts[b]++;
+			bvhGrowBounds(binMin[b], binMax[b], it.bmin, it.bmax);
+		}
+
+		// Sweep from the right, then from the left.
+		float rightArea[BVH_NUM_BINS];
+		int rightCount[BVH_NUM_BINS];
+		float rmin[3], rmax[3];
+		bvhResetBounds(rmin, rmax);
+		int rcount = 0;
+		for (int b = BVH_NUM_BINS-1; b > 0; --b)
+		{
+			rcount += counts[b];
+			if (counts[b])
+				bvhGrowBounds(rmin, rmax, binMin[b], binMax[b]);
+			rightCount[b] = rcount;
+			rightArea[b] = rcount ? bvhHalfArea(rmin, rmax) : 0.0f;
+		}
+		float lmin[3], lmax[3];
+		bvhResetBounds(lmin, lmax);
+		int lcount = 0;
+		for (int b = 1; b < BVH_NUM_BINS; ++b)
+		{
+			lcount += counts[b-1];
+			if (counts[b-1])
+				bvhGrowBounds(lmin, lmax, binMin[b-1], binMax[b-1]);
+			if (!lcount || !rightCount[b])
+				continue;
+			const float cost = bvhHalfArea(lmin, lmax) * bvhPacketCount(lcount) +
+				rightArea[b] * bvhPacketCount(rightCount[b]);
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = k;
+				bestSplit = b;
+			}
+		}
+	}
+
+	if (bestAxis < 0)
+		return -1;
+	const float area = bvhHalfArea(bmin, bmax);
+	const float splitCost = BVH_TRAVERSAL_COST +
+		(area > 0.0f ? bestCost / area : 0.0f) * BVH_PACKET_COST;
+	if (n <= ctx.maxTrisPerLeaf && splitCost >= leafCost)
+		return -1;
+
+	BVHBinPredicate pred;
+	pred.items = ctx.items;
+	pred.axis = bestAxis;
+	pred.cmin = cmin[bestAxis];
+	pred.scale = BVH_NUM_BINS / (cmax[bestAxis] - cmin[bestAxis]);
+	pred.split = bestSplit;
+	axis = bestAxis;
+	return (int)(std::partition(ctx.ids+imin, ctx.ids+imax, pred) - ctx.ids);
+}
+
+static void subdivideBVH(BVHBuildContext& ctx, const int imin, const int imax, const int depth)
+{
+	const int inode = ctx.nnodes++;
+	float bmin[3], bmax[3], cmin[3], cmax[3];
+	bvhResetBounds(bmin, bmax);
+	bvhResetBounds(cmin, cmax);
+	for (int i = imin; i < imax; ++i)
+	{
+		const BVHItem& it = ctx.items[ctx.ids[i]];
+		bvhGrowBounds(bmin, bmax, it.bmin, it.bmax);
+		bvhGrowBounds(cmin, cmax, it.c, it.c);
+	}
+	rcVcopy(ctx.nodes[inode].bmin, bmin);
+	rcVcopy(ctx.nodes[inode].bmax, bmax);
+
+	const int n = imax - imin;
+	int axis = 0;
+	int isplit = -1;
+	if (n > 1)
+	{
+		if (depth < BVH_MAX_SAH_DEPTH)
+			isplit = findSAHSplit(ctx, imin, imax, bmin, bmax, cmin, cmax, axis);
+		if (isplit < 0 && n > ctx.maxTrisPerLeaf)
+		{
+			// Too many triangles for a leaf: split at the median of the
+			// longest centroid axis.
+			const float ex = cmax[0] - cmin[0];
+			const float ey = cmax[1] - cmin[1];
+			const float ez = cmax[2] - cmin[2];
+			axis = (ey > ex) ? ((ez > ey) ? 2 : 1) : ((ez > ex) ? 2 : 0);
+			isplit = imin + n/2;
+			BVHCentroidLess less;
+			less.items = ctx.items;
+			less.axis = axis;
+			std::nth_element(ctx.ids+imin, ctx.ids+isplit, ctx.ids+imax, less);
+		}
+	}
+
+	rnsup::rcTriMeshBVHNode& node = ctx.nodes[inode];
+	if (isplit < 0)
+	{
+		// Leaf, packets are filled later in ids order.
+		ctx.leafTris[inode] = n;
+		node.i = ctx.npackets;
+		node.n = (short)bvhPacketCount(n);
+		node.axis = 0;
+		ctx.npackets += node.n;
+		return;
+	}
+
+	subdivideBVH(ctx, imin, isplit, depth+1);
+	ctx.nodes[inode].i = ctx.nnodes;
+	ctx.nodes[inode].n = 0;
+	ctx.nodes[inode].axis = (short)axis;
+	subdivideBVH(ctx, isplit, imax, depth+1);
+}
+
+// Per segment data of the raycast.
+struct BVHSegment
+{
+	float sp[3];
+	float qp[3];		///< sp - sq, as in the scalar segment/triangle test.
+	float invd[3];
+	bool parallel[3];
+};
+
+static const float BVH_PARALLEL_EPS = 1e-6f;
+// Slack on the segment parameter of the box tests, so that rounding never
+// culls a triangle hit.
+static const float BVH_SEGMENT_EPS = 1e-4f;
+
+inline bool overlapSegmentNode(const BVHSegment& seg, const rnsup::rcTriMeshBVHNode& node,
+							   const float tmaxSeg)
+{
+	float tmin = -BVH_SEGMENT_EPS;
+	float tmax = tmaxSeg + BVH_SEGMENT_EPS;
+	for (int k = 0; k < 3; ++k)
+	{
+		if (seg.parallel[k])
+		{
+			if (seg.sp[k] < node.bmin[k] || seg.sp[k] > node.bmax[k])
+				return false;
+		}
+		else
+		{
+			float t1 = (node.bmin[k] - seg.sp[k]) * seg.invd[k];
+			float t2 = (node.bmax[k] - seg.sp[k]) * seg.invd[k];
+			if (t1 > t2) { float tmp = t1; t1 = t2; t2 = tmp; }
+			if (t1 > tmin) tmin = t1;
+			if (t2 < tmax) tmax = t2;
+			if (tmin > tmax) return false;
+		}
+	}
+	return true;
+}
+
+// Intersects the segment with the triangles of a packet, at once. The
+// operations are the ones of the scalar test, in the same order, so the hit
+// parameters are the same.
+inline bool intersectSegmentPacket(const BVHSegment& seg, const rnsup::rcTriMeshBVHPacket& p,
+								   float& tmin)
+{
+	bool hit = false;
+#ifdef RC_BVH_SSE
+	const __m128 qpx = _mm_set1_ps(seg.qp[0]);
+	const __m128 qpy = _mm_set1_ps(seg.qp[1]);
+	const __m128 qpz = _mm_set1_ps(seg.qp[2]);
+	const __m128 nx = _mm_loadu_ps(p.norm[0]);
+	const __m128 ny = _mm_loadu_ps(p.norm[1]);
+	const __m128 nz = _mm_loadu_ps(p.norm[2]);
+	const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qpx, nx), _mm_mul_ps(qpy, ny)), _mm_mul_ps(qpz, nz));
+	const __m128 zero = _mm_setzero_ps();
+	__m128 mask = _mm_cmpgt_ps(d, zero);
+	if (!_mm_movemask_ps(mask))
+		return false;
+	const __m128 apx = _mm_sub_ps(_mm_set1_ps(seg.sp[0]), _mm_loadu_ps(p.a[0]));
+	const __m128 apy = _mm_sub_ps(_mm_set1_ps(seg.sp[1]), _mm_loadu_ps(p.a[1]));
+	const __m128 apz = _mm_sub_ps(_mm_set1_ps(seg.sp[2]), _mm_loadu_ps(p.a[2]));
+	const __m128 t = _mm_add_ps(_mm_add_ps(_mm_mul_ps(apx, nx), _mm_mul_ps(apy, ny)), _mm_mul_ps(apz, nz));
+	mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmple_ps(t, d)));
+	if (!_mm_movemask_ps(mask))
+		return false;
+	const __m128 ex = _mm_sub_ps(_mm_mul_ps(qpy, apz), _mm_mul_ps(qpz, apy));
+	const __m128 ey = _mm_sub_ps(_mm_mul_ps(qpz, apx), _mm_mul_ps(qpx, apz));
+	const __m128 ez = _mm_sub_ps(_mm_mul_ps(qpx, apy), _mm_mul_ps(qpy, apx));
+	const __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(p.ac[0]), ex),
+			_mm_mul_ps(_mm_loadu_ps(p.ac[1]), ey)), _mm_mul_ps(_mm_loadu_ps(p.ac[2]), ez));
+	const __m128 w = _mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(p.ab[0]), ex),
+			_mm_mul_ps(_mm_loadu_ps(p.ab[1]), ey)), _mm_mul_ps(_mm_loadu_ps(p.ab[2]), ez)));
+	mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(v, d)));
+	mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(w, zero), _mm_cmple_ps(_mm_add_ps(v, w), d)));
+	int bits = _mm_movemask_ps(mask);
+	if (!bits)
+		return false;
+	float tt[4];
+	_mm_storeu_ps(tt, _mm_div_ps(t, d));
+	for (int l = 0; bits; ++l, bits >>= 1)
+	{
+		if ((bits & 1) && tt[l] < tmin)
+		{
+			tmin = tt[l];
+			hit = true;
+		}
+	}
+#else
+	for (int l = 0; l < rnsup::RC_BVH_PACKET_SIZE; ++l)
+	{
+		const float d = seg.qp[0]*p.norm[0][l] + seg.qp[1]*p.norm[1][l] + seg.qp[2]*p.norm[2][l];
+		if (d <= 0.0f) continue;
+		float ap[3], e[3];
+		ap[0] = seg.sp[0] - p.a[0][l];
+		ap[1] = seg.sp[1] - p.a[1][l];
+		ap[2] = seg.sp[2] - p.a[2][l];
+		float t = ap[0]*p.norm[0][l] + ap[1]*p.norm[1][l] + ap[2]*p.norm[2][l];
+		if (t < 0.0f || t > d) continue;
+		rcVcross(e, seg.qp, ap);
+		const float v = p.ac[0][l]*e[0] + p.ac[1][l]*e[1] + p.ac[2][l]*e[2];
+		if (v < 0.0f || v > d) continue;
+		const float w = -(p.ab[0][l]*e[0] + p.ab[1][l]*e[1] + p.ab[2][l]*e[2]);
+		if (w < 0.0f || v + w > d) continue;
+		t /= d;
+		if (t < tmin)
+		{
+			tmin = t;
+			hit = true;
+		}
+	}
+#endif
+	return hit;
+}
+
+namespace rnsup
+{
+
+bool rcCreateTriMeshBVH(const float* verts, const int* tris, int ntris,
+						int maxPacketsPerLeaf, rcTriMeshBVH* bvh)
+{
+	delete [] bvh->nodes;
+	bvh->nodes = 0;
+	bvh->nnodes = 0;
+	delete [] bvh->packets;
+	bvh->packets = 0;
+	bvh->npackets = 0;
+	bvh->ntris = ntris;
+	if (ntris <= 0)
+		return true;
+
+	BVHItem* items = new BVHItem[ntris];
+	int* ids = new int[ntris];
+	int* leafTris = new int[ntris*2];
+	bvh->nodes = new rcTriMeshBVHNode[ntris*2];
+	if (!items || !ids || !leafTris || !bvh->nodes)
+	{
+		delete [] items;
+		delete [] ids;
+		delete [] leafTris;
+		return false;
+	}
+
+	for (int i = 0; i < ntris; ++i)
+	{
+		const int* t = &tris[i*3];
+		BVHItem& it = items[i];
+		rcVcopy(it.bmin, &verts[t[0]*3]);
+		rcVcopy(it.bmax, &verts[t[0]*3]);
+		for (int j = 1; j < 3; ++j)
+			bvhGrowBounds(it.bmin, it.bmax, &verts[t[j]*3], &verts[t[j]*3]);
+		for (int k = 0; k < 3; ++k)
+			it.c[k] = (it.bmin[k] + it.bmax[k]) * 0.5f;
+		ids[i] = i;
+	}
+
+	BVHBuildContext ctx;
+	ctx.items = items;
+	ctx.ids = ids;
+	ctx.nodes = bvh->nodes;
+	ctx.nnodes = 0;
+	ctx.leafTris = leafTris;
+	ctx.maxTrisPerLeaf = rcMax(maxPacketsPerLeaf, 1) * RC_BVH_PACKET_SIZE;
+	ctx.npackets = 0;
+	subdivideBVH(ctx, 0, ntris, 0);
+	bvh->nnodes = ctx.nnodes;
+
+	bvh->packets = new rcTriMeshBVHPacket[ctx.npackets];
+	if (!bvh->packets)
+	{
+		delete [] items;
+		delete [] ids;
+		delete [] leafTris;
+		return false;
+	}
+	bvh->npackets = ctx.npackets;
+
+	// Fill the packets of the leaves, which are in ids order.
+	int curTri = 0;
+	for (int i = 0; i < bvh->nnodes; ++i)
+	{
+		const rcTriMeshBVHNode& node = bvh->nodes[i];
+		if (node.n == 0)
+			continue;
+		memset(&bvh->packets[node.i], 0, sizeof(rcTriMeshBVHPacket)*node.n);
+		for (int j = 0; j < leafTris[i]; ++j)
+		{
+			rcTriMeshBVHPacket& p = bvh->packets[node.i + j/RC_BVH_PACKET_SIZE];
+			const int l = j % RC_BVH_PACKET_SIZE;
+			const int* t = &tris[ids[curTri++]*3];
+			float ab[3], ac[3], norm[3];
+			rcVsub(ab, &verts[t[1]*3], &verts[t[0]*3]);
+			rcVsub(ac, &verts[t[2]*3], &verts[t[0]*3]);
+			rcVcross(norm, ab, ac);
+			for (int k = 0; k < 3; ++k)
+			{
+				p.a[k][l] = verts[t[0]*3+k];
+				p.ab[k][l] = ab[k];
+				p.ac[k][l] = ac[k];
+				p.norm[k][l] = norm[k];
+			}
+		}
+	}
+
+	delete [] items;
+	delete [] ids;
+	delete [] leafTris;
+	return true;
+}
+
+bool rcRaycastTriMeshBVH(const rcTriMeshBVH* bvh, const float* sp, const float* sq, float& tmin)
+{
+	tmin = 1.0f;
+	if (!bvh->nnodes)
+		return false;
+
+	BVHSegment seg;
+	rcVcopy(seg.sp, sp);
+	rcVsub(seg.qp, sp, sq);
+	for (int k = 0; k < 3; ++k)
+	{
+		const float d = sq[k] - sp[k];
+		seg.parallel[k] = fabsf(d) < BVH_PARALLEL_EPS;
+		seg.invd[k] = seg.parallel[k] ? 0.0f : 1.0f / d;
+	}
+
+	// The nearest hit so far also bounds the box tests.
+	float best = FLT_MAX;
+	bool hit = false;
+	int stack[BVH_MAX_STACK];
+	int nstack = 0;
+	int i = 0;
+	for (;;)
+	{
+		const rcTriMeshBVHNode& node = bvh->nodes[i];
+		if (overlapSegmentNode(seg, node, hit ? best : 1.0f))
+		{
+			if (node.n > 0)
+			{
+				for (int j = 0; j < node.n; ++j)
+				{
+					if (intersectSegmentPacket(seg, bvh->packets[node.i + j], best))
+						hit = true;
+				}
+			}
+			else
+			{
+				// Visit the nearest child first.
+				int first = i+1, second = node.i;
+				if (seg.qp[node.axis] > 0.0f)
+				{
+					first = node.i;
+					second = i+1;
+				}
+				stack[nstack++] = second;
+				i = first;
+				continue;
+			}
+		}
+		if (!nstack)
+			break;
+		i = stack[--nstack];
+	}
+
+	if (hit)
+		tmin = best;
+	return hit;
+}
+
+} // namespace rnsup
@@ -0,0 +1,87 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+/**
+ * \file TriMeshBVH.h
+ *
+ * \date 2026-10-19
+ * \author consultit
+ */
+
+#ifndef TRIMESHBVH_H
+#define TRIMESHBVH_H
+
+#include "common.h"
+
+namespace rnsup
+{
+/// Number of triangles tested at once by the raycast.
+static const int RC_BVH_PACKET_SIZE = 4;
+
+/// Node of a flattened BVH: nodes are stored depth first, so the first child
+/// of an internal node is the next node.
+struct rcTriMeshBVHNode
+{
+	float bmin[3];
+	float bmax[3];
+	int i;				///< Leaf: first packet. Internal: index of the second child.
+	short n;			///< Leaf: number of packets. Internal: 0.
+	short axis;			///< Internal: split axis, to visit the nearest child first.
+};
+
+/// Triangles of a leaf, in struct of arrays layout, for the segment test.
+/// Unused slots hold degenerate triangles, which are never hit.
+struct rcTriMeshBVHPacket
+{
+	float a[3][RC_BVH_PACKET_SIZE];		///< First vertex.
+	float ab[3][RC_BVH_PACKET_SIZE];	///< First edge.
+	float ac[3][RC_BVH_PACKET_SIZE];	///< Second edge.
+	float norm[3][RC_BVH_PACKET_SIZE];	///< Unnormalized normal: ab x ac.
+};
+
+/// 3D bounding volume hierarchy over a triangle mesh, built with the binned
+/// surface area heuristic, for raycasts against the input geometry.
+struct rcTriMeshBVH
+{
+	inline rcTriMeshBVH() : nodes(0), nnodes(0), packets(0), npackets(0), ntris(0) {};
+	inline ~rcTriMeshBVH() { delete [] nodes; delete [] packets; }
+
+	rcTriMeshBVHNode* nodes;
+	int nnodes;
+	rcTriMeshBVHPacket* packets;
+	int npackets;
+	int ntris;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	rcTriMeshBVH(const rcTriMeshBVH&);
+	rcTriMeshBVH& operator=(const rcTriMeshBVH&);
+};
+
+/// Creates the BVH of a triangle mesh, where each leaf contains at max
+/// maxPacketsPerLeaf packets of triangles.
+bool rcCreateTriMeshBVH(const float* verts, const int* tris, int ntris,
+						int maxPacketsPerLeaf, rcTriMeshBVH* bvh);
+
+/// Intersects the segment [sp, sq] with the triangles facing sp.
+/// Returns true on hit, with tmin the parameter of the nearest hit along the
+/// segment.
+bool rcRaycastTriMeshBVH(const rcTriMeshBVH* bvh, const float* sp, const float* sq, float& tmin);
+
+} // namespace rnsup
+
+#endif // TRIMESHBVH_H